@@ -0,0 +1,249 @@
+#include "networking/messageFormatting.hpp"
+#include "networking/socket.hpp"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <netinet/in.h>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * serverLoad
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Load generator for a running server, built with -DDFD_BENCH=ON.
+ *
+ *   $ dfdl-server-load <server ip> <server port> [connections] [requests]
+ *
+ * Opens every connection at once, the way a crowd of clients would arrive,
+ * and sends each one's requests one after another, each once the last is
+ * answered. Requests are SOURCE_REQUESTs for a uuid no one has indexed, so
+ * they go to the server's read workers and change nothing. A request's
+ * latency runs from when it was queued, or from when the connection was
+ * started for a connection's first, to when its reply is whole.
+ *
+ * The target is every request answered, with a p99 under LOAD_TARGET_P99_MS,
+ * for LOAD_CONNECTIONS connections against a server on the same machine with
+ * the default SERVER_REACTOR_LOOPS and SERVER_HANDLER_THREADS. Exits with
+ * EXIT_FAILURE if it's missed.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+
+//connections opened if none are given
+#define LOAD_CONNECTIONS 10000
+
+//requests each connection sends if none are given
+#define LOAD_REQUESTS 1
+
+//how long the run has before whatever's unanswered counts as failed, in ms
+#define LOAD_DEADLINE_MS 60000
+
+//the p99 latency the target allows, in ms
+#define LOAD_TARGET_P99_MS 1000
+
+//a uuid no client will have indexed
+#define LOAD_UUID 0xDFD0BE4C4ULL
+
+using Clock = std::chrono::steady_clock;
+
+//one client connection
+struct LoadConn {
+    bool              connected = false;
+    size_t            answered  = 0;
+    Clock::time_point started;
+    dfd::FrameReader  in;
+    dfd::FrameWriter  out;
+};
+
+//lets the process have a socket for every connection, if it's allowed to
+static void raiseFdLimit(size_t wanted) {
+    struct rlimit lim;
+    if (getrlimit(RLIMIT_NOFILE, &lim) < 0)
+        return;
+    rlim_t want = std::min<rlim_t>(lim.rlim_max, wanted + 64);
+    if (lim.rlim_cur < want) {
+        lim.rlim_cur = want;
+        setrlimit(RLIMIT_NOFILE, &lim);
+    }
+}
+
+//changes what epoll waits on for a socket
+static void watch(int epoll_fd, int fd, uint32_t events, int op) {
+    struct epoll_event ev{};
+    ev.events  = events;
+    ev.data.fd = fd;
+    epoll_ctl(epoll_fd, op, fd, &ev);
+}
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * sendNext
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Sends what's queued on a connection, and watches for the reply once it's
+ *    all gone or for room on the socket if it hasn't.
+ *
+ * Takes:
+ * -> epoll_fd:
+ *    The epoll instance watching the connection.
+ * -> fd:
+ *    The connection's socket.
+ * -> conn:
+ *    The connection.
+ *
+ * Returns:
+ * -> false if the connection broke, true otherwise.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+static bool sendNext(int epoll_fd, int fd, LoadConn& conn) {
+    int res = dfd::tcp::sendQueued(fd, conn.out);
+    if (res < 0)
+        return false;
+    watch(epoll_fd, fd, res == 1 ? (uint32_t)EPOLLIN : (uint32_t)EPOLLOUT, EPOLL_CTL_MOD);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "USAGE: " << argv[0] << " <server ip> <server port> [connections] [requests]"
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    struct sockaddr_in server{};
+    server.sin_family = AF_INET;
+    server.sin_port   = htons(std::atoi(argv[2]));
+    if (inet_pton(AF_INET, argv[1], &server.sin_addr) != 1) {
+        std::cerr << "[err] Not an IPv4 address: " << argv[1] << std::endl;
+        return EXIT_FAILURE;
+    }
+    size_t connections = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : LOAD_CONNECTIONS;
+    size_t requests    = argc > 4 ? std::strtoull(argv[4], nullptr, 10) : LOAD_REQUESTS;
+    if (connections == 0 || requests == 0) {
+        std::cerr << "[err] Need at least one connection and one request." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    raiseFdLimit(connections);
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) {
+        std::cerr << "[err] Could not create an epoll instance." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const std::vector<uint8_t>        request = dfd::createSourceRequest(LOAD_UUID);
+    std::unordered_map<int, LoadConn> conns;
+    std::vector<double>               latencies;
+    size_t                            failed = 0;
+    latencies.reserve(connections * requests);
+
+    //every connection at once
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < connections; ++i) {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            failed += requests; //out of descriptors, the limit's too low
+            continue;
+        }
+        if (connect(fd, (struct sockaddr*)&server, sizeof(server)) < 0 && errno != EINPROGRESS) {
+            close(fd);
+            failed += requests;
+            continue;
+        }
+
+        LoadConn& conn = conns[fd];
+        conn.started   = Clock::now();
+        dfd::tcp::queueFrame(conn.out, request);
+        watch(epoll_fd, fd, EPOLLOUT, EPOLL_CTL_ADD);
+    }
+    Clock::duration opening = Clock::now() - start;
+
+    std::vector<struct epoll_event> events(1024);
+    Clock::time_point               deadline = start + std::chrono::milliseconds(LOAD_DEADLINE_MS);
+    while (!conns.empty() && Clock::now() < deadline) {
+        int ready = epoll_wait(epoll_fd, events.data(), events.size(), 100);
+        for (int i = 0; i < ready; ++i) {
+            auto it = conns.find(events[i].data.fd);
+            if (it == conns.end())
+                continue;
+
+            int       fd   = it->first;
+            LoadConn& conn = it->second;
+            bool      keep = !(events[i].events & EPOLLERR);
+
+            if (keep && !conn.connected && (events[i].events & EPOLLOUT)) {
+                int       err = 0;
+                socklen_t len = sizeof(err);
+                getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len);
+                conn.connected = err == 0;
+                keep           = conn.connected;
+            }
+            if (keep && (events[i].events & EPOLLOUT))
+                keep = sendNext(epoll_fd, fd, conn);
+
+            //keep alives are skipped by recvFrame, anything returned is the reply
+            int res = 0;
+            if (keep && (events[i].events & (EPOLLIN | EPOLLHUP)))
+                res = dfd::tcp::recvFrame(fd, conn.in, CONTROL_MESSAGE_MAX);
+            if (res == 1) {
+                latencies.push_back(std::chrono::duration<double, std::milli>(
+                    Clock::now() - conn.started).count());
+                conn.answered++;
+                if (conn.answered < requests) {
+                    conn.started = Clock::now();
+                    dfd::tcp::queueFrame(conn.out, request);
+                    keep = sendNext(epoll_fd, fd, conn);
+                } else {
+                    close(fd);
+                    conns.erase(fd);
+                    continue;
+                }
+            }
+
+            if (!keep || res < 0) {
+                failed += requests - conn.answered;
+                close(fd);
+                conns.erase(fd);
+            }
+        }
+    }
+
+    //out of time
+    for (auto& [fd, conn] : conns) {
+        failed += requests - conn.answered;
+        close(fd);
+    }
+    close(epoll_fd);
+    double took = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&latencies](double p) {
+        if (latencies.empty())
+            return 0.0;
+        return latencies[std::min(latencies.size() - 1, size_t(p * latencies.size()))];
+    };
+    double p99 = percentile(0.99);
+
+    std::cout << "connections: " << connections << ", requests each: " << requests << "\n"
+              << "opened in:   " << std::chrono::duration<double, std::milli>(opening).count() << " ms\n"
+              << "answered:    " << latencies.size() << ", failed: " << failed << "\n"
+              << "p50:         " << percentile(0.50) << " ms\n"
+              << "p99:         " << p99 << " ms\n"
+              << "max:         " << (latencies.empty() ? 0.0 : latencies.back()) << " ms\n"
+              << "throughput:  " << latencies.size() / took << " requests/s\n";
+
+    bool met = failed == 0 && p99 < LOAD_TARGET_P99_MS;
+    std::cout << "target:      every request answered, p99 under " << LOAD_TARGET_P99_MS << " ms, "
+              << (met ? "met" : "MISSED") << std::endl;
+    return met ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -8,7 +8,9 @@ namespace dfd {
 void run_client(const std::string& ip,
                uint16_t           port,
                const std::string& download_dir,
-               const std::string& listen_addr);
+               const std::string& listen_addr,
+               const std::string& hash_scheme,
+               bool               dedup);
 
 }
 
@@ -7,9 +7,6 @@
 
 namespace dfd {
 
-#define MAX_PEER_THREADS 5
-
-
 /*
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  * clientListener
@@ -18,14 +15,14 @@ namespace dfd {
  * -> Opens a socket to listen for incoming connections. Records the port it
  *    opened on in the provided atomic uint16_t. This function is designed to be
  *    opened as a thread that can be flagged for shutdown, and is not detatched.
- *    This function will join all seedThreads it has open before returning
- *    itself.
+ *    Every peer is seeded to from this thread's seedEngine(), which joins its
+ *    workers before this function returns.
  *
  * Takes:
  * -> shutdown:
  *    A atomic bool that, if set True, this function will make its best effort
- *    to exit as fast as possible to by joined, only delayed by joined all
- *    threads it's currently managing first.
+ *    to exit as fast as possible to by joined, only delayed by the seed
+ *    workers finishing the request they're on.
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  */
 void clientListener(      std::atomic<bool>&               shutdown,
@@ -1,13 +1,21 @@
 #pragma once
 
+#include "networking/messageFormatting.hpp"
 #include "sourceInfo.hpp"
 
 #include <cstdint>
 #include <memory>
+#include <string>
 #include <vector>
 
+//chunk size to ask peers to send with, 0 to let them fit it to the file. worth
+//raising on fast LANs, where bigger chunks mean fewer round trips
+#define DOWNLOAD_CHUNK_SIZE 0
+
 namespace dfd {
 
+struct DownloadFile;
+
 /*
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  * selectPeerSource
@@ -38,7 +46,17 @@ int selectPeerSource(std::vector<bool>& f_stats);
  *    provided peer. If successful, f_name and f_size will be set with the
  *    information obtained in the DOWNLOAD_CONFIRM message so calculations for
  *    how many threads to open for the remaining chunks can occur, as well as
- *    file_ptr for the actual file to compile chunks into.
+ *    file for the download threads to write the remaining chunks into.
+ *
+ *    The chunk size is DOWNLOAD_CHUNK_SIZE, or whatever the peer picks for the
+ *    file. Resuming an interrupted download instead asks for the size it was
+ *    started with, reconnecting to ask again if needed. Every other peer of
+ *    the download has to send with the same size.
+ *
+ *    Before any chunks, the peer is asked for the file's chunk manifest, which
+ *    every chunk of the download is then checked against. Peers without one
+ *    are downloaded from unverified, but one sending a manifest that doesn't
+ *    match f_uuid is treated as a failure.
  *
  * Takes:
  * -> f_uuid:
@@ -47,9 +65,11 @@ int selectPeerSource(std::vector<bool>& f_stats);
  *    A reference to a std::string to store the file name on success.
  * -> f_size:
  *    A reference to a uint64_t to store the file size on success.
- * -> file_ptr:
- *    A reference to a std::unique_ptr<std::ofstream> that, on success, will be
- *    set to the open file and, on failure, will be left alone.
+ * -> file:
+ *    On success, set to the download file with the first chunk written to it.
+ *    If an earlier attempt at this download was interrupted, it's resumed and
+ *    the first chunk is only fetched if it was missing. On failure, left
+ *    alone.
  * -> peer:
  *    The peer to attempt connecting to.
  * -> connection_timeout:
@@ -67,9 +87,50 @@ int selectPeerSource(std::vector<bool>& f_stats);
 int attemptInitialChunkDownload(const  uint64_t                        f_uuid,       
                                        std::string&                    f_name,
                                        uint64_t&                       f_size,
-                                       std::unique_ptr<std::ofstream>& file_ptr,
+                                       std::shared_ptr<DownloadFile>&  file,
                                 const  SourceInfo&                     peer,
                                 struct timeval                         connection_timeout,
                                 struct timeval                         response_timeout);
 
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * attemptBundleManifest
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Opens a bundle session with a peer just to ask for the bundle's manifest,
+ *    its list of files. The manifest has to hash back to b_uuid, so a peer
+ *    can't slip files into it.
+ *
+ * Takes:
+ * -> b_uuid:
+ *    The uuid of the bundle.
+ * -> b_name:
+ *    On success, set to the bundle's name.
+ * -> c_size:
+ *    On success, set to the chunk size the peer picked. Every other session of
+ *    the download has to use the same.
+ * -> members:
+ *    On success, set to the bundle's files.
+ * -> peer:
+ *    The peer to ask.
+ * -> connection_timeout:
+ *    The timeout for connecting to the peer.
+ * -> response_timeout:
+ *    The timeout for the peers response.
+ *
+ * Returns:
+ * -> On success:
+ *    EXIT_SUCCESS
+ * -> On failure:
+ *    EXIT_FAILURE
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+int attemptBundleManifest(const  uint64_t                   b_uuid,
+                                 std::string&               b_name,
+                                 size_t&                    c_size,
+                                 std::vector<BundleMember>& members,
+                          const  SourceInfo&                peer,
+                          struct timeval                    connection_timeout,
+                          struct timeval                    response_timeout);
+
 } //dfd
@@ -22,6 +22,8 @@ namespace dfd {
  * -> file_path:
  *    The path to the file to index. If the file is empty but exists, returns an
  *    error.
+ * -> refused:
+ *    Set if the server answered, but turned the file down. Cleared otherwise.
  * -> indexed_files:
  *    The vector to add this entry to for external use.
  * -> server:
@@ -41,10 +43,49 @@ namespace dfd {
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  */
 int attemptIndex(const  FileId&     file,
+                        bool&       refused,
                  const  SourceInfo& server,
                  struct timeval     connection_timeout,
                  struct timeval     response_timeout);
 
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * attemptIndexBatch
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> attemptIndex() for several files at once. Every index request is sent
+ *    over one connection before any reply is read, so the batch costs one
+ *    round trip rather than one per file.
+ *
+ * Takes:
+ * -> files:
+ *    The files to index.
+ * -> answered:
+ *    Set to how many files, from the front of files, the server indexed.
+ * -> refused:
+ *    Set if the server answered the file after those, but turned it down.
+ *    Cleared otherwise.
+ * -> server:
+ *    The server to send them to.
+ * -> connection_timeout:
+ *    The timeout for how long to wait while connecting to the server.
+ * -> response_timeout:
+ *    The timeout for how long to wait for each reply.
+ *
+ * Returns:
+ * -> On success:
+ *    EXIT_SUCCESS, every file was indexed.
+ * -> On failure:
+ *    EXIT_FAILURE, the rest of files past answered weren't.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+int attemptIndexBatch(const  std::vector<FileId>& files,
+                             size_t&              answered,
+                             bool&                refused,
+                      const  SourceInfo&          server,
+                      struct timeval              connection_timeout,
+                      struct timeval              response_timeout);
+
 /*
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  * attemptDrop
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "networking/messageFormatting.hpp"
+#include "sourceInfo.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <vector>
+
+//most files of a bundle download held open at once. more are opened as these
+//finish
+#define BUNDLE_OPEN_FILES 64
+
+//sessions a bundle download spreads over its peers, round robin
+#define BUNDLE_SESSIONS 4
+
+namespace dfd {
+
+struct DownloadFile;
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * BundleItem
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> One chunk of one file of a bundle, waiting to be fetched.
+ *
+ * Member Variables:
+ * -> member:
+ *    Index of the file in the bundle's manifest.
+ * -> chunk:
+ *    Which chunk of it.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+struct BundleItem {
+    size_t member = 0;
+    size_t chunk  = 0;
+};
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * BundleJob
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> A bundle download, shared between doBundleDownload() and its
+ *    bundleThread()s. Everything past the first three is guarded by mtx.
+ *
+ * Member Variables:
+ * -> b_uuid:
+ *    The bundle's uuid.
+ * -> c_size:
+ *    The chunk size every file is fetched with.
+ * -> members:
+ *    The bundle's files.
+ * -> files:
+ *    The download of each file, by index in members. nullptr until it's
+ *    opened, and again once it's closed.
+ * -> unsent:
+ *    Chunks of each file not yet received. Once a file's reaches 0 its staged
+ *    writes are flushed.
+ * -> unwritten:
+ *    Chunks of each file not yet written. Once a file's reaches 0 it's pushed
+ *    onto finished.
+ * -> queue:
+ *    Chunks to fetch, from every open file, in order.
+ * -> finished:
+ *    Files with every chunk written, for doBundleDownload() to verify and
+ *    close.
+ * -> sessions:
+ *    bundleThread()s still running.
+ * -> closing:
+ *    Set once nothing more will be queued, so idle threads return.
+ * -> bad_peers:
+ *    Peers that failed or sent bad data.
+ * -> mtx:
+ *    Guards the above.
+ * -> queued:
+ *    Notified when chunks are queued, or closing is set.
+ * -> progress:
+ *    Notified when a file is finished, or a thread returns.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+struct BundleJob {
+    uint64_t                                   b_uuid = 0;
+    size_t                                     c_size = 0;
+    std::vector<BundleMember>                  members;
+
+    std::vector<std::shared_ptr<DownloadFile>> files;
+    std::vector<size_t>                        unsent;
+    std::vector<size_t>                        unwritten;
+    std::deque<BundleItem>                     queue;
+    std::queue<size_t>                         finished;
+    size_t                                     sessions = 0;
+    bool                                       closing  = false;
+    std::vector<SourceInfo>                    bad_peers;
+    std::mutex                                 mtx;
+    std::condition_variable                    queued;
+    std::condition_variable                    progress;
+};
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * bundleThread
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Designed to be opened as a thread. Opens one bundle session with a peer
+ *    and fetches chunks off job's queue over it, whatever file they're from,
+ *    until closing is set. Chunks are staged to be written as they arrive,
+ *    and a file's writes are flushed once its last chunk is in. If the peer
+ *    fails, the chunk it was asked for goes back on the front of the queue,
+ *    the peer is added to bad_peers and the thread returns. Decrements
+ *    sessions and notifies progress on its way out.
+ *
+ *    Write callbacks may run after the thread returns, so job must outlive
+ *    every file it opened. doBundleDownload() closes them all first.
+ *
+ * Takes:
+ * -> job:
+ *    The download. sessions must already count this thread.
+ * -> peer:
+ *    The peer to fetch from.
+ * -> connection_timeout:
+ *    How long to wait when connecting to the peer.
+ * -> response_timeout:
+ *    How long to wait for each reply.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+void bundleThread(      BundleJob&     job,
+                  const SourceInfo&    peer,
+                  struct timeval       connection_timeout,
+                  struct timeval       response_timeout);
+
+} //dfd
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace dfd {
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Bundle
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> A bundle this client shares, see messageFormatting.hpp. Its files are
+ *    indexed and seeded like any other, the bundle only says which ones
+ *    belong to it.
+ *
+ * Member Variables:
+ * -> name:
+ *    The name downloaders save it under, the directory it was indexed from.
+ * -> manifest:
+ *    Its files, packed with packBundle().
+ * -> members:
+ *    The uuids of its files, the only ones its sessions serve.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+struct Bundle {
+    std::string          name;
+    std::vector<uint8_t> manifest;
+    std::set<uint64_t>   members;
+};
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * shareBundle
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Starts answering BUNDLE_INIT for a bundle. Thread safe.
+ *
+ * Takes:
+ * -> uuid:
+ *    The bundle's uuid.
+ * -> bundle:
+ *    The bundle.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+void shareBundle(const uint64_t uuid, std::shared_ptr<const Bundle> bundle);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * sharedBundle
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Looks up a bundle this client shares. Thread safe.
+ *
+ * Takes:
+ * -> uuid:
+ *    The bundle's uuid.
+ *
+ * Returns:
+ * -> On success:
+ *    The bundle.
+ * -> On failure:
+ *    nullptr, if it isn't shared.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+std::shared_ptr<const Bundle> sharedBundle(const uint64_t uuid);
+
+} //dfd
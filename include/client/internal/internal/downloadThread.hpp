@@ -2,14 +2,55 @@
 
 #include "sourceInfo.hpp"
 
+#include <atomic>
 #include <condition_variable>
 #include <cstdint>
+#include <memory>
 #include <mutex>
 #include <queue>
 #include <vector>
 
+//hand received chunks to the write-behind stage, 0 to write them on the
+//download thread before requesting the next
+#define ASYNC_CHUNK_WRITES 1
+
+//most chunks asked of a peer in one REQUEST_RANGE
+#define DOWNLOAD_RANGE_CHUNKS 256
+
+//how long a thread that's run out of chunks waits for a busy one to hand some
+//over, in ms. has to be well under the seeder's 3s timeout
+#define DOWNLOAD_IDLE_MS 1000
+
 namespace dfd {
 
+struct DownloadFile;
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * RangeShare
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> How downloadThread()s of one download hand work to each other. A thread
+ *    that runs out of chunks waits as hungry, and a busy one streaming a long
+ *    range shrinks it and puts the tail back on remaining_chunks for it. busy
+ *    is guarded by remaining_chunks_mtx.
+ *
+ * Member Variables:
+ * -> busy:
+ *    Threads with chunks asked of a peer.
+ * -> hungry:
+ *    Threads waiting for chunks to be handed back.
+ * -> returned:
+ *    Notified when chunks are put back on remaining_chunks, or a thread stops
+ *    being busy.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+struct RangeShare {
+    size_t                  busy   = 0;
+    std::atomic<size_t>     hungry = 0;
+    std::condition_variable returned;
+};
+
 /*
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  * downloadThread
@@ -26,13 +67,30 @@ namespace dfd {
  *    -> To get the next chunk needed, a thread will aquire a lock on
  *       remaining_chunks_mtx, pop the next chunk off the queue, and release the
  *       lock.
- *    -> To report successful storage of the chunk to disk for compiling, a
- *       thread will aquire a lock on done_chunks_mtx, push the chunk index onto
- *       the queue, release the lock, and notify the chunk_ready CV. 
+ *    -> Up to a window of chunks are kept outstanding with each peer, see
+ *       chunkWindow.hpp. Chunks that follow on from each other in the queue
+ *       are asked for as one range, up to DOWNLOAD_RANGE_CHUNKS, which the
+ *       peer streams back without waiting for more requests. If the peer
+ *       fails, every chunk still asked of it goes back on remaining_chunks.
+ *    -> A thread that runs out of chunks waits up to DOWNLOAD_IDLE_MS for a
+ *       busy one to hand it the tail of its range through share.
+ *    -> Chunks are written straight into file at their offset as they arrive.
+ *       With ASYNC_CHUNK_WRITES they're staged to be written alongside their
+ *       neighbours and the thread moves on to the next chunk right away.
+ *       Whatever's still staged is flushed when the thread is done with a
+ *       peer.
+ *    -> To report a chunk written to disk, whichever thread finished the write
+ *       will aquire a lock on done_chunks_mtx, push the chunk index onto the
+ *       queue, release the lock, and notify the chunk_ready CV. A chunk that
+ *       couldn't be written goes back on remaining_chunks. Call
+ *       waitFileWrites() on file after joining these threads, before the
+ *       queues go out of scope.
  *
  * Takes:
  * -> file_uuid:
  *    The UUID of the file to download chunks for.
+ * -> file:
+ *    The download file from openDownloadFile() to write chunks into.
  * -> sources:
  *    A list of SourceInfo's for the various peers returned by the server.
  * -> source_stats:
@@ -50,31 +108,35 @@ namespace dfd {
  * -> remaining_chunks_mtx:
  *    A mutex to lock while popping from the above queue.
  * -> done_chunks:
- *    A queue of chunk indexes that have been successfully written to disk so
- *    they can be compiled by the main thread.
+ *    A queue of chunk indexes that have been successfully written to disk, so
+ *    the main thread can track progress.
  * -> done_chunks_mtx:
  *    A mutex to lock while pushing to the above queue.
  * -> chunk_ready:
  *    A condition variable to notify when a chunk is pushed to the done_chunks
  *    queue.
+ * -> share:
+ *    Shared by every thread of the download, see RangeShare.
  * -> connection_timeout:
  *    How long to wait when attempting a peer connection.
  * -> response_timeout:
  *    How long to wait when waiting for a reply from the peer.
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  */
-void downloadThread(const uint64_t                 f_uuid,
-                    const std::vector<SourceInfo>& sources,
-                    std::vector<bool>&             source_stats,
-                    std::mutex&                    stat_mtx,
-                    std::vector<SourceInfo>&       bad_peers,
-                    std::mutex&                    bad_peers_mtx,
-                    std::queue<size_t>&            remaining_chunks,
-                    std::mutex&                    remaining_chunks_mtx,
-                    std::queue<size_t>&            done_chunks,
-                    std::mutex&                    done_chunks_mtx,
-                    std::condition_variable&       chunk_ready,
-                    struct timeval                 connection_timeout,
-                    struct timeval                 response_timeout);
+void downloadThread(const uint64_t                       f_uuid,
+                    const std::shared_ptr<DownloadFile>& file,
+                    const std::vector<SourceInfo>&       sources,
+                    std::vector<bool>&                   source_stats,
+                    std::mutex&                          stat_mtx,
+                    std::vector<SourceInfo>&             bad_peers,
+                    std::mutex&                          bad_peers_mtx,
+                    std::queue<size_t>&                  remaining_chunks,
+                    std::mutex&                          remaining_chunks_mtx,
+                    std::queue<size_t>&                  done_chunks,
+                    std::mutex&                          done_chunks_mtx,
+                    std::condition_variable&             chunk_ready,
+                    RangeShare&                          share,
+                    struct timeval                       connection_timeout,
+                    struct timeval                       response_timeout);
 
 }
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "networking/messageFormatting.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <queue>
+#include <utility>
+
+//most threads hashing files at once when indexing a directory
+#define INDEX_HASH_THREADS 4
+
+//hashed files the registrar takes off the queue at a time
+#define INDEX_BATCH_SIZE 64
+
+namespace dfd {
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * IndexJob
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Everything shared between the stages of indexing a directory. A scanner
+ *    walks the tree and queues files to hash, a pool of hashers turns them into
+ *    FileIds, and the registrar takes those off in batches to index with the
+ *    server, all at the same time.
+ *
+ * Member Variables:
+ * -> my_listener:
+ *    This client's info, for the FileIds.
+ * -> to_hash, to_hash_mtx, path_ready:
+ *    Files found by the scanner, the lock for them, and signalled whenever one
+ *    is queued or the scan finishes.
+ * -> scan_done:
+ *    Set once the scanner has queued every file. Lock to_hash_mtx.
+ * -> hashed, hashed_mtx, file_ready:
+ *    Files that have been hashed along with their absolute path, the lock for
+ *    them, and signalled whenever one is queued or hashing finishes.
+ * -> hashers_running:
+ *    How many hashers haven't exited yet. Lock hashed_mtx.
+ * -> scanned, failed:
+ *    How many files were found, and how many couldn't be hashed or were
+ *    turned down by the server.
+ * -> cancel:
+ *    Set to make every stage stop early.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+struct IndexJob {
+    SourceInfo                                           my_listener;
+
+    std::queue<std::filesystem::path>                    to_hash;
+    std::mutex                                           to_hash_mtx;
+    std::condition_variable                              path_ready;
+    bool                                                 scan_done       = false;
+
+    std::queue<std::pair<std::filesystem::path, FileId>> hashed;
+    std::mutex                                           hashed_mtx;
+    std::condition_variable                              file_ready;
+    size_t                                               hashers_running = 0;
+
+    std::atomic<size_t>                                  scanned         = 0;
+    std::atomic<size_t>                                  failed          = 0;
+    std::atomic<bool>                                    cancel          = false;
+};
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * scanThread
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Designed to be opened as a thread. Walks root recursively and queues every
+ *    regular file it finds on job.to_hash, then sets job.scan_done. Directories
+ *    it can't read are skipped, symlinked directories aren't followed, and
+ *    .dfdpart sidecars of unfinished downloads are left out. Any other error
+ *    ends the scan early, with what was found so far still queued.
+ *
+ * Takes:
+ * -> root:
+ *    The directory to index, absolute.
+ * -> job:
+ *    The job to queue files on.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+void scanThread(const std::filesystem::path& root, IndexJob& job);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * hashThread
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Designed to be opened as a thread, any number at once. Takes files off
+ *    job.to_hash, computes their uuid with fileUuid(), and queues the result on
+ *    job.hashed. Exits once the scan is done and nothing is left to hash. The
+ *    last hasher to exit notifies job.file_ready with hashers_running at 0.
+ *    job.hashers_running must be set to the number of hashers before any of
+ *    them start.
+ *
+ * Takes:
+ * -> job:
+ *    The job to take files from and queue results on.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+void hashThread(IndexJob& job);
+
+} //dfd
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+
+//chunk requests a download session keeps outstanding with one peer. it starts
+//at DOWNLOAD_WINDOW_START and follows the link from there, never past
+//DOWNLOAD_WINDOW_MAX. set both to 1 to wait for every chunk before asking for
+//the next
+#define DOWNLOAD_WINDOW_START 2
+#define DOWNLOAD_WINDOW_MAX   32
+
+namespace dfd {
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * A note on request windows
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * A seeder answers a session's requests one at a time, in the order they were
+ * sent. Asking for the next chunk before the last one arrives keeps the link
+ * busy while requests and replies are in the air, instead of leaving it idle
+ * for a round trip per chunk. Replies still come back in order, and each
+ * carries its chunk index, so the downloader only has to check it against the
+ * oldest outstanding request.
+ *
+ * How many requests are worth keeping outstanding depends on the link: enough
+ * chunks to cover the bandwidth-delay product, plus one so the seeder always
+ * has the next request waiting. The window measures the shortest time a
+ * request has taken to be answered, the round trip with no queueing, and how
+ * fast chunks are arriving, and sizes itself to that once per window's worth
+ * of replies. While the window is what's limiting the rate, that's always a
+ * little more than it is now, so it grows until the link is full.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * ChunkWindow
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> The request window of one download session. Not thread safe, each
+ *    session keeps its own.
+ *
+ * Member Variables:
+ * -> size:
+ *    How many requests to keep outstanding.
+ * -> min_rtt:
+ *    Shortest time a request has taken to be answered, in seconds. 0 until
+ *    the first reply.
+ * -> rate:
+ *    How fast chunks arrived over the last window's worth of replies, in
+ *    bytes per second.
+ * -> since:
+ *    When size was last changed.
+ * -> bytes:
+ *    Bytes received since then.
+ * -> replies:
+ *    Replies received since then.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+struct ChunkWindow {
+    size_t                                size    = DOWNLOAD_WINDOW_START;
+    double                                min_rtt = 0;
+    double                                rate    = 0;
+    std::chrono::steady_clock::time_point since;
+    size_t                                bytes   = 0;
+    size_t                                replies = 0;
+};
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * windowStart
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Resets a window for a new session, which may be to a different peer.
+ *
+ * Takes:
+ * -> window:
+ *    The window.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+void windowStart(ChunkWindow& window);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * windowReply
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Records a reply, and resizes the window if a window's worth of them came
+ *    in since it was last resized.
+ *
+ * Takes:
+ * -> window:
+ *    The window.
+ * -> bytes:
+ *    How much the reply carried.
+ * -> c_size:
+ *    The session's chunk size.
+ * -> sent:
+ *    When the request it answers was sent.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+void windowReply(ChunkWindow&                                window,
+                 const size_t                                bytes,
+                 const size_t                                c_size,
+                 const std::chrono::steady_clock::time_point sent);
+
+} //dfd
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "sourceInfo.hpp"
+#include <initializer_list>
 #include <optional>
 #include <vector>
 
@@ -93,6 +94,24 @@ bool recvOkay(int                           sock,
               const uint8_t                 expected_code,
               std::optional<struct timeval> timeout=std::nullopt);
 
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * recvOkay
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Same as above, for a reply that can come as more than one kind of
+ *    message.
+ *
+ * Takes:
+ * -> expected_codes:
+ *    The codes the message may have.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+bool recvOkay(int                            sock,
+              std::vector<uint8_t>&          buffer,
+              std::initializer_list<uint8_t> expected_codes,
+              std::optional<struct timeval>  timeout=std::nullopt);
+
 
 /*
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
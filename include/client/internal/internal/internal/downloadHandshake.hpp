@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <string>
 
@@ -12,18 +13,24 @@ namespace dfd {
  * Description:
  * -> Takes an already connected socket to a peer indexing a file and sends a
  *    DOWNLOAD_INIT message. Waits for a DOWNLOAD_CONFIRM message to obtain the
- *    file name and size. If any error occurs, the socket is CLOSED, and an
- *    error is returned.
+ *    file name, size, and the chunk size the peer will send with. The peer may
+ *    not use the chunk size asked for. A name with directories in it, or one
+ *    that steps up a directory, is refused. If any error occurs, the socket is
+ *    CLOSED, and an error is returned.
  *
  * Takes:
  * -> connected_sock:
  *    The peer to do the handshake with.
  * -> f_uuid:
  *    The uuid of the file to request.
+ * -> want_c_size:
+ *    The chunk size to ask for, or 0 to let the peer pick one for the file.
  * -> f_name:
  *    A reference to a std::string to, on success, put the file name into.
  * -> f_size:
  *    A reference to a uint64_t to, on success, put the file size into.
+ * -> c_size:
+ *    A reference to a size_t to, on success, put the chunk size into.
  * -> response_timeout:
  *    The timeout for how long to wait for the DOWNLOAD_CONFIRM message.
  *
@@ -36,8 +43,50 @@ namespace dfd {
  */
 int attemptDownloadHandshake(int            connected_sock,
                              const uint64_t f_uuid,
+                             const size_t   want_c_size,
                              std::string&   f_name,
                              uint64_t&      f_size,
+                             size_t&        c_size,
                              struct timeval response_timeout);
 
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * attemptBundleHandshake
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Same as above, for a bundle. Sends BUNDLE_INIT instead, and the size in
+ *    the DOWNLOAD_CONFIRM is that of the bundle's packed manifest. Every file
+ *    of the bundle is sent with the chunk size it confirms.
+ *
+ * Takes:
+ * -> connected_sock:
+ *    The peer to do the handshake with.
+ * -> b_uuid:
+ *    The uuid of the bundle to request.
+ * -> want_c_size:
+ *    The chunk size to ask for, or 0 to let the peer pick one.
+ * -> b_name:
+ *    On success, set to the bundle's name.
+ * -> m_size:
+ *    On success, set to the size of the bundle's packed manifest.
+ * -> c_size:
+ *    On success, set to the chunk size.
+ * -> response_timeout:
+ *    The timeout for how long to wait for the DOWNLOAD_CONFIRM message.
+ *
+ * Returns:
+ * -> On success:
+ *    EXIT_SUCCESS
+ * -> On failure:
+ *    EXIT_FAILURE, the socket is closed.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+int attemptBundleHandshake(int            connected_sock,
+                           const uint64_t b_uuid,
+                           const size_t   want_c_size,
+                           std::string&   b_name,
+                           uint64_t&      m_size,
+                           size_t&        c_size,
+                           struct timeval response_timeout);
+
 } //dfd
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "sourceInfo.hpp"
+
+#include <cstdint>
+#include <vector>
+
+//idle connections kept open to each server. more than this at once only
+//happens with that many requests to one server at the same time
+#define SERVER_POOL_PER_SERVER 4
+
+//how long a connection can sit idle in the pool before it's closed, in ms.
+//under the server's CLIENT_IDLE_MS so it's the client that hangs up
+#define SERVER_POOL_IDLE_MS 20000
+
+namespace dfd {
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * A note on server connections
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * A server keeps a client's connection open after replying and reads the
+ * next request from it, so requests to a server reuse a connection from a
+ * process wide pool instead of connecting for each one.
+ *
+ * The server answers a connection's requests one at a time, in the order they
+ * were sent. Several can be sent before reading any replies, and the order
+ * says which reply is whose, so a connection doesn't need request ids. A
+ * connection is only put back in the pool once every reply it's owed has
+ * been read. Anything else, a timeout or a reply that wasn't the one
+ * expected, closes it.
+ *
+ * A pooled connection the server has since closed is noticed before it's
+ * used. If a reused connection still breaks before a single byte of the
+ * first request went out, the server can't have seen any of them, so they're
+ * sent again on a new connection. Once anything has gone out they aren't,
+ * since the server may have acted on a request whose reply was lost, and an
+ * INDEX_REQUEST or DROP_REQUEST shouldn't be applied twice.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * serverRequest
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Sends a request to a server over a pooled connection, and receives its
+ *    reply. Thread safe.
+ *
+ * Takes:
+ * -> server:
+ *    The server.
+ * -> request:
+ *    A server request formatted by messageFormatting.
+ * -> response:
+ *    Where to put the reply. Holds a FAIL message if that was the reply.
+ * -> msg_code:
+ *    The code the reply should have.
+ * -> connection_timeout:
+ *    How long to attempt a connection for, if there's none pooled.
+ * -> response_timeout:
+ *    How long to wait for the reply.
+ *
+ * Returns:
+ * -> On success:
+ *    EXIT_SUCCESS
+ * -> On failure:
+ *    EXIT_FAILURE
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+int serverRequest(const  SourceInfo&           server,
+                  const  std::vector<uint8_t>& request,
+                         std::vector<uint8_t>& response,
+                  const  uint8_t               msg_code,
+                  struct timeval               connection_timeout,
+                  struct timeval               response_timeout);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * serverRequests
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Sends every request to a server over one pooled connection before
+ *    reading any of the replies, then reads them in order. Stops at the first
+ *    reply that doesn't have msg_code. Thread safe.
+ *
+ * Takes:
+ * -> server:
+ *    The server.
+ * -> requests:
+ *    Server requests formatted by messageFormatting.
+ * -> responses:
+ *    Where to put the replies, in the order of requests. Cleared first, and
+ *    only holds replies that had msg_code.
+ * -> last:
+ *    The last reply read, so the one that broke off the exchange if one did.
+ *    Empty if nothing was read.
+ * -> msg_code:
+ *    The code every reply should have.
+ * -> connection_timeout:
+ *    How long to attempt a connection for, if there's none pooled.
+ * -> response_timeout:
+ *    How long to wait for each reply.
+ *
+ * Returns:
+ * -> On success:
+ *    EXIT_SUCCESS, every request was answered.
+ * -> On failure:
+ *    EXIT_FAILURE, responses.size() were answered before it went wrong.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+int serverRequests(const  SourceInfo&                        server,
+                   const  std::vector<std::vector<uint8_t>>& requests,
+                          std::vector<std::vector<uint8_t>>& responses,
+                          std::vector<uint8_t>&              last,
+                   const  uint8_t                            msg_code,
+                   struct timeval                            connection_timeout,
+                   struct timeval                            response_timeout);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * closeServerConnections
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Closes every pooled connection. Connections in use are closed once
+ *    they're done with instead of pooled.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+void closeServerConnections();
+
+} //dfd
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+//threads reading and packing chunks for every peer. the event loop does all
+//the socket work, these only wait on the disk and the buffer pool
+#define SEED_WORKER_THREADS 2
+
+//bytes queued for a peer before its next request waits for them to go. a
+//couple of chunks keeps its socket busy without holding much memory for it
+#define SEED_SEND_AHEAD (2 << 20)
+
+//how long a peer with nothing outstanding can go quiet before it's dropped,
+//in ms
+#define SEED_IDLE_MS 3000
+
+//largest request a downloader can send. handshakes and chunk requests are a
+//few dozen bytes, anything claiming more is dropped before it's read
+#define SEED_REQUEST_MAX (64 << 10)
+
+//connections the kernel holds for the seed listener before they're accepted
+#define SEED_LISTEN_BACKLOG 128
+
+namespace dfd {
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * A note on the seed engine
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Every peer downloading from us is one non-blocking socket on a single
+ * event loop, which reads its requests as they arrive and sends its chunks as
+ * its socket takes them. Nothing on the loop waits on a peer.
+ *
+ * Answering a request can wait on the disk or the buffer pool, so that's
+ * handed to SEED_WORKER_THREADS workers, one request per peer at a time, in
+ * the order the peer sent them. A worker only queues the reply, with the
+ * chunk's bytes left in the page cache or a pooled buffer, and the loop sends
+ * it. A peer's next request isn't handed out until less than
+ * SEED_SEND_AHEAD is waiting to go to it, so a slow peer holds a couple of
+ * chunks rather than a worker. A worker waits at most SEED_BUFFER_WAIT_MS for
+ * a buffer, and a peer whose job has taken longer than SEND_STALL_MS is
+ * dropped.
+ *
+ * A range is streamed the same way, one chunk handed out at a time, and a
+ * SHRINK_RANGE is applied the moment it arrives. Anything else sent during a
+ * range waits until its RANGE_END has been queued.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * seedEngine
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Seeds to every peer connecting to listener until shutdown is set. Runs
+ *    the event loop on the calling thread, starts the workers, and joins them
+ *    before returning. Peer sockets still open are closed on the way out,
+ *    listener is not.
+ *
+ * Takes:
+ * -> shutdown:
+ *    Set to shut down. Noticed within a second.
+ * -> listener:
+ *    The listening socket, already listening. Made non-blocking.
+ * -> indexed_files:
+ *    A map of all files this client currently has indexed.
+ * -> indexed_files_mtx:
+ *    A mutex to lock when accessing the indexed_files map.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+void seedEngine(      std::atomic<bool>&               shutdown,
+                      int                              listener,
+                const std::map<uint64_t, std::string>& indexed_files,
+                      std::mutex&                      indexed_files_mtx);
+
+} //dfd
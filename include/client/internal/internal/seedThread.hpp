@@ -1,32 +1,190 @@
 #pragma once
 
-#include <atomic>
+#include "networking/messageFormatting.hpp"
+#include "networking/socket.hpp"
+
+#include <cstdint>
 #include <map>
+#include <memory>
 #include <mutex>
+#include <optional>
 #include <string>
+#include <utility>
+#include <vector>
+
+//send chunks straight from the page cache with sendfile(), 0 to read them into
+//memory first
+#define ZERO_COPY_SEEDING 1
+
+//read the chunks a peer is likely to ask for next into memory before it asks,
+//0 to read each one once it's asked for
+#define SEED_PREFETCH 1
+
+//how long reading a chunk waits for room in the buffer pool before the peer
+//is told to try elsewhere, in ms. only when it can't be sent from the file
+#define SEED_BUFFER_WAIT_MS 2000
 
 namespace dfd {
 
+struct Bundle;
+struct FileHandle;
+struct SeedPrefetcher;
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * SeedSession
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Everything one seeding connection agreed on in its handshake. Nothing here
+ *    is shared with other sessions, even ones seeding the same file. Only one
+ *    thread may use a session at a time.
+ *
+ * Member Variables:
+ * -> file:
+ *    The shared handle of the file being seeded.
+ * -> f_uuid:
+ *    The uuid of the file being seeded.
+ * -> c_size:
+ *    The chunk size every chunk of this session is sent with.
+ * -> prefetch:
+ *    Chunks read ahead of the peer's requests. nullptr if SEED_PREFETCH is off.
+ * -> packer:
+ *    Whether, and how, chunks are compressed for this peer.
+ * -> bundle:
+ *    The bundle being seeded, nullptr for a single file. file and f_uuid are
+ *    then whichever of its files was last asked for.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+struct SeedSession {
+    std::shared_ptr<FileHandle>     file;
+    uint64_t                        f_uuid = 0;
+    size_t                          c_size = 0;
+    std::shared_ptr<SeedPrefetcher> prefetch;
+    ChunkPacker                     packer;
+    std::shared_ptr<const Bundle>   bundle;
+};
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * seedHandshake
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Answers a peer's DOWNLOAD_INIT: checks that we know where the file is,
+ *    reads in the file size, settles on a chunk size, and queues a
+ *    DOWNLOAD_CONFIRM. The chunk size is the one asked for if it's within
+ *    MIN_CHUNK_SIZE and MAX_CHUNK_SIZE, brought into that range if not, or
+ *    chunkSizeFor() the file if the peer left it to us. Chunks are packed with
+ *    the best codec the peer offered that we have. A BUNDLE_INIT is confirmed
+ *    the same way for a bundle we share, with the size of its manifest, and no
+ *    file is opened until one is asked for. If appropriate, a FAIL message is
+ *    queued with the reason the handshake failed, so the peer can deregister
+ *    us as a peer hosting this file.
+ *
+ * Takes:
+ * -> out:
+ *    The peer's writer, the reply is queued on it.
+ * -> init_msg:
+ *    The first message the peer sent.
+ * -> indexed_files:
+ *    A map of all files this client currently has indexed.
+ * -> indexed_files_mtx:
+ *    A mutex to lock when accessing the indexed_files map.
+ * -> session:
+ *    Filled in with what the handshake agreed on, on success.
+ *
+ * Returns:
+ * -> On success:
+ *    EXIT_SUCCESS
+ * -> On failure:
+ *    EXIT_FAILURE, close the connection once out is sent.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+int seedHandshake(      FrameWriter&                     out,
+                  const std::vector<uint8_t>&            init_msg,
+                  const std::map<uint64_t, std::string>& indexed_files,
+                        std::mutex&                      indexed_files_mtx,
+                        SeedSession&                     session);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * seedRequest
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Answers one request from a peer past its handshake, queueing the reply.
+ *    A REQUEST_RANGE is only checked, and handed back in range for the caller
+ *    to stream with seedChunk() and finish with RANGE_END, see
+ *    messageFormatting.hpp. SHRINK_RANGE is the caller's to apply.
+ *
+ * Takes:
+ * -> out:
+ *    The peer's writer, the reply is queued on it.
+ * -> request:
+ *    The request.
+ * -> indexed_files:
+ *    A map of all files this client currently has indexed.
+ * -> indexed_files_mtx:
+ *    A mutex to lock when accessing the indexed_files map.
+ * -> session:
+ *    The session, from seedHandshake().
+ * -> range:
+ *    Set to the first chunk and one past the last of a range to stream.
+ *
+ * Returns:
+ * -> On success:
+ *    EXIT_SUCCESS
+ * -> On failure:
+ *    EXIT_FAILURE, the peer is finished or the session can't go on. Close
+ *    the connection once out is sent.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+int seedRequest(      FrameWriter&                              out,
+                const std::vector<uint8_t>&                     request,
+                const std::map<uint64_t, std::string>&          indexed_files,
+                      std::mutex&                               indexed_files_mtx,
+                      SeedSession&                              session,
+                      std::optional<std::pair<size_t, size_t>>& range);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * seedChunk
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Queues one chunk of the session's file: read ahead, sent straight from
+ *    the page cache when its turn comes, or read in, and packed if that pays
+ *    off. If the file can't be read a FAIL message is queued instead. May
+ *    wait on the disk, and up to SEED_BUFFER_WAIT_MS on the buffer pool,
+ *    sending from the file instead when the pool's full and it can.
+ *
+ * Takes:
+ * -> out:
+ *    The peer's writer.
+ * -> session:
+ *    The session, with the file to send from.
+ * -> chunk_id:
+ *    The chunk asked for.
+ *
+ * Returns:
+ * -> On success:
+ *    EXIT_SUCCESS
+ * -> On failure:
+ *    EXIT_FAILURE, the session can't go on.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+int seedChunk(FrameWriter& out, SeedSession& session, const size_t chunk_id);
+
 /*
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
- * seedToPeer
+ * endSeedSession
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  * Description:
- * -> A function to handle a client request for file chunks. This function is
- *    designed to be opened as a thread that can be flagged for shutdown, and
- *    is not detatched.
+ * -> Stops a session's read-ahead and lets go of its file once the
+ *    connection is closed. Chunks still queued hold the file themselves.
  *
  * Takes:
- * -> shutdown:
- *    A atomic bool that, if set True, this function will make its best effort
- *    to exit as fast as possible to by joined.
- * -> peer_sock:
- *    The socket connection to the peer requesting a file download.
+ * -> session:
+ *    The session.
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  */
-void seedToPeer(std::atomic<bool>&                     shutdown,
-                int                                    peer_sock,
-                const std::map<uint64_t, std::string>& indexed_files,
-                std::mutex&                            indexed_files_mtx);
+void endSeedSession(SeedSession& session);
 
 } //dfd
@@ -6,6 +6,9 @@
 #include <string>
 #include <vector>
 
+//how many chunks doDownload lets pile up before making them crash safe
+#define DOWNLOAD_CHECKPOINT_CHUNKS 64
+
 namespace dfd {
 
 /*
@@ -23,12 +26,16 @@ namespace dfd {
  *    error it's indicitive of failure of every server provided. In that case,
  *    server_list is not modified, and the error is returned instead.
  *
+ *    If file_path is a directory, every file under it is indexed instead. The
+ *    tree is scanned, hashed and registered with the server all at once, with
+ *    progress printed as files are registered.
+ *
  * Takes:
  * -> my_listener:
  *    A SourceInfo object that houses all of this client's info. All fields
  *    MUST be set.
  * -> file_path:
- *    A path to the file, relative or absolute.
+ *    A path to the file or directory, relative or absolute.
  * -> indexed_files:
  *    The vector of indexed_files that client_main() maintains.
  * -> server_list:
@@ -103,6 +110,10 @@ int doDrop(const SourceInfo&                      my_listener,
  *    error is returned instead.
  *
  *    Manages communicating faulty peers to the server entirely internally.
+ *
+ *    If a download fails partway, what was downloaded is kept alongside a
+ *    .dfdpart sidecar. Downloading the same file again only fetches the
+ *    chunks that are still missing.
  *    
  * Returns:
  * -> On success:
@@ -114,4 +125,30 @@ int doDrop(const SourceInfo&                      my_listener,
 int doDownload(const uint64_t                 f_uuid,
                      std::vector<SourceInfo>& server_list);
 
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * doBundleDownload
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Downloads every file of a bundle, a directory some peer indexed, into a
+ *    directory of the same name. Fetches the bundle's list of files first,
+ *    then opens up to BUNDLE_OPEN_FILES of them at a time and fetches their
+ *    chunks over BUNDLE_SESSIONS bundleThread()s, one queue for all of them,
+ *    so small files don't each pay for their own connection and handshake.
+ *    Each file is verified against its own uuid once its last chunk is in.
+ *
+ *    server_list is handled the same as doDownload(), and faulty peers are
+ *    reported the same way. Files already in the directory are skipped, and
+ *    ones left unfinished are resumed by downloading the bundle again.
+ *
+ * Returns:
+ * -> On success:
+ *    EXIT_SUCCESS, every file is there.
+ * -> On failure:
+ *    EXIT_FAILURE
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+int doBundleDownload(const uint64_t                 b_uuid,
+                           std::vector<SourceInfo>& server_list);
+
 }
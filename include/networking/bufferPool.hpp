@@ -0,0 +1,157 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+//most bytes of pooled buffers the process holds at once, handed out or idle.
+//always lets one buffer through
+#define BUFFER_POOL_MAX_BYTES (256 << 20)
+
+//most bytes of returned buffers kept for reuse, the rest are freed
+#define BUFFER_POOL_IDLE_BYTES (64 << 20)
+
+//smallest size class. smaller buffers are rounded up to it
+#define BUFFER_POOL_MIN_CLASS (1 << 16)
+
+//bytes every buffer has past its size class, so a chunk and the few bytes of
+//message around it fit the chunk's class
+#define BUFFER_POOL_SLACK 64
+
+//ask for transparent huge pages behind buffers of 2MiB and up. off by default,
+//most chunks are smaller than a huge page
+#define BUFFER_POOL_HUGE_PAGES 0
+
+namespace dfd {
+
+//a buffer from the pool. it goes back to the pool once the last copy of the
+//pointer is gone, whatever thread that happens on
+using PooledBuffer = std::shared_ptr<std::vector<uint8_t>>;
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * A note on the buffer pool
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Chunks are sent and received in buffers a megabyte or so long, several per
+ * chunk on each end. Allocating those fresh every time churns the allocator,
+ * and with enough peers connected at once memory use has no upper bound.
+ *
+ * Buffers are handed out in size classes, a power of two plus
+ * BUFFER_POOL_SLACK bytes, and kept once returned so the next chunk of that
+ * class reuses one. Every buffer handed out, and every one kept idle, counts
+ * toward BUFFER_POOL_MAX_BYTES. Once that's reached idle buffers are freed
+ * to make room, and if there are none takeBuffer() waits until a buffer comes
+ * back. tryTakeBuffer() gives up instead, for work that can be skipped, and
+ * takeBufferFor() gives up after a while, for threads other peers wait on.
+ *
+ * A thread must not wait on takeBuffer() while holding buffers that only it
+ * can give back.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * takeBuffer
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Takes a buffer of at least len bytes from the pool, waiting while the
+ *    pool is at BUFFER_POOL_MAX_BYTES. Thread safe.
+ *
+ * Takes:
+ * -> len:
+ *    The bytes needed. The buffer is resized to exactly this, its contents are
+ *    whatever the last user left.
+ *
+ * Returns:
+ * -> On success:
+ *    The buffer.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+PooledBuffer takeBuffer(const size_t len);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * tryTakeBuffer
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Same as takeBuffer(), but doesn't wait.
+ *
+ * Takes:
+ * -> len:
+ *    The bytes needed.
+ *
+ * Returns:
+ * -> On success:
+ *    The buffer.
+ * -> On failure:
+ *    nullptr, if the pool is at BUFFER_POOL_MAX_BYTES.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+PooledBuffer tryTakeBuffer(const size_t len);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * takeBufferFor
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Same as takeBuffer(), but only waits so long for a buffer to come back.
+ *
+ * Takes:
+ * -> len:
+ *    The bytes needed.
+ * -> timeout_ms:
+ *    How long to wait, in ms.
+ *
+ * Returns:
+ * -> On success:
+ *    The buffer.
+ * -> On failure:
+ *    nullptr, if the pool was still at BUFFER_POOL_MAX_BYTES once the time
+ *    was up.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+PooledBuffer takeBufferFor(const size_t len, const int timeout_ms);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * BufferPoolStats
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> A snapshot of the pool.
+ *
+ * Member Variables:
+ * -> used_bytes:
+ *    Bytes in buffers handed out.
+ * -> idle_bytes:
+ *    Bytes in buffers kept for reuse.
+ * -> reused:
+ *    Buffers handed out that had been used before.
+ * -> allocated:
+ *    Buffers handed out that had to be allocated.
+ * -> waits:
+ *    Times takeBuffer() had to wait for a buffer to come back.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+struct BufferPoolStats {
+    uint64_t used_bytes = 0;
+    uint64_t idle_bytes = 0;
+    uint64_t reused     = 0;
+    uint64_t allocated  = 0;
+    uint64_t waits      = 0;
+};
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * bufferPoolStats
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Returns a snapshot of the pool. Thread safe.
+ *
+ * Returns:
+ * -> On success:
+ *    The snapshot.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+BufferPoolStats bufferPoolStats();
+
+} //dfd
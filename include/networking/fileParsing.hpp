@@ -1,34 +1,62 @@
 #pragma once
 
+#include "networking/bufferPool.hpp"
+
+#include <array>
 #include <cstdint>
 #include <filesystem>
+#include <functional>
 #include <optional>
 #include <string>
 #include <vector>
 #include <memory>
 #include <fstream>
 
+//smallest and largest chunk size a seeder will agree to send with
+#define MIN_CHUNK_SIZE (1 << 12)
+#define MAX_CHUNK_SIZE (1 << 24)
+
 /*
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  * RECOMMENDED USAGE:
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * A note on chunk sizes:
+ * -> every transfer agrees its own chunk size in the DOWNLOAD_INIT/CONFIRM
+ *    handshake, and passes it to each call below that splits a file. nothing
+ *    here depends on the size any other transfer is using. getChunkSize() is
+ *    only the default for where nothing was agreed.
+ *
  * Downloader:
- * -> with the file size, call fileChunks() to get the number of chunks to recv.
- * -> recv data into buffer and call unpackFileChunk() to store partial chunks
- *    to the disk so others can be recieved async.
- * -> when you have chunk 0 unpacked, call openFile(), which will convert
- *    the first chunk to a file pointer that can be written to. this is NOT
- *    thread safe. one thread should be calling fileSize() periodically to check
- *    for file chunks.
- * -> with these chunks, call assembleChunk() to move the chunk data into the
- *    file.
- * -> when all chunks written, destroy the file pointer to save and write to
- *    disk. use std::move() to give the pointer away for cleanup.
+ * -> with the file and chunk size, call fileChunks() to get the number of
+ *    chunks to recv.
+ * -> call openDownloadFile() once to create the destination at its full size,
+ *    or resume an interrupted download of it. missingChunks() lists what's
+ *    left to fetch.
+ * -> from any number of threads, recv chunks into a buffer and call
+ *    writeFileChunk() with the handle to write them straight into place, or
+ *    writeFileChunkAsync() to hand the write off and keep receiving. async
+ *    chunks are held back to be written alongside their neighbours, call
+ *    flushFileWrites() when a thread stops receiving so none are left
+ *    waiting. call checkpointDownloadFile() every so often so progress
+ *    survives a crash.
+ * -> when every chunk is written call verifyDownloadFile(), then
+ *    closeDownloadFile(). if the download is abandoned, or fails to verify
+ *    and discardChunks() was called on what it returned, call it with complete
+ *    set false to keep it for resuming.
+ * -> unpackFileChunk()/openFile()/assembleChunk()/saveFile() are the older
+ *    spill-to-disk path, which stages each chunk in its own file first. they
+ *    are only still used where chunks arrive one at a time from one peer.
  *
  * Sender:
- * -> Call fileSize() to get file size. Call fileChunks() for number of chunks
- *    to send.
- * -> For chunks 0..n call packageFileChunk() to read them into memory to send.
+ * -> Call openSeedFile() once per session to get a shared handle to the file.
+ *    Call fileSize() on the handle to get file size. Settle on a chunk size,
+ *    chunkSizeFor() if the downloader didn't ask for one. Call fileChunks()
+ *    for number of chunks to send.
+ * -> For chunks 0..n call packageFileChunk() with the handle to read them into
+ *    memory to send. To read ahead of the peer, call openPrefetcher() and try
+ *    prefetchedChunk() first.
+ * -> When a file stops being shared, call dropSeedFile() so sessions still
+ *    holding it stop serving it.
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  */
 
@@ -51,13 +79,28 @@
 
 namespace dfd {
 
+struct FileHandle;
+struct DownloadFile;
+struct SeedPrefetcher;
+
+//file uuid schemes, see fileUuid()
+inline constexpr uint8_t HASH_SHA256 = 0x01; //v1, sha256 of the whole file
+inline constexpr uint8_t HASH_TREE   = 0x02; //v2, parallel tree hash
+
+//one tree digest per chunk of a file
+using ChunkDigests = std::vector<std::array<uint8_t, 32>>;
+
+//each content defined segment's length then digest, in file order
+using SegmentDigests = std::vector<std::pair<uint32_t, std::array<uint8_t, 32>>>;
+
 /*
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  * setChunkSize
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  * Description:
- * -> Sets the chunk size to send and recieve at a time. The default of 1MiB is
- *    recommended (ie, don't call this unless you have a good reason to).
+ * -> Sets the default chunk size, used where a transfer didn't agree on its
+ *    own. The default of 1MiB is recommended (ie, don't call this unless you
+ *    have a good reason to). Transfers already under way aren't affected.
  *
  * Takes:
  * -> size:
@@ -66,6 +109,42 @@ namespace dfd {
  */
 void setChunkSize(const size_t size);
 
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * getChunkSize
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Returns the chunk size set by setChunkSize(), or the default.
+ *
+ * Returns:
+ * -> On success:
+ *    The size of a chunk, in bytes.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+size_t getChunkSize();
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * chunkSizeFor
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Picks a chunk size to fit a file, for a seeder to use when the downloader
+ *    leaves it up to them. Small files get small chunks so several peers can
+ *    share them, huge files get bigger ones so fewer round trips are spent per
+ *    byte. Always the same for the same size, so every peer of a file agrees,
+ *    and always lines up with the tree hash so manifests still work.
+ *
+ * Takes:
+ * -> f_size:
+ *    The size of the file.
+ *
+ * Returns:
+ * -> On success:
+ *    The chunk size, between MIN_CHUNK_SIZE and MAX_CHUNK_SIZE.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+size_t chunkSizeFor(const uint64_t f_size);
+
 std::filesystem::path initDownloadDir();
 
 /*
@@ -116,12 +195,13 @@ std::optional<ssize_t> fileSize(const std::filesystem::path& f_path);
  * chunksInFile
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  * Description:
- * -> Returns the number of chunks the file will be, calculated with the
- *    internal chunk_size.
+ * -> Returns the number of chunks the file will be, split into c_size chunks.
  *
  * Takes:
  * -> f_size:
  *    The size of the file, obtained from fileSize().
+ * -> c_size:
+ *    The chunk size.
  *
  * Returns:
  * -> On success:
@@ -130,7 +210,7 @@ std::optional<ssize_t> fileSize(const std::filesystem::path& f_path);
  *    std::nullopt
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  */
-std::optional<size_t> fileChunks(const ssize_t f_size);
+std::optional<size_t> fileChunks(const ssize_t f_size, const size_t c_size);
 
 /*
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
@@ -145,13 +225,12 @@ std::optional<size_t> fileChunks(const ssize_t f_size);
  *    The path to the file, absolute from root or relative from cwd.
  * -> buff:
  *    The buffer to read the file into. Any data in the buffer prior to this
- *    will be overwritten. chunk_size bytes will be written here, unless it's
- *    the final chunk. It could be anything between 1 and chunk_size in that
- *    case.
- * -> chunk_size:
- *    The size of file chunks.
+ *    will be overwritten. c_size bytes will be written here, unless it's the
+ *    final chunk. It could be anything between 1 and c_size in that case.
  * -> chunk:
  *    Which chunk to read in. 0-indexed.
+ * -> c_size:
+ *    The size of file chunks.
  *
  * Returns:
  * -> On success:
@@ -162,147 +241,1130 @@ std::optional<size_t> fileChunks(const ssize_t f_size);
  */
 std::optional<ssize_t> packageFileChunk(const std::filesystem::path& f_path,
                                               std::vector<uint8_t>&  buff,
-                                        const size_t                 chunk);
+                                        const size_t                 chunk,
+                                        const size_t                 c_size);
 
 /*
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
- * storeFileChunk
+ * openSeedFile
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  * Description:
- * -> Takes a recieved chunk of bytes, some data recieved from a collection of
- *    packets. Stores the bytes to disk so we can reuse the RAM. Stores the file
- *    in the download directory as f_path->[chunk#]
+ * -> Returns a shared handle to an indexed file for serving chunks from. Every
+ *    session seeding the same path shares one open fd, and the file is only
+ *    stat'd here, once per session, rather than for every chunk. If the file
+ *    changed on disk since the cached handle was opened, a new one is opened
+ *    and the old one is invalidated. Each call counts as a seed session when
+ *    picking how the file is kept in the page cache, see seedPolicy.hpp.
  *
  * Takes:
- * -> f_name:
- *    The name of the file where building. Ex. doc.txt, and chunks like
- *    doc.txt-0 are unpacked.
+ * -> f_path:
+ *    The path to the file, absolute or relative from cwd.
+ *
+ * Returns:
+ * -> On success:
+ *    The handle.
+ * -> On failure:
+ *    nullptr
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+std::shared_ptr<FileHandle> openSeedFile(const std::filesystem::path& f_path);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * dropSeedFile
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Evicts a file from the seed handle cache. Sessions still holding a handle
+ *    to it will fail their next packageFileChunk() call. The fd is closed once
+ *    the last of them lets go.
+ *
+ * Takes:
+ * -> f_path:
+ *    The path the file was opened with.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+void dropSeedFile(const std::filesystem::path& f_path);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * fileSize
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Returns the size of an open seed file in bytes, as it was when opened. No
+ *    syscalls are made.
+ *
+ * Takes:
+ * -> file:
+ *    The handle from openSeedFile().
+ *
+ * Returns:
+ * -> On success:
+ *    A non-negative number of bytes.
+ * -> On failure:
+ *    std::nullopt, if the handle is null or was invalidated.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+std::optional<ssize_t> fileSize(const std::shared_ptr<FileHandle>& file);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * packageFileChunk
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Same as above, but reads through an open handle with pread() into the
+ *    caller's buffer, instead of stat'ing and reopening the file by path.
+ *
+ * Takes:
+ * -> file:
+ *    The handle from openSeedFile().
  * -> buff:
- *    The buffer to read data off of.
- * -> data_len:
- *    The length of data to write.
+ *    The buffer to read the chunk into. Resized to the bytes read.
  * -> chunk:
- *    Which chunk to store. 0-indexed.
+ *    Which chunk to read in. 0-indexed.
+ * -> c_size:
+ *    The chunk size this session agreed on.
  *
  * Returns:
  * -> On success:
- *    EXIT_SUCCESS
+ *    Bytes read into buffer.
  * -> On failure:
- *    EXIT_FAILURE
+ *    std::nullopt. Also returned once the handle is invalidated, or if the
+ *    file was found to have shrunk, which invalidates the handle.
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  */
-int unpackFileChunk(const std::string&           f_name,
-                    const std::vector<uint8_t>&  buff,
-                    const size_t                 data_len,
-                    const size_t                 chunk);
+std::optional<ssize_t> packageFileChunk(const std::shared_ptr<FileHandle>& file,
+                                              std::vector<uint8_t>&        buff,
+                                        const size_t                       chunk,
+                                        const size_t                       c_size);
+
+//where a chunk lives in an open seed file, for handing straight to the kernel
+struct FileRange {
+    int    fd;
+    off_t  offset;
+    size_t len;
+};
 
 /*
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
- * openFile
+ * chunkRange
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  * Description:
- * -> Creates a file, writing the first chunk to it. Must have the first chunk
- *    unpacked by any download process to start creating the main file. Doesn't
- *    care if first chunk is less than chunk_size (already EOF), expects the
- *    caller to handle calling saveFile() after. Errors out if first chunk is
- *    missing, or for any other reason like not being able to write to disk.
+ * -> Works out where a chunk sits in an open seed file without reading it, so
+ *    the bytes can be sent with tcp::sendFileMessage() instead of being copied
+ *    into a buffer by packageFileChunk(). The fd stays owned by the handle, so
+ *    the handle must be held until the send is done.
  *
  * Takes:
- * -> f_name:
- *    The name of the file to create inside the download directory.
+ * -> file:
+ *    The handle from openSeedFile().
+ * -> chunk:
+ *    Which chunk to locate. 0-indexed.
+ * -> c_size:
+ *    The chunk size this session agreed on.
  *
  * Returns:
  * -> On success:
- *    A pointer to the file.
+ *    The fd, offset and length of the chunk. len is 0 for an empty file.
  * -> On failure:
- *   nullptr
+ *    std::nullopt, if the handle is invalid or the chunk is past EOF.
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  */
-std::unique_ptr<std::ofstream> openFile(const std::string& f_name);
+std::optional<FileRange> chunkRange(const std::shared_ptr<FileHandle>& file,
+                                    const size_t                       chunk,
+                                    const size_t                       c_size);
 
 /*
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
- * assembleChunk
+ * canSendRange
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  * Description:
- * -> Appends a chunk to the file.
+ * -> Whether chunks of an open seed file can be sent from chunkRange(). A file
+ *    read around the page cache with O_DIRECT can't, since sending it from the
+ *    fd would pull it back in. Use packageFileChunk() for those.
  *
  * Takes:
  * -> file:
- *    The file to write the chunk to.
+ *    The handle from openSeedFile().
+ *
+ * Returns:
+ * -> On success:
+ *    true if chunkRange() can be used, false otherwise.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+bool canSendRange(const std::shared_ptr<FileHandle>& file);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * rangeSent
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Call once a range from chunkRange() has been sent, so a streamed file can
+ *    drop it from the page cache. packageFileChunk() does this itself.
+ *
+ * Takes:
+ * -> file:
+ *    The handle from openSeedFile().
+ * -> range:
+ *    The range that was sent.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+void rangeSent(const std::shared_ptr<FileHandle>& file, const FileRange& range);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * rangeShort
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Call if a range from chunkRange() couldn't all be sent because the file
+ *    ended first. The file was truncated since it was opened, so the handle
+ *    is invalidated the same as when packageFileChunk() comes up short, and
+ *    the next openSeedFile() opens it fresh.
+ *
+ * Takes:
+ * -> file:
+ *    The handle from openSeedFile().
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+void rangeShort(const std::shared_ptr<FileHandle>& file);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * openPrefetcher
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Starts reading ahead for a seed session, see prefetch.hpp. Call once the
+ *    session's chunk size is settled, and ask prefetchedChunk() for each chunk
+ *    before reading it any other way.
+ *
+ * Takes:
+ * -> file:
+ *    The handle from openSeedFile().
+ * -> c_size:
+ *    The chunk size this session agreed on.
+ *
+ * Returns:
+ * -> On success:
+ *    The session's prefetcher.
+ * -> On failure:
+ *    nullptr. prefetchedChunk() then always misses.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+std::shared_ptr<SeedPrefetcher> openPrefetcher(const std::shared_ptr<FileHandle>& file,
+                                               const size_t                       c_size);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * prefetchedChunk
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Records that a chunk was asked for and hands it back if it was read ahead,
+ *    then starts reading ahead of it.
+ *
+ * Takes:
+ * -> p:
+ *    The prefetcher from openPrefetcher().
  * -> chunk:
- *    The size of the entire file.
+ *    The chunk asked for. 0-indexed.
  *
  * Returns:
  * -> On success:
- *    EXIT_SUCESS
+ *    The chunk, in a buffer from the buffer pool, the chunk was read ahead.
  * -> On failure:
- *    EXIT_FAILURE
+ *    nullptr, read the chunk with chunkRange() or packageFileChunk().
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  */
-int assembleChunk(      std::ofstream* file,
-                  const std::string&                    f_name,
-                  const size_t                          chunk);
+PooledBuffer prefetchedChunk(const std::shared_ptr<SeedPrefetcher>& p,
+                             const size_t                           chunk);
 
 /*
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
- * saveFile
+ * endPrefetcher
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  * Description:
- * -> Calls close on file, and releases ownership. Should only be called once
- *    all chunks have been written to the file with assembleChunk.
+ * -> Stops a session's read-ahead once the session is over.
+ *
+ * Takes:
+ * -> p:
+ *    The prefetcher from openPrefetcher(). Reset.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+void endPrefetcher(std::shared_ptr<SeedPrefetcher>& p);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * PrefetchStats
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> How well prefetching has done, over every seed session so far.
+ *
+ * Member Variables:
+ * -> hits:
+ *    Requests answered from a chunk read ahead.
+ * -> misses:
+ *    Requests that had to go to the disk.
+ * -> wasted:
+ *    Chunks read ahead that were never asked for.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+struct PrefetchStats {
+    uint64_t hits   = 0;
+    uint64_t misses = 0;
+    uint64_t wasted = 0;
+};
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * prefetchStats
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Returns how well read-ahead has done over every seed session so far.
+ *
+ * Returns:
+ * -> On success:
+ *    The hit, miss and waste counts.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+PrefetchStats prefetchStats();
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * openDownloadFile
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Opens a file in the download directory to download into. If an earlier
+ *    download of the same uuid was interrupted, its partial file and .dfdpart
+ *    sidecar are picked back up, and missingChunks() only returns what it
+ *    didn't finish. Otherwise a new file is created, preallocated to f_size
+ *    bytes. Fails if a file of that name exists that isn't a resumable
+ *    download of this uuid, with this chunk size.
+ *
+ * Takes:
+ * -> f_name:
+ *    The name of the file inside the download directory. May have directories
+ *    in it, they have to exist already.
+ * -> f_size:
+ *    The size of the file, from DOWNLOAD_CONFIRM.
+ * -> uuid:
+ *    The uuid of the file being downloaded.
+ * -> c_size:
+ *    The chunk size, from DOWNLOAD_CONFIRM. Every peer the download uses has
+ *    to send with this size.
+ *
+ * Returns:
+ * -> On success:
+ *    A shared handle to the file for writeFileChunk().
+ * -> On failure:
+ *    nullptr
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+std::shared_ptr<DownloadFile> openDownloadFile(const std::string& f_name,
+                                               const uint64_t     f_size,
+                                               const uint64_t     uuid,
+                                               const size_t       c_size);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * partialChunkSize
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Looks for an interrupted download of a file in the download directory,
+ *    and returns the chunk size it was using. A resume has to ask peers for
+ *    that size again, or openDownloadFile() can't pick it back up.
+ *
+ * Takes:
+ * -> f_name, f_size, uuid:
+ *    See openDownloadFile().
+ *
+ * Returns:
+ * -> On success:
+ *    The chunk size recorded in its .dfdpart sidecar.
+ * -> On failure:
+ *    std::nullopt, if there's no interrupted download of this file.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+std::optional<size_t> partialChunkSize(const std::string& f_name,
+                                       const uint64_t     f_size,
+                                       const uint64_t     uuid);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * downloadChunkSize
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Returns the chunk size a download was opened with.
  *
  * Takes:
  * -> file:
- *    The file to close and deallocate.
+ *    The handle from openDownloadFile().
  *
  * Returns:
  * -> On success:
- *    EXIT_SUCCESS
+ *    The chunk size.
+ * -> On failure:
+ *    0, if file is null.
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  */
-int saveFile(std::unique_ptr<std::ofstream> file);
+size_t downloadChunkSize(const std::shared_ptr<DownloadFile>& file);
 
 /*
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
- * deleteFile
+ * missingChunks
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  * Description:
- * -> Deletes a file, if it exists.
+ * -> Lists the chunks of a download that haven't been written yet. For a new
+ *    download that's every chunk.
  *
  * Takes:
- * -> f_path:
- *    The path to the file to delete.
+ * -> file:
+ *    The handle from openDownloadFile().
  *
  * Returns:
  * -> On success:
- *    EXIT_SUCCESS
+ *    The missing chunk indexes, ascending.
  * -> On failure:
- *    EXIT_FAILURE
+ *    An empty vector.
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  */
-int deleteFile(const std::string& f_path);
+std::vector<size_t> missingChunks(const std::shared_ptr<DownloadFile>& file);
 
 /*
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
- * sha512Hash
+ * writeFileChunk
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  * Description:
- * -> Computes the SHA512 hash of a file on the disk. If the file DNE, or on any
- *    other error (perms, etc.) 0 is returned. Truncates the first 8-bytes to
- *    return.
+ * -> Writes a received chunk to its offset in the download file with pwrite().
+ *    Thread safe, chunks can be written in any order from any thread. The
+ *    chunk must be exactly as long as that chunk of the file is, anything
+ *    else is rejected so a bad peer can't write past the end of its chunk.
+ *    The chunk is recorded as done at the next checkpointDownloadFile().
  *
  * Takes:
- * -> f_path:
- *    The path to the file, relative or absolute, on the disk.
+ * -> file:
+ *    The handle from openDownloadFile().
+ * -> buff:
+ *    The chunk's data.
+ * -> data_len:
+ *    The length of data to write.
+ * -> chunk:
+ *    Which chunk this is. 0-indexed.
  *
  * Returns:
  * -> On success:
- *    A 8-byte hash.
+ *    EXIT_SUCCESS
  * -> On failure:
- *    0
+ *    EXIT_FAILURE
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  */
-uint64_t sha256Hash(const std::filesystem::path& f_path);
+int writeFileChunk(const std::shared_ptr<DownloadFile>& file,
+                   const std::vector<uint8_t>&          buff,
+                   const size_t                         data_len,
+                   const size_t                         chunk);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * writeFileChunkAsync
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Same as writeFileChunk(), but the chunk is staged and written in the
+ *    background, so the caller can go back to receiving while the disk catches
+ *    up. Staged chunks are written in contiguous runs with one pwritev() each,
+ *    see writeBehind.hpp. Only waits if DOWNLOAD_DIRTY_BYTES of this file are
+ *    already waiting to be written. The chunk is only marked once it's
+ *    written.
+ *
+ * Takes:
+ * -> file:
+ *    The handle from openDownloadFile(). Kept alive until the write is done.
+ * -> buff:
+ *    The chunk's data, exactly as long as the chunk. Moved from.
+ * -> chunk:
+ *    Which chunk this is. 0-indexed.
+ * -> done:
+ *    Called once the write finishes, with EXIT_SUCCESS or EXIT_FAILURE.
+ *    Usually from an I/O engine thread, and possibly well after this returns
+ *    if the chunk is staged. Not called if this returns EXIT_FAILURE.
+ *
+ * Returns:
+ * -> On success:
+ *    EXIT_SUCCESS, the write is queued.
+ * -> On failure:
+ *    EXIT_FAILURE, if the chunk was rejected outright.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+int writeFileChunkAsync(const std::shared_ptr<DownloadFile>& file,
+                              std::vector<uint8_t>&&         buff,
+                        const size_t                         chunk,
+                              std::function<void(int)>       done);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * writeFileChunkAsync
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Same as above, but shares the caller's buffer instead of taking it, so a
+ *    PooledBuffer goes back to the pool once the write is done.
+ *
+ * Takes:
+ * -> data:
+ *    The chunk's data, exactly as long as the chunk. Mustn't be changed until
+ *    done is called.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+int writeFileChunkAsync(const std::shared_ptr<DownloadFile>&               file,
+                        const std::shared_ptr<const std::vector<uint8_t>>& data,
+                        const size_t                                       chunk,
+                              std::function<void(int)>                     done);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * flushFileWrites
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Starts writing every chunk writeFileChunkAsync() is still holding back,
+ *    without waiting for them to finish. Thread safe.
+ *
+ * Takes:
+ * -> file:
+ *    The handle from openDownloadFile().
+ *
+ * Returns:
+ * -> On success:
+ *    How many chunks were held back.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+size_t flushFileWrites(const std::shared_ptr<DownloadFile>& file);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * waitFileWrites
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Writes anything writeFileChunkAsync() is holding back, then blocks until
+ *    every chunk given to it has been written and had its done callback run.
+ *
+ * Takes:
+ * -> file:
+ *    The handle from openDownloadFile().
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+void waitFileWrites(const std::shared_ptr<DownloadFile>& file);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * setDownloadManifest
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Gives a download the per-chunk digests a peer sent for it, after checking
+ *    they combine back to the uuid being downloaded. From then on
+ *    verifyFileChunk() checks chunks against them. A manifest that doesn't
+ *    match the uuid means the peer sending it can't be trusted.
+ *
+ * Takes:
+ * -> file:
+ *    The handle from openDownloadFile().
+ * -> c_size:
+ *    The chunk size the manifest was built for.
+ * -> digests:
+ *    One digest per chunk.
+ *
+ * Returns:
+ * -> On success:
+ *    EXIT_SUCCESS
+ * -> On failure:
+ *    EXIT_FAILURE, if the manifest doesn't belong to this file or chunk size.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+int setDownloadManifest(const std::shared_ptr<DownloadFile>& file,
+                        const size_t                         c_size,
+                        const ChunkDigests&                  digests);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * verifyFileChunk
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Checks a received chunk against the download's manifest, before it's
+ *    written. Thread safe.
+ *
+ * Takes:
+ * -> file:
+ *    The handle from openDownloadFile().
+ * -> buff:
+ *    The chunk's data.
+ * -> data_len:
+ *    The length of the data.
+ * -> chunk:
+ *    Which chunk this is. 0-indexed.
+ *
+ * Returns:
+ * -> On success:
+ *    true if the chunk matches, or there's no manifest to check against.
+ * -> On failure:
+ *    false, the chunk is corrupt and its sender shouldn't be trusted.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+bool verifyFileChunk(const std::shared_ptr<DownloadFile>& file,
+                     const std::vector<uint8_t>&          buff,
+                     const size_t                         data_len,
+                     const size_t                         chunk);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * checkpointDownloadFile
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Makes every chunk written so far survive a crash, by flushing the file and
+ *    then recording them in the sidecar. Costs an fdatasync(), so call it
+ *    every so many chunks rather than after each one. Chunks still held back
+ *    by writeFileChunkAsync() are started on their way, and are recorded by
+ *    the next checkpoint.
+ *
+ * Takes:
+ * -> file:
+ *    The handle from openDownloadFile().
+ *
+ * Returns:
+ * -> On success:
+ *    EXIT_SUCCESS
+ * -> On failure:
+ *    EXIT_FAILURE
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+int checkpointDownloadFile(const std::shared_ptr<DownloadFile>& file);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * verifyDownloadFile
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Checks a finished download hashes back to the uuid it was requested by.
+ *    Chunks are hashed in order as they're written, so this only has to read
+ *    back the ones that arrived too far out of order, or before a resume. A
+ *    download with a manifest was already checked chunk by chunk, and passes
+ *    straight away. Waits for queued async writes first. Call once, after
+ *    every chunk is written.
+ *
+ * Takes:
+ * -> file:
+ *    The handle from openDownloadFile().
+ *
+ * Returns:
+ * -> On success:
+ *    The chunks to fetch again, empty if the file is intact. Without a
+ *    manifest there's no telling which chunk is wrong, so on a mismatch it's
+ *    all of them.
+ * -> On failure:
+ *    std::nullopt, if the file couldn't be read back.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+std::optional<std::vector<size_t>> verifyDownloadFile(const std::shared_ptr<DownloadFile>& file);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * discardChunks
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Marks chunks as not downloaded, so the next attempt at the download
+ *    fetches them again. Meant for the result of verifyDownloadFile().
+ *
+ * Takes:
+ * -> file:
+ *    The handle from openDownloadFile().
+ * -> chunks:
+ *    The chunks to fetch again.
+ *
+ * Returns:
+ * -> On success:
+ *    EXIT_SUCCESS
+ * -> On failure:
+ *    EXIT_FAILURE
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+int discardChunks(const std::shared_ptr<DownloadFile>& file,
+                  const std::vector<size_t>&           chunks);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * closeDownloadFile
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Releases the caller's handle to the download file, once any queued async
+ *    writes have finished. A complete download is flushed and its sidecar
+ *    removed. An incomplete one is checkpointed and left on disk, so the next
+ *    openDownloadFile() of it resumes.
+ *
+ * Takes:
+ * -> file:
+ *    The handle from openDownloadFile(). Reset by this call.
+ * -> complete:
+ *    Whether every chunk was written.
+ *
+ * Returns:
+ * -> On success:
+ *    EXIT_SUCCESS
+ * -> On failure:
+ *    EXIT_FAILURE
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+int closeDownloadFile(std::shared_ptr<DownloadFile>& file, bool complete);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * storeFileChunk
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Takes a recieved chunk of bytes, some data recieved from a collection of
+ *    packets. Stores the bytes to disk so we can reuse the RAM. Stores the file
+ *    in the download directory as f_path->[chunk#]
+ *
+ * Takes:
+ * -> f_name:
+ *    The name of the file where building. Ex. doc.txt, and chunks like
+ *    doc.txt-0 are unpacked.
+ * -> buff:
+ *    The buffer to read data off of.
+ * -> data_len:
+ *    The length of data to write.
+ * -> chunk:
+ *    Which chunk to store. 0-indexed.
+ *
+ * Returns:
+ * -> On success:
+ *    EXIT_SUCCESS
+ * -> On failure:
+ *    EXIT_FAILURE
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+int unpackFileChunk(const std::string&           f_name,
+                    const std::vector<uint8_t>&  buff,
+                    const size_t                 data_len,
+                    const size_t                 chunk);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * openFile
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Creates a file, writing the first chunk to it. Must have the first chunk
+ *    unpacked by any download process to start creating the main file. Doesn't
+ *    care if first chunk is less than chunk_size (already EOF), expects the
+ *    caller to handle calling saveFile() after. Errors out if first chunk is
+ *    missing, or for any other reason like not being able to write to disk.
+ *
+ * Takes:
+ * -> f_name:
+ *    The name of the file to create inside the download directory.
+ *
+ * Returns:
+ * -> On success:
+ *    A pointer to the file.
+ * -> On failure:
+ *   nullptr
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+std::unique_ptr<std::ofstream> openFile(const std::string& f_name);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * assembleChunk
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Appends a chunk to the file.
+ *
+ * Takes:
+ * -> file:
+ *    The file to write the chunk to.
+ * -> chunk:
+ *    The size of the entire file.
+ * -> c_size:
+ *    The chunk size the file is being sent with.
+ *
+ * Returns:
+ * -> On success:
+ *    EXIT_SUCESS
+ * -> On failure:
+ *    EXIT_FAILURE
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+int assembleChunk(      std::ofstream* file,
+                  const std::string&                    f_name,
+                  const size_t                          chunk,
+                  const size_t                          c_size);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * saveFile
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Calls close on file, and releases ownership. Should only be called once
+ *    all chunks have been written to the file with assembleChunk. Chunks are
+ *    buffered until then, so this is where a failed write shows up.
+ *
+ * Takes:
+ * -> file:
+ *    The file to close and deallocate.
+ *
+ * Returns:
+ * -> On success:
+ *    EXIT_SUCCESS
+ * -> On failure:
+ *    EXIT_FAILURE, if anything couldn't be written.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+int saveFile(std::unique_ptr<std::ofstream> file);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * deleteFile
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Deletes a file, if it exists.
+ *
+ * Takes:
+ * -> f_path:
+ *    The path to the file to delete.
+ *
+ * Returns:
+ * -> On success:
+ *    EXIT_SUCCESS
+ * -> On failure:
+ *    EXIT_FAILURE
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+int deleteFile(const std::string& f_path);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * sha512Hash
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Computes the SHA512 hash of a file on the disk. If the file DNE, or on any
+ *    other error (perms, etc.) 0 is returned. Truncates the first 8-bytes to
+ *    return.
+ *
+ * Takes:
+ * -> f_path:
+ *    The path to the file, relative or absolute, on the disk.
+ *
+ * Returns:
+ * -> On success:
+ *    A 8-byte hash.
+ * -> On failure:
+ *    0
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+uint64_t sha256Hash(const std::filesystem::path& f_path);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * treeHash
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Computes the v2 uuid of a file on the disk. The file is hashed in 256 KiB
+ *    leaves on every core at once, and the leaf digests are combined in a
+ *    fixed order binary tree, so the result is the same on every machine no
+ *    matter how many threads hashed it. See treeHash.hpp for the exact layout.
+ *
+ * Takes:
+ * -> f_path:
+ *    The path to the file, relative or absolute, on the disk.
+ *
+ * Returns:
+ * -> On success:
+ *    A 8-byte hash.
+ * -> On failure:
+ *    0
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+uint64_t treeHash(const std::filesystem::path& f_path);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * dataUuid
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Computes the uuid treeHash() would give a file holding exactly these
+ *    bytes, for things that are shared under a uuid but aren't files on the
+ *    disk, like bundle manifests.
+ *
+ * Takes:
+ * -> data, len:
+ *    The bytes.
+ *
+ * Returns:
+ * -> On success:
+ *    A 8-byte hash.
+ * -> On failure:
+ *    0
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+uint64_t dataUuid(const uint8_t* data, const size_t len);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * setHashScheme
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Sets which scheme fileUuid() identifies files with. Defaults to
+ *    HASH_SHA256, so files indexed before v2 existed keep their uuids. A file
+ *    gets a different uuid under each scheme, so peers sharing the same file
+ *    should agree on one.
+ *
+ * Takes:
+ * -> scheme:
+ *    HASH_SHA256 or HASH_TREE.
+ *
+ * Returns:
+ * -> On success:
+ *    EXIT_SUCCESS
+ * -> On failure:
+ *    EXIT_FAILURE, for an unknown scheme. The scheme is left alone.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+int setHashScheme(const uint8_t scheme);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * getHashScheme
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Returns the scheme set with setHashScheme().
+ *
+ * Returns:
+ * -> On success:
+ *    HASH_SHA256 or HASH_TREE.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+uint8_t getHashScheme();
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * setHashCache
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Turns on the on-disk hash cache, stored at c_path. Once on, fileUuid()
+ *    remembers every uuid it computes along with the file's device, inode,
+ *    size and mtime, and only hashes a file again once one of those changes.
+ *
+ * Takes:
+ * -> c_path:
+ *    Where to keep the cache. Created if it doesn't exist.
+ *
+ * Returns:
+ * -> On success:
+ *    EXIT_SUCCESS
+ * -> On failure:
+ *    EXIT_FAILURE. Files are hashed every time, as if it was never called.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+int setHashCache(const std::filesystem::path& c_path);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * fileUuid
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Computes a file's uuid with the current hash scheme. If the hash cache is
+ *    on and the file hasn't changed since it was last hashed, the cached uuid
+ *    is returned without reading the file, along with its manifest for
+ *    HASH_TREE. With HASH_TREE the file's content defined segments are cut
+ *    while it's hashed and kept in the hash cache, see segmentDigests().
+ *
+ * Takes:
+ * -> f_path:
+ *    The path to the file, relative or absolute, on the disk.
+ *
+ * Returns:
+ * -> On success:
+ *    A 8-byte hash.
+ * -> On failure:
+ *    0
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+uint64_t fileUuid(const std::filesystem::path& f_path);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * chunkManifest
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Returns the per-chunk digests of a file this client indexed with the tree
+ *    hash, for a chunk size. The leaf digests are kept from when the file was
+ *    hashed, so the file isn't read again. Files identified with HASH_SHA256
+ *    have no manifest.
+ *
+ * Takes:
+ * -> uuid:
+ *    The file's uuid.
+ * -> c_size:
+ *    The chunk size the session agreed on.
+ *
+ * Returns:
+ * -> On success:
+ *    One digest per chunk.
+ * -> On failure:
+ *    std::nullopt, if the file has no manifest or the chunk size doesn't line
+ *    up with the tree's leaves.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+std::optional<ChunkDigests> chunkManifest(const uint64_t uuid, const size_t c_size);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * dropManifest
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Forgets the leaf digests kept for a file, once it's no longer shared.
+ *
+ * Takes:
+ * -> uuid:
+ *    The file's uuid.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+void dropManifest(const uint64_t uuid);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * setChunkStore
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Turns the local chunk store on or off, see chunkStore.hpp. Off by
+ *    default. While on, every file fileUuid() identifies with HASH_TREE, and
+ *    every download finished with a manifest, is added to it, and
+ *    fillFromChunkStore() copies chunks out of them. Only files seen after
+ *    it's turned on are added.
+ *
+ * Takes:
+ * -> on:
+ *    Whether to keep the store.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+void setChunkStore(const bool on);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * fillFromChunkStore
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Writes every missing chunk of a download that some file on this machine
+ *    already holds, found by the chunk's digest in the download's manifest.
+ *    Each chunk is checked against the manifest before it's written, so they
+ *    count as received. Does nothing without a manifest or with the store off.
+ *
+ * Takes:
+ * -> file:
+ *    The handle from openDownloadFile(), with a manifest set.
+ *
+ * Returns:
+ * -> On success:
+ *    How many chunks were written. 0 if none were found.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+size_t fillFromChunkStore(const std::shared_ptr<DownloadFile>& file);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * segmentDigests
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Returns a seeded file's content defined segments, for a downloader to
+ *    find in a near copy of its own, see contentChunks.hpp. Only what was cut
+ *    when the file was hashed with HASH_TREE is returned, read back from the
+ *    hash cache. Nothing is cut here.
+ *
+ * Takes:
+ * -> file:
+ *    The handle from openSeedFile().
+ *
+ * Returns:
+ * -> On success:
+ *    The segments.
+ * -> On failure:
+ *    std::nullopt, if none were kept for this version of the file.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+std::optional<SegmentDigests> segmentDigests(const std::shared_ptr<FileHandle>& file);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * wantsSegments
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> If it's worth asking the peer for the file's segments, after
+ *    fillFromChunkStore(). Only with the store on, a manifest to check the
+ *    chunks against, chunks still missing, and segments in the store to look
+ *    for them by.
+ *
+ * Takes:
+ * -> file:
+ *    The handle from openDownloadFile().
+ *
+ * Returns:
+ * -> true if fillFromSegments() might find something.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+bool wantsSegments(const std::shared_ptr<DownloadFile>& file);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * fillFromSegments
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Writes every missing chunk of a download whose bytes are all in files on
+ *    this machine, found by the segments the peer sent rather than by chunk,
+ *    so they're found however far they've shifted. Each chunk is put
+ *    together from the segments it overlaps and checked against the manifest
+ *    before it's written, so a peer lying about its segments can't get bad
+ *    data in. Does nothing without a manifest or with the store off.
+ *
+ * Takes:
+ * -> file:
+ *    The handle from openDownloadFile(), with a manifest set.
+ * -> segments:
+ *    The segments of the file being downloaded.
+ *
+ * Returns:
+ * -> On success:
+ *    How many chunks were written. 0 if none were found.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+size_t fillFromSegments(const std::shared_ptr<DownloadFile>& file,
+                        const SegmentDigests&                segments);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * ChunkStoreStats
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> What the chunk store has saved, over every download so far.
+ *
+ * Member Variables:
+ * -> files:
+ *    Files in the store now.
+ * -> chunks:
+ *    Chunks copied from local files instead of fetched.
+ * -> bytes:
+ *    Bytes in those chunks.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+struct ChunkStoreStats {
+    uint64_t files  = 0;
+    uint64_t chunks = 0;
+    uint64_t bytes  = 0;
+};
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * chunkStoreStats
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Returns what the chunk store has saved so far. Thread safe.
+ *
+ * Returns:
+ * -> On success:
+ *    The counts.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+ChunkStoreStats chunkStoreStats();
 
 }
@@ -0,0 +1,231 @@
+#pragma once
+
+#include "networking/fileParsing.hpp"
+#include "networking/internal/fileParsing/contentChunks.hpp"
+#include "networking/internal/fileParsing/hashCache.hpp"
+#include "networking/internal/fileParsing/treeHash.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <vector>
+
+namespace dfd {
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * A note on the chunk store
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Files hashed with the tree hash are identified by their content, chunk by
+ * chunk: a chunk's digest only depends on its bytes, not on which file or
+ * offset they came from. The store remembers the digests of every file on
+ * this machine that has them, the ones indexed with HASH_TREE and the
+ * downloads finished with a manifest, and looks chunks up by digest. A new
+ * download whose manifest names a chunk already on the disk, under any uuid,
+ * copies it from there instead of fetching it.
+ *
+ * Indexed files can be looked up at any chunk size the tree lines up with,
+ * downloads only at the chunk size they were fetched with. Nothing in the
+ * store is trusted: a file whose stamp changed is dropped, and every chunk
+ * copied out is hashed again before it's written.
+ *
+ * Chunks only match at the same chunk aligned offset in both files. For a
+ * near copy whose bytes have shifted, files in the store can also be looked
+ * up by content defined segment, see contentChunks.hpp. A seeder sends the
+ * segments of the file being downloaded, and a chunk whose every segment is
+ * on the disk is put together from them, then checked against the manifest
+ * like any other. A file's segments come in with its digests, cut when it
+ * was hashed or finished downloading, and are indexed as they arrive, so a
+ * lookup never reads a file.
+ *
+ * The store only knows this machine's files. Finding a peer that holds a
+ * segment under another uuid needs the servers to index segment digests:
+ * INDEX_REQUEST would carry the file's segment digests, the server would keep
+ * which uuids hold each, and a downloader would ask for the peers of the
+ * segments it couldn't find locally, then fetch them by uuid, offset and
+ * length. That's a change to the server's schema and its sync with other
+ * servers, and isn't done yet.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * StoredChunk
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Where a chunk with some digest can be read from.
+ *
+ * Member Variables:
+ * -> f_path:
+ *    The absolute path of the file holding it.
+ * -> chunk:
+ *    Which chunk of that file it is, at the chunk size it was looked up with.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+struct StoredChunk {
+    std::filesystem::path f_path;
+    size_t                chunk = 0;
+};
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * StoredSegment
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Where a segment with some digest can be read from.
+ *
+ * Member Variables:
+ * -> f_path:
+ *    The absolute path of the file holding it.
+ * -> offset:
+ *    Where in that file it starts.
+ * -> len:
+ *    How long it is.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+struct StoredSegment {
+    std::filesystem::path f_path;
+    uint64_t              offset = 0;
+    uint32_t              len    = 0;
+};
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * storeLeaves
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Adds a tree hashed file to the store, replacing what was kept for the
+ *    same path. Thread safe.
+ *
+ * Takes:
+ * -> f_path:
+ *    The file's absolute path.
+ * -> stamp:
+ *    The file's stamp when it was hashed.
+ * -> leaves:
+ *    Its leaf digests.
+ * -> segments:
+ *    Its segments, empty if they weren't cut.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+void storeLeaves(const std::filesystem::path& f_path,
+                 const FileStamp&             stamp,
+                 const std::vector<Digest>&   leaves,
+                 const std::vector<Segment>&  segments);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * storeChunks
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Adds a file whose digests are only known at one chunk size, a finished
+ *    download, replacing what was kept for the same path. Thread safe.
+ *
+ * Takes:
+ * -> f_path:
+ *    The file's absolute path.
+ * -> stamp:
+ *    The file's stamp now.
+ * -> c_size:
+ *    The chunk size the digests are for.
+ * -> digests:
+ *    One digest per chunk.
+ * -> segments:
+ *    Its segments, empty if they weren't cut.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+void storeChunks(const std::filesystem::path& f_path,
+                 const FileStamp&             stamp,
+                 const size_t                 c_size,
+                 const ChunkDigests&          digests,
+                 const std::vector<Segment>&  segments);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * forgetStoreFile
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Drops a file from the store, once it's gone or was found to have
+ *    changed. Thread safe.
+ *
+ * Takes:
+ * -> f_path:
+ *    The path it was added with.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+void forgetStoreFile(const std::filesystem::path& f_path);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * findStoredChunk
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Looks a chunk up by digest. Files whose stamp no longer matches are
+ *    dropped on the way. Thread safe.
+ *
+ * Takes:
+ * -> c_size:
+ *    The chunk size the digest is for.
+ * -> digest:
+ *    The chunk's digest.
+ *
+ * Returns:
+ * -> On success:
+ *    Where to read it from. The caller still has to check the bytes, the file
+ *    may have changed without its stamp changing.
+ * -> On failure:
+ *    std::nullopt, if no file in the store has it.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+std::optional<StoredChunk> findStoredChunk(const size_t c_size, const Digest& digest);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * findStoredSegment
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Looks a segment up by digest. A file whose stamp no longer matches is
+ *    dropped. Thread safe.
+ *
+ * Takes:
+ * -> digest:
+ *    The segment's digest.
+ *
+ * Returns:
+ * -> On success:
+ *    Where to read it from. The caller still has to check the bytes.
+ * -> On failure:
+ *    std::nullopt, if no file in the store has it.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+std::optional<StoredSegment> findStoredSegment(const Digest& digest);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * storeFiles
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Returns how many files are in the store. Thread safe.
+ *
+ * Returns:
+ * -> On success:
+ *    The count.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+size_t storeFiles();
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * storeSegmentCount
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Returns how many segments the store can look up. Thread safe.
+ *
+ * Returns:
+ * -> On success:
+ *    The count.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+size_t storeSegmentCount();
+
+} //dfd
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "networking/internal/fileParsing/treeHash.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace dfd {
+
+struct FileHandle;
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * A note on content defined segments
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Chunks sit at fixed offsets, so a byte inserted near the start of a file
+ * changes every chunk after it. Segments are cut where the file's content
+ * says to instead: a gear hash rolls over the bytes, and a segment ends where
+ * the hash of the last 64 bytes has its top SEGMENT_MASK_BITS clear. The same
+ * run of bytes is cut the same way wherever it sits in a file, so a near
+ * copy shares most of its segments with the original however its bytes
+ * shifted. Segments are kept between SEGMENT_MIN_SIZE and SEGMENT_MAX_SIZE.
+ * -> digest = SHA256(0x03 || segment bytes)
+ * The prefix keeps segment digests apart from the tree hash's.
+ *
+ * Every peer has to cut with the same parameters and gear table, or none of
+ * its segments match anyone else's.
+ *
+ * Cutting reads the whole file, so it's only done where the file's being read
+ * in full anyway: alongside the tree hash when a file's indexed, and when a
+ * download's finished. The segments are kept in the hash cache, see
+ * hashCache.hpp, and nothing cuts a file while a peer waits on it.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+
+inline constexpr size_t SEGMENT_MIN_SIZE  = 1 << 14; //16 KiB
+inline constexpr size_t SEGMENT_MAX_SIZE  = 1 << 18; //256 KiB
+inline constexpr int    SEGMENT_MASK_BITS = 16;      //cut every 64 KiB on average
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Segment
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> One content defined segment of a file.
+ *
+ * Member Variables:
+ * -> offset:
+ *    Where it starts in the file.
+ * -> len:
+ *    How long it is, at most SEGMENT_MAX_SIZE.
+ * -> digest:
+ *    Its digest, see above.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+struct Segment {
+    uint64_t offset = 0;
+    uint32_t len    = 0;
+    Digest   digest;
+};
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * contentSegments
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Cuts an open file into segments and hashes each. Reads the file once,
+ *    front to back.
+ *
+ * Takes:
+ * -> file:
+ *    The handle to cut.
+ *
+ * Returns:
+ * -> On success:
+ *    The segments in file order, covering the whole file. Empty for an empty
+ *    file.
+ * -> On failure:
+ *    std::nullopt, if the file couldn't be read in full.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+std::optional<std::vector<Segment>> contentSegments(const std::shared_ptr<FileHandle>& file);
+
+} //dfd
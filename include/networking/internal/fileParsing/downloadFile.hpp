@@ -0,0 +1,299 @@
+#pragma once
+
+#include "networking/internal/fileParsing/streamVerify.hpp"
+#include "networking/internal/fileParsing/treeHash.hpp"
+#include "networking/internal/fileParsing/writeBehind.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace dfd {
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * A note on .dfdpart sidecars
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Every download in progress has a sidecar next to it, named <file>.dfdpart,
+ * recording which chunks have made it to disk. All integers are big-endian.
+ * -> 8 bytes: "DFDPART" followed by a version byte, 0x01
+ * -> 8 bytes: the file's uuid
+ * -> 8 bytes: the file's size
+ * -> 8 bytes: the chunk size the bitmap was built with
+ * -> ceil(chunks/8) bytes: bitmap, bit (i%8) of byte (i/8) set once chunk i is
+ *    on disk
+ *
+ * The sidecar is mmap'd. Written chunks are only marked in memory until the
+ * next checkpoint, which fdatasync()s the data file, then sets their bits and
+ * msync()s the sidecar. A bit on disk therefore always means the chunk is
+ * too. The sidecar is removed once the download completes.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * DownloadFile
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> The destination of a download, created at its full size up front so every
+ *    download thread can pwrite() its chunks straight to their final offset.
+ *    Shared between the download threads through std::shared_ptr, the fds are
+ *    closed when the last of them lets go.
+ *
+ * Member Variables:
+ * -> fd:
+ *    The open file descriptor. Read as well as written, so chunks can be read
+ *    back to verify them.
+ * -> f_path:
+ *    Where the file lives.
+ * -> f_size:
+ *    The size of the finished file, from DOWNLOAD_CONFIRM.
+ * -> uuid:
+ *    The file's uuid, recorded in the sidecar.
+ * -> c_size:
+ *    The chunk size the bitmap is built with.
+ * -> f_chunks:
+ *    The number of chunks in the file.
+ * -> part_fd, part_map, part_len:
+ *    The sidecar's fd, and its mapping.
+ * -> bitmap:
+ *    Points into part_map. Chunks known to be on disk.
+ * -> pending:
+ *    Chunks written since the last checkpoint, same layout as bitmap.
+ * -> pending_count:
+ *    How many bits are set in pending.
+ * -> part_mtx:
+ *    Lock while touching bitmap or pending.
+ * -> manifest:
+ *    Per-chunk digests to check received chunks against, if the seeder had
+ *    them. Empty otherwise. Set once before download threads start.
+ * -> writer:
+ *    Chunks waiting to be written, see writeBehind.hpp.
+ * -> verifier:
+ *    Running digests of the file, see streamVerify.hpp.
+ *
+ * Constructor:
+ * -> Takes:
+ *    -> fd:
+ *       An open fd. The handle takes ownership of it.
+ *    -> f_path:
+ *       The path fd was opened from.
+ *    -> f_size:
+ *       The expected size of the file.
+ * Destructor:
+ * -> Unmaps and closes the sidecar, closes fd.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+struct DownloadFile {
+    int                     fd;
+    std::filesystem::path   f_path;
+    uint64_t                f_size;
+    uint64_t                uuid           = 0;
+    size_t                  c_size         = 0;
+    size_t                  f_chunks       = 0;
+    int                     part_fd        = -1;
+    void*                   part_map       = nullptr;
+    size_t                  part_len       = 0;
+    uint8_t*                bitmap         = nullptr;
+    std::vector<uint8_t>    pending;
+    size_t                  pending_count  = 0;
+    std::mutex              part_mtx;
+    std::vector<Digest>     manifest;
+    WriteBehind             writer;
+    StreamVerifier          verifier;
+
+    DownloadFile(int fd, const std::filesystem::path& f_path, uint64_t f_size);
+    ~DownloadFile();
+
+    DownloadFile(const DownloadFile&)            = delete;
+    DownloadFile& operator=(const DownloadFile&) = delete;
+};
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * partPath
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Returns the path of the sidecar for a download at f_path.
+ *
+ * Takes:
+ * -> f_path:
+ *    Where the download is being written.
+ *
+ * Returns:
+ * -> On success:
+ *    f_path with .dfdpart appended.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+std::filesystem::path partPath(const std::filesystem::path& f_path);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * createDownloadFile
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Creates f_path, failing if it already exists, and reserves f_size bytes
+ *    for it with fallocate(). Filesystems that can't preallocate get the size
+ *    set with ftruncate() instead, so offsets past the current end are always
+ *    writable either way. Creates an empty sidecar next to it.
+ *
+ * Takes:
+ * -> f_path:
+ *    Where to create the file.
+ * -> f_size:
+ *    How big the finished file is.
+ * -> uuid:
+ *    The file's uuid.
+ * -> c_size:
+ *    The chunk size chunks will be written with.
+ *
+ * Returns:
+ * -> On success:
+ *    A shared handle to the new file.
+ * -> On failure:
+ *    nullptr. Nothing is left on disk.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+std::shared_ptr<DownloadFile> createDownloadFile(const std::filesystem::path& f_path,
+                                                 const uint64_t               f_size,
+                                                 const uint64_t               uuid,
+                                                 const size_t                 c_size);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * resumeDownloadFile
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Reopens a partial download left behind by an earlier attempt. Only works
+ *    if both the file and its sidecar exist, and the sidecar records the same
+ *    uuid, size and chunk size being asked for now.
+ *
+ * Takes:
+ * -> f_path:
+ *    Where the partial file is.
+ * -> f_size, uuid, c_size:
+ *    What the download is expected to be, see createDownloadFile().
+ *
+ * Returns:
+ * -> On success:
+ *    A shared handle to the file, with its bitmap loaded.
+ * -> On failure:
+ *    nullptr. Nothing on disk is touched.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+std::shared_ptr<DownloadFile> resumeDownloadFile(const std::filesystem::path& f_path,
+                                                 const uint64_t               f_size,
+                                                 const uint64_t               uuid,
+                                                 const size_t                 c_size);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * sidecarChunkSize
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Reads the chunk size out of the sidecar of a partial download, if it's a
+ *    download of this uuid and size.
+ *
+ * Takes:
+ * -> f_path:
+ *    Where the partial file is.
+ * -> f_size, uuid:
+ *    What the download is expected to be.
+ *
+ * Returns:
+ * -> On success:
+ *    The chunk size the bitmap was built with.
+ * -> On failure:
+ *    std::nullopt
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+std::optional<size_t> sidecarChunkSize(const std::filesystem::path& f_path,
+                                       const uint64_t               f_size,
+                                       const uint64_t               uuid);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * markChunk
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Records that a chunk has been written. Only kept in memory until the next
+ *    checkpointDownload(). Thread safe.
+ *
+ * Takes:
+ * -> file:
+ *    The download.
+ * -> chunk:
+ *    The chunk that was written.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+void markChunk(DownloadFile& file, const size_t chunk);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * hasChunk
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Whether a chunk has been written, checkpointed or not. Thread safe.
+ *
+ * Takes:
+ * -> file:
+ *    The download.
+ * -> chunk:
+ *    The chunk to check.
+ *
+ * Returns:
+ * -> On success:
+ *    true if written, false otherwise.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+bool hasChunk(DownloadFile& file, const size_t chunk);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * clearChunks
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Forgets that chunks were written, in memory and in the sidecar, so a
+ *    later resume fetches them again. Thread safe, but blocks on disk.
+ *
+ * Takes:
+ * -> file:
+ *    The download.
+ * -> chunks:
+ *    The chunks to forget.
+ *
+ * Returns:
+ * -> On success:
+ *    EXIT_SUCCESS
+ * -> On failure:
+ *    EXIT_FAILURE, if the sidecar couldn't be flushed.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+int clearChunks(DownloadFile& file, const std::vector<size_t>& chunks);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * checkpointDownload
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Makes every chunk marked so far durable: flushes the data file, then sets
+ *    their bits in the sidecar and flushes that. Does nothing if no chunks were
+ *    marked since the last checkpoint. Thread safe, but blocks on disk.
+ *
+ * Takes:
+ * -> file:
+ *    The download.
+ *
+ * Returns:
+ * -> On success:
+ *    EXIT_SUCCESS
+ * -> On failure:
+ *    EXIT_FAILURE. Marked chunks stay pending for the next attempt.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+int checkpointDownload(DownloadFile& file);
+
+} //dfd
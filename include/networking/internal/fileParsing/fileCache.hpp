@@ -0,0 +1,110 @@
+#pragma once
+
+#include "networking/internal/fileParsing/seedPolicy.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <sys/types.h>
+
+namespace dfd {
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * FileHandle
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> An open, read-only file that's shared between every seed session serving
+ *    it. Handles are reference counted through std::shared_ptr, and the fd is
+ *    closed when the last session lets go of it. Reads go through pread(), so
+ *    any number of threads can read from the same handle at once.
+ *
+ * Member Variables:
+ * -> fd:
+ *    The open file descriptor.
+ * -> f_path:
+ *    The path the handle was opened with. This is the cache key.
+ * -> f_size:
+ *    The size of the file when it was opened.
+ * -> dev, ino, mtime_ns:
+ *    Identity of the file on disk when it was opened. If any of these (or the
+ *    size) differ on the next acquire, the file has changed and the handle is
+ *    replaced.
+ * -> valid:
+ *    Cleared when the file is dropped or found to have changed. Reads on an
+ *    invalid handle fail, so sessions still holding it stop serving.
+ * -> policy:
+ *    How the file's pages are treated while it's seeded, see seedPolicy.hpp.
+ * -> direct_fd:
+ *    The file opened again with O_DIRECT, for the SEED_DIRECT policy. -1 until
+ *    that policy is first picked.
+ *
+ * Constructor:
+ * -> Takes:
+ *    -> fd:
+ *       An open fd. The handle takes ownership of it.
+ *    -> f_path:
+ *       The path fd was opened from.
+ * Destructor:
+ * -> Closes fd, and direct_fd if open.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+struct FileHandle {
+    int                   fd;
+    std::filesystem::path f_path;
+    ssize_t               f_size    = 0;
+    dev_t                 dev       = 0;
+    ino_t                 ino       = 0;
+    int64_t               mtime_ns  = 0;
+    std::atomic<bool>     valid     = true;
+    std::atomic<uint8_t>  policy    = SEED_CACHED;
+    std::atomic<int>      direct_fd = -1;
+
+    FileHandle(int fd, const std::filesystem::path& f_path);
+    ~FileHandle();
+
+    FileHandle(const FileHandle&)            = delete;
+    FileHandle& operator=(const FileHandle&) = delete;
+};
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * cacheAcquire
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Returns the cached handle for f_path, opening the file if nobody currently
+ *    holds it. The file is stat'd once per call to catch files that were
+ *    replaced or modified since the cached handle was opened, in which case the
+ *    old handle is invalidated and a fresh one is opened. Call this once per
+ *    seed session, not once per chunk.
+ *
+ * Takes:
+ * -> f_path:
+ *    The path to the file, absolute or relative from cwd.
+ *
+ * Returns:
+ * -> On success:
+ *    A shared handle to the open file.
+ * -> On failure:
+ *    nullptr
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+std::shared_ptr<FileHandle> cacheAcquire(const std::filesystem::path& f_path);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * cacheInvalidate
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Removes f_path from the cache and marks any handle still held for it as
+ *    invalid. Does nothing if the path isn't cached.
+ *
+ * Takes:
+ * -> f_path:
+ *    The path the handle was acquired with.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+void cacheInvalidate(const std::filesystem::path& f_path);
+
+} //dfd
@@ -65,6 +65,68 @@ std::optional<ssize_t> readFile(const std::filesystem::path& f_path,
                                 const size_t                 offset,
                                       std::vector<uint8_t>&  buff);
 
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * readFileAt
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Same as readFile(), but reads from an already open fd with pread(), so no
+ *    open/seek/close happens and the fd's offset is left untouched. Safe to
+ *    call from several threads on the same fd.
+ *
+ * Takes:
+ * -> fd:
+ *    An fd open for reading.
+ * -> read_size:
+ *    The number of bytes to read. Reading less than read_size means EOF.
+ * -> offset:
+ *    Where to start reading from. 0 for start of file.
+ * -> buff:
+ *    Where to store the read bytes. Resized to the number of bytes read.
+ *
+ * Returns:
+ * -> On success:
+ *    Bytes read.
+ * -> On failure:
+ *    std::nullopt
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+std::optional<ssize_t> readFileAt(const int                   fd,
+                                  const size_t                read_size,
+                                  const size_t                offset,
+                                        std::vector<uint8_t>& buff);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * writeFileAt
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Writes len bytes of buff to an already open fd at offset with pwrite(),
+ *    retrying short writes. The fd's offset is left untouched, so any number of
+ *    threads can write disjoint ranges of the same fd at once.
+ *
+ * Takes:
+ * -> fd:
+ *    An fd open for writing.
+ * -> buff:
+ *    The bytes to write.
+ * -> len:
+ *    How many bytes of buff to write.
+ * -> offset:
+ *    Where in the file to write them.
+ *
+ * Returns:
+ * -> On success:
+ *    EXIT_SUCCESS
+ * -> On failure:
+ *    EXIT_FAILURE
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+int writeFileAt(const int                   fd,
+                const std::vector<uint8_t>& buff,
+                const size_t                len,
+                const size_t                offset);
+
 /*
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  * writeToNewFile
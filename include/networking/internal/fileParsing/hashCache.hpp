@@ -0,0 +1,229 @@
+#pragma once
+
+#include "networking/internal/fileParsing/contentChunks.hpp"
+#include "networking/internal/fileParsing/treeHash.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <vector>
+
+namespace dfd {
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * A note on the hash cache file
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * An append-only log of every uuid this client has computed, so a file that
+ * hasn't changed is never hashed twice. All integers are big-endian.
+ * -> 8 bytes: "DFDHASH" followed by a version byte, 0x02
+ * -> then any number of records:
+ *    -> 4 bytes: length of the path
+ *    -> the absolute path, no terminator
+ *    -> 8 bytes each: device, inode, size, mtime in ns
+ *    -> 1 byte: the hash scheme, or SEGMENT_RECORD
+ *    -> 8 bytes: the uuid, 0 for SEGMENT_RECORD
+ *    -> 8 bytes: how many entries follow, 0 for HASH_SHA256
+ *    -> per entry, a 32 byte leaf digest, or for SEGMENT_RECORD a 4 byte
+ *       segment length then its 32 byte digest
+ *
+ * A SEGMENT_RECORD holds a file's content defined segments, cut when the file
+ * was hashed or finished downloading, so they're never cut while a peer
+ * waits on them. Version 0x01 files have no segment records and are read as
+ * they are, their header is moved on to 0x02.
+ *
+ * A later record for the same path and kind replaces an earlier one. Only
+ * the record headers are kept in memory, entries are read back from the file
+ * on a hit. A torn record at the end, from a crash mid-append, is dropped on
+ * load.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * FileStamp
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> What a file looked like when it was hashed. If any of it differs now, the
+ *    file may have changed and its cached uuid can't be trusted.
+ *
+ * Member Variables:
+ * -> dev, ino:
+ *    Which file it is.
+ * -> f_size:
+ *    Its size.
+ * -> mtime_ns:
+ *    Its last modification time, in ns.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+struct FileStamp {
+    uint64_t dev      = 0;
+    uint64_t ino      = 0;
+    uint64_t f_size   = 0;
+    int64_t  mtime_ns = 0;
+
+    bool operator==(const FileStamp& other) const {
+        return dev      == other.dev    &&
+               ino      == other.ino    &&
+               f_size   == other.f_size &&
+               mtime_ns == other.mtime_ns;
+    }
+};
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * fileStamp
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> stat()s a file for its stamp.
+ *
+ * Takes:
+ * -> f_path:
+ *    The file.
+ *
+ * Returns:
+ * -> On success:
+ *    The file's stamp.
+ * -> On failure:
+ *    std::nullopt, if it doesn't exist or isn't a regular file.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+std::optional<FileStamp> fileStamp(const std::filesystem::path& f_path);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * loadHashCache
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Opens the cache file at c_path, creating it if needed, and reads in its
+ *    records. If most of the file is records that have since been replaced,
+ *    it's rewritten with only the live ones first. Until this is called,
+ *    lookups always miss and nothing is stored.
+ *
+ * Takes:
+ * -> c_path:
+ *    Where the cache file lives.
+ *
+ * Returns:
+ * -> On success:
+ *    EXIT_SUCCESS
+ * -> On failure:
+ *    EXIT_FAILURE. The cache stays off.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+int loadHashCache(const std::filesystem::path& c_path);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * cachedUuid
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Looks up the uuid of a file, as long as it still has the stamp it was
+ *    hashed with. Thread safe.
+ *
+ * Takes:
+ * -> f_path:
+ *    The file, absolute.
+ * -> stamp:
+ *    The file's current stamp.
+ * -> scheme:
+ *    The hash scheme the uuid should be from.
+ * -> leaves:
+ *    If not nullptr, filled with the file's leaf digests. A hit on a
+ *    HASH_TREE record whose digests can't be read back is a miss.
+ *
+ * Returns:
+ * -> On success:
+ *    The cached uuid.
+ * -> On failure:
+ *    std::nullopt
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+std::optional<uint64_t> cachedUuid(const std::filesystem::path& f_path,
+                                   const FileStamp&             stamp,
+                                   const uint8_t                scheme,
+                                         std::vector<Digest>*   leaves);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * storeUuid
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Appends a freshly computed uuid to the cache. Thread safe.
+ *
+ * Takes:
+ * -> f_path:
+ *    The file, absolute.
+ * -> stamp:
+ *    The file's stamp from before it was hashed.
+ * -> scheme:
+ *    The hash scheme the uuid is from.
+ * -> uuid:
+ *    The uuid.
+ * -> leaves:
+ *    The file's leaf digests for HASH_TREE, empty otherwise.
+ *
+ * Returns:
+ * -> On success:
+ *    EXIT_SUCCESS
+ * -> On failure:
+ *    EXIT_FAILURE, if the cache is off or couldn't be written.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+int storeUuid(const std::filesystem::path& f_path,
+              const FileStamp&             stamp,
+              const uint8_t                scheme,
+              const uint64_t               uuid,
+              const std::vector<Digest>&   leaves);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * cachedSegments
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Reads back the segments of a file, as long as it still has the stamp
+ *    they were cut at. Thread safe.
+ *
+ * Takes:
+ * -> f_path:
+ *    The file, absolute.
+ * -> stamp:
+ *    The file's current stamp.
+ *
+ * Returns:
+ * -> On success:
+ *    The segments, in file order.
+ * -> On failure:
+ *    std::nullopt, if none were stored for this version of the file.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+std::optional<std::vector<Segment>> cachedSegments(const std::filesystem::path& f_path,
+                                                   const FileStamp&             stamp);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * storeSegments
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Appends a file's freshly cut segments to the cache. Thread safe.
+ *
+ * Takes:
+ * -> f_path:
+ *    The file, absolute.
+ * -> stamp:
+ *    The file's stamp from before it was cut.
+ * -> segments:
+ *    Its segments, from contentSegments().
+ *
+ * Returns:
+ * -> On success:
+ *    EXIT_SUCCESS
+ * -> On failure:
+ *    EXIT_FAILURE, if the cache is off or couldn't be written.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+int storeSegments(const std::filesystem::path& f_path,
+                  const FileStamp&             stamp,
+                  const std::vector<Segment>&  segments);
+
+} //dfd
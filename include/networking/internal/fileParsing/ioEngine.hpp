@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <vector>
+
+//submit disk I/O through io_uring where the kernel allows it, 0 to always use
+//the thread pool
+#define IO_URING_ENGINE 1
+
+//requests that can be in flight at once, per engine
+#define IO_ENGINE_DEPTH 64
+
+//threads the fallback engine does blocking I/O on
+#define IO_POOL_THREADS 4
+
+namespace dfd {
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * A note on the I/O engine
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * One engine is shared by the whole process, started on first use. It runs
+ * pread()/pwrite() style requests in the background and calls each request's
+ * callback once the request is done, so the thread that submitted it can go
+ * back to the network straight away.
+ *
+ * Where io_uring is available, requests go onto the ring in batches and a
+ * single completion thread reaps them. That's any Linux since 5.1, unless a
+ * seccomp filter or the io_uring_disabled sysctl blocks it. Anywhere else,
+ * the same requests run on a small pool of threads doing plain blocking I/O.
+ * Callers can't tell the difference.
+ *
+ * Callbacks run on the engine's threads and should be quick. They must not
+ * submit and then wait on more I/O themselves.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+
+inline constexpr uint8_t IO_READ  = 0x00;
+inline constexpr uint8_t IO_WRITE = 0x01;
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * IoRequest
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> A single read or write of a byte range of an open fd, from one buffer or
+ *    scattered over several.
+ *
+ * Member Variables:
+ * -> op:
+ *    IO_READ or IO_WRITE.
+ * -> fd:
+ *    The fd to read or write. Must stay open until done is called.
+ * -> buff:
+ *    Where to read into, or write from. Must stay valid until done is called.
+ *    Ignored if iov isn't empty.
+ * -> len:
+ *    How many bytes to read or write. Short transfers are retried, so only
+ *    a read reaching EOF transfers less. Worked out from iov if that's used.
+ * -> iov:
+ *    The buffers to read into or write from in order, as one preadv() or
+ *    pwritev(), instead of buff. At most IOV_MAX of them. Each must stay valid
+ *    until done is called.
+ * -> offset:
+ *    Where in the file to start.
+ * -> done:
+ *    Called once with the number of bytes transferred, or -errno on failure.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+struct IoRequest {
+    uint8_t                      op;
+    int                          fd;
+    uint8_t*                     buff;
+    size_t                       len;
+    size_t                       offset;
+    std::vector<struct iovec>    iov;
+    std::function<void(ssize_t)> done;
+};
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * submitIo
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Hands a batch of requests to the engine, starting it if this is the first
+ *    use. With io_uring the whole batch goes to the kernel in one syscall.
+ *    Only blocks if IO_ENGINE_DEPTH requests are already in flight, until
+ *    enough of them finish. Thread safe.
+ *
+ * Takes:
+ * -> batch:
+ *    The requests. Moved from.
+ *
+ * Returns:
+ * -> On success:
+ *    EXIT_SUCCESS. Every request's done will be called.
+ * -> On failure:
+ *    EXIT_FAILURE, if no engine could be started. No callbacks are called.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+int submitIo(std::vector<IoRequest>& batch);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * ioEngineName
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Says which engine is running, for diagnostics.
+ *
+ * Returns:
+ * -> On success:
+ *    "io_uring", "threads", or "none" before the first submitIo().
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+const char* ioEngineName();
+
+} //dfd
@@ -0,0 +1,177 @@
+#pragma once
+
+#include "networking/bufferPool.hpp"
+#include "networking/fileParsing.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sys/types.h>
+#include <vector>
+
+//chunks a seed session reads ahead of the last one it was asked for
+#define SEED_PREFETCH_CHUNKS 4
+
+//most bytes a seed session holds read ahead, at least one chunk
+#define SEED_PREFETCH_BYTES (16 << 20)
+
+namespace dfd {
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * A note on prefetching
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Download threads take chunks off a shared queue in order, so the chunks one
+ * seed session is asked for climb steadily, skipping the ones other peers were
+ * asked for. After every request the session guesses the next few: the same
+ * step as the last two requests if they agree, the very next chunks if not.
+ * Those are read into memory on the I/O engine while the peer is busy, so a
+ * request that was guessed right is answered without touching the disk.
+ *
+ * A guess that's no longer ahead of the requests is thrown away, read or not.
+ * Files read with O_DIRECT aren't prefetched, every request for them misses.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * PrefetchSlot
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> One chunk being read ahead.
+ *
+ * Member Variables:
+ * -> buff:
+ *    Where the chunk is read into, from the buffer pool.
+ * -> res:
+ *    Bytes read, or -errno, once ready is set.
+ * -> ready:
+ *    Set once the read finishes.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+struct PrefetchSlot {
+    PooledBuffer buff;
+    ssize_t      res   = 0;
+    bool         ready = false;
+};
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * SeedPrefetcher
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> The read-ahead state of one seed session. Only the session's thread asks
+ *    it for chunks, the I/O engine fills its slots.
+ *
+ * Member Variables:
+ * -> file:
+ *    The handle being seeded.
+ * -> c_size:
+ *    The session's chunk size.
+ * -> f_chunks:
+ *    The number of chunks in the file at that size.
+ * -> depth:
+ *    How many chunks are read ahead at once.
+ * -> slots:
+ *    Chunks read ahead, or being read, by index.
+ * -> last, step:
+ *    The last chunk asked for, and the step between it and the one before.
+ * -> mtx, filled:
+ *    Lock while touching a slot, and signalled whenever a read finishes.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+struct SeedPrefetcher {
+    std::shared_ptr<FileHandle>                     file;
+    size_t                                          c_size   = 0;
+    size_t                                          f_chunks = 0;
+    size_t                                          depth    = 0;
+    std::map<size_t, std::shared_ptr<PrefetchSlot>> slots;
+    std::optional<size_t>                           last;
+    size_t                                          step     = 1;
+    std::mutex                                      mtx;
+    std::condition_variable                         filled;
+};
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * createPrefetcher
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Sets up read-ahead for a seed session. Nothing is read until the first
+ *    request.
+ *
+ * Takes:
+ * -> file:
+ *    The handle being seeded.
+ * -> c_size:
+ *    The session's chunk size.
+ *
+ * Returns:
+ * -> On success:
+ *    The prefetcher.
+ * -> On failure:
+ *    nullptr, if the handle is null or c_size is 0.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+std::shared_ptr<SeedPrefetcher> createPrefetcher(const std::shared_ptr<FileHandle>& file,
+                                                 const size_t                       c_size);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * takePrefetched
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Records a request for a chunk, hands back the chunk if it was read ahead,
+ *    and starts reading the next guesses. Waits if the chunk's read is still
+ *    in flight. Throws away guesses that are behind the request. Guesses are
+ *    only read while tryTakeBuffer() has room for them.
+ *
+ * Takes:
+ * -> p:
+ *    The session's prefetcher.
+ * -> chunk:
+ *    The chunk requested.
+ *
+ * Returns:
+ * -> On success:
+ *    The chunk, exactly as long as it is, the chunk was read ahead.
+ * -> On failure:
+ *    nullptr, the chunk has to be read now.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+PooledBuffer takePrefetched(const std::shared_ptr<SeedPrefetcher>& p,
+                            const size_t                           chunk);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * closePrefetcher
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Ends a session's read-ahead, counting anything still read ahead as
+ *    wasted. Reads still in flight finish in the background.
+ *
+ * Takes:
+ * -> p:
+ *    The session's prefetcher. Reset.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+void closePrefetcher(std::shared_ptr<SeedPrefetcher>& p);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * prefetchTotals
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Returns the hit, miss and waste counts over every session so far.
+ *
+ * Returns:
+ * -> On success:
+ *    The counts.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+PrefetchStats prefetchTotals();
+
+} //dfd
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <sys/types.h>
+#include <vector>
+
+//files smaller than this are always left to the page cache
+#define SEED_COLD_MIN_SIZE (1 << 26)
+
+//recent seed sessions a file needs to count as hot, see below. two sessions a
+//half-life apart count as 1.5
+#define SEED_HOT_SESSIONS 1.5
+
+//seconds for a file's recent session count to halve
+#define SEED_HOT_HALF_LIFE 600
+
+//bytes past each chunk served from a streamed file to ask the kernel to read in
+#define SEED_READAHEAD_BYTES (8 << 20)
+
+//read big cold files with O_DIRECT instead of streaming them through the page
+//cache. off by default, not every filesystem supports it
+#define SEED_DIRECT_IO 0
+
+//smallest file read with O_DIRECT, when it's on
+#define SEED_DIRECT_MIN_SIZE (int64_t(1) << 30)
+
+//offset and length alignment O_DIRECT reads are made with
+#define SEED_DIRECT_ALIGN 4096
+
+namespace dfd {
+
+struct FileHandle;
+
+//how a seed file's pages are treated, see chooseSeedPolicy()
+inline constexpr uint8_t SEED_CACHED = 0x00; //left to the kernel
+inline constexpr uint8_t SEED_STREAM = 0x01; //read ahead, dropped once served
+inline constexpr uint8_t SEED_DIRECT = 0x02; //read with O_DIRECT, never cached
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * A note on seed policies
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Seeding a big file nobody else is asking for pulls every byte of it through
+ * the page cache once, pushing out whatever else the machine had cached. Such
+ * a file is streamed instead: the kernel is told it's read sequentially and to
+ * read ahead of each chunk, and each chunk is dropped from the cache once it's
+ * been served. With SEED_DIRECT_IO on, files past SEED_DIRECT_MIN_SIZE skip
+ * the cache altogether.
+ *
+ * Small files, and files several sessions have asked for recently, are left
+ * to the kernel, since the next session will likely want the same pages. Each
+ * session opened on a file counts once, and the count halves every
+ * SEED_HOT_HALF_LIFE seconds. Files are tracked by device and inode, so the
+ * count outlives the handle.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * chooseSeedPolicy
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Counts a new seed session on file, picks its policy from its size and how
+ *    often it's been seeded recently, stores it in the handle, and passes the
+ *    matching access pattern to the kernel. The policy is the file's, not the
+ *    session's, so every session sharing the handle follows it. Opens the
+ *    handle's O_DIRECT fd if it's needed and not open yet. If it can't be
+ *    opened the file is streamed instead. Thread safe.
+ *
+ * Takes:
+ * -> file:
+ *    The handle of the file about to be seeded.
+ *
+ * Returns:
+ * -> On success:
+ *    The policy picked.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+uint8_t chooseSeedPolicy(FileHandle& file);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * seedReadahead
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Asks the kernel to start reading in the SEED_READAHEAD_BYTES after a
+ *    chunk, if the file is being streamed. Doesn't wait for it.
+ *
+ * Takes:
+ * -> file:
+ *    The handle being seeded.
+ * -> offset, len:
+ *    The chunk about to be served.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+void seedReadahead(const FileHandle& file, const off_t offset, const size_t len);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * seedServed
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Drops a chunk, and whatever was served just before it, from the page
+ *    cache once it's been served, if the file is being streamed. Pages still
+ *    in use, like ones a socket hasn't finished sending, are left alone by the
+ *    kernel.
+ *
+ * Takes:
+ * -> file:
+ *    The handle being seeded.
+ * -> offset, len:
+ *    The chunk that was served.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+void seedServed(const FileHandle& file, const off_t offset, const size_t len);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * readDirect
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Same as readFileAt(), but reads through the handle's O_DIRECT fd. The
+ *    read is widened to SEED_DIRECT_ALIGN on both ends into an aligned buffer
+ *    kept per thread, and the requested bytes are copied out of it.
+ *
+ * Takes:
+ * -> file:
+ *    A handle with the SEED_DIRECT policy.
+ * -> read_size:
+ *    The number of bytes to read. Reading less than read_size means EOF.
+ * -> offset:
+ *    Where to start reading from.
+ * -> buff:
+ *    Where to store the read bytes. Resized to the number of bytes read.
+ *
+ * Returns:
+ * -> On success:
+ *    Bytes read.
+ * -> On failure:
+ *    std::nullopt
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+std::optional<ssize_t> readDirect(const FileHandle&           file,
+                                  const size_t                read_size,
+                                  const size_t                offset,
+                                        std::vector<uint8_t>& buff);
+
+} //dfd
@@ -0,0 +1,153 @@
+#pragma once
+
+#include "networking/internal/fileParsing/treeHash.hpp"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <openssl/evp.h>
+#include <vector>
+
+//bytes of chunks past the next one in file order a download holds in memory
+//until it can hash them, at least one chunk. chunks further ahead are read back
+//from disk when their turn comes instead
+#define VERIFY_REORDER_BYTES (32 << 20)
+
+namespace dfd {
+
+struct DownloadFile;
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * A note on streaming verification
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * A download without a manifest has nothing to check chunks against as they
+ * arrive, only the uuid it was asked for. Rather than read the whole file back
+ * once it's done, every chunk is hashed as it's written, in file order, so
+ * the uuid is known the moment the last chunk lands.
+ *
+ * Chunks arrive out of order from several peers. The one that extends the
+ * hashed prefix is hashed by the thread that received it, which then carries
+ * on with any of the following chunks that are already waiting. Chunks ahead
+ * of the prefix wait in memory, up to VERIFY_REORDER_BYTES of them. Anything
+ * further ahead, or left over from an earlier attempt, is read back from disk
+ * when the prefix reaches it.
+ *
+ * The downloader doesn't know which scheme the seeder's uuid came from, so
+ * both are kept: a SHA-256 of the whole stream, and the tree leaves, see
+ * treeHash.hpp. A download with a manifest skips all of this, since every
+ * chunk was checked on arrival against digests that combine to the uuid.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * StreamVerifier
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> The running digests of a download, kept in its DownloadFile.
+ *
+ * Member Variables:
+ * -> next:
+ *    The first chunk not hashed yet.
+ * -> held:
+ *    Chunks received ahead of next, waiting their turn.
+ * -> draining:
+ *    Set while a thread is hashing. Only that thread touches the digests.
+ * -> failed:
+ *    Set if a chunk couldn't be read back or hashed. The download can't be
+ *    verified.
+ * -> whole:
+ *    SHA-256 of every byte hashed so far.
+ * -> leaf, leaf_fill, leaf_open:
+ *    The tree leaf being hashed, how many bytes are in it, and whether it's
+ *    been started.
+ * -> leaves:
+ *    Every tree leaf finished so far.
+ * -> mtx:
+ *    Lock while touching next, held, draining or failed.
+ *
+ * Constructor:
+ * -> Starts both digests.
+ * Destructor:
+ * -> Frees them.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+struct StreamVerifier {
+    size_t                                                          next      = 0;
+    std::map<size_t, std::shared_ptr<const std::vector<uint8_t>>>   held;
+    bool                                                            draining  = false;
+    bool                                                            failed    = false;
+    EVP_MD_CTX*                                                     whole     = nullptr;
+    EVP_MD_CTX*                                                     leaf      = nullptr;
+    size_t                                                          leaf_fill = 0;
+    bool                                                            leaf_open = false;
+    std::vector<Digest>                                             leaves;
+    std::mutex                                                      mtx;
+
+    StreamVerifier();
+    ~StreamVerifier();
+
+    StreamVerifier(const StreamVerifier&)            = delete;
+    StreamVerifier& operator=(const StreamVerifier&) = delete;
+};
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * streamChunk
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Hands a received chunk to the download's verifier. Hashes it straight
+ *    away if it's next, along with anything it unblocks, otherwise holds on to
+ *    it or drops it as described above. Does nothing for a download with a
+ *    manifest. Thread safe.
+ *
+ * Takes:
+ * -> file:
+ *    The download.
+ * -> chunk:
+ *    The index of the chunk.
+ * -> data:
+ *    The chunk data. Must be the whole chunk.
+ * -> len:
+ *    The length of data.
+ * -> owner:
+ *    What data lives in, if the caller can share it. The verifier keeps a
+ *    reference instead of copying data when it has to hold the chunk. May be
+ *    nullptr.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+void streamChunk(      DownloadFile&                                file,
+                 const size_t                                       chunk,
+                 const uint8_t*                                     data,
+                 const size_t                                       len,
+                 const std::shared_ptr<const std::vector<uint8_t>>& owner);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * finishStream
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Hashes whatever's left of the file, reading it back from disk where it
+ *    isn't held, and checks the result against the download's uuid under both
+ *    schemes. Only call once every chunk is on disk and nothing is calling
+ *    streamChunk() any more.
+ *
+ * Takes:
+ * -> file:
+ *    The download.
+ *
+ * Returns:
+ * -> On success:
+ *    The chunks that need fetching again. Empty if the file matches its uuid,
+ *    or has a manifest. A whole-file digest can't say where a mismatch is, so
+ *    otherwise it's every chunk.
+ * -> On failure:
+ *    std::nullopt, if the file couldn't be read back or hashed.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+std::optional<std::vector<size_t>> finishStream(DownloadFile& file);
+
+} //dfd
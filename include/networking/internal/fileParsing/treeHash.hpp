@@ -0,0 +1,178 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace dfd {
+
+struct FileHandle;
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * A note on the tree hash
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * The file is split into TREE_LEAF_SIZE leaves, independent of the chunk size
+ * so the result doesn't depend on how the file is transferred. Then:
+ * -> leaf   = SHA256(0x00 || leaf bytes)
+ * -> node   = SHA256(0x01 || left || right), built level by level from the
+ *             leaves in file order. A level with an odd node count promotes
+ *             its last node to the next level unchanged.
+ * -> uuid   = first 8 bytes of SHA256(0x02 || be64(file size) || root), read
+ *             in network order.
+ * An empty file is a single empty leaf. The prefixes keep leaves, nodes and
+ * the final uuid from ever colliding with each other.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+
+inline constexpr size_t TREE_LEAF_SIZE = 1 << 18; //256 KiB
+
+using Digest = std::array<uint8_t, 32>;
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * leafDigests
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Hashes every leaf of an open file. The leaves are split into contiguous
+ *    runs, one per thread, and each thread pread()s and hashes its run on its
+ *    own, so the whole file is hashed on every core at once.
+ *
+ * Takes:
+ * -> file:
+ *    The handle to hash, from openSeedFile().
+ * -> threads:
+ *    How many threads to hash with. 0 uses every hardware thread.
+ *
+ * Returns:
+ * -> On success:
+ *    The leaf digests in file order.
+ * -> On failure:
+ *    std::nullopt, if the file couldn't be read in full.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+std::optional<std::vector<Digest>> leafDigests(const std::shared_ptr<FileHandle>& file,
+                                               size_t                             threads);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * treeRoot
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Combines a run of digests into a single root, as described above.
+ *
+ * Takes:
+ * -> nodes:
+ *    The digests to combine, in file order.
+ * -> first:
+ *    Index of the first digest to include.
+ * -> count:
+ *    How many digests to include.
+ *
+ * Returns:
+ * -> On success:
+ *    The root. A run of one digest is its own root.
+ * -> On failure:
+ *    std::nullopt, on an empty or out of range run.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+std::optional<Digest> treeRoot(const std::vector<Digest>& nodes,
+                               size_t                     first,
+                               size_t                     count);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * treeUuid
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Derives the file uuid from its size and tree root.
+ *
+ * Takes:
+ * -> f_size:
+ *    The size of the file.
+ * -> root:
+ *    The root of the file's leaves, from treeRoot().
+ *
+ * Returns:
+ * -> On success:
+ *    The uuid.
+ * -> On failure:
+ *    0
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+uint64_t treeUuid(const uint64_t f_size, const Digest& root);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * leavesPerChunk
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Returns how many leaves make up a chunk, if chunks of c_size line up with
+ *    the tree. They do when c_size is TREE_LEAF_SIZE times a power of two, in
+ *    which case every chunk's digest is a node of the file's tree, and the
+ *    chunk digests combine to the same root as the leaves do.
+ *
+ * Takes:
+ * -> c_size:
+ *    The chunk size.
+ *
+ * Returns:
+ * -> On success:
+ *    The number of leaves per chunk.
+ * -> On failure:
+ *    std::nullopt, if chunks don't line up with the tree.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+std::optional<size_t> leavesPerChunk(const size_t c_size);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * chunkDigests
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Builds the digest of every chunk of a file from its leaf digests, without
+ *    touching the file again.
+ *
+ * Takes:
+ * -> leaves:
+ *    The file's leaf digests, from leafDigests().
+ * -> c_size:
+ *    The chunk size. Must pass leavesPerChunk().
+ *
+ * Returns:
+ * -> On success:
+ *    One digest per chunk, in file order.
+ * -> On failure:
+ *    std::nullopt
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+std::optional<std::vector<Digest>> chunkDigests(const std::vector<Digest>& leaves,
+                                                const size_t               c_size);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * dataDigest
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Computes the tree digest of a chunk of data in memory, splitting it into
+ *    leaves and combining them as above. Matches the chunk's entry from
+ *    chunkDigests() when the data is intact.
+ *
+ * Takes:
+ * -> data:
+ *    The chunk data.
+ * -> len:
+ *    The length of data.
+ *
+ * Returns:
+ * -> On success:
+ *    The digest.
+ * -> On failure:
+ *    std::nullopt
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+std::optional<Digest> dataDigest(const uint8_t* data, const size_t len);
+
+} //dfd
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+//bytes of received chunks a download can have waiting to be written, staged or
+//on their way to disk, before the threads receiving them have to wait. always
+//lets at least one chunk through
+#define DOWNLOAD_DIRTY_BYTES (64 << 20)
+
+//staged chunks are written once they join up into a run of this many bytes
+#define WRITE_BEHIND_RUN_BYTES (8 << 20)
+
+namespace dfd {
+
+struct DownloadFile;
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * A note on write-behind
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Chunks handed to writeFileChunkAsync() aren't written one at a time. They're
+ * staged in memory until neighbouring chunks arrive, and each contiguous run
+ * goes to disk as a single pwritev(). A run is written once it:
+ * -> reaches WRITE_BEHIND_RUN_BYTES,
+ * -> can't grow any more, because the chunks either side of it are already
+ *    written or the file ends there, or
+ * -> is still staged when half of DOWNLOAD_DIRTY_BYTES is, at which point
+ *    every staged run is written.
+ * Anything left is written by flushWrites(), which waiting on, checkpointing
+ * or closing the download all call first.
+ *
+ * Nothing is fsync'd here. Written chunks are marked, and only made durable by
+ * the next checkpoint, see downloadFile.hpp.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * StagedChunk
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> A received chunk waiting to be written.
+ *
+ * Member Variables:
+ * -> data:
+ *    The chunk's bytes. Shared with the verifier if it's holding them too.
+ * -> done:
+ *    Called once the chunk's write finishes, see writeFileChunkAsync().
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+struct StagedChunk {
+    std::shared_ptr<const std::vector<uint8_t>> data;
+    std::function<void(int)>                    done;
+};
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * WriteBehind
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> The write-behind state of a download, kept in its DownloadFile.
+ *
+ * Member Variables:
+ * -> staged:
+ *    Chunks waiting to be written, by index.
+ * -> staged_bytes:
+ *    Bytes in staged.
+ * -> dirty_bytes:
+ *    Bytes staged or being written.
+ * -> submitted:
+ *    Chunks that have been handed to the I/O engine, whether or not the write
+ *    finished. Cleared again if it failed.
+ * -> mtx, drained:
+ *    Lock while touching any of the above, and signalled whenever dirty_bytes
+ *    drops.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+struct WriteBehind {
+    std::map<size_t, StagedChunk> staged;
+    size_t                        staged_bytes = 0;
+    size_t                        dirty_bytes  = 0;
+    std::vector<bool>             submitted;
+    std::mutex                    mtx;
+    std::condition_variable       drained;
+};
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * stageWrite
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Stages a received chunk, writing it along with its run as described above
+ *    if that's due. Waits first while DOWNLOAD_DIRTY_BYTES are already dirty,
+ *    writing whatever's staged so the wait can end. Thread safe.
+ *
+ * Takes:
+ * -> file:
+ *    The download. Kept alive until every write it's part of is done.
+ * -> chunk:
+ *    Which chunk this is. Must be exactly as long as the chunk.
+ * -> staged:
+ *    The chunk's data and callback.
+ *
+ * Returns:
+ * -> On success:
+ *    EXIT_SUCCESS, the chunk's done will be called, with EXIT_FAILURE if its
+ *    write fails.
+ * -> On failure:
+ *    EXIT_FAILURE, if the chunk isn't part of the file. done isn't called.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+int stageWrite(const std::shared_ptr<DownloadFile>& file,
+               const size_t                         chunk,
+                     StagedChunk&&                  staged);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * flushWrites
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Writes every staged run now, without waiting for the writes to finish.
+ *    Thread safe.
+ *
+ * Takes:
+ * -> file:
+ *    The download.
+ *
+ * Returns:
+ * -> On success:
+ *    How many chunks were handed to the I/O engine.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+size_t flushWrites(const std::shared_ptr<DownloadFile>& file);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * drainWrites
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Writes every staged run and blocks until nothing is dirty, so every done
+ *    callback has run.
+ *
+ * Takes:
+ * -> file:
+ *    The download.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+void drainWrites(const std::shared_ptr<DownloadFile>& file);
+
+} //dfd
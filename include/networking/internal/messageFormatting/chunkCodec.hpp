@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+//compression levels chunks are packed with. low, packing is on the send path
+#define ZLIB_PACK_LEVEL 1
+#define ZSTD_PACK_LEVEL 1
+
+//a chunk is only sent packed if it packs to at most this fraction of its size
+#define PACK_KEEP_RATIO 0.9
+
+//most chunks a session sends without trying to pack them after one that didn't
+//shrink. starts at 1 and doubles every time a try fails
+#define PACK_MAX_BACKOFF 64
+
+namespace dfd {
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * A note on codecs
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Which codecs are built in is decided when the build finds their libraries:
+ * DFD_HAVE_ZLIB and DFD_HAVE_ZSTD are defined by CMake. A build with neither
+ * still speaks the protocol, it just never packs a chunk and advertises no
+ * codecs, so peers never send it one packed.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * localCodecs
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Returns the codecs this build can pack and unpack, as a set of CODEC_*
+ *    bits.
+ *
+ * Returns:
+ * -> On success:
+ *    The set. 0 if there are none.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+uint8_t localCodecs();
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * bestCodec
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Picks the codec to pack with for a peer, zstd over zlib.
+ *
+ * Takes:
+ * -> peer_codecs:
+ *    The set of codecs the peer advertised.
+ *
+ * Returns:
+ * -> On success:
+ *    The best codec both ends have, CODEC_NONE if there isn't one.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+uint8_t bestCodec(const uint8_t peer_codecs);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * packBytes
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Compresses bytes with a codec, as long as they fit in the space given.
+ *    Thread safe.
+ *
+ * Takes:
+ * -> codec:
+ *    A codec from localCodecs().
+ * -> in, in_len:
+ *    The bytes to compress.
+ * -> out:
+ *    Where the compressed bytes go. Its size is the most they may take up, it's
+ *    resized down to what they did.
+ *
+ * Returns:
+ * -> On success:
+ *    The compressed length.
+ * -> On failure:
+ *    std::nullopt, if the codec isn't built in, failed, or the bytes didn't
+ *    fit.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+std::optional<size_t> packBytes(const uint8_t               codec,
+                                const uint8_t*              in,
+                                const size_t                in_len,
+                                      std::vector<uint8_t>& out);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * unpackBytes
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Decompresses bytes packed by packBytes(). Thread safe.
+ *
+ * Takes:
+ * -> codec:
+ *    The codec they were packed with.
+ * -> in, in_len:
+ *    The compressed bytes.
+ * -> out, out_len:
+ *    Where the bytes go, and exactly how many there must be.
+ *
+ * Returns:
+ * -> On success:
+ *    EXIT_SUCCESS
+ * -> On failure:
+ *    EXIT_FAILURE, if the codec isn't built in, the bytes are corrupt, or they
+ *    don't unpack to exactly out_len bytes.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+int unpackBytes(const uint8_t  codec,
+                const uint8_t* in,
+                const size_t   in_len,
+                      uint8_t* out,
+                const size_t   out_len);
+
+} //dfd
@@ -26,6 +26,24 @@ struct SourceInfo;
  */
 void msgLenToBytes(const size_t val, uint8_t* buffer);
 
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * bytesToSize_t
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Convert a byte array into an integer.
+ *
+ * Takes:
+ * -> bytes:
+ *    The 8 bytes to be converted.
+ *
+ * Returns:
+ * -> val:
+ *    The converted integer
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+size_t bytesToMsgLen(const uint8_t* bytes);
+
 /*
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  * bytesToSize_t
@@ -46,32 +64,36 @@ size_t bytesToMsgLen(const std::vector<uint8_t>& buffer);
 
 /*
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
- * recvBytes
+ * recvInto
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  * Description:
- * -> Reads bytes on the socket into a buffer if it's present. 
+ * -> Reads exactly len bytes off the socket straight into dest. Waits on the
+ *    socket with poll() against a deadline rather than setting SO_RCVTIMEO, so
+ *    nothing about the socket is changed and it works whether or not the
+ *    socket is blocking. The deadline moves up whenever bytes arrive, so a
+ *    large message on a slow link is fine as long as it keeps coming.
  *
  * Takes:
  * -> socket_fd:
  *    The socket to read the data from.
- * -> buffer:
- *    The container to append the read bytes to.
- * -> try_to_recv:
- *    Bytes attempt to read.
+ * -> dest:
+ *    Where to put the bytes, with room for at least len of them.
+ * -> len:
+ *    Bytes to read.
  * -> timeout:
- *    How long this function attempts to read try_to_recv bytes for before
- *    giving up. 
+ *    How long to wait for more bytes before giving up. Zero waits forever.
  *
  * Returns:
  * -> On success:
- *    The number of bytes read. May or may not be equal to try_to_recv.
+ *    len
  * -> On failure:
- *    -1
+ *    -1, the peer closed, the socket broke, or it went quiet for a timeout.
+ *    Some of dest may have been written.
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  */
-ssize_t recvBytes(int                  socket_fd, 
-                 std::vector<uint8_t>& buffer, 
-                 size_t                try_to_recv, 
-                 timeval               timeout);
+ssize_t recvInto(int      socket_fd,
+                 uint8_t* dest,
+                 size_t   len,
+                 timeval  timeout);
 
 } //dfd
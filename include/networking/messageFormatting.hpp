@@ -1,9 +1,32 @@
 #pragma once
 
+#include "networking/bufferPool.hpp"
 #include "sourceInfo.hpp"
+#include <array>
 #include <cstdint>
 #include <vector>
 #include <optional>
+#include <string>
+#include <tuple>
+
+//most digests a MANIFEST carries. a file with more chunks than this at the
+//session's chunk size is seeded without one
+#define MANIFEST_MAX_DIGESTS (1 << 20)
+
+//largest packed bundle manifest. a directory past this is still indexed file
+//by file, just not as a bundle
+#define BUNDLE_MANIFEST_MAX (64 << 20)
+
+//largest message that isn't a chunk or a manifest. requests, acks, source and
+//server lists all come in far under it
+#define CONTROL_MESSAGE_MAX (1 << 20)
+
+//bytes a DATA_CHUNK or PACKED_CHUNK can have on top of its data
+#define CHUNK_MESSAGE_SLACK 64
+
+//most segments a SEGMENT_MANIFEST carries, 64 GiB of file at the average
+//segment size. a file with more is sent without one
+#define SEGMENT_MANIFEST_MAX (1 << 20)
 
 namespace dfd {
 
@@ -374,6 +397,42 @@ inline constexpr uint8_t REQUEST_CHUNK      = 0x0B;
 inline constexpr uint8_t DATA_CHUNK         = 0x0C;
 inline constexpr uint8_t FINISH_DOWNLOAD    = 0x0D; //simple ack, just send byte
 inline constexpr uint8_t FINISH_OK          = 0x0E;
+inline constexpr uint8_t MANIFEST_REQUEST   = 0x19; //just send this byte after DOWNLOAD_CONFIRM
+inline constexpr uint8_t MANIFEST           = 0x1A;
+inline constexpr uint8_t PACKED_CHUNK       = 0x1B; //a DATA_CHUNK with compressed data
+inline constexpr uint8_t BUNDLE_INIT        = 0x1C; //a DOWNLOAD_INIT for a bundle uuid
+inline constexpr uint8_t BUNDLE_MANIFEST    = 0x1D;
+inline constexpr uint8_t REQUEST_FILE_CHUNK = 0x1E; //a REQUEST_CHUNK naming the file, in bundles
+inline constexpr uint8_t REQUEST_RANGE      = 0x1F;
+inline constexpr uint8_t RANGE_END          = 0x30; //follows the last chunk of a range
+inline constexpr uint8_t SHRINK_RANGE       = 0x31;
+inline constexpr uint8_t SEGMENTS_REQUEST   = 0x32; //just send this byte after MANIFEST
+inline constexpr uint8_t SEGMENT_MANIFEST   = 0x33;
+
+//chunk codecs. DOWNLOAD_INIT advertises a set of them OR'd together
+inline constexpr uint8_t CODEC_NONE = 0x00;
+inline constexpr uint8_t CODEC_ZLIB = 0x01;
+inline constexpr uint8_t CODEC_ZSTD = 0x02;
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * messageLimit
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> The most bytes a message with this code can be, for a receiver to check a
+ *    length prefix against before allocating for it. Chunks can be up to
+ *    MAX_CHUNK_SIZE, manifests up to their own bounds, and everything else up
+ *    to CONTROL_MESSAGE_MAX.
+ *
+ * Takes:
+ * -> code:
+ *    The message's first byte.
+ *
+ * Returns:
+ * -> The limit, in bytes, code included.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+size_t messageLimit(const uint8_t code);
 
 
 /*
@@ -382,15 +441,18 @@ inline constexpr uint8_t FINISH_OK          = 0x0E;
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  * Description:
  * -> Creates a buffer for writing all needed info in an unambiguous manner that
- *    can be easily unpacked by the below function. Chunk size is only needed if
- *    it was modified in fileParsing. Otherwise, the default is assumed.
+ *    can be easily unpacked by the below function. The chunk size is only a
+ *    request, the seeder answers with the one it'll actually use in
+ *    DOWNLOAD_CONFIRM.
  *
  * Takes:
  * -> uuid:
  *    The uuid of the file to download.
  * -> chunk_size:
- *    Possibly the chunk size to send with. If std::nullopt the default is
- *    assumed.
+ *    Possibly the chunk size to send with. If std::nullopt the seeder picks
+ *    one to suit the file.
+ * -> codecs:
+ *    The set of codecs chunks can be sent packed with, see supportedCodecs().
  *
  * Returns:
  * -> On success:
@@ -399,15 +461,19 @@ inline constexpr uint8_t FINISH_OK          = 0x0E;
  *    An empty buffer.
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  */
-std::vector<uint8_t> createDownloadInit(const uint64_t uuid, std::optional<size_t> chunk_size);
+std::vector<uint8_t> createDownloadInit(const uint64_t        uuid,
+                                        std::optional<size_t> chunk_size,
+                                        const uint8_t         codecs = CODEC_NONE);
 
 /*
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  * parseDownloadInit 
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  * Description:
- * -> Unpacks the above message, and returns the received pair of file uuid and
- *    file chunk size. If size is std::nullopt the default is assumed.
+ * -> Unpacks the above message, and returns the received file uuid, file chunk
+ *    size and codecs. If size is std::nullopt the downloader left it to us.
+ *    Messages from before codecs were advertised have none. Also unpacks
+ *    BUNDLE_INIT, which is laid out the same.
  * Takes:
  * -> request_message:
  *    A message received who's std::vector::front references the DOWNLOAD_INIT 
@@ -415,23 +481,25 @@ std::vector<uint8_t> createDownloadInit(const uint64_t uuid, std::optional<size_
  *
  * Returns:
  * -> On success:
- *    The pair. 
+ *    The tuple. 
  * -> On failure:
- *    A pair with uuid set to 0. 
+ *    A tuple with uuid set to 0. 
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
 */
-std::pair<uint64_t, std::optional<size_t>> parseDownloadInit(const std::vector<uint8_t> init_message);
+std::tuple<uint64_t, std::optional<size_t>, uint8_t> parseDownloadInit(const std::vector<uint8_t> init_message);
 
 /*
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  * createDownloadConfirm
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  * Description:
- * -> Creates a buffer for communicating a file size and name to the client
- *    before it attempts downloading.
+ * -> Creates a buffer for communicating a file size, chunk size and name to the
+ *    client before it attempts downloading.
  * Takes:
  * -> f_size:
  *    The file size.
+ * -> c_size:
+ *    The chunk size every chunk of this session will be sent with.
  * -> f_name:
  *    The file name.
  *
@@ -442,15 +510,17 @@ std::pair<uint64_t, std::optional<size_t>> parseDownloadInit(const std::vector<u
  *    An empty buffer. 
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
 */
-std::vector<uint8_t> createDownloadConfirm(const uint64_t f_size, const std::string& f_name);
+std::vector<uint8_t> createDownloadConfirm(const uint64_t     f_size,
+                                           const uint64_t     c_size,
+                                           const std::string& f_name);
 
 /*
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  * parseDownloadConfirm 
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  * Description:
- * -> Unpacks the above message, and returns the received pair of file_size, and
- *    file name, in that order.
+ * -> Unpacks the above message, and returns the received file size, chunk size
+ *    and file name, in that order.
  *
  * Takes:
  * -> confirm_message:
@@ -459,12 +529,12 @@ std::vector<uint8_t> createDownloadConfirm(const uint64_t f_size, const std::str
  *
  * Returns:
  * -> On success:
- *    The pair. 
+ *    The tuple.
  * -> On failure:
- *    A pair with uuid set to 0. 
+ *    A tuple with file size and chunk size set to 0.
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
 */
-std::pair<uint64_t, std::string> parseDownloadConfirm(const std::vector<uint8_t> confirm_message);
+std::tuple<uint64_t, uint64_t, std::string> parseDownloadConfirm(const std::vector<uint8_t> confirm_message);
 
 
 /*
@@ -509,6 +579,151 @@ std::vector<uint8_t> createChunkRequest(const size_t chunk);
 */
 size_t parseChunkRequest(const std::vector<uint8_t>& request_message);
 
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * A note on ranges
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * REQUEST_RANGE asks for chunks [first, end) of a single file session. The
+ * seeder streams them back in order, each as a DATA_CHUNK or PACKED_CHUNK the
+ * same as if they'd been asked for one at a time, then sends RANGE_END with
+ * where it stopped. Requests sent while a range is streaming are answered
+ * once it's done.
+ *
+ * While it's streaming, SHRINK_RANGE moves a range's end down, so its tail
+ * can be handed to another peer. It names the range by its first chunk, and
+ * the seeder ignores it if that range is already done, or if the new end is
+ * behind what it has sent. Either way RANGE_END says where the range really
+ * ended, and only chunks past that are the downloader's to reassign.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * createRangeRequest
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Creates a REQUEST_RANGE message, see above.
+ *
+ * Takes:
+ * -> first:
+ *    The first chunk of the range, 0-indexed.
+ * -> end:
+ *    One past the last chunk of the range.
+ *
+ * Returns:
+ * -> On success:
+ *    The buffer to send over the socket.
+ * -> On failure:
+ *    An empty buffer, if the range is empty.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+std::vector<uint8_t> createRangeRequest(const size_t first, const size_t end);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * parseRangeRequest
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Unpacks the above message.
+ *
+ * Takes:
+ * -> request_message:
+ *    A message received who's std::vector::front references the REQUEST_RANGE
+ *    code.
+ *
+ * Returns:
+ * -> On success:
+ *    The pair of first and end chunk.
+ * -> On failure:
+ *    The pair {SIZE_MAX, SIZE_MAX}, also if the range is empty.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+std::pair<size_t, size_t> parseRangeRequest(const std::vector<uint8_t>& request_message);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * createRangeShrink
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Creates a SHRINK_RANGE message, see above.
+ *
+ * Takes:
+ * -> first:
+ *    The first chunk of the range to shrink, as it was requested.
+ * -> end:
+ *    Its new end.
+ *
+ * Returns:
+ * -> On success:
+ *    The buffer to send over the socket.
+ * -> On failure:
+ *    An empty buffer.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+std::vector<uint8_t> createRangeShrink(const size_t first, const size_t end);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * parseRangeShrink
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Unpacks the above message.
+ *
+ * Takes:
+ * -> shrink_message:
+ *    A message received who's std::vector::front references the SHRINK_RANGE
+ *    code.
+ *
+ * Returns:
+ * -> On success:
+ *    The pair of first chunk and new end.
+ * -> On failure:
+ *    The pair {SIZE_MAX, SIZE_MAX}.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+std::pair<size_t, size_t> parseRangeShrink(const std::vector<uint8_t>& shrink_message);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * createRangeEnd
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Creates a RANGE_END message, see above.
+ *
+ * Takes:
+ * -> end:
+ *    One past the last chunk sent.
+ *
+ * Returns:
+ * -> On success:
+ *    The buffer to send over the socket.
+ * -> On failure:
+ *    An empty buffer.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+std::vector<uint8_t> createRangeEnd(const size_t end);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * parseRangeEnd
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Unpacks the above message.
+ *
+ * Takes:
+ * -> end_message:
+ *    A message received who's std::vector::front references the RANGE_END
+ *    code.
+ *
+ * Returns:
+ * -> On success:
+ *    Where the range ended.
+ * -> On failure:
+ *    SIZE_MAX
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+size_t parseRangeEnd(const std::vector<uint8_t>& end_message);
+
 //pair of actual data, and the chunk number, 0-indexed
 using DataChunk = std::pair<size_t, std::vector<uint8_t>>;
 /*
@@ -532,6 +747,29 @@ using DataChunk = std::pair<size_t, std::vector<uint8_t>>;
  */
 std::vector<uint8_t> createDataChunk(const DataChunk& chunk);
 
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * createDataChunkHeader
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Creates just the leading bytes of a DATA_CHUNK message, the code and the
+ *    chunk index, without any chunk data. Sending this followed directly by the
+ *    chunk's bytes produces exactly what createDataChunk() would have, so the
+ *    data can be handed to the socket straight from the file.
+ *
+ * Takes:
+ * -> chunk:
+ *    The index of the chunk that will follow, 0-indexed.
+ *
+ * Returns:
+ * -> On success:
+ *    The header buffer.
+ * -> On failure:
+ *    An empty buffer.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+std::vector<uint8_t> createDataChunkHeader(const size_t chunk);
+
 /*
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  * parseDataChunk
@@ -557,6 +795,478 @@ std::vector<uint8_t> createDataChunk(const DataChunk& chunk);
 */
 DataChunk parseDataChunk(const std::vector<uint8_t>& data_chunk_message);
 
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * stripDataChunk
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Same as parseDataChunk(), but unpacks the message in place instead of
+ *    copying the data out, so a pooled receive buffer can be kept. Also takes
+ *    PACKED_CHUNK messages, whose data is decompressed into a buffer from the
+ *    pool and swapped in.
+ *
+ * Takes:
+ * -> data_chunk_message:
+ *    A message received who's std::vector::front references the DATA_CHUNK
+ *    or PACKED_CHUNK code. Left holding only the chunk's data on success,
+ *    unchanged on failure.
+ *
+ * Returns:
+ * -> On success:
+ *    The chunk index.
+ * -> On failure:
+ *    SIZE_MAX
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+size_t stripDataChunk(std::vector<uint8_t>& data_chunk_message);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * A note on packed chunks
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * A downloader advertises the codecs it can unpack in DOWNLOAD_INIT. The seeder
+ * picks the best one it also has and may then answer any REQUEST_CHUNK with a
+ * PACKED_CHUNK instead of a DATA_CHUNK:
+ * -> PACKED_CHUNK, chunk index (8), codec (1), unpacked length (8), data
+ * A chunk is only sent packed if that saves enough, see PACK_KEEP_RATIO. After
+ * one that doesn't, the next few chunks aren't tried at all, and the gap
+ * doubles each time a try fails, so incompressible files cost a try now and
+ * then rather than every chunk. Chunks that aren't tried can go out with
+ * sendfile() as usual.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * supportedCodecs
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Returns the codecs this build can unpack, to advertise in DOWNLOAD_INIT.
+ *
+ * Returns:
+ * -> On success:
+ *    The set of CODEC_* bits. CODEC_NONE if it has none.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+uint8_t supportedCodecs();
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * ChunkPacker
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> One seed session's packing state.
+ *
+ * Member Variables:
+ * -> codec:
+ *    The codec agreed on, CODEC_NONE to never pack.
+ * -> skip:
+ *    Chunks left to send before trying to pack again.
+ * -> backoff:
+ *    What skip is set to next time a try doesn't pay.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+struct ChunkPacker {
+    uint8_t  codec   = CODEC_NONE;
+    uint32_t skip    = 0;
+    uint32_t backoff = 1;
+};
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * openPacker
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Sets up packing for a seed session.
+ *
+ * Takes:
+ * -> peer_codecs:
+ *    The codecs the downloader advertised in DOWNLOAD_INIT.
+ *
+ * Returns:
+ * -> On success:
+ *    The session's packer, with the best codec both ends have.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+ChunkPacker openPacker(const uint8_t peer_codecs);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * packNext
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Call once per chunk sent. Says whether to try packing it, and counts it
+ *    off the skip if not.
+ *
+ * Takes:
+ * -> packer:
+ *    The session's packer.
+ *
+ * Returns:
+ * -> On success:
+ *    true if the chunk should go through packChunk().
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+bool packNext(ChunkPacker& packer);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * packChunk
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Tries to pack a chunk, keeping it only if it shrinks by enough. Backs off
+ *    the packer if it doesn't. Thread safe.
+ *
+ * Takes:
+ * -> packer:
+ *    The session's packer.
+ * -> chunk:
+ *    The chunk's data.
+ *
+ * Returns:
+ * -> On success:
+ *    The packed data in a pooled buffer, to send with createPackedChunkHeader().
+ * -> On failure:
+ *    nullptr, send the chunk as it is. Also when the buffer pool is full.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+PooledBuffer packChunk(ChunkPacker& packer, const std::vector<uint8_t>& chunk);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * createPackedChunkHeader
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Same as createDataChunkHeader(), but for a PACKED_CHUNK. The packed data
+ *    goes right after it.
+ *
+ * Takes:
+ * -> chunk:
+ *    The chunk index, 0-indexed.
+ * -> codec:
+ *    The codec it was packed with.
+ * -> chunk_len:
+ *    The length of the chunk before it was packed.
+ *
+ * Returns:
+ * -> On success:
+ *    The header buffer.
+ * -> On failure:
+ *    An empty buffer.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+std::vector<uint8_t> createPackedChunkHeader(const size_t  chunk,
+                                             const uint8_t codec,
+                                             const size_t  chunk_len);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * PackStats
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> How packing has done over every session so far, both ends.
+ *
+ * Member Variables:
+ * -> tried, kept:
+ *    Chunks packing was tried on, and the ones sent packed.
+ * -> kept_bytes, packed_bytes:
+ *    Bytes of the chunks sent packed before and after packing.
+ * -> pack_ns:
+ *    Time spent packing, including tries that weren't kept.
+ * -> unpacked, unpack_ns:
+ *    Packed chunks received, and time spent unpacking them.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+struct PackStats {
+    uint64_t tried        = 0;
+    uint64_t kept         = 0;
+    uint64_t kept_bytes   = 0;
+    uint64_t packed_bytes = 0;
+    uint64_t pack_ns      = 0;
+    uint64_t unpacked     = 0;
+    uint64_t unpack_ns    = 0;
+};
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * packStats
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Returns the packing counts so far. Thread safe.
+ *
+ * Returns:
+ * -> On success:
+ *    The counts.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+PackStats packStats();
+
+
+//chunk size the manifest was built for, then one tree digest per chunk
+using ChunkManifest = std::pair<size_t, std::vector<std::array<uint8_t, 32>>>;
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * createManifest
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Creates the reply to a MANIFEST_REQUEST, the per-chunk digests a seeder
+ *    has for a file. Only files identified with the tree hash have one, and
+ *    only with up to MANIFEST_MAX_DIGESTS chunks. Seeders without one reply
+ *    with a FAIL message instead.
+ *
+ * Takes:
+ * -> manifest:
+ *    The ChunkManifest to send.
+ *
+ * Returns:
+ * -> On success:
+ *    The buffer to send over the socket.
+ * -> On failure:
+ *    An empty buffer, including if there are more than MANIFEST_MAX_DIGESTS.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+std::vector<uint8_t> createManifest(const ChunkManifest& manifest);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * parseManifest
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Unpacks the above message. The digests are only as trustworthy as the
+ *    peer that sent them until they're checked against the file uuid.
+ *
+ * Takes:
+ * -> manifest_message:
+ *    A message received who's std::vector::front references the MANIFEST
+ *    code.
+ *
+ * Returns:
+ * -> On success:
+ *    The ChunkManifest.
+ * -> On failure:
+ *    A ChunkManifest with chunk size set to 0.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*/
+ChunkManifest parseManifest(const std::vector<uint8_t>& manifest_message);
+
+//each content defined segment's length then digest, in file order
+using SegmentManifest = std::vector<std::pair<uint32_t, std::array<uint8_t, 32>>>;
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * createSegmentManifest
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Creates the reply to a SEGMENTS_REQUEST, the content defined segments of
+ *    the file being downloaded. Lets a downloader find the file's bytes in a
+ *    near copy it already has, wherever they sit in it. Seeders with no
+ *    segments kept for the file reply with a FAIL message instead.
+ *
+ * Takes:
+ * -> segments:
+ *    The SegmentManifest to send.
+ *
+ * Returns:
+ * -> On success:
+ *    The buffer to send over the socket.
+ * -> On failure:
+ *    An empty buffer, including if there are more than SEGMENT_MANIFEST_MAX.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+std::vector<uint8_t> createSegmentManifest(const SegmentManifest& segments);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * parseSegmentManifest
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Unpacks the above message. Nothing in it is trusted, chunks put together
+ *    from it are checked against the chunk manifest.
+ *
+ * Takes:
+ * -> segment_message:
+ *    A message received who's std::vector::front references the
+ *    SEGMENT_MANIFEST code.
+ *
+ * Returns:
+ * -> On success:
+ *    The SegmentManifest.
+ * -> On failure:
+ *    An empty SegmentManifest.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*/
+SegmentManifest parseSegmentManifest(const std::vector<uint8_t>& segment_message);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * A note on bundles
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * A bundle is a set of indexed files shared under one uuid, every file of a
+ * directory. It's downloaded over a few sessions that each fetch chunks of any
+ * of its files, rather than a handshake and a set of threads per file.
+ *
+ * A bundle session starts with BUNDLE_INIT instead of DOWNLOAD_INIT, and is
+ * confirmed with a DOWNLOAD_CONFIRM whose size is that of the bundle's packed
+ * manifest and whose name is the bundle's. MANIFEST_REQUEST is answered with
+ * BUNDLE_MANIFEST, the packed manifest, and chunks are asked for with
+ * REQUEST_FILE_CHUNK, naming the file. They come back as DATA_CHUNK or
+ * PACKED_CHUNK, same as any session. The bundle's uuid is dataUuid() of its
+ * packed manifest, so a manifest can be checked against the uuid it was asked
+ * for, and each file is then checked against its own uuid.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * BundleMember
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> One file of a bundle.
+ *
+ * Member Variables:
+ * -> uuid:
+ *    The file's uuid.
+ * -> f_size:
+ *    The file's size.
+ * -> name:
+ *    Where the file goes, relative to the bundle's directory.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+struct BundleMember {
+    uint64_t    uuid   = 0;
+    uint64_t    f_size = 0;
+    std::string name;
+};
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * packBundle
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Lays a bundle's files out as bytes, the form its uuid is computed from and
+ *    that's sent in BUNDLE_MANIFEST. The same files in the same order always
+ *    pack to the same bytes.
+ *
+ * Takes:
+ * -> members:
+ *    The bundle's files.
+ *
+ * Returns:
+ * -> On success:
+ *    The packed manifest.
+ * -> On failure:
+ *    An empty buffer, if a name is too long or the whole is past
+ *    BUNDLE_MANIFEST_MAX.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+std::vector<uint8_t> packBundle(const std::vector<BundleMember>& members);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * unpackBundle
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Unpacks a manifest packed by packBundle().
+ *
+ * Takes:
+ * -> data, len:
+ *    The packed manifest.
+ *
+ * Returns:
+ * -> On success:
+ *    The bundle's files.
+ * -> On failure:
+ *    std::nullopt, if it's malformed.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+std::optional<std::vector<BundleMember>> unpackBundle(const uint8_t* data, const size_t len);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * createBundleInit
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Same as createDownloadInit(), for a bundle. Unpacked by
+ *    parseDownloadInit().
+ *
+ * Takes:
+ * -> uuid:
+ *    The bundle's uuid.
+ * -> chunk_size:
+ *    Possibly the chunk size to send every file's chunks with.
+ * -> codecs:
+ *    The set of codecs chunks can be sent packed with.
+ *
+ * Returns:
+ * -> On success:
+ *    The buffer to send over the socket.
+ * -> On failure:
+ *    An empty buffer.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+std::vector<uint8_t> createBundleInit(const uint64_t        uuid,
+                                      std::optional<size_t> chunk_size,
+                                      const uint8_t         codecs);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * createBundleManifest
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Creates the reply to a MANIFEST_REQUEST in a bundle session.
+ *
+ * Takes:
+ * -> packed:
+ *    The bundle's manifest, from packBundle().
+ *
+ * Returns:
+ * -> On success:
+ *    The buffer to send over the socket.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+std::vector<uint8_t> createBundleManifest(const std::vector<uint8_t>& packed);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * createFileChunkRequest
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Creates a request for a chunk of one of a bundle's files.
+ *
+ * Takes:
+ * -> f_uuid:
+ *    The file's uuid.
+ * -> chunk:
+ *    The chunk index.
+ *
+ * Returns:
+ * -> On success:
+ *    The buffer to send over the socket.
+ * -> On failure:
+ *    An empty buffer.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+std::vector<uint8_t> createFileChunkRequest(const uint64_t f_uuid, const size_t chunk);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * parseFileChunkRequest
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Unpacks the above message.
+ *
+ * Takes:
+ * -> request_message:
+ *    A message received who's std::vector::front references the
+ *    REQUEST_FILE_CHUNK code.
+ *
+ * Returns:
+ * -> On success:
+ *    The file's uuid and the chunk index.
+ * -> On failure:
+ *    A pair with the uuid set to 0.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+std::pair<uint64_t, size_t> parseFileChunkRequest(const std::vector<uint8_t>& request_message);
 
 //SERVER REGISTRATION MESSAGES
 inline constexpr uint8_t SERVER_REG         = 0x0F;
@@ -1,16 +1,145 @@
 #pragma once
 
 #include <cstdint>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <memory>
 #include <optional>
 #include <string>
 #include <sys/types.h>
 #include <utility>
 #include <vector>
 
+//how long a send waits on a socket that won't take more data before the
+//connection is given up on, in ms
+#define SEND_STALL_MS 30000
+
+//what recvFrame() first makes room for in a message, doubled as more of it
+//arrives
+#define FRAME_GROW_BYTES (1 << 12)
+
 namespace dfd {
 
 struct SourceInfo;
 
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * ByteSpan
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Borrowed bytes to send, owned by the caller and only read during the
+ *    call they're passed to.
+ *
+ * Member Variables:
+ * -> data:
+ *    The first byte.
+ * -> len:
+ *    How many bytes.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+struct ByteSpan {
+    const uint8_t* data = nullptr;
+    size_t         len  = 0;
+
+    ByteSpan() = default;
+    ByteSpan(const uint8_t* d, size_t l) : data(d), len(l) {}
+    ByteSpan(const std::vector<uint8_t>& v) : data(v.data()), len(v.size()) {}
+};
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * FrameReader
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> How far into the next message on a non-blocking socket tcp::recvFrame()
+ *    has read. Each connection keeps its own.
+ *
+ * Member Variables:
+ * -> prefix:
+ *    The message's length prefix.
+ * -> prefix_got:
+ *    How much of prefix has arrived.
+ * -> msg_len:
+ *    The message's length, from the prefix.
+ * -> msg:
+ *    The message, grown as it arrives rather than sized from the prefix, so a
+ *    peer has to send the bytes it claims before they're held for it. Holds
+ *    the whole message once tcp::recvFrame() says so, until it's called
+ *    again.
+ * -> msg_got:
+ *    How much of msg has arrived.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+struct FrameReader {
+    uint8_t              prefix[8];
+    size_t               prefix_got = 0;
+    size_t               msg_len    = 0;
+    std::vector<uint8_t> msg;
+    size_t               msg_got    = 0;
+};
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * QueuedFrame
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> One message queued for a non-blocking socket. Its bytes are head, then
+ *    body, then file_len bytes of file_fd from offset, any of which can be
+ *    empty. Only head is copied, the rest are sent from where they are.
+ *
+ * Member Variables:
+ * -> head:
+ *    The length prefix and the start of the message.
+ * -> body:
+ *    More of the message, held until it's sent. nullptr for none.
+ * -> file_fd:
+ *    A file the rest of the message is sent from with sendfile(), -1 for
+ *    none. Whoever queued it keeps it open until on_sent.
+ * -> offset:
+ *    Where in the file.
+ * -> file_len:
+ *    How many bytes of the file.
+ * -> on_sent:
+ *    Called once the whole message is out. Not called if it never is.
+ * -> on_short:
+ *    Called if the file ends before file_len bytes of it went, it was
+ *    truncated after this was queued. The connection's broken after.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+struct QueuedFrame {
+    std::vector<uint8_t>                        head;
+    std::shared_ptr<const std::vector<uint8_t>> body;
+    int                                         file_fd  = -1;
+    off_t                                       offset   = 0;
+    size_t                                      file_len = 0;
+    std::function<void()>                       on_sent;
+    std::function<void()>                       on_short;
+};
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * FrameWriter
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Messages queued for a non-blocking socket, already framed, that it
+ *    hasn't taken yet.
+ *
+ * Member Variables:
+ * -> frames:
+ *    The messages, in order.
+ * -> sent:
+ *    How much of the first one has gone.
+ * -> queued:
+ *    Bytes in frames not yet sent, for holding off on queueing more.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+struct FrameWriter {
+    std::deque<QueuedFrame> frames;
+    size_t                  sent   = 0;
+    size_t                  queued = 0;
+};
+
 /*
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  * getMyPublicIP
@@ -74,6 +203,28 @@ std::optional<std::pair<int, uint16_t>> openSocket(bool     is_server,
  */
 void closeSocket(int socket_fd);
 
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * setBlocking
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Makes a socket blocking or non-blocking.
+ *
+ * Takes:
+ * -> socket_fd:
+ *    The socket.
+ * -> blocking:
+ *    Which it should be.
+ *
+ * Returns:
+ * -> On success:
+ *    EXIT_SUCCESS
+ * -> On failure:
+ *    EXIT_FAILURE
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+int setBlocking(int socket_fd, bool blocking);
+
 namespace tcp {
 
 /*
@@ -174,33 +325,271 @@ int accept(int                                 server_fd,
  */
 int sendMessage(int socket_fd, const std::vector<uint8_t>& data);
 
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * sendMessage
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Sends a message made of a small header followed by data, without copying
+ *    the two together first. On the other end this is indistinguishable from a
+ *    sendMessage() of header+data. Same as sendFramed() with the two.
+ *
+ * Takes:
+ * -> socket_fd:
+ *    The socket to send the data through.
+ * -> header:
+ *    The bytes that go in front of the data.
+ * -> data:
+ *    The data to send.
+ *
+ * Returns:
+ * -> On success:
+ *    EXIT_SUCCESS
+ * -> On failure:
+ *    EXIT_FAILURE. The message may have been partially sent, so the connection
+ *    should be dropped.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+int sendMessage(int                         socket_fd,
+                const std::vector<uint8_t>& header,
+                const std::vector<uint8_t>& data);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * sendFramed
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Sends one message made of every part back to back, with a single
+ *    sendmsg() for the length prefix and all of them where the socket takes
+ *    it, so nothing is copied together first. Partial sends carry on where
+ *    they stopped, and a socket that's full is waited on for up to
+ *    SEND_STALL_MS. On the other end this is indistinguishable from a
+ *    sendMessage() of the parts joined together. The other sendMessage()s are
+ *    this with one or two parts.
+ *
+ * Takes:
+ * -> socket_fd:
+ *    The socket to send the data through.
+ * -> parts:
+ *    The message, in order. Empty parts are skipped.
+ * -> sent:
+ *    If given, set to how many bytes of the message the socket took, length
+ *    prefix included. 0 on failure means none of it went out.
+ *
+ * Returns:
+ * -> On success:
+ *    EXIT_SUCCESS
+ * -> On failure:
+ *    EXIT_FAILURE. The message may have been partially sent, so the connection
+ *    should be dropped.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+int sendFramed(int socket_fd, std::initializer_list<ByteSpan> parts, size_t* sent = nullptr);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * sendFileMessage
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Sends a message made of a small in-memory header followed by a range of a
+ *    file, without copying the file bytes through userspace. The length prefix
+ *    and header are sent first, then the file range is handed to the kernel
+ *    with sendfile(). On the other end this is indistinguishable from a
+ *    sendMessage() of header+file bytes. If the kernel can't sendfile() from
+ *    this fd, the remainder is read and sent normally instead.
+ *
+ * Takes:
+ * -> socket_fd:
+ *    The socket to send the data through.
+ * -> header:
+ *    The bytes that go in front of the file data.
+ * -> file_fd:
+ *    An fd open for reading. Its file offset is not used or changed.
+ * -> offset:
+ *    Where in the file the range starts.
+ * -> len:
+ *    How many bytes of the file to send.
+ *
+ * Returns:
+ * -> On success:
+ *    EXIT_SUCCESS
+ * -> On failure:
+ *    EXIT_FAILURE. The message may have been partially sent, so the connection
+ *    should be dropped.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+int sendFileMessage(int                         socket_fd,
+                    const std::vector<uint8_t>& header,
+                    int                         file_fd,
+                    off_t                       offset,
+                    size_t                      len);
+
 /*
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  * recvData
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  * Description:
- * -> Reads data on the socket into a buffer if it's present. 
+ * -> Reads the next message on the socket into buffer, skipping keep alives.
+ *    The length prefix and the message's code are read first, and a length
+ *    past messageLimit() for that code is taken as a broken connection rather
+ *    than allocated for. buffer is then sized once and the message is received
+ *    straight into it. Nothing about the socket is changed, the timeout is
+ *    waited out with poll().
  * 
  * Takes:
  * -> socket_fd:
  *    The socket to read the data from.
  * -> buffer:
- *    The container to append the read bytes to.
+ *    The container to put the message in. Anything already in it is
+ *    overwritten. Pass one with the capacity already, a pooled buffer, to
+ *    avoid allocating.
  * -> timeout:
- *    How long this function attempts to read try_to_recv bytes for before
- *    giving up. 
+ *    How long this function waits for more of the message before giving up.
+ *    Zero waits forever.
  *
  * Returns:
  * -> On success:
  *    The number of bytes read.
  * -> On failure:
- *    -1
+ *    -1, including if the message is bigger than its code allows.
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  */
 ssize_t recvMessage(int                   socket_fd, 
                     std::vector<uint8_t>& buffer, 
                     timeval               timeout);
 
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * recvFrame
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Reads whatever of the next message a non-blocking socket has waiting,
+ *    carrying on from where reader left off, and never waits for more. Keep
+ *    alives are skipped, same as recvMessage(). Call it until it returns 0 to
+ *    drain the socket, taking each message out of reader.msg as it's
+ *    returned.
+ *
+ * Takes:
+ * -> socket_fd:
+ *    The non-blocking socket to read from.
+ * -> reader:
+ *    The socket's reader.
+ * -> max_len:
+ *    The largest message the caller takes from this socket. Whoever's
+ *    reading sets it to the biggest message the other end has reason to
+ *    send.
+ *
+ * Returns:
+ * -> 1:
+ *    A whole message is in reader.msg.
+ * -> 0:
+ *    Nothing more has arrived yet.
+ * -> -1:
+ *    The peer closed, the socket broke, or the message is bigger than
+ *    max_len.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+int recvFrame(int socket_fd, FrameReader& reader, size_t max_len);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * queueFrame
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Frames a message onto the end of writer's queue. Nothing is sent until
+ *    sendQueued().
+ *
+ * Takes:
+ * -> writer:
+ *    The socket's writer.
+ * -> data:
+ *    The message.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+void queueFrame(FrameWriter& writer, const std::vector<uint8_t>& data);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * queueFrame
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Frames a message made of header then body onto the end of writer's
+ *    queue, the same as sendMessage() with both. body isn't copied, it's
+ *    held until it's sent.
+ *
+ * Takes:
+ * -> writer:
+ *    The socket's writer.
+ * -> header:
+ *    The start of the message.
+ * -> body:
+ *    The rest of it.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+void queueFrame(FrameWriter&                                writer,
+                const std::vector<uint8_t>&                 header,
+                std::shared_ptr<const std::vector<uint8_t>> body);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * queueFileFrame
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Frames a message made of header then len bytes of a file onto the end
+ *    of writer's queue, the same as sendFileMessage(). The file's bytes go
+ *    out with sendfile() when their turn comes.
+ *
+ * Takes:
+ * -> writer:
+ *    The socket's writer.
+ * -> header:
+ *    The start of the message.
+ * -> file_fd:
+ *    The file, which must stay open until on_sent is called or the writer
+ *    is destroyed.
+ * -> offset:
+ *    Where in the file the bytes start.
+ * -> len:
+ *    How many bytes.
+ * -> on_sent:
+ *    Called once they've all gone.
+ * -> on_short:
+ *    Called if the file turns out shorter than offset+len when they're sent.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+void queueFileFrame(FrameWriter&                writer,
+                    const std::vector<uint8_t>& header,
+                    int                         file_fd,
+                    off_t                       offset,
+                    size_t                      len,
+                    std::function<void()>       on_sent,
+                    std::function<void()>       on_short = nullptr);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * sendQueued
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Sends as much of writer's queue as a non-blocking socket will take right
+ *    now, and never waits for it to take more.
+ *
+ * Takes:
+ * -> socket_fd:
+ *    The non-blocking socket to send on.
+ * -> writer:
+ *    The socket's writer.
+ *
+ * Returns:
+ * -> 1:
+ *    Everything queued is sent, the queue is empty.
+ * -> 0:
+ *    The socket is full, wait for it to be writable and call again.
+ * -> -1:
+ *    The connection broke.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+int sendQueued(int socket_fd, FrameWriter& writer);
+
 } //tcp
 
 namespace udp {
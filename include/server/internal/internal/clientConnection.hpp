@@ -14,36 +14,34 @@ namespace dfd {
 
 /*
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
- * clientConnection
+ * ClientContext
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  * Description:
- * -> Handles an entire client connection from start to finish, then closes
- *    itself.
+ * -> Everything of the server's a client request needs to be served, shared
+ *    by every thread serving them. Built once by listenThread().
  *
- * Takes:
- * -> client_sock:
- *    The open TCP socket connected to the client.
+ * Member Variables:
  * -> next_reader:
  *    An atomic counter that marks the next reader to use to distribute the
  *    read load around.
  * -> workers:
  *    The vector of database worker threads.
  * -> worker_stats:
- *    An array that corresponds to every threads current status. This is what
- *    this thread will use to flag its shutdown.
+ *    An array that corresponds to every threads current status.
  * -> worker_strikes:
  *    An array that corresponds to every threads current failed responses.
- *    This thread will simply 0 this on startup.
  * -> read_workers:
- *    An array of the ports of the various read workers. If this thread is a
- *    read worker, its listening sockets port will be at
- *    read_workers[thread_ind].
+ *    An array of the ports of the various read workers.
  * -> write_worker:
  *    The port of the write workers listening socket.
  * -> election_mtx:
- *    The mutex to aquire a lock on to call an election. Any function including
- *    this one that attempts to modify db_workers in any way must aquire this
- *    lock to do so in a safe manner.
+ *    The mutex to aquire a lock on to call an election. Any function that
+ *    attempts to modify db_workers in any way must aquire this lock to do so
+ *    in a safe manner.
+ * -> known_servers:
+ *    Vector of known servers.
+ * -> known_server_mtx:
+ *    Mutex for known servers.
  * -> record_msgs:
  *    A flag that is true when messages are to be recorded.
  * -> record_queue:
@@ -53,17 +51,88 @@ namespace dfd {
  *    The mutex for the record que
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  */
-void clientConnection(int                                              client_sock,
-                      std::atomic<int>&                                next_reader,
-                      std::array<std::thread,       WORKER_THREADS  >& workers,
-                      std::array<std::atomic<bool>, WORKER_THREADS  >& worker_stats,
-                      std::array<std::atomic<int>,  WORKER_THREADS  >& worker_strikes,
-                      std::array<uint16_t,          WORKER_THREADS-1>& read_workers,
-                      uint16_t&                                        write_worker,
-                      std::mutex&                                      election_mtx,
-                      std::vector<SourceInfo>&                         known_servers,
-                      std::mutex&                                      known_server_mtx,
-                      std::atomic<bool>&                               record_msgs,
-                      std::queue<std::vector<uint8_t>>&                record_queue,
-                      std::mutex&                                      record_queue_mtx);
-}
+struct ClientContext {
+    std::atomic<int>&                                next_reader;
+    std::array<std::thread,       WORKER_THREADS  >& workers;
+    std::array<std::atomic<bool>, WORKER_THREADS  >& worker_stats;
+    std::array<std::atomic<int>,  WORKER_THREADS  >& worker_strikes;
+    std::array<uint16_t,          WORKER_THREADS-1>& read_workers;
+    uint16_t&                                        write_worker;
+    std::mutex&                                      election_mtx;
+    std::vector<SourceInfo>&                         known_servers;
+    std::mutex&                                      known_server_mtx;
+    std::atomic<bool>&                               record_msgs;
+    std::queue<std::vector<uint8_t>>&                record_queue;
+    std::mutex&                                      record_queue_mtx;
+};
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * takesClientSocket
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Whether serving a request needs the client's socket to itself, to stream
+ *    to it or close it, rather than just producing a reply.
+ *
+ * Takes:
+ * -> client_request:
+ *    The request.
+ *
+ * Returns:
+ * -> true if serveClientRequest() takes the socket, false if not.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+bool takesClientSocket(const std::vector<uint8_t>& client_request);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * serveClientRequest
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Serves one client request through the database workers, retrying and
+ *    calling elections on workers that don't answer, and produces the reply
+ *    for the client. Blocks until a worker answers or every attempt fails.
+ *
+ *    If takesClientSocket() says so, the request is served over client_sock
+ *    directly instead, which must be blocking and is closed before this
+ *    returns. Otherwise client_sock isn't touched.
+ *
+ * Takes:
+ * -> client_sock:
+ *    The client's socket.
+ * -> client_request:
+ *    The request.
+ * -> reply:
+ *    Where to put the reply. Left empty if the socket was taken.
+ * -> ctx:
+ *    The server.
+ *
+ * Returns:
+ * -> true if a worker answered, and the request should be passed on with
+ *    syncClientRequest() once the reply is sent. false otherwise.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+bool serveClientRequest(int                   client_sock,
+                        std::vector<uint8_t>& client_request,
+                        std::vector<uint8_t>& reply,
+                        ClientContext&        ctx);
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * syncClientRequest
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Forwards a served request to the other known servers, and adds a newly
+ *    registered server to the list. Blocks on every server it forwards to.
+ *
+ * Takes:
+ * -> client_request:
+ *    The request, already served.
+ * -> ctx:
+ *    The server.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+void syncClientRequest(std::vector<uint8_t>& client_request,
+                       ClientContext&        ctx);
+
+} //dfd
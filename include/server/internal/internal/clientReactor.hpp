@@ -0,0 +1,103 @@
+#pragma once
+
+#include "server/internal/internal/clientConnection.hpp"
+
+#include <atomic>
+
+//event loops sharing the listener, each owning the clients it accepted. one
+//is plenty for a few thousand clients, set it to the cores the server has
+//to spare past that
+#define SERVER_REACTOR_LOOPS 1
+
+//threads serving requests handed off by the loops. this caps how many
+//requests wait on the database workers at once, no matter how many clients
+//are connected
+#define SERVER_HANDLER_THREADS 8
+
+//served requests waiting to be passed on to the other servers. past this the
+//sync thread's fallen too far behind a slow server, and newer ones are
+//dropped with a warning rather than held
+#define SERVER_SYNC_QUEUE_MAX 4096
+
+//connections the kernel holds for the listener before they're accepted
+#define SERVER_LISTEN_BACKLOG 4096
+
+//largest request a client or server can send. an index request or a
+//forwarded one is well under a kilobyte, anything claiming more is dropped
+//before it's read
+#define SERVER_REQUEST_MAX (64 << 10)
+
+//how long a client has to get its whole request in after connecting, in ms
+#define CLIENT_REQUEST_TIMEOUT_MS 5000
+
+//how long a client's connection is kept open waiting on its next request once
+//a reply's out, in ms
+#define CLIENT_IDLE_MS 30000
+
+//how often a client waiting on its reply is sent a keep alive, in ms
+#define CLIENT_KEEP_ALIVE_MS 1000
+
+//most bytes a client's connection can have waiting to go out. a reply is at
+//most CONTROL_MESSAGE_MAX, one bigger closes the connection rather than
+//being held for it
+#define CLIENT_OUT_MAX (2 << 20)
+
+namespace dfd {
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * A note on the client reactor
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Every client socket is non-blocking and owned by one event loop, which
+ * accepts it, reads its request in whatever pieces it arrives, and writes
+ * the reply back. The connection's then kept for the client's next request,
+ * until it goes CLIENT_IDLE_MS without one or hangs up. A client can send
+ * several requests without waiting, they're served one at a time and
+ * answered in the order they were sent. Nothing on a loop ever waits on a
+ * client. Serving the request blocks on the database workers, so that's
+ * handed to a fixed pool of handler threads, which pass the reply back to
+ * the loop that owns the socket. While a request waits on a handler the loop
+ * sends its client keep alives, so it doesn't time out. Passing a served
+ * request on to the other servers blocks on each of them, so handlers leave
+ * that to one sync thread and go straight back to the pool.
+ *
+ * A client that stops taking what's sent is closed once its reply goes
+ * SEND_STALL_MS without any of it going out. A keep alive is only queued once
+ * the last one's gone, so what's held for a client is at most one of those
+ * and its reply, up to CLIENT_OUT_MAX.
+ *
+ * The threads a server runs are SERVER_REACTOR_LOOPS, SERVER_HANDLER_THREADS
+ * and the sync thread however many clients are connected, and a storm of
+ * connections costs a file descriptor and a few hundred bytes each rather
+ * than two threads.
+ *
+ * Requests that stream to the client themselves, see takesClientSocket(),
+ * are taken off the loop entirely and handed over with a blocking socket.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * clientReactor
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Serves every client connecting to listener until server_running is
+ *    cleared. Runs one event loop on the calling thread, starts the rest, the
+ *    handler threads and the sync thread, and joins them all before
+ *    returning. Syncs still queued are sent first. Client sockets still open
+ *    are closed on the way out, listener is not.
+ *
+ * Takes:
+ * -> server_running:
+ *    Cleared to shut down. Noticed within a second.
+ * -> listener:
+ *    The listening socket, already listening. Made non-blocking.
+ * -> ctx:
+ *    The server, for the handlers.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+void clientReactor(std::atomic<bool>& server_running,
+                   int                listener,
+                   ClientContext&     ctx);
+
+} //dfd
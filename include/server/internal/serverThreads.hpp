@@ -25,8 +25,7 @@ struct SourceInfo;
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  * Description:
  * -> Opens a listening socket which will accept incoming client connections,
- *    and spawn internal threads to handle them via the database workers
- *    provided.
+ *    and serve them via the database workers provided with clientReactor().
  *
  *    If this function fails at any point an error message is printed to stdout.
  *    No crash will occur.
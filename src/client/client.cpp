@@ -2,7 +2,10 @@
 #include "client/internal/clientConfigs.hpp"
 #include "client/internal/requests.hpp"
 #include "client/internal/clientThreads.hpp"
+#include "client/internal/internal/internal/serverConnections.hpp"
+#include "networking/bufferPool.hpp"
 #include "networking/fileParsing.hpp"
+#include "networking/messageFormatting.hpp"
 #include "sourceInfo.hpp"
 
 #include <csignal>
@@ -19,6 +22,7 @@ namespace dfd {
 
 inline static const std::string HOST_FILE_NAME = "hosts";
 inline static const std::string UUID_FILE_NAME = "uuid";
+inline static const std::string HASH_FILE_NAME = "hashcache";
 
 std::vector<SourceInfo>  server_list;
 uint64_t                 my_uuid = 0;
@@ -27,7 +31,9 @@ std::string              my_download_dir;
 
 int client_startup(const std::string& ip, 
                    const uint16_t     port,
-                   const std::string& download_dir) {
+                   const std::string& download_dir,
+                   const std::string& hash_scheme,
+                   const bool         dedup) {
     //load at minimum one server
     getHostListFromDisk(server_list, HOST_FILE_NAME);
     if (!ip.empty() && port != 0) {
@@ -58,6 +64,21 @@ int client_startup(const std::string& ip,
         return EXIT_FAILURE; 
     }
 
+    //how files we index are identified
+    if (hash_scheme == "tree")
+        setHashScheme(HASH_TREE);
+    else
+        setHashScheme(HASH_SHA256);
+
+    //chunks are only looked up by their tree hash digests
+    if (dedup && hash_scheme != "tree")
+        std::cerr << "[err] --dedup needs --hash tree, only finished downloads will be reused." << std::endl;
+    setChunkStore(dedup);
+
+    //not fatal, files just get hashed every time without it
+    if (EXIT_FAILURE == setHashCache(HASH_FILE_NAME))
+        std::cerr << "[err] Could not open the hash cache, files will be rehashed on every index." << std::endl;
+
     if (!download_dir.empty()) {
         setDownloadDir(download_dir);
         my_download_dir = download_dir;
@@ -95,12 +116,51 @@ void printList(std::map<uint64_t, std::string>& indexed_files) {
     }
 }
 
+void printStats() {
+    PrefetchStats stats = prefetchStats();
+    uint64_t      asked = stats.hits + stats.misses;
+    std::cout << "Seeding read-ahead:\n";
+    std::cout << "  hits:   " << stats.hits;
+    if (asked > 0)
+        std::cout << " (" << (stats.hits * 100) / asked << "%)";
+    std::cout << "\n";
+    std::cout << "  misses: " << stats.misses << "\n";
+    std::cout << "  wasted: " << stats.wasted << "\n";
+
+    BufferPoolStats pool = bufferPoolStats();
+    std::cout << "Chunk buffers:\n";
+    std::cout << "  in use:    " << (pool.used_bytes >> 20) << "MiB of "
+                                 << (BUFFER_POOL_MAX_BYTES >> 20) << "MiB\n";
+    std::cout << "  idle:      " << (pool.idle_bytes >> 20) << "MiB\n";
+    std::cout << "  reused:    " << pool.reused    << "\n";
+    std::cout << "  allocated: " << pool.allocated << "\n";
+    std::cout << "  waits:     " << pool.waits     << "\n";
+
+    PackStats pack = packStats();
+    std::cout << "Chunk compression:\n";
+    std::cout << "  sent packed: " << pack.kept << " of " << pack.tried << " tried";
+    if (pack.packed_bytes > 0)
+        std::cout << ", " << double(pack.kept_bytes) / pack.packed_bytes << "x smaller";
+    std::cout << "\n";
+    std::cout << "  pack time:   " << pack.pack_ns / 1000000 << "ms\n";
+    std::cout << "  unpacked:    " << pack.unpacked << " in "
+                                   << pack.unpack_ns / 1000000 << "ms\n";
+
+    ChunkStoreStats store = chunkStoreStats();
+    std::cout << "Local chunk store:\n";
+    std::cout << "  files:  " << store.files << "\n";
+    std::cout << "  reused: " << store.chunks << " chunks, "
+                              << (store.bytes >> 20) << "MiB" << std::endl;
+}
+
 void printHelp() {
     std::cout << "Available commands:\n";
     std::cout << "  list                - List all currently indexed files\n";
-    std::cout << "  index <filename>    - Register/share <filename>\n";
+    std::cout << "  index <path>        - Register/share a file, or every file in a directory\n";
     std::cout << "  download <filename> - Download <filename> from a peer\n";
+    std::cout << "  bundle <uuid>       - Download every file of an indexed directory\n";
     std::cout << "  drop <filename>     - Remove <filename> from the server\n";
+    std::cout << "  stats               - Show read-ahead, buffer and compression counts\n";
     std::cout << "  help                - Show this message\n";
     std::cout << "  exit                - Quit the client\n";
 }
@@ -112,6 +172,8 @@ enum message_code {
     INDEX,
     DROP,
     DOWNLOAD,
+    BUNDLE,
+    STATS,
     CRASH,
 };
 
@@ -155,6 +217,7 @@ std::optional<message_code> parseCommand(const std::string&                   co
     if (command.substr(0,5) == "exit "  || command == "exit")  return EXIT;
     if (command.substr(0,5) == "list "  || command == "list")  return LIST;
     if (command.substr(0,5) == "help "  || command == "help")  return HELP;
+    if (command.substr(0,6) == "stats " || command == "stats") return STATS;
     if (command.substr(0,6) == "crash " || command == "crash") return CRASH;
 
     //index command, takes std::string as arg
@@ -162,7 +225,7 @@ std::optional<message_code> parseCommand(const std::string&                   co
         std::string f_path;
         if (EXIT_FAILURE == getArg(command, f_path)) {
             std::cerr << "[err] Invalid command: " << command << std::endl;
-            std::cerr << "[err] Usage: index <path to file>"  << std::endl;
+            std::cerr << "[err] Usage: index <path to file or directory>" << std::endl;
             return std::nullopt;
         }
 
@@ -195,6 +258,18 @@ std::optional<message_code> parseCommand(const std::string&                   co
         return DOWNLOAD;
     }
 
+    if (command.substr(0,6) == "bundle") {
+        uint64_t uuid;
+        if (EXIT_FAILURE == getArg(command, uuid)) {
+            std::cerr << "[err] Invalid command: " << command << std::endl;
+            std::cerr << "[err] Usage: bundle <uuid>"         << std::endl;
+            return std::nullopt;
+        }
+
+        command_arg = uuid;
+        return BUNDLE;
+    }
+
     return std::nullopt;
 }
 
@@ -210,6 +285,8 @@ void client_main(const std::string&                     listen_addr,
 
     //handle CONTROL+C
     signal(SIGINT, signalHandler);
+    //sendfile() has no MSG_NOSIGNAL, a peer hanging up mid-chunk shouldn't kill us
+    signal(SIGPIPE, SIG_IGN);
 
     //welcome messages
     std::cout << "Welcome to P2P Client!"                                  << std::endl;
@@ -273,6 +350,17 @@ void client_main(const std::string&                     listen_addr,
                 break;
             }
 
+            case BUNDLE: {
+                doBundleDownload(std::get<uint64_t>(command_arg), //bundle uuid
+                                 server_list);
+                break;
+            }
+
+            case STATS: {
+                printStats();
+                break;
+            }
+
             case CRASH: {
                 exit(-1);
             }
@@ -286,9 +374,11 @@ void client_main(const std::string&                     listen_addr,
 void run_client(const std::string& ip,
                 const uint16_t     port,
                 const std::string& download_dir,
-                const std::string& listen_addr) {
+                const std::string& listen_addr,
+                const std::string& hash_scheme,
+                const bool         dedup) {
     //setup and input validation
-    if (EXIT_FAILURE == client_startup(ip, port, download_dir))
+    if (EXIT_FAILURE == client_startup(ip, port, download_dir, hash_scheme, dedup))
         exit(EXIT_FAILURE);
     std::cout << "Setup with " << server_list.size() << " servers." << std::endl;
 
@@ -321,6 +411,7 @@ void run_client(const std::string& ip,
     shutdown = true;
 
     storeHostListToDisk(server_list, HOST_FILE_NAME);
+    closeServerConnections();
 
     my_listener.join(); 
     exit(EXIT_SUCCESS);
@@ -1,12 +1,10 @@
 #include <atomic>
 #include <iostream>
-#include <thread>
 #include <sys/socket.h>
 #include <netinet/in.h>
-#include <unistd.h>
 
 #include "client/internal/clientThreads.hpp"
-#include "client/internal/internal/seedThread.hpp"
+#include "client/internal/internal/seedEngine.hpp"
 #include "networking/socket.hpp"
 #include "sourceInfo.hpp"
 
@@ -32,37 +30,17 @@ void clientListener(      std::atomic<bool>&               shutdown,
     // std::cout << "[clientListener] Listening on port " << sock_port->second << std::endl;
 
     // start listening for incoming clients
-    if (tcp::listen(my_listen_sock, MAX_PEER_THREADS)) {
+    if (tcp::listen(my_listen_sock, SEED_LISTEN_BACKLOG)) {
         std::cerr << "[clientListener] Could not start listening.\n";
         closeSocket(my_listen_sock);
         return;
     }
 
     listener_setup = true;
-    struct timeval accept_timeout;
-    accept_timeout.tv_sec  = 1;
-    accept_timeout.tv_usec = 0;
 
-    while (!shutdown.load()) { //Keep listening until shutdown is requested
-        SourceInfo client;
-        int peer_sock = tcp::accept(my_listen_sock, client, accept_timeout);
-        if (peer_sock < 0) {
-            if (shutdown.load())
-                break; // Exit if we're shutting down
-            // std::cerr << "[clientListener] Error accepting connection.\n";
-            continue; // Try to accept the next connection
-        }
+    //every peer is served from here until shutdown, see seedEngine.hpp
+    seedEngine(shutdown, my_listen_sock, indexed_files, indexed_files_mtx);
 
-        // Launch a thread to handle the incoming peer connection
-        // TODO FIX MEMORY LEAK
-        std::thread(seedToPeer,
-                    std::ref(shutdown),
-                    peer_sock,
-                    std::cref(indexed_files),
-                    std::ref(indexed_files_mtx)).detach();
-    }
-
-    sleep(2); //let seed threads close
     closeSocket(my_listen_sock); // Close the listening socket when done
 }
 
@@ -22,61 +22,243 @@ int selectPeerSource(std::vector<bool>& f_stats) {
     return ind;
 }
 
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * requestManifest
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Asks the peer for the file's chunk manifest, and attaches it to the
+ *    download if it checks out. A peer that doesn't have one replies FAIL, and
+ *    the download carries on unverified.
+ *
+ * Takes:
+ * -> sock:
+ *    The connected, post-handshake peer socket.
+ * -> file:
+ *    The download to attach the manifest to.
+ * -> response_timeout:
+ *    How long to wait for a reply.
+ *
+ * Returns:
+ * -> On success:
+ *    EXIT_SUCCESS, with or without a manifest.
+ * -> On failure:
+ *    EXIT_FAILURE, if the peer didn't answer or sent a manifest that doesn't
+ *    match the file.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+static int requestManifest(int                                  sock,
+                           const std::shared_ptr<DownloadFile>& file,
+                           struct timeval                       response_timeout) {
+    std::vector<uint8_t> manifest_msg;
+    if (!sendOkay(sock, {MANIFEST_REQUEST}))
+        return EXIT_FAILURE;
+
+    if (recvOkay(sock, manifest_msg, MANIFEST, response_timeout)) {
+        ChunkManifest manifest = parseManifest(manifest_msg);
+        return setDownloadManifest(file, manifest.first, manifest.second);
+    }
+
+    if (!manifest_msg.empty() && manifest_msg[0] == FAIL)
+        return EXIT_SUCCESS; //peer has no manifest for this file
+    return EXIT_FAILURE;
+}
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * requestSegments
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Asks the peer for the file's content defined segments, if they're worth
+ *    having, for fillFromSegments(). They're only a shortcut, so a peer that
+ *    can't cut the file, or takes too long to, is still fine.
+ *
+ * Takes:
+ * -> sock:
+ *    The connected peer socket, past the manifest. Out of step if nothing
+ *    comes back, only close it after.
+ * -> file:
+ *    The download, with a manifest set.
+ * -> response_timeout:
+ *    How long to wait for a reply.
+ *
+ * Returns:
+ * -> On success:
+ *    The segments.
+ * -> On failure:
+ *    An empty SegmentManifest.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+static SegmentManifest requestSegments(int                                  sock,
+                                       const std::shared_ptr<DownloadFile>& file,
+                                       struct timeval                       response_timeout) {
+    std::vector<uint8_t> segment_msg;
+    if (!wantsSegments(file) || !sendOkay(sock, {SEGMENTS_REQUEST}))
+        return {};
+    if (!recvOkay(sock, segment_msg, SEGMENT_MANIFEST, response_timeout))
+        return {};
+    return parseSegmentManifest(segment_msg);
+}
+
 int attemptInitialChunkDownload(const  uint64_t                        f_uuid,       
                                        std::string&                    f_name,
                                        uint64_t&                       f_size,
-                                       std::unique_ptr<std::ofstream>& file_ptr,
+                                       std::shared_ptr<DownloadFile>&  file,
                                 const  SourceInfo&                     server,
                                 struct timeval                         connection_timeout,
                                 struct timeval                         response_timeout) {
-    int sock = connectToSource(server, connection_timeout); 
-    if (sock < 0) return EXIT_FAILURE;
+    //new download, or resume of one that was interrupted. a resume has to use
+    //the chunk size it started with, which we only learn once we have the name
+    size_t                        want_c_size = DOWNLOAD_CHUNK_SIZE;
+    size_t                        c_size      = 0;
+    int                           sock        = -1;
+    std::shared_ptr<DownloadFile> new_file    = nullptr;
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        sock = connectToSource(server, connection_timeout); 
+        if (sock < 0) return EXIT_FAILURE;
 
-    if (EXIT_FAILURE == attemptDownloadHandshake(sock,
-                                                 f_uuid,
-                                                 f_name,
-                                                 f_size,
-                                                 response_timeout)) {
-        return EXIT_FAILURE; //socket already closed
+        if (EXIT_FAILURE == attemptDownloadHandshake(sock,
+                                                     f_uuid,
+                                                     want_c_size,
+                                                     f_name,
+                                                     f_size,
+                                                     c_size,
+                                                     response_timeout)) {
+            return EXIT_FAILURE; //socket already closed
+        }
+
+        if (want_c_size != 0 && c_size != want_c_size) {
+            //peer won't send with the size the download needs
+            sendOkay(sock, {FINISH_DOWNLOAD});
+            closeSocket(sock);
+            return EXIT_FAILURE;
+        }
+
+        new_file = openDownloadFile(f_name, f_size, f_uuid, c_size);
+        if (new_file != nullptr)
+            break;
+
+        sendOkay(sock, {FINISH_DOWNLOAD});
+        closeSocket(sock);
+
+        auto part_c_size = partialChunkSize(f_name, f_size, f_uuid);
+        if (!part_c_size || part_c_size.value() == c_size)
+            break;
+        want_c_size = part_c_size.value(); //ask again with that
     }
 
-    if (std::filesystem::exists( getDownloadDir() / f_name )) {
-        std::cerr << "[err] A file with the same name already exists. Have you already downloaded this file?" << std::endl;
+    if (new_file == nullptr) {
+        if (std::filesystem::exists( getDownloadDir() / f_name ))
+            std::cerr << "[err] A file with the same name already exists. Have you already downloaded this file?" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    //a peer that can't back up its manifest can't be trusted for chunk 0 either
+    if (EXIT_FAILURE == requestManifest(sock, new_file, response_timeout)) {
         closeSocket(sock);
+        closeDownloadFile(new_file, false);
         return EXIT_FAILURE;
-   }
+    }
+
+    //chunks some other local file already holds don't need a peer
+    size_t local = fillFromChunkStore(new_file);
+    if (local > 0)
+        std::cout << "Found " << local << " chunks of the file on disk already." << std::endl;
 
+    //ones a near copy holds elsewhere in it are found by segment, once the
+    //first chunk's settled
+    auto fillShifted = [&new_file](const SegmentManifest& segments) {
+        size_t shifted = fillFromSegments(new_file, segments);
+        if (shifted > 0)
+            std::cout << "Found " << shifted << " chunks of the file in near copies on disk." << std::endl;
+    };
+
+    auto missing = missingChunks(new_file);
+    if (missing.empty() || missing.front() != 0) {
+        //first chunk survived an earlier attempt
+        SegmentManifest segments = requestSegments(sock, new_file, response_timeout);
+        sendOkay(sock, {FINISH_DOWNLOAD});
+        closeSocket(sock);
+        fillShifted(segments);
+        file = std::move(new_file);
+        return EXIT_SUCCESS;
+    }
+
+    //the chunk may come back packed, we offered codecs in the handshake
     std::vector<uint8_t> chunk_request = createChunkRequest(0);
     std::vector<uint8_t> data_chunk_msg;
-    int res = sendAndRecv(sock,
-                          chunk_request,
-                          data_chunk_msg,
-                          DATA_CHUNK,
-                          response_timeout);
-    if (res == EXIT_FAILURE) {
+    if (!sendOkay(sock, chunk_request) || !recvOkay(sock,
+                                                    data_chunk_msg,
+                                                    {DATA_CHUNK, PACKED_CHUNK},
+                                                    response_timeout)) {
         closeSocket(sock);
+        closeDownloadFile(new_file, false);
         return EXIT_FAILURE;
     }
 
     //send finish message and close connection
+    SegmentManifest segments = requestSegments(sock, new_file, response_timeout);
     sendOkay(sock, {FINISH_DOWNLOAD});
     closeSocket(sock);
 
     //peer communication finished, now start file
-    DataChunk dc = parseDataChunk(data_chunk_msg);
-    if (dc.first == SIZE_MAX)
+    size_t c_index = stripDataChunk(data_chunk_msg);
+    if (c_index != 0                                                         ||
+        !verifyFileChunk(new_file, data_chunk_msg, data_chunk_msg.size(), 0) ||
+        EXIT_FAILURE == writeFileChunk(new_file,
+                                       data_chunk_msg,
+                                       data_chunk_msg.size(),
+                                       0)) {
+        //bad parse, wrong chunk, corrupt, or couldn't write it
+        closeDownloadFile(new_file, false);
         return EXIT_FAILURE;
+    }
 
-    if (EXIT_FAILURE == unpackFileChunk(f_name,
-                                        dc.second,
-                                        dc.second.size(),
-                                        dc.first)) {
-        return EXIT_FAILURE;
+    fillShifted(segments);
+    file = std::move(new_file);
+    return EXIT_SUCCESS;
+}
+
+int attemptBundleManifest(const  uint64_t                   b_uuid,
+                                 std::string&               b_name,
+                                 size_t&                    c_size,
+                                 std::vector<BundleMember>& members,
+                          const  SourceInfo&                peer,
+                          struct timeval                    connection_timeout,
+                          struct timeval                    response_timeout) {
+    int sock = connectToSource(peer, connection_timeout);
+    if (sock < 0) return EXIT_FAILURE;
+
+    uint64_t m_size = 0;
+    if (EXIT_FAILURE == attemptBundleHandshake(sock,
+                                               b_uuid,
+                                               DOWNLOAD_CHUNK_SIZE,
+                                               b_name,
+                                               m_size,
+                                               c_size,
+                                               response_timeout)) {
+        return EXIT_FAILURE; //socket already closed
     }
 
-    file_ptr = openFile(f_name);
-    if (file_ptr == nullptr)
+    std::vector<uint8_t> manifest_msg;
+    bool got = sendOkay(sock, {MANIFEST_REQUEST}) && recvOkay(sock,
+                                                              manifest_msg,
+                                                              BUNDLE_MANIFEST,
+                                                              response_timeout);
+    sendOkay(sock, {FINISH_DOWNLOAD});
+    closeSocket(sock);
+    if (!got || manifest_msg.size() - 1 != m_size)
         return EXIT_FAILURE;
+
+    //the bundle's uuid is the hash of its manifest
+    if (dataUuid(manifest_msg.data() + 1, m_size) != b_uuid)
+        return EXIT_FAILURE;
+
+    auto unpacked = unpackBundle(manifest_msg.data() + 1, m_size);
+    if (!unpacked)
+        return EXIT_FAILURE;
+
+    members = std::move(unpacked.value());
     return EXIT_SUCCESS;
 }
 
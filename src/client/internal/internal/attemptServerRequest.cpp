@@ -1,4 +1,4 @@
-#include "client/internal/internal/internal/clientNetworking.hpp"
+#include "client/internal/internal/internal/serverConnections.hpp"
 #include "networking/socket.hpp"
 #include "networking/messageFormatting.hpp"
 #include "sourceInfo.hpp"
@@ -16,9 +16,9 @@ namespace dfd {
  * attemptServerCommunication
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  * Description:
- * -> Attempts to connect to a server within a connection_timeout, send a
- *    request to that server, and receive a response from that server within
- *    response_timeout.
+ * -> Attempts to send a request to a server over a pooled connection,
+ *    connecting within connection_timeout if there's none, and receive a
+ *    response from that server within response_timeout.
  *
  * Takes:
  * -> server:
@@ -45,33 +45,63 @@ int attemptServerCommunication(const  SourceInfo&           server,
                                const  uint8_t               msg_code,
                                struct timeval               connection_timeout,
                                struct timeval               response_timeout) {
-    int sock = connectToSource(server, connection_timeout);
-    if (sock < 0) return EXIT_FAILURE;
-
-    int res = sendAndRecv(sock,
-                          request,
-                          response_buff,
-                          msg_code,
-                          response_timeout);
-
-    closeSocket(sock);
-    return res; //either EXIT_SUCCESS / EXIT_FAILURE
+    return serverRequest(server,
+                         request,
+                         response_buff,
+                         msg_code,
+                         connection_timeout,
+                         response_timeout); //either EXIT_SUCCESS / EXIT_FAILURE
 }
 
 int attemptIndex(const  FileId&     file,
+                        bool&       refused,
                  const  SourceInfo& server,
                  struct timeval     connection_timeout,
                  struct timeval     response_timeout) {
+    refused = false;
     std::vector<uint8_t> index_request = createIndexRequest(file);
     std::vector<uint8_t> server_response;
     if (index_request.empty()) return EXIT_FAILURE;
 
-    return attemptServerCommunication(server,
-                                      index_request,
-                                      server_response,
-                                      INDEX_OK,
-                                      connection_timeout,
-                                      response_timeout);
+    int res = attemptServerCommunication(server,
+                                         index_request,
+                                         server_response,
+                                         INDEX_OK,
+                                         connection_timeout,
+                                         response_timeout);
+    refused = res != EXIT_SUCCESS && !server_response.empty() && server_response[0] == FAIL;
+    return res;
+}
+
+int attemptIndexBatch(const  std::vector<FileId>& files,
+                             size_t&              answered,
+                             bool&                refused,
+                      const  SourceInfo&          server,
+                      struct timeval              connection_timeout,
+                      struct timeval              response_timeout) {
+    answered = 0;
+    refused  = false;
+    std::vector<std::vector<uint8_t>> index_requests;
+    for (const FileId& file : files) {
+        index_requests.push_back(createIndexRequest(file));
+        if (index_requests.back().empty()) {
+            index_requests.pop_back();
+            break; //the rest wait for attemptIndex() to turn this one down
+        }
+    }
+
+    std::vector<std::vector<uint8_t>> server_responses;
+    std::vector<uint8_t>              last;
+    int res = serverRequests(server,
+                             index_requests,
+                             server_responses,
+                             last,
+                             INDEX_OK,
+                             connection_timeout,
+                             response_timeout);
+    answered = server_responses.size();
+    refused  = res != EXIT_SUCCESS && !last.empty() && last[0] == FAIL;
+    return res == EXIT_SUCCESS && answered == files.size() ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
 int attemptDrop(const  IndexUuidPair& file,
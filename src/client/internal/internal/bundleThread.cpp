@@ -0,0 +1,208 @@
+#include "client/internal/internal/bundleThread.hpp"
+#include "client/internal/internal/internal/chunkWindow.hpp"
+#include "client/internal/internal/internal/clientNetworking.hpp"
+#include "client/internal/internal/internal/downloadHandshake.hpp"
+#include "networking/bufferPool.hpp"
+#include "networking/fileParsing.hpp"
+#include "networking/socket.hpp"
+
+#include <deque>
+
+namespace dfd {
+
+//a chunk asked of the peer and not yet received
+struct InFlight {
+    BundleItem                            item;
+    std::shared_ptr<DownloadFile>         file;
+    std::chrono::steady_clock::time_point sent;
+};
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * chunkWritten
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Records that a chunk of a bundle's file landed, or puts it back on the
+ *    queue if it didn't. Called from an I/O engine thread.
+ *
+ * Takes:
+ * -> job:
+ *    The download.
+ * -> item:
+ *    The chunk.
+ * -> res:
+ *    EXIT_SUCCESS or EXIT_FAILURE, from the write.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+static void chunkWritten(BundleJob& job, const BundleItem item, int res) {
+    std::lock_guard<std::mutex> lock(job.mtx);
+    if (res != EXIT_SUCCESS) {
+        //couldn't write it, someone will have to fetch it again
+        ++job.unsent[item.member];
+        job.queue.push_back(item);
+        job.queued.notify_one();
+        return;
+    }
+
+    if (--job.unwritten[item.member] == 0) {
+        job.finished.push(item.member);
+        job.progress.notify_one();
+    }
+}
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * receiveItem
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Receives one chunk already asked of the peer and stages it to be written.
+ *    The last chunk of a file to come in flushes its writes.
+ *
+ * Takes:
+ * -> sock:
+ *    The connected, post-handshake peer socket.
+ * -> job:
+ *    The download.
+ * -> item:
+ *    The chunk expected, the oldest one asked for.
+ * -> file:
+ *    The download of the chunk's file.
+ * -> response_timeout:
+ *    How long to wait for a reply.
+ *
+ * Returns:
+ * -> On success:
+ *    EXIT_SUCCESS, the chunk is staged.
+ * -> On failure:
+ *    EXIT_FAILURE, the peer didn't answer or sent the wrong thing.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+static int receiveItem(int                                  sock,
+                       BundleJob&                           job,
+                       const BundleItem                     item,
+                       const std::shared_ptr<DownloadFile>& file,
+                       struct timeval                       response_timeout) {
+    //same as receiveChunk(), let held back chunks go before waiting on the pool
+    size_t       msg_len    = 1 + 8 + job.c_size;
+    PooledBuffer chunk_data = tryTakeBuffer(msg_len);
+    if (!chunk_data) {
+        flushFileWrites(file);
+        chunk_data = takeBuffer(msg_len);
+    }
+
+    if (!recvOkay(sock, *chunk_data, {DATA_CHUNK, PACKED_CHUNK}, response_timeout))
+        return EXIT_FAILURE;
+
+    if (stripDataChunk(*chunk_data) != item.chunk)
+        return EXIT_FAILURE; //bad parse, or not what we asked for
+
+    if (EXIT_SUCCESS != writeFileChunkAsync(file,
+                                            chunk_data,
+                                            item.chunk,
+                                            [&job, item](int res) {
+                                                chunkWritten(job, item, res);
+                                            })) {
+        return EXIT_FAILURE; //wrong length for the chunk
+    }
+
+    bool last;
+    {
+        std::lock_guard<std::mutex> lock(job.mtx);
+        last = --job.unsent[item.member] == 0;
+    }
+
+    //nothing else of this file is coming to sit next to what's staged
+    if (last)
+        flushFileWrites(file);
+    return EXIT_SUCCESS;
+}
+
+void bundleThread(      BundleJob&     job,
+                  const SourceInfo&    peer,
+                  struct timeval       connection_timeout,
+                  struct timeval       response_timeout) {
+    std::string b_name;
+    uint64_t    m_size = 0;
+    size_t      c_size = 0;
+    int         sock   = connectToSource(peer, connection_timeout);
+    if (sock >= 0 && EXIT_FAILURE == attemptBundleHandshake(sock,
+                                                            job.b_uuid,
+                                                            job.c_size,
+                                                            b_name,
+                                                            m_size,
+                                                            c_size,
+                                                            response_timeout)) {
+        sock = -1; //closed by attemptBundleHandshake
+    }
+
+    if (sock >= 0 && c_size != job.c_size) {
+        //every file was opened with job's chunk size
+        sendOkay(sock, {FINISH_DOWNLOAD});
+        closeSocket(sock);
+        sock = -1;
+    }
+
+    //a window of requests outstanding, same as downloadThread(). only waits
+    //for more to be queued once every request has been answered
+    std::deque<InFlight> in_flight;
+    ChunkWindow          window;
+    windowStart(window);
+
+    bool failed = sock < 0;
+    while (!failed) {
+        {
+            std::unique_lock<std::mutex> lock(job.mtx);
+            if (in_flight.empty())
+                job.queued.wait(lock, [&job]{ return !job.queue.empty() || job.closing; });
+
+            std::vector<InFlight> asking;
+            while (in_flight.size() + asking.size() < window.size && !job.queue.empty()) {
+                BundleItem item = job.queue.front();
+                job.queue.pop_front();
+                asking.push_back({item, job.files[item.member], {}});
+            }
+            lock.unlock();
+
+            //whatever isn't sent is handed back below with the rest
+            for (InFlight& ask : asking) {
+                ask.sent = std::chrono::steady_clock::now();
+                in_flight.push_back(std::move(ask));
+                const BundleItem& item = in_flight.back().item;
+                failed = failed || !sendOkay(sock, createFileChunkRequest(job.members[item.member].uuid,
+                                                                          item.chunk));
+            }
+        }
+        if (failed || in_flight.empty())
+            break; //peer's gone, or closing and nothing left
+
+        InFlight& next = in_flight.front();
+        if (EXIT_SUCCESS != receiveItem(sock, job, next.item, next.file, response_timeout)) {
+            failed = true;
+            break;
+        }
+
+        windowReply(window, job.c_size, job.c_size, next.sent);
+        in_flight.pop_front();
+    }
+
+    if (!in_flight.empty()) {
+        //someone else will have to get them, ahead of what's still queued
+        std::lock_guard<std::mutex> lock(job.mtx);
+        for (auto it = in_flight.rbegin(); it != in_flight.rend(); ++it)
+            job.queue.push_front(it->item);
+        job.queued.notify_all();
+    }
+
+    if (sock >= 0) {
+        sendOkay(sock, {FINISH_DOWNLOAD});
+        closeSocket(sock);
+    }
+
+    std::lock_guard<std::mutex> lock(job.mtx);
+    if (failed)
+        job.bad_peers.push_back(peer);
+    --job.sessions;
+    job.progress.notify_all();
+}
+
+} //dfd
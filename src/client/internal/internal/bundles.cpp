@@ -0,0 +1,25 @@
+#include "client/internal/internal/bundles.hpp"
+
+#include <map>
+#include <mutex>
+
+namespace dfd {
+
+//every bundle shared, by uuid. sessions hold on to their own copy
+static std::mutex                                        bundles_mtx;
+static std::map<uint64_t, std::shared_ptr<const Bundle>> bundles;
+
+void shareBundle(const uint64_t uuid, std::shared_ptr<const Bundle> bundle) {
+    std::lock_guard<std::mutex> lock(bundles_mtx);
+    bundles[uuid] = std::move(bundle);
+}
+
+std::shared_ptr<const Bundle> sharedBundle(const uint64_t uuid) {
+    std::lock_guard<std::mutex> lock(bundles_mtx);
+    auto it = bundles.find(uuid);
+    if (it == bundles.end())
+        return nullptr;
+    return it->second;
+}
+
+} //dfd
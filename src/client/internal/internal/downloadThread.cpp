@@ -1,11 +1,16 @@
 #include "client/internal/internal/downloadThread.hpp"
 #include "client/internal/internal/attemptPeerRequest.hpp"
+#include "client/internal/internal/internal/chunkWindow.hpp"
 #include "client/internal/internal/internal/clientNetworking.hpp"
 #include "client/internal/internal/internal/downloadHandshake.hpp"
+#include "networking/bufferPool.hpp"
 #include "networking/messageFormatting.hpp"
 #include "networking/socket.hpp"
 #include "networking/fileParsing.hpp"
 
+#include <chrono>
+#include <deque>
+#include <functional>
 #include <optional>
 #include <thread>
 #include <iostream>
@@ -64,54 +69,75 @@ void addBadPeer(const SourceInfo&              bad_peer,
 
 /*
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
- * getNextChunk
+ * getNextRun
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  * Description:
- * -> Aquires a lock on the remaining_chunks mutex, checks the queue for any
- *    remaining chunks, pops the next in the queue if it exists, then returns
- *    it. If no chunks are left 0 is returned as the main thread downloads the
- *    0th chunk when opening the file. There's no circumstance where it should
- *    be present in the remaining_chunks queue.
+ * -> Aquires a lock on the remaining_chunks mutex, and pops the next chunk in
+ *    the queue along with the chunks right after it while they follow on from
+ *    it, so they can be asked for as one range. Chunk 0 is never queued, the
+ *    main thread downloads it when opening the file.
  *
  * Takes:
  * -> remaining_chunks:
  *    The queue of chunks.
  * -> remaining_chunks_mtx:
  *    The mutex to lock.
+ * -> max_chunks:
+ *    Most chunks to pop.
  *
  * Returns:
  * -> On success:
- *    The chunk to download.
+ *    The pair of first chunk and one past the last.
  * -> On failure:
- *    0
+ *    The pair {0, 0}, if the queue is empty.
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  */
-size_t getNextChunk(std::queue<size_t>& remaining_chunks,
-                    std::mutex&         remaining_chunks_mtx) {
+static std::pair<size_t, size_t> getNextRun(std::queue<size_t>& remaining_chunks,
+                                            std::mutex&         remaining_chunks_mtx,
+                                            const size_t        max_chunks) {
     std::lock_guard<std::mutex> lock(remaining_chunks_mtx);
     if (remaining_chunks.empty())
-        return 0;
-    size_t chunk = remaining_chunks.front();
+        return {0, 0};
+
+    size_t first = remaining_chunks.front();
+    size_t end   = first + 1;
     remaining_chunks.pop();
-    return chunk;
+    while (!remaining_chunks.empty()       &&
+           remaining_chunks.front() == end &&
+           end - first < max_chunks) {
+        remaining_chunks.pop();
+        end++;
+    }
+    return {first, end};
 }
 
 /*
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
- * downloadChunk
+ * receiveChunk
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  * Description:
- * -> Downloads a chunk from a peer. 
+ * -> Receives a chunk already requested from a peer, checks it against the
+ *    download's manifest if it has one, and writes it into the download file.
+ *    With ASYNC_CHUNK_WRITES the write is only queued, and may finish after
+ *    this returns.
  *
  * Takes:
  * -> sock:
  *    The connected, post-handshake peer socket. 
  * -> chunk_index:
- *    The index of the chunk to download.
- * -> f_name:
- *    The name of the file for unpackFileChunk()
+ *    The index of the chunk expected, the oldest one requested.
+ * -> file:
+ *    The download file to write the chunk into.
  * -> response_timeout:
  *    How long to wait for a reply.
+ * -> written:
+ *    Called with EXIT_SUCCESS or EXIT_FAILURE once the chunk is written, or
+ *    fails to be. Only called if this returns EXIT_SUCCESS.
+ * -> corrupt:
+ *    Set to true if the peer sent the chunk, but it didn't match the manifest.
+ * -> range_end:
+ *    Set to where a range ended if the peer sent RANGE_END instead of a chunk,
+ *    std::nullopt otherwise. Nothing is written then.
  * 
  * Returns:
  * -> On success:
@@ -120,43 +146,210 @@ size_t getNextChunk(std::queue<size_t>& remaining_chunks,
  *    EXIT_FAILURE
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  */
-int downloadChunk(int                sock,
-                  const size_t       chunk_index,
-                  const std::string& f_name,
-                  struct timeval     response_timeout) {
-    //Try to receive chunk
-    std::vector<uint8_t> chunk_req = createChunkRequest(chunk_index);
-    std::vector<uint8_t> chunk_data;
-    if (EXIT_FAILURE == sendAndRecv(sock,
-                                    chunk_req,
-                                    chunk_data,
-                                    DATA_CHUNK,
-                                    response_timeout)) {
+int receiveChunk(int                                  sock,
+                 const size_t                         chunk_index,
+                 const std::shared_ptr<DownloadFile>& file,
+                 struct timeval                       response_timeout,
+                 const std::function<void(int)>&      written,
+                 bool&                                corrupt,
+                 std::optional<size_t>&               range_end) {
+    corrupt   = false;
+    range_end = std::nullopt;
+
+    //room for the chunk and its header. if the pool is full, chunks we're
+    //holding back may be what's filling it, so let them go before waiting
+    size_t       msg_len    = 1 + 8 + downloadChunkSize(file);
+    PooledBuffer chunk_data = tryTakeBuffer(msg_len);
+    if (!chunk_data) {
+        flushFileWrites(file);
+        chunk_data = takeBuffer(msg_len);
+    }
+
+    //the seeder packs chunks it thinks are worth it, with a codec we offered
+    if (!recvOkay(sock, *chunk_data, {DATA_CHUNK, PACKED_CHUNK, RANGE_END}, response_timeout))
         return EXIT_FAILURE;
+
+    if ((*chunk_data)[0] == RANGE_END) {
+        range_end = parseRangeEnd(*chunk_data);
+        return range_end.value() == SIZE_MAX ? EXIT_FAILURE : EXIT_SUCCESS;
     }
 
-    //store received datachunk
-    DataChunk dc = parseDataChunk(chunk_data);
-    unpackFileChunk(f_name, dc.second, dc.second.size(), chunk_index);
+    //unpack the received datachunk where it landed. replies come in the order
+    //they were asked for
+    if (stripDataChunk(*chunk_data) != chunk_index)
+        return EXIT_FAILURE; //bad parse, or not what we asked for
 
+    if (!verifyFileChunk(file, *chunk_data, chunk_data->size(), chunk_index)) {
+        corrupt = true;
+        return EXIT_FAILURE;
+    }
+
+    //write it into place, the buffer goes back to the pool once it's written
+    if (ASYNC_CHUNK_WRITES)
+        return writeFileChunkAsync(file, chunk_data, chunk_index, written);
+
+    if (EXIT_SUCCESS != writeFileChunk(file, *chunk_data, chunk_data->size(), chunk_index))
+        return EXIT_FAILURE;
+    written(EXIT_SUCCESS);
     return EXIT_SUCCESS;
 }
 
-void downloadThread(const uint64_t                 f_uuid,
-                    const std::vector<SourceInfo>& sources,
-                    std::vector<bool>&             source_stats,
-                    std::mutex&                    stat_mtx,
-                    std::vector<SourceInfo>&       bad_peers,
-                    std::mutex&                    bad_peers_mtx,
-                    std::queue<size_t>&            remaining_chunks,
-                    std::mutex&                    remaining_chunks_mtx,
-                    std::queue<size_t>&            done_chunks,
-                    std::mutex&                    done_chunks_mtx,
-                    std::condition_variable&       chunk_ready,
-                    struct timeval                 connection_timeout,
-                    struct timeval                 response_timeout) {
-    size_t chunks_obtained = 0;
-    int    peer_index;
+//chunks asked of a peer, one at a time or as a range
+using Clock = std::chrono::steady_clock;
+struct ChunkRequest {
+    size_t            first;
+    size_t            next;   //next chunk expected
+    size_t            end;    //one past the last, as asked for
+    Clock::time_point sent;
+    bool              range;
+    bool              shrunk; //SHRINK_RANGE sent, end is only known at RANGE_END
+};
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * setBusy
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Counts a thread in or out of share.busy, once it has chunks asked of a
+ *    peer or once it has none. Threads waiting in waitForReturned() are woken
+ *    when the last one stops, there's no one left to hand them anything.
+ *
+ * Takes:
+ * -> share:
+ *    The download's RangeShare.
+ * -> remaining_chunks_mtx:
+ *    The mutex guarding it.
+ * -> busy:
+ *    In or out.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+static void setBusy(RangeShare& share, std::mutex& remaining_chunks_mtx, const bool busy) {
+    {
+        std::lock_guard<std::mutex> lock(remaining_chunks_mtx);
+        share.busy = busy ? share.busy + 1 : share.busy - 1;
+    }
+    share.returned.notify_all();
+}
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * returnChunks
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Puts chunks [first, end) back on the queue for any thread to take, and
+ *    wakes one waiting for them.
+ *
+ * Takes:
+ * -> first:
+ *    The first chunk.
+ * -> end:
+ *    One past the last. Nothing is returned if it's not past first.
+ * -> remaining_chunks:
+ *    The queue of chunks.
+ * -> remaining_chunks_mtx:
+ *    The mutex to lock.
+ * -> share:
+ *    The download's RangeShare.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+static void returnChunks(const size_t        first,
+                         const size_t        end,
+                         std::queue<size_t>& remaining_chunks,
+                         std::mutex&         remaining_chunks_mtx,
+                         RangeShare&         share) {
+    if (first >= end)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(remaining_chunks_mtx);
+        for (size_t c = first; c < end; ++c)
+            remaining_chunks.push(c);
+    }
+    share.returned.notify_one();
+}
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * waitForReturned
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Called by a thread with nothing queued and nothing asked of its peer.
+ *    Counts it as hungry, so busy threads shrink their ranges, and waits for
+ *    chunks to be handed back. Gives up once no thread is busy, or once it's
+ *    been idle for DOWNLOAD_IDLE_MS, before the seeder times the session out.
+ *
+ * Takes:
+ * -> share:
+ *    The download's RangeShare.
+ * -> remaining_chunks:
+ *    The queue of chunks.
+ * -> remaining_chunks_mtx:
+ *    The mutex guarding it and share.
+ * -> idle_since:
+ *    When the thread last had chunks asked of its peer.
+ *
+ * Returns:
+ * -> On success:
+ *    true, there are chunks to take.
+ * -> On failure:
+ *    false, the thread is done.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+static bool waitForReturned(RangeShare&             share,
+                            std::queue<size_t>&     remaining_chunks,
+                            std::mutex&             remaining_chunks_mtx,
+                            const Clock::time_point idle_since) {
+    std::unique_lock<std::mutex> lock(remaining_chunks_mtx);
+    share.hungry++;
+    share.returned.wait_until(lock,
+                              idle_since + std::chrono::milliseconds(DOWNLOAD_IDLE_MS),
+                              [&]{ return !remaining_chunks.empty() || share.busy == 0; });
+    share.hungry--;
+    return !remaining_chunks.empty();
+}
+
+void downloadThread(const uint64_t                       f_uuid,
+                    const std::shared_ptr<DownloadFile>& file,
+                    const std::vector<SourceInfo>&       sources,
+                    std::vector<bool>&                   source_stats,
+                    std::mutex&                          stat_mtx,
+                    std::vector<SourceInfo>&             bad_peers,
+                    std::mutex&                          bad_peers_mtx,
+                    std::queue<size_t>&                  remaining_chunks,
+                    std::mutex&                          remaining_chunks_mtx,
+                    std::queue<size_t>&                  done_chunks,
+                    std::mutex&                          done_chunks_mtx,
+                    std::condition_variable&             chunk_ready,
+                    RangeShare&                          share,
+                    struct timeval                       connection_timeout,
+                    struct timeval                       response_timeout) {
+    int peer_index;
+
+    //runs once a chunk is on disk, possibly on an I/O engine thread after this
+    //one has returned, so only holds on to what doDownload owns
+    auto chunkWritten = [remaining = &remaining_chunks,
+                         rem_mtx   = &remaining_chunks_mtx,
+                         done      = &done_chunks,
+                         done_mtx  = &done_chunks_mtx,
+                         ready     = &chunk_ready,
+                         returned  = &share.returned](size_t chunk_index, int res) {
+        if (res != EXIT_SUCCESS) {
+            //couldn't write it, someone will have to fetch it again
+            {
+                std::lock_guard<std::mutex> lock(*rem_mtx);
+                remaining->push(chunk_index);
+            }
+            returned->notify_one();
+            return;
+        }
+
+        {
+            //record downloaded chunk
+            std::unique_lock<std::mutex> lock(*done_mtx);
+            done->push(chunk_index);
+        }
+        ready->notify_one();
+    };
+
     while ((peer_index = selectPeerThreaded(source_stats, stat_mtx)) >= 0) {
         //select peer
         const SourceInfo& selected_peer = sources[peer_index];
@@ -168,52 +361,153 @@ void downloadThread(const uint64_t                 f_uuid,
             continue;
         }
 
-        //do handshake with peer
+        //this peer's alone, so one that fails having sent nothing is marked
+        //bad even if an earlier one sent plenty
+        size_t chunks_obtained = 0;
+
+        //do handshake with peer, every chunk has to be the size the file was
+        //opened with
         std::string f_name;
         uint64_t    f_size;
+        size_t      c_size;
         if (EXIT_FAILURE == attemptDownloadHandshake(sock,
                                                      f_uuid,
+                                                     downloadChunkSize(file),
                                                      f_name,
                                                      f_size,
+                                                     c_size,
                                                      response_timeout)) {
             addBadPeer(selected_peer, bad_peers, bad_peers_mtx);
             return; //socket closed by attemptDownloadHandshake
         }
 
-        //chunk request loop, while chunks are in the queue we:
-        size_t chunk_index;
-        while ((chunk_index = getNextChunk(remaining_chunks, remaining_chunks_mtx)) != 0) {
-            // std::cout << "next:" << chunk_index << " from " << selected_peer.port << std::endl; 
-            if (EXIT_SUCCESS != downloadChunk(sock,
-                                              chunk_index,
-                                              f_name,
-                                              response_timeout)) {
+        if (c_size != downloadChunkSize(file)) {
+            //can't use this peer, and it isn't freed so nobody else tries
+            sendOkay(sock, {FINISH_DOWNLOAD});
+            closeSocket(sock);
+            addBadPeer(selected_peer, bad_peers, bad_peers_mtx);
+            continue;
+        }
+
+        //keep a window of chunks outstanding, topping it back up as replies
+        //come in. runs of chunks that follow on from each other are asked for
+        //as one range. replies come back in the order they were asked for
+        std::deque<ChunkRequest> in_flight;
+        size_t                   in_air = 0;
+        ChunkWindow              window;
+        windowStart(window);
+
+        bool failed  = false;
+        bool corrupt = false;
+        auto idle_since = Clock::now();
+        while (!failed) {
+            while (in_air < window.size) {
+                auto [first, end] = getNextRun(remaining_chunks,
+                                               remaining_chunks_mtx,
+                                               DOWNLOAD_RANGE_CHUNKS);
+                if (first == end)
+                    break;
+
+                bool range = end - first > 1;
+                if (in_flight.empty()) setBusy(share, remaining_chunks_mtx, true);
+                in_flight.push_back({first, first, end, Clock::now(), range, false});
+                in_air += end - first;
+
+                std::vector<uint8_t> request = range ? createRangeRequest(first, end)
+                                                     : createChunkRequest(first);
+                if (!sendOkay(sock, request)) {
+                    failed = true;
+                    break;
+                }
+            }
+            if (failed)
+                break; //peer's gone
+
+            if (in_flight.empty()) {
+                //nothing left, unless a busy thread hands some back. give up
+                //on that before the peer gives up on us
+                if (!waitForReturned(share,
+                                     remaining_chunks,
+                                     remaining_chunks_mtx,
+                                     idle_since))
+                    break;
+                continue;
+            }
+
+            ChunkRequest&         front = in_flight.front();
+            std::optional<size_t> range_end;
+            size_t                chunk_index = front.next;
+            if (EXIT_SUCCESS != receiveChunk(sock,
+                                             chunk_index,
+                                             file,
+                                             response_timeout,
+                                             [=](int res) { chunkWritten(chunk_index, res); },
+                                             corrupt,
+                                             range_end)) {
+                failed = true;
                 break;
             }
 
-            {
-                //record downloaded chunk
-                std::unique_lock<std::mutex> lock(done_chunks_mtx);
-                done_chunks.push(chunk_index);
+            if (range_end) {
+                //every chunk up to where it ended has to be in
+                if (!front.range || range_end.value() != front.next) {
+                    failed = true;
+                    break;
+                }
+
+                //whatever it was shrunk by is someone else's now
+                returnChunks(front.next, front.end, remaining_chunks, remaining_chunks_mtx, share);
+                in_air -= front.end - front.next;
+                in_flight.pop_front();
+            } else {
+                front.next++;
+                in_air--;
+                windowReply(window, c_size, c_size, front.sent);
+                chunks_obtained++;
+                if (!front.range && front.next == front.end)
+                    in_flight.pop_front();
+            }
+
+            if (in_flight.empty()) {
+                setBusy(share, remaining_chunks_mtx, false);
+                idle_since = Clock::now();
+                continue;
+            }
+
+            //a thread ran out of work, hand over half of what's left of the
+            //range being streamed, past what's needed to keep the window full
+            ChunkRequest& streaming = in_flight.front();
+            size_t        tail      = streaming.end - streaming.next;
+            if (share.hungry > 0 && streaming.range && !streaming.shrunk && tail > 2 * window.size) {
+                streaming.shrunk = true;
+                if (!sendOkay(sock, createRangeShrink(streaming.first, streaming.next + tail / 2))) {
+                    failed = true;
+                    break;
+                }
             }
-            chunk_ready.notify_one();
         }
 
         //done with this peer
         sendOkay(sock, {FINISH_DOWNLOAD});
         closeSocket(sock);
 
-        if (chunk_index == 0) {
+        //don't leave chunks held back for neighbours that may never come
+        flushFileWrites(file);
+
+        if (!failed) {
             //nothing left to do
             std::lock_guard<std::mutex> lock(stat_mtx);
             source_stats[peer_index] = true; //this peer is fine
             return;
         } else {
-            //if this peer isn't responding
-            if (chunks_obtained < 1)
+            //if this peer isn't responding, or is sending bad data. either
+            //way it's not marked free again, so no thread picks it back up
+            if (corrupt || chunks_obtained < 1)
                 addBadPeer(selected_peer, bad_peers, bad_peers_mtx);
-            std::lock_guard<std::mutex> lock(remaining_chunks_mtx);
-            remaining_chunks.push(chunk_index);
+            for (const ChunkRequest& req : in_flight)
+                returnChunks(req.next, req.end, remaining_chunks, remaining_chunks_mtx, share);
+            if (!in_flight.empty())
+                setBusy(share, remaining_chunks_mtx, false);
         }
     }
 }
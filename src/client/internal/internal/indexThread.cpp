@@ -0,0 +1,74 @@
+#include "client/internal/internal/indexThread.hpp"
+#include "networking/fileParsing.hpp"
+
+#include <iostream>
+
+namespace dfd {
+
+void scanThread(const std::filesystem::path& root, IndexJob& job) {
+    namespace fs = std::filesystem;
+
+    std::error_code ec;
+    fs::recursive_directory_iterator it(root, fs::directory_options::skip_permission_denied, ec);
+    fs::recursive_directory_iterator end;
+    while (!ec && it != end && !job.cancel) {
+        const fs::directory_entry& entry = *it;
+        std::error_code type_ec;
+        if (entry.is_regular_file(type_ec) && entry.path().extension() != ".dfdpart") {
+            {
+                std::lock_guard<std::mutex> lock(job.to_hash_mtx);
+                job.to_hash.push(entry.path());
+            }
+            job.scanned++;
+            job.path_ready.notify_one();
+        }
+
+        it.increment(ec);
+    }
+
+    if (ec)
+        std::cerr << "[err] Stopped scanning " << root << " early: " << ec.message() << std::endl;
+
+    {
+        std::lock_guard<std::mutex> lock(job.to_hash_mtx);
+        job.scan_done = true;
+    }
+    job.path_ready.notify_all();
+}
+
+void hashThread(IndexJob& job) {
+    while (!job.cancel) {
+        std::filesystem::path f_path;
+        {
+            std::unique_lock<std::mutex> lock(job.to_hash_mtx);
+            job.path_ready.wait(lock, [&] {
+                return !job.to_hash.empty() || job.scan_done || job.cancel;
+            });
+            if (job.to_hash.empty())
+                break; //scan done, or cancelled
+            f_path = std::move(job.to_hash.front());
+            job.to_hash.pop();
+        }
+
+        uint64_t f_uuid = fileUuid(f_path);
+        auto     f_size = fileSize(f_path);
+        if (f_uuid == 0 || !f_size) {
+            job.failed++;
+            continue;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(job.hashed_mtx);
+            job.hashed.push({f_path, FileId(f_uuid, job.my_listener, f_size.value())});
+        }
+        job.file_ready.notify_one();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(job.hashed_mtx);
+        job.hashers_running--;
+    }
+    job.file_ready.notify_all();
+}
+
+} //dfd
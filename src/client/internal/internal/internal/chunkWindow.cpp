@@ -0,0 +1,43 @@
+#include "client/internal/internal/internal/chunkWindow.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace dfd {
+
+void windowStart(ChunkWindow& window) {
+    window       = ChunkWindow();
+    window.since = std::chrono::steady_clock::now();
+}
+
+void windowReply(ChunkWindow&                                window,
+                 const size_t                                bytes,
+                 const size_t                                c_size,
+                 const std::chrono::steady_clock::time_point sent) {
+    auto   now = std::chrono::steady_clock::now();
+    double rtt = std::chrono::duration<double>(now - sent).count();
+    if (window.min_rtt == 0 || rtt < window.min_rtt)
+        window.min_rtt = rtt;
+
+    window.bytes += bytes;
+    if (++window.replies < window.size)
+        return;
+
+    double secs = std::chrono::duration<double>(now - window.since).count();
+    if (secs <= 0 || c_size == 0)
+        return; //wait for the clock to move
+
+    //enough chunks in the air to cover a round trip at this rate, and one more
+    //so the peer is never left waiting on us. at most double or halve per step
+    window.rate    = window.bytes / secs;
+    double covered = std::ceil(window.rate * window.min_rtt / c_size);
+    size_t target  = static_cast<size_t>(std::min(covered, static_cast<double>(DOWNLOAD_WINDOW_MAX))) + 1;
+    target         = std::clamp(target, std::max<size_t>(1, window.size / 2), window.size * 2);
+    window.size    = std::min<size_t>(target, DOWNLOAD_WINDOW_MAX);
+
+    window.since   = now;
+    window.bytes   = 0;
+    window.replies = 0;
+}
+
+} //dfd
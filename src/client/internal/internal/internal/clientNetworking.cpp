@@ -30,6 +30,13 @@ bool recvOkay(int                           sock,
               std::vector<uint8_t>&         buffer,
               const uint8_t                 expected_code,
               std::optional<struct timeval> timeout) {
+    return recvOkay(sock, buffer, {expected_code}, timeout);
+}
+
+bool recvOkay(int                            sock,
+              std::vector<uint8_t>&          buffer,
+              std::initializer_list<uint8_t> expected_codes,
+              std::optional<struct timeval>  timeout) {
     buffer.clear();
 
     struct timeval recv_timeout;
@@ -46,7 +53,10 @@ bool recvOkay(int                           sock,
         return false;
     }
 
-    return buffer[0] == expected_code;
+    for (uint8_t code : expected_codes)
+        if (buffer[0] == code)
+            return true;
+    return false;
 }
 
 int sendAndRecv(int                           sock_fd,
@@ -2,24 +2,23 @@
 #include "client/internal/internal/internal/clientNetworking.hpp"
 #include "networking/messageFormatting.hpp"
 #include "networking/socket.hpp"
+#include <filesystem>
 #include <iostream>
 #include <ostream>
 #include <vector>
 
 namespace dfd {
 
-int attemptDownloadHandshake(int            connected_sock,
-                             const uint64_t f_uuid,
-                             std::string&   f_name,
-                             uint64_t&      f_size,
-                             struct timeval response_timeout) {
-    std::vector<uint8_t> download_init = createDownloadInit(f_uuid, std::nullopt);
-    if (download_init.empty())
-        return EXIT_FAILURE;
-
+//sends an init message, DOWNLOAD_INIT or BUNDLE_INIT, and reads the confirm
+static int handshake(int                         connected_sock,
+                     const std::vector<uint8_t>& init_msg,
+                     std::string&                f_name,
+                     uint64_t&                   f_size,
+                     size_t&                     c_size,
+                     struct timeval              response_timeout) {
     std::vector<uint8_t> peer_response;
     int res = sendAndRecv(connected_sock,
-                          download_init,
+                          init_msg,
                           peer_response,
                           DOWNLOAD_CONFIRM,
                           response_timeout);
@@ -28,15 +27,62 @@ int attemptDownloadHandshake(int            connected_sock,
         return EXIT_FAILURE;
     }
     
-    auto [size, name] = parseDownloadConfirm(peer_response);
+    auto [size, chunk, name] = parseDownloadConfirm(peer_response);
     if (size == 0) {
         closeSocket(connected_sock);
         return EXIT_FAILURE;
     }
 
     f_size = size;
+    c_size = chunk;
     f_name = name;
     return EXIT_SUCCESS;
 }
 
+int attemptDownloadHandshake(int            connected_sock,
+                             const uint64_t f_uuid,
+                             const size_t   want_c_size,
+                             std::string&   f_name,
+                             uint64_t&      f_size,
+                             size_t&        c_size,
+                             struct timeval response_timeout) {
+    std::optional<size_t> ask;
+    if (want_c_size != 0)
+        ask = want_c_size;
+
+    std::vector<uint8_t> download_init = createDownloadInit(f_uuid, ask, supportedCodecs());
+    if (download_init.empty())
+        return EXIT_FAILURE;
+    if (EXIT_SUCCESS != handshake(connected_sock, download_init, f_name, f_size, c_size, response_timeout))
+        return EXIT_FAILURE;
+
+    //the peer picks the name, and it goes straight in the download directory
+    std::filesystem::path name(f_name);
+    if (name.empty() || name.has_root_path() || !name.has_filename() ||
+        std::distance(name.begin(), name.end()) != 1 ||
+        name == "." || name == "..") {
+        std::cerr << "[err] Peer sent a file name that isn't a plain file name, refusing it." << std::endl;
+        closeSocket(connected_sock);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+int attemptBundleHandshake(int            connected_sock,
+                           const uint64_t b_uuid,
+                           const size_t   want_c_size,
+                           std::string&   b_name,
+                           uint64_t&      m_size,
+                           size_t&        c_size,
+                           struct timeval response_timeout) {
+    std::optional<size_t> ask;
+    if (want_c_size != 0)
+        ask = want_c_size;
+
+    std::vector<uint8_t> bundle_init = createBundleInit(b_uuid, ask, supportedCodecs());
+    if (bundle_init.empty())
+        return EXIT_FAILURE;
+    return handshake(connected_sock, bundle_init, b_name, m_size, c_size, response_timeout);
+}
+
 } //dfd
@@ -0,0 +1,246 @@
+#include "client/internal/internal/internal/serverConnections.hpp"
+#include "client/internal/internal/internal/clientNetworking.hpp"
+#include "networking/socket.hpp"
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <poll.h>
+#include <string>
+
+namespace dfd {
+
+using Clock = std::chrono::steady_clock;
+
+//a connection waiting in the pool
+struct IdleConn {
+    int               fd;
+    Clock::time_point since;
+};
+
+//idle connections by server, most recently used last
+static std::map<std::pair<std::string, uint16_t>, std::vector<IdleConn>> idle_conns;
+static bool                                                              pool_closed = false;
+static std::mutex                                                        pool_mtx;
+
+//true if the server's hung up on a pooled connection, or sent something it
+//shouldn't have while it sat there
+static bool connectionDropped(int fd) {
+    struct pollfd pfd{fd, POLLIN, 0};
+    return poll(&pfd, 1, 0) != 0;
+}
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * takeConnection
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Takes the most recently used idle connection to a server from the pool,
+ *    closing any on the way that have gone stale. Connects if there are none.
+ *
+ * Takes:
+ * -> server:
+ *    The server.
+ * -> connection_timeout:
+ *    How long to attempt a connection for.
+ * -> reused:
+ *    Set if the connection came from the pool.
+ *
+ * Returns:
+ * -> On success:
+ *    The connected socket.
+ * -> On failure:
+ *    -1
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+static int takeConnection(const  SourceInfo& server,
+                          struct timeval     connection_timeout,
+                                 bool&       reused) {
+    std::vector<int> stale;
+    int              sock = -1;
+    {
+        std::lock_guard<std::mutex> lock(pool_mtx);
+        auto it = idle_conns.find({server.ip_addr, server.port});
+        Clock::time_point now = Clock::now();
+        while (it != idle_conns.end() && !it->second.empty() && sock < 0) {
+            IdleConn conn = it->second.back();
+            it->second.pop_back();
+            if (now - conn.since > std::chrono::milliseconds(SERVER_POOL_IDLE_MS) ||
+                connectionDropped(conn.fd))
+                stale.push_back(conn.fd);
+            else
+                sock = conn.fd;
+        }
+    }
+
+    for (int fd : stale)
+        closeSocket(fd);
+
+    reused = sock >= 0;
+    if (sock < 0)
+        sock = connectToSource(server, connection_timeout);
+    return sock;
+}
+
+//puts a connection with no replies owed back in the pool, or closes it if
+//the pool's full or closed
+static void giveConnection(const SourceInfo& server, int sock) {
+    {
+        std::lock_guard<std::mutex> lock(pool_mtx);
+        std::vector<IdleConn>& idle = idle_conns[{server.ip_addr, server.port}];
+        if (!pool_closed && idle.size() < SERVER_POOL_PER_SERVER) {
+            idle.push_back({sock, Clock::now()});
+            return;
+        }
+    }
+    closeSocket(sock);
+}
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * exchange
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Sends every request over sock, then reads the replies in order.
+ *
+ * Takes:
+ * -> sock:
+ *    The connection.
+ * -> requests, responses, msg_code, response_timeout:
+ *    See serverRequests().
+ * -> last:
+ *    Holds the last message read, the one that broke off the exchange if it
+ *    did. Empty if nothing was read.
+ * -> sent_any:
+ *    Set if any bytes of the requests went out.
+ *
+ * Returns:
+ * -> On success:
+ *    EXIT_SUCCESS, every request was answered and the connection's in step.
+ * -> On failure:
+ *    EXIT_FAILURE
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+static int exchange(       int                                sock,
+                    const  std::vector<std::vector<uint8_t>>& requests,
+                           std::vector<std::vector<uint8_t>>& responses,
+                    const  uint8_t                            msg_code,
+                    struct timeval                            response_timeout,
+                           std::vector<uint8_t>&              last,
+                           bool&                              sent_any) {
+    responses.clear();
+    last.clear();
+    sent_any = false;
+    for (const std::vector<uint8_t>& request : requests) {
+        size_t sent = 0;
+        int    res  = tcp::sendFramed(sock, {request}, &sent);
+        sent_any    = sent_any || sent > 0;
+        if (res != EXIT_SUCCESS)
+            return EXIT_FAILURE;
+    }
+
+    while (responses.size() < requests.size()) {
+        if (!recvOkay(sock, last, msg_code, response_timeout))
+            return EXIT_FAILURE;
+        responses.push_back(last);
+    }
+    return EXIT_SUCCESS;
+}
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * pooledExchange
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> exchange() over a pooled connection to server, tried once more on a new
+ *    connection if a reused one broke before any of the requests went out.
+ *    The connection goes back to the pool if every reply was read.
+ *
+ * Takes:
+ * -> See serverRequests() and exchange().
+ *
+ * Returns:
+ * -> See exchange().
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+static int pooledExchange(const  SourceInfo&                        server,
+                          const  std::vector<std::vector<uint8_t>>& requests,
+                                 std::vector<std::vector<uint8_t>>& responses,
+                          const  uint8_t                            msg_code,
+                          struct timeval                            connection_timeout,
+                          struct timeval                            response_timeout,
+                                 std::vector<uint8_t>&              last) {
+    responses.clear();
+    last.clear();
+    if (requests.empty())
+        return EXIT_SUCCESS;
+
+    bool reused;
+    int  sock = takeConnection(server, connection_timeout, reused);
+    if (sock < 0)
+        return EXIT_FAILURE;
+
+    bool sent_any;
+    int  res = exchange(sock, requests, responses, msg_code, response_timeout, last, sent_any);
+    if (res != EXIT_SUCCESS && reused && !sent_any) {
+        //the server hung up on it just as it was taken, and saw none of this
+        closeSocket(sock);
+        sock = connectToSource(server, connection_timeout);
+        if (sock < 0)
+            return EXIT_FAILURE;
+        res = exchange(sock, requests, responses, msg_code, response_timeout, last, sent_any);
+    }
+
+    if (res == EXIT_SUCCESS)
+        giveConnection(server, sock);
+    else
+        closeSocket(sock); //replies may still be coming, it's out of step
+    return res;
+}
+
+int serverRequests(const  SourceInfo&                        server,
+                   const  std::vector<std::vector<uint8_t>>& requests,
+                          std::vector<std::vector<uint8_t>>& responses,
+                          std::vector<uint8_t>&              last,
+                   const  uint8_t                            msg_code,
+                   struct timeval                            connection_timeout,
+                   struct timeval                            response_timeout) {
+    return pooledExchange(server,
+                          requests,
+                          responses,
+                          msg_code,
+                          connection_timeout,
+                          response_timeout,
+                          last);
+}
+
+int serverRequest(const  SourceInfo&           server,
+                  const  std::vector<uint8_t>& request,
+                         std::vector<uint8_t>& response,
+                  const  uint8_t               msg_code,
+                  struct timeval               connection_timeout,
+                  struct timeval               response_timeout) {
+    std::vector<std::vector<uint8_t>> responses;
+    return pooledExchange(server,
+                          {request},
+                          responses,
+                          msg_code,
+                          connection_timeout,
+                          response_timeout,
+                          response);
+}
+
+void closeServerConnections() {
+    std::map<std::pair<std::string, uint16_t>, std::vector<IdleConn>> closing;
+    {
+        std::lock_guard<std::mutex> lock(pool_mtx);
+        pool_closed = true;
+        closing.swap(idle_conns);
+    }
+
+    for (auto& [server, conns] : closing)
+        for (IdleConn& conn : conns)
+            closeSocket(conn.fd);
+}
+
+} //dfd
@@ -0,0 +1,576 @@
+#include "client/internal/internal/seedEngine.hpp"
+#include "client/internal/internal/seedThread.hpp"
+#include "networking/messageFormatting.hpp"
+#include "networking/socket.hpp"
+#include "sourceInfo.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace dfd {
+
+using Clock = std::chrono::steady_clock;
+
+//how often the loop checks its peers for timeouts, in ms. also how long
+//shutting down can take to be noticed
+#define SEED_TICK_MS 250
+
+//how long the loop stops accepting after running out of file descriptors, in
+//ms
+#define SEED_ACCEPT_BACKOFF_MS 100
+
+//requests a peer can have waiting before its socket stops being read. a
+//download session keeps at most DOWNLOAD_WINDOW_MAX outstanding
+#define SEED_QUEUED_REQUESTS 64
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * PeerConn
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> One peer downloading from us. session is the worker's while busy is set,
+ *    everything else is only touched by the loop.
+ *
+ * Member Variables:
+ * -> fd:
+ *    The peer's socket.
+ * -> session:
+ *    What the handshake agreed on.
+ * -> handshaken:
+ *    If the handshake is done. Until then the first request is the handshake.
+ * -> in:
+ *    The next request, as it arrives.
+ * -> out:
+ *    Replies and chunks, as they go.
+ * -> requests:
+ *    Requests not yet handed to a worker, in order.
+ * -> ranging:
+ *    If a range is being streamed.
+ * -> range_first:
+ *    The first chunk of the range, for matching SHRINK_RANGE.
+ * -> range_next:
+ *    The next chunk of the range to hand to a worker.
+ * -> range_end:
+ *    One past the range's last chunk.
+ * -> busy:
+ *    If a worker has the peer.
+ * -> busy_since:
+ *    When the worker was handed the peer's current job.
+ * -> finishing:
+ *    If the peer is closed once out is sent.
+ * -> closed:
+ *    If the socket's closed, and the peer only waits on its worker.
+ * -> watching_out:
+ *    If the loop is waiting for room to send on the socket.
+ * -> reading:
+ *    If the loop is reading the socket.
+ * -> last_active:
+ *    When the peer last sent something or took something sent.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+struct PeerConn {
+    int                              fd           = -1;
+    SeedSession                      session;
+    bool                             handshaken   = false;
+    FrameReader                      in;
+    FrameWriter                      out;
+    std::deque<std::vector<uint8_t>> requests;
+    bool                             ranging      = false;
+    size_t                           range_first  = 0;
+    size_t                           range_next   = 0;
+    size_t                           range_end    = 0;
+    bool                             busy         = false;
+    Clock::time_point                busy_since;
+    bool                             finishing    = false;
+    bool                             closed       = false;
+    bool                             watching_out = false;
+    bool                             reading      = true;
+    Clock::time_point                last_active;
+};
+
+enum class SeedWork {
+    HANDSHAKE, //request is the peer's first
+    REQUEST,   //request is anything after
+    CHUNK      //chunk is the next of a range
+};
+
+//a peer's next piece of work, for a worker
+struct SeedJob {
+    std::shared_ptr<PeerConn> peer;
+    SeedWork                  work  = SeedWork::REQUEST;
+    std::vector<uint8_t>      request;
+    size_t                    chunk = 0;
+};
+
+//what a worker made of a job, for the loop
+struct SeedDone {
+    std::shared_ptr<PeerConn>                peer;
+    SeedWork                                 work = SeedWork::REQUEST;
+    FrameWriter                              out;
+    bool                                     ok   = false;
+    std::optional<std::pair<size_t, size_t>> range;
+};
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * SeedLoop
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> The engine's state. peers is only touched by the loop, jobs and done are
+ *    shared with the workers under their mutexes.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+struct SeedLoop {
+    SeedLoop(const std::map<uint64_t, std::string>& files, std::mutex& files_mtx)
+        : indexed_files(files), indexed_files_mtx(files_mtx) {}
+
+    const std::map<uint64_t, std::string>&                 indexed_files;
+    std::mutex&                                            indexed_files_mtx;
+    int                                                    epoll_fd = -1;
+    int                                                    wake_fd  = -1;
+    std::unordered_map<int, std::shared_ptr<PeerConn>>     peers;
+
+    std::deque<SeedJob>                                    jobs;
+    bool                                                   stopping = false;
+    std::mutex                                             jobs_mtx;
+    std::condition_variable                                jobs_ready;
+
+    std::vector<SeedDone>                                  done;
+    std::mutex                                             done_mtx;
+};
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * seedWorker
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Designed to be opened as a thread. Does jobs off the loop's queue,
+ *    queueing the replies on a writer of their own, and hands them back to
+ *    the loop. Returns once the loop is stopping and the queue is empty.
+ *
+ * Takes:
+ * -> loop:
+ *    The engine.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+static void seedWorker(SeedLoop& loop) {
+    while (true) {
+        SeedJob job;
+        {
+            std::unique_lock<std::mutex> lock(loop.jobs_mtx);
+            loop.jobs_ready.wait(lock, [&loop]{ return !loop.jobs.empty() || loop.stopping; });
+            if (loop.jobs.empty())
+                return;
+            job = std::move(loop.jobs.front());
+            loop.jobs.pop_front();
+        }
+
+        SeedDone     res;
+        SeedSession& session = job.peer->session;
+        res.peer = job.peer;
+        res.work = job.work;
+        if (job.work == SeedWork::HANDSHAKE)
+            res.ok = EXIT_SUCCESS == seedHandshake(res.out,
+                                                   job.request,
+                                                   loop.indexed_files,
+                                                   loop.indexed_files_mtx,
+                                                   session);
+        else if (job.work == SeedWork::CHUNK)
+            res.ok = EXIT_SUCCESS == seedChunk(res.out, session, job.chunk);
+        else
+            res.ok = EXIT_SUCCESS == seedRequest(res.out,
+                                                 job.request,
+                                                 loop.indexed_files,
+                                                 loop.indexed_files_mtx,
+                                                 session,
+                                                 res.range);
+
+        {
+            std::lock_guard<std::mutex> lock(loop.done_mtx);
+            loop.done.push_back(std::move(res));
+        }
+        uint64_t one = 1;
+        ssize_t  wrote = write(loop.wake_fd, &one, sizeof(one));
+        (void)wrote; //only fails if the counter's full, and then it's awake anyway
+    }
+}
+
+static void dispatch(SeedLoop& loop, SeedJob&& job) {
+    job.peer->busy       = true;
+    job.peer->busy_since = Clock::now();
+    {
+        std::lock_guard<std::mutex> lock(loop.jobs_mtx);
+        loop.jobs.push_back(std::move(job));
+    }
+    loop.jobs_ready.notify_one();
+}
+
+static void closePeer(SeedLoop& loop, PeerConn& peer) {
+    if (peer.closed)
+        return;
+    peer.closed = true;
+    closeSocket(peer.fd); //leaves the epoll set with it
+    if (!peer.busy)
+        endSeedSession(peer.session); //otherwise once the worker's done with it
+    loop.peers.erase(peer.fd); //may be the last reference, peer goes with it
+}
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * flushPeer
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Sends what's queued for a peer, and sets what the loop waits on for it:
+ *    room to send if it didn't all go, and more requests unless it has
+ *    plenty waiting.
+ *
+ * Takes:
+ * -> loop:
+ *    The engine.
+ * -> peer:
+ *    The peer.
+ *
+ * Returns:
+ * -> true if the peer carries on, false if it was closed.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+static bool flushPeer(SeedLoop& loop, PeerConn& peer) {
+    size_t before = peer.out.queued;
+    int    res    = tcp::sendQueued(peer.fd, peer.out);
+    if (peer.out.queued != before)
+        peer.last_active = Clock::now();
+
+    if (res < 0 || (res == 1 && peer.finishing && !peer.busy)) {
+        closePeer(loop, peer);
+        return false;
+    }
+
+    bool want_out = res == 0;
+    bool want_in  = peer.requests.size() < SEED_QUEUED_REQUESTS;
+    if (want_out != peer.watching_out || want_in != peer.reading) {
+        struct epoll_event ev{};
+        ev.events  = (want_in ? EPOLLIN : 0u) | (want_out ? EPOLLOUT : 0u);
+        ev.data.fd = peer.fd;
+        epoll_ctl(loop.epoll_fd, EPOLL_CTL_MOD, peer.fd, &ev);
+        peer.watching_out = want_out;
+        peer.reading      = want_in;
+    }
+    return true;
+}
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * pumpPeer
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Hands a peer's next piece of work to a worker if it has none out and
+ *    isn't too far behind on sending: the next chunk of its range, or its
+ *    next request. Ends a range that's done with RANGE_END, then sends what's
+ *    queued.
+ *
+ * Takes:
+ * -> loop:
+ *    The engine.
+ * -> peer:
+ *    The peer.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+static void pumpPeer(SeedLoop& loop, PeerConn& peer) {
+    while (!peer.busy && !peer.finishing && peer.out.queued < SEED_SEND_AHEAD) {
+        if (peer.ranging) {
+            if (peer.range_next < peer.range_end) {
+                SeedJob job;
+                job.peer  = loop.peers.at(peer.fd);
+                job.work  = SeedWork::CHUNK;
+                job.chunk = peer.range_next++;
+                dispatch(loop, std::move(job));
+                break;
+            }
+
+            tcp::queueFrame(peer.out, createRangeEnd(peer.range_next));
+            peer.ranging = false;
+            continue;
+        }
+
+        if (peer.requests.empty())
+            break;
+
+        SeedJob job;
+        job.peer    = loop.peers.at(peer.fd);
+        job.work    = peer.handshaken ? SeedWork::REQUEST : SeedWork::HANDSHAKE;
+        job.request = std::move(peer.requests.front());
+        peer.requests.pop_front();
+        if (job.work == SeedWork::REQUEST && job.request[0] == SHRINK_RANGE)
+            continue; //came in after its range was done, RANGE_END already said so
+        dispatch(loop, std::move(job));
+        break;
+    }
+
+    flushPeer(loop, peer);
+}
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * readPeer
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Reads every request a peer has sent so far. A SHRINK_RANGE for the range
+ *    being streamed is applied straight away, anything else waits its turn.
+ *
+ * Takes:
+ * -> peer:
+ *    The peer.
+ *
+ * Returns:
+ * -> true if the peer carries on, false if it hung up or sent junk.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+static bool readPeer(PeerConn& peer) {
+    while (peer.requests.size() < SEED_QUEUED_REQUESTS) {
+        int res = tcp::recvFrame(peer.fd, peer.in, SEED_REQUEST_MAX);
+        if (res < 0)
+            return false;
+        if (res == 0)
+            return true;
+
+        peer.last_active = Clock::now();
+        if (peer.in.msg.empty())
+            return false;
+
+        if (peer.ranging && peer.in.msg[0] == SHRINK_RANGE) {
+            auto [shrink_first, shrink_end] = parseRangeShrink(peer.in.msg);
+            if (shrink_first == peer.range_first)
+                peer.range_end = std::clamp(shrink_end, peer.range_next, peer.range_end);
+            continue;
+        }
+        peer.requests.push_back(std::move(peer.in.msg));
+    }
+    return true;
+}
+
+//picks up what the workers have finished, and moves their peers along
+static void takeDone(SeedLoop& loop) {
+    uint64_t count;
+    ssize_t  res = read(loop.wake_fd, &count, sizeof(count));
+    (void)res;
+
+    std::vector<SeedDone> done;
+    {
+        std::lock_guard<std::mutex> lock(loop.done_mtx);
+        done.swap(loop.done);
+    }
+
+    for (SeedDone& res : done) {
+        PeerConn& peer = *res.peer;
+        peer.busy = false;
+        if (peer.closed) {
+            endSeedSession(peer.session);
+            continue;
+        }
+
+        for (QueuedFrame& frame : res.out.frames)
+            peer.out.frames.push_back(std::move(frame));
+        peer.out.queued += res.out.queued;
+
+        if (!res.ok) {
+            peer.finishing = true; //whatever it queued goes first, FAIL included
+        } else if (res.work == SeedWork::HANDSHAKE) {
+            peer.handshaken = true;
+        } else if (res.range) {
+            peer.ranging     = true;
+            peer.range_first = res.range->first;
+            peer.range_next  = res.range->first;
+            peer.range_end   = res.range->second;
+        }
+        pumpPeer(loop, peer);
+    }
+}
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * acceptPeers
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Accepts every peer waiting on the listener onto the loop.
+ *
+ * Takes:
+ * -> loop:
+ *    The engine.
+ * -> listener:
+ *    The non-blocking listening socket.
+ *
+ * Returns:
+ * -> true if the listener's drained, false if the process is out of file
+ *    descriptors and accepting should back off.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+static bool acceptPeers(SeedLoop& loop, int listener) {
+    while (true) {
+        SourceInfo client;
+        int peer_sock = tcp::accept(listener, client);
+        if (peer_sock < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            return errno != EMFILE && errno != ENFILE;
+        }
+
+        struct epoll_event ev{};
+        ev.events  = EPOLLIN;
+        ev.data.fd = peer_sock;
+        if (EXIT_SUCCESS != setBlocking(peer_sock, false) ||
+            epoll_ctl(loop.epoll_fd, EPOLL_CTL_ADD, peer_sock, &ev) < 0) {
+            closeSocket(peer_sock);
+            continue;
+        }
+
+        auto peer = std::make_shared<PeerConn>();
+        peer->fd          = peer_sock;
+        peer->last_active = Clock::now();
+        loop.peers[peer_sock] = std::move(peer);
+    }
+}
+
+//drops peers that have gone quiet, or stopped taking what's sent to them, or
+//whose worker has been stuck on them too long. a peer dropped while busy is
+//only closed, its worker still ends its session
+static void sweepPeers(SeedLoop& loop) {
+    Clock::time_point      now = Clock::now();
+    std::vector<PeerConn*> dead;
+    for (auto& [fd, peer] : loop.peers) {
+        if (peer->busy) {
+            //a worker's on it, the peer's waiting on us
+            if (now - peer->busy_since > std::chrono::milliseconds(SEND_STALL_MS))
+                dead.push_back(peer.get());
+            continue;
+        }
+
+        auto limit = std::chrono::milliseconds(peer->out.frames.empty() ? SEED_IDLE_MS
+                                                                        : SEND_STALL_MS);
+        if (now - peer->last_active > limit)
+            dead.push_back(peer.get());
+    }
+
+    for (PeerConn* peer : dead)
+        closePeer(loop, *peer);
+}
+
+void seedEngine(      std::atomic<bool>&               shutdown,
+                      int                              listener,
+                const std::map<uint64_t, std::string>& indexed_files,
+                      std::mutex&                      indexed_files_mtx) {
+    SeedLoop loop(indexed_files, indexed_files_mtx);
+    loop.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    loop.wake_fd  = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    struct epoll_event ev{};
+    bool opened = loop.epoll_fd >= 0 && loop.wake_fd >= 0 &&
+                  EXIT_SUCCESS == setBlocking(listener, false);
+    ev.events  = EPOLLIN;
+    ev.data.fd = listener;
+    opened = opened && epoll_ctl(loop.epoll_fd, EPOLL_CTL_ADD, listener, &ev) == 0;
+    ev.data.fd = loop.wake_fd;
+    opened = opened && epoll_ctl(loop.epoll_fd, EPOLL_CTL_ADD, loop.wake_fd, &ev) == 0;
+    if (!opened) {
+        std::cerr << "[err] Could not start seeding." << std::endl;
+        if (loop.epoll_fd >= 0) closeSocket(loop.epoll_fd);
+        if (loop.wake_fd  >= 0) closeSocket(loop.wake_fd);
+        return;
+    }
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < SEED_WORKER_THREADS; ++i)
+        workers.emplace_back(seedWorker, std::ref(loop));
+
+    std::array<struct epoll_event, 256> events;
+    std::optional<Clock::time_point>    accept_paused;
+    Clock::time_point                   next_sweep = Clock::now();
+    while (!shutdown.load()) {
+        int ready = epoll_wait(loop.epoll_fd, events.data(), events.size(), SEED_TICK_MS);
+        if (ready < 0 && errno != EINTR)
+            break;
+
+        for (int i = 0; i < ready; ++i) {
+            int      fd    = events[i].data.fd;
+            uint32_t flags = events[i].events;
+            if (fd == listener) {
+                if (!acceptPeers(loop, listener)) {
+                    //out of descriptors, the listener would just keep waking us
+                    epoll_ctl(loop.epoll_fd, EPOLL_CTL_DEL, listener, nullptr);
+                    accept_paused = Clock::now() + std::chrono::milliseconds(SEED_ACCEPT_BACKOFF_MS);
+                }
+                continue;
+            }
+
+            if (fd == loop.wake_fd) {
+                takeDone(loop);
+                continue;
+            }
+
+            auto it = loop.peers.find(fd);
+            if (it == loop.peers.end())
+                continue; //closed earlier in this batch
+
+            //held here so closing it doesn't pull it out from under us
+            std::shared_ptr<PeerConn> peer = it->second;
+            if ((flags & EPOLLIN) && !readPeer(*peer)) {
+                closePeer(loop, *peer);
+                continue;
+            }
+            if (flags & (EPOLLERR | EPOLLHUP)) {
+                closePeer(loop, *peer);
+                continue;
+            }
+            pumpPeer(loop, *peer);
+        }
+
+        Clock::time_point now = Clock::now();
+        if (accept_paused && now >= *accept_paused) {
+            struct epoll_event listen_ev{};
+            listen_ev.events  = EPOLLIN;
+            listen_ev.data.fd = listener;
+            epoll_ctl(loop.epoll_fd, EPOLL_CTL_ADD, listener, &listen_ev);
+            accept_paused.reset();
+        }
+
+        if (now >= next_sweep) {
+            sweepPeers(loop);
+            next_sweep = now + std::chrono::milliseconds(SEED_TICK_MS);
+        }
+    }
+
+    //close every peer, then let the workers finish what they have
+    std::vector<std::shared_ptr<PeerConn>> open;
+    for (auto& [fd, peer] : loop.peers)
+        open.push_back(peer);
+    for (auto& peer : open)
+        closePeer(loop, *peer);
+
+    {
+        std::lock_guard<std::mutex> lock(loop.jobs_mtx);
+        loop.stopping = true;
+    }
+    loop.jobs_ready.notify_all();
+    for (std::thread& t : workers)
+        t.join();
+
+    for (SeedDone& res : loop.done)
+        endSeedSession(res.peer->session);
+    loop.done.clear();
+
+    closeSocket(loop.epoll_fd);
+    closeSocket(loop.wake_fd);
+}
+
+} //dfd
@@ -1,12 +1,12 @@
 #include "client/internal/internal/seedThread.hpp"
-#include "client/internal/internal/internal/clientNetworking.hpp"
+#include "client/internal/internal/bundles.hpp"
+#include "networking/bufferPool.hpp"
 #include "networking/fileParsing.hpp"
 #include "networking/messageFormatting.hpp"
 #include "networking/socket.hpp"
+#include <algorithm>
 #include <iostream>
 #include <map>
-#include <thread>
-#include <unistd.h>
 
 namespace dfd {
 
@@ -15,149 +15,345 @@ namespace dfd {
  * errScenario
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  * Description:
- * -> Creates a FAIL message to send to the connected peer. Sends the message,
- *    then closes the socket. Returns EXIT_FAILURE to report as the exit code
- *    for the calling function.
+ * -> Queues a FAIL message for the connected peer. Returns EXIT_FAILURE to
+ *    report as the exit code for the calling function, so the session is
+ *    closed once the message is out.
  *
  * Takes:
  * -> msg:
  *    The error message to encapsulate in the FAIL message.
- * -> sock:
- *    The connected peer socket to close.
+ * -> out:
+ *    The peer's writer.
  *
  * Returns:
  * -> On success:
  *    EXIT_FAILURE
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  */
-int errScenario(const std::string& msg, int sock) {
-    std::vector<uint8_t> fail_msg = createFailMessage(msg);
-    sendOkay(sock, fail_msg);
-    closeSocket(sock);
+static int errScenario(const std::string& msg, FrameWriter& out) {
+    tcp::queueFrame(out, createFailMessage(msg));
     return EXIT_FAILURE;
 }
 
+int seedHandshake(      FrameWriter&                     out,
+                  const std::vector<uint8_t>&            init_msg,
+                  const std::map<uint64_t, std::string>& indexed_files,
+                        std::mutex&                      indexed_files_mtx,
+                        SeedSession&                     session) {
+    if (init_msg.empty() || (init_msg[0] != DOWNLOAD_INIT && init_msg[0] != BUNDLE_INIT))
+        return EXIT_FAILURE;
+
+    //check for valid request
+    auto [uuid, c_size, codecs] = parseDownloadInit(init_msg);
+    session.packer = openPacker(codecs);
+    if (init_msg[0] == BUNDLE_INIT) {
+        session.bundle = sharedBundle(uuid);
+        if (uuid == 0 || !session.bundle)
+            return EXIT_FAILURE;
+
+        //its files can be any size, so no picking one to suit them
+        session.c_size = std::clamp(c_size.value_or(getChunkSize()),
+                                    static_cast<size_t>(MIN_CHUNK_SIZE),
+                                    static_cast<size_t>(MAX_CHUNK_SIZE));
+
+        std::vector<uint8_t> confirm_msg = createDownloadConfirm(session.bundle->manifest.size(),
+                                                                 session.c_size,
+                                                                 session.bundle->name);
+        if (confirm_msg.empty())
+            return EXIT_FAILURE;
+        tcp::queueFrame(out, confirm_msg);
+        return EXIT_SUCCESS;
+    }
+
+    std::filesystem::path f_path;
+    {
+        //lock indexed files for the read
+        std::unique_lock<std::mutex> lock(indexed_files_mtx);
+        auto it = indexed_files.find(uuid);
+        if (uuid == 0 || it == indexed_files.end())
+            return EXIT_FAILURE;
+
+        f_path = indexed_files.at(uuid);
+    }
+    session.f_uuid = uuid;
+    
+    //find file
+    if (f_path.empty())
+        return errScenario("[err] Could not find file. Sorry.", out);
+
+    //one open/stat for the whole session, chunks are pread from the handle
+    session.file = openSeedFile(f_path);
+    auto f_size_opt = fileSize(session.file);
+    if (!f_size_opt.has_value())
+        return errScenario("[err] Could not determine file size. Sorry.", out);
+
+    //chunk size is this session's alone, other sessions keep theirs
+    if (c_size.has_value())
+        session.c_size = std::clamp(c_size.value(),
+                                    static_cast<size_t>(MIN_CHUNK_SIZE),
+                                    static_cast<size_t>(MAX_CHUNK_SIZE));
+    else
+        session.c_size = chunkSizeFor(f_size_opt.value());
+
+    //reply with confirmation to peer
+    std::vector<uint8_t> confirm_msg = createDownloadConfirm(f_size_opt.value(),
+                                                             session.c_size,
+                                                             f_path.filename());
+    if (confirm_msg.empty())
+        return EXIT_FAILURE;
+
+    if (SEED_PREFETCH)
+        session.prefetch = openPrefetcher(session.file, session.c_size);
+
+    tcp::queueFrame(out, confirm_msg);
+    return EXIT_SUCCESS;
+}
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * queueChunkRange
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Queues a chunk to be sent straight from the file behind its header, no
+ *    copy through our memory. The handle keeps the fd open until it's sent,
+ *    and is invalidated if the file's truncated before then.
+ *
+ * Takes:
+ * -> out:
+ *    The peer's writer.
+ * -> session:
+ *    The session, with the file to send from.
+ * -> chunk_id:
+ *    The chunk.
+ * -> header:
+ *    The chunk's DATA_CHUNK header.
+ *
+ * Returns:
+ * -> On success:
+ *    EXIT_SUCCESS
+ * -> On failure:
+ *    EXIT_FAILURE, the session can't go on.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+static int queueChunkRange(      FrameWriter&          out,
+                                 SeedSession&          session,
+                           const size_t                chunk_id,
+                           const std::vector<uint8_t>& header) {
+    auto range = chunkRange(session.file, chunk_id, session.c_size);
+    if (!range)
+        return errScenario("Sorry, file appears to be unavailable.", out);
+
+    std::shared_ptr<FileHandle> file = session.file;
+    FileRange                   sent = range.value();
+    tcp::queueFileFrame(out,
+                        header,
+                        range->fd,
+                        range->offset,
+                        range->len,
+                        [file, sent]{ rangeSent(file, sent); },
+                        [file]{ rangeShort(file); });
+    return EXIT_SUCCESS;
+}
+
+int seedChunk(FrameWriter& out, SeedSession& session, const size_t chunk_id) {
+    //the chunk's bytes go out behind this without being copied in
+    std::vector<uint8_t> header = createDataChunkHeader(chunk_id);
+    if (header.empty()) return EXIT_FAILURE;
+    bool pack = packNext(session.packer);
+
+    //guessed right, already in memory
+    PooledBuffer chunk = prefetchedChunk(session.prefetch, chunk_id);
+
+    bool send_range = ZERO_COPY_SEEDING && canSendRange(session.file);
+    if (!chunk && !pack && send_range)
+        return queueChunkRange(out, session, chunk_id, header);
+
+    if (!chunk) {
+        //read chunk. if the buffer pool is full it goes straight from the file
+        //unpacked, or waits a while for room
+        chunk = tryTakeBuffer(session.c_size);
+        if (!chunk && send_range)
+            return queueChunkRange(out, session, chunk_id, header);
+        if (!chunk)
+            chunk = takeBufferFor(session.c_size, SEED_BUFFER_WAIT_MS);
+        if (!chunk)
+            return errScenario("Sorry, too busy to send that right now.", out);
+
+        auto res = packageFileChunk(session.file, *chunk, chunk_id, session.c_size);
+        if (!res) {
+            //could not read file for some reason
+            return errScenario("Sorry, file appears to be unavailable.", out);
+        }
+        chunk->resize(res.value());
+    }
+
+    //send it compressed if that pays off
+    PooledBuffer packed = pack ? packChunk(session.packer, *chunk) : nullptr;
+    if (packed) {
+        header = createPackedChunkHeader(chunk_id, session.packer.codec, chunk->size());
+        if (header.empty())
+            return EXIT_FAILURE;
+        tcp::queueFrame(out, header, packed);
+        return EXIT_SUCCESS;
+    }
+
+    //send chunk, the buffer goes back to the pool once it's out
+    tcp::queueFrame(out, header, chunk);
+    return EXIT_SUCCESS;
+}
+
 /*
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
- * initHandshake
+ * checkRange
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  * Description:
- * -> Receives a DOWNLOAD_INIT message from the client, parses it, checks that
- *    we know where the file is, reads in the file size, and replies with a
- *    DOWNLOAD_CONFIRM message. If a failure occurs at any point in this
- *    handshake, the socket is closed, and an error is returned. If appropriate,
- *    a FAIL message is sent to the client with the reason for the error so they
- *    can deregister us as a peer hosting this file.
+ * -> Checks a range a peer asked for is within the session's file. If not,
+ *    the peer is sent a FAIL message.
  *
  * Takes:
- * -> peer_sock:
- *    The socket connected to the requesting peer.
+ * -> out:
+ *    The peer's writer.
+ * -> session:
+ *    The session, with the file to send from.
+ * -> end:
+ *    One past the range's last chunk.
+ *
+ * Returns:
+ * -> On success:
+ *    EXIT_SUCCESS
+ * -> On failure:
+ *    EXIT_FAILURE, the session can't go on.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+static int checkRange(FrameWriter& out, SeedSession& session, const size_t end) {
+    auto f_size   = fileSize(session.file);
+    auto f_chunks = f_size ? fileChunks(f_size.value(), session.c_size) : std::nullopt;
+    if (!f_chunks || end > f_chunks.value())
+        return errScenario("Sorry, range is past the end of the file.", out);
+    return EXIT_SUCCESS;
+}
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * switchFile
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Points a bundle session at one of the bundle's files, if it isn't
+ *    already. Files are only read ahead in single file sessions, a bundle's
+ *    requests jump between files.
+ *
+ * Takes:
+ * -> session:
+ *    The bundle session.
+ * -> f_uuid:
+ *    The file asked for.
  * -> indexed_files:
  *    A map of all files this client currently has indexed.
  * -> indexed_files_mtx:
  *    A mutex to lock when accessing the indexed_files map.
- * -> timeout:
- *    A timeout for all received messages.
- * -> f_path:
- *    The path to the indexed file on the disk.
  *
  * Returns:
  * -> On success:
  *    EXIT_SUCCESS
  * -> On failure:
- *    EXIT_FAILURE
+ *    EXIT_FAILURE, if it isn't in the bundle, or is no longer shared.
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  */
-int initHandshake(int                                     peer_sock,
-                  const  std::map<uint64_t, std::string>& indexed_files,
-                  std::mutex&                             indexed_files_mtx,
-                  struct timeval                          timeout,
-                  std::filesystem::path&                  f_path) {
-    // recieve client download init request
-    std::vector<uint8_t> client_init_msg;
-    if (!recvOkay(peer_sock, client_init_msg, DOWNLOAD_INIT, timeout)) {
-        closeSocket(peer_sock);
+static int switchFile(      SeedSession&                     session,
+                      const uint64_t                         f_uuid,
+                      const std::map<uint64_t, std::string>& indexed_files,
+                            std::mutex&                      indexed_files_mtx) {
+    if (session.file && session.f_uuid == f_uuid)
+        return EXIT_SUCCESS;
+    if (f_uuid == 0 || session.bundle->members.count(f_uuid) == 0)
         return EXIT_FAILURE;
-    }
 
-    //check for valid request
-    auto [uuid, c_size] = parseDownloadInit(client_init_msg);
+    std::filesystem::path f_path;
     {
-        //lock indexed files for the read
-        std::unique_lock<std::mutex> lock(indexed_files_mtx);
-        auto it = indexed_files.find(uuid);
-        if (uuid == 0 || it == indexed_files.end()) {
-            closeSocket(peer_sock);
+        std::lock_guard<std::mutex> lock(indexed_files_mtx);
+        auto it = indexed_files.find(f_uuid);
+        if (it == indexed_files.end() || it->second.empty())
             return EXIT_FAILURE;
-        }
-
-        f_path = indexed_files.at(uuid);
+        f_path = it->second;
     }
-    
-    //find file
-    if (f_path.empty())
-        return errScenario("[err] Could not find file. Sorry.", peer_sock);
-
-    //find file size & chunks
-    if (c_size.has_value()) setChunkSize(c_size.value());
 
-    auto f_size_opt = fileSize(f_path);
-    if (!f_size_opt.has_value())
-        return errScenario("[err] Could not determine file size. Sorry.", peer_sock);
+    session.file   = openSeedFile(f_path);
+    session.f_uuid = f_uuid;
+    if (!fileSize(session.file)) {
+        session.file = nullptr;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
 
-    //reply with confirmation to peer
-    std::vector<uint8_t> confirm_msg = createDownloadConfirm(f_size_opt.value(),
-                                                             f_path.filename());
+int seedRequest(      FrameWriter&                              out,
+                const std::vector<uint8_t>&                     request,
+                const std::map<uint64_t, std::string>&          indexed_files,
+                      std::mutex&                               indexed_files_mtx,
+                      SeedSession&                              session,
+                      std::optional<std::pair<size_t, size_t>>& range) {
+    range.reset();
+    if (request.empty())
+        return EXIT_FAILURE;
 
-    if (sendOkay(peer_sock, confirm_msg))
+    if (request[0] == REQUEST_RANGE && !session.bundle) {
+        auto [first, end] = parseRangeRequest(request);
+        if (first == SIZE_MAX) return EXIT_FAILURE;
+        if (EXIT_SUCCESS != checkRange(out, session, end)) return EXIT_FAILURE;
+        range = std::make_pair(first, end);
         return EXIT_SUCCESS;
-    closeSocket(peer_sock);
-    return EXIT_FAILURE;
-}
+    }
 
-void seedToPeer(std::atomic<bool>&                     shutdown,
-                int                                    peer_sock,
-                const std::map<uint64_t, std::string>& indexed_files,
-                std::mutex&                            indexed_files_mtx) {
-    struct timeval seed_timeout;
-    seed_timeout.tv_sec  = 3;
-    seed_timeout.tv_usec = 0;
-
-    //handshake with peer, send peer needed info
-    std::filesystem::path f_path; //set by handshake
-    if (EXIT_FAILURE == initHandshake(peer_sock,
-                                      indexed_files, 
-                                      indexed_files_mtx,
-                                      seed_timeout,
-                                      f_path)) {
-        return;
+    if (request[0] == MANIFEST_REQUEST && session.bundle) {
+        //the bundle's files, not a file's chunks. sent straight from the
+        //bundle, same as createBundleManifest() without the copy
+        std::shared_ptr<const std::vector<uint8_t>> manifest(session.bundle, &session.bundle->manifest);
+        tcp::queueFrame(out, {BUNDLE_MANIFEST}, manifest);
+        return EXIT_SUCCESS;
     }
 
-    //wait for peer chunk requests
-        std::vector<uint8_t> client_ask;
-    while (recvOkay(peer_sock, client_ask, REQUEST_CHUNK, seed_timeout)) {
-        size_t chunk_id = parseChunkRequest(client_ask); 
+    if (request[0] == MANIFEST_REQUEST) {
+        //only files we tree hashed have one, and only so many digests fit
+        auto digests = chunkManifest(session.f_uuid, session.c_size);
+        std::vector<uint8_t> reply;
+        if (digests)
+            reply = createManifest({session.c_size, digests.value()});
+        if (reply.empty())
+            reply = createFailMessage("No manifest for this file.");
+        if (reply.empty()) return EXIT_FAILURE;
+        tcp::queueFrame(out, reply);
+        return EXIT_SUCCESS;
+    }
 
-        //read chunk
-        std::vector<uint8_t> chunk;
-        auto res = packageFileChunk(f_path, chunk, chunk_id);
-        if (!res) {
-            //could not read file for some reason
-            std::vector<uint8_t> fail_msg = createFailMessage("Sorry, file appears to be unavailable.");
-            sendOkay(peer_sock, fail_msg);
-            break;
-        }
+    if (request[0] == SEGMENTS_REQUEST && !session.bundle) {
+        //for a downloader with a near copy of it. only what was cut when the
+        //file was hashed, cutting it here would hold a worker for the whole file
+        auto segments = segmentDigests(session.file);
+        std::vector<uint8_t> reply;
+        if (segments)
+            reply = createSegmentManifest(segments.value());
+        if (reply.empty())
+            reply = createFailMessage("No segments for this file.");
+        if (reply.empty()) return EXIT_FAILURE;
+        tcp::queueFrame(out, reply);
+        return EXIT_SUCCESS;
+    }
 
-        //send chunk
-        chunk.resize(res.value());
-        DataChunk dc = {chunk_id, chunk};
-        std::vector<uint8_t> chunk_msg = createDataChunk(dc);
-        // double X=((double)rand()/(double)RAND_MAX);
-        // std::this_thread::sleep_for(std::chrono::duration<double>(X)); //ARTIFICIAL DELAYS
-        if (!sendOkay(peer_sock, chunk_msg)) break;
+    if (request[0] == REQUEST_FILE_CHUNK && session.bundle) {
+        auto [f_uuid, chunk_id] = parseFileChunkRequest(request);
+        if (EXIT_SUCCESS != switchFile(session, f_uuid, indexed_files, indexed_files_mtx))
+            return errScenario("Sorry, file is no longer shared.", out);
+        return seedChunk(out, session, chunk_id);
     }
 
-    closeSocket(peer_sock); // Clean up the socket when done
+    if (request[0] != REQUEST_CHUNK || session.bundle) return EXIT_FAILURE; //FINISH_DOWNLOAD, or junk
+    size_t chunk_id = parseChunkRequest(request); 
+    return seedChunk(out, session, chunk_id);
+}
+
+void endSeedSession(SeedSession& session) {
+    endPrefetcher(session.prefetch);
+    session.file = nullptr;
 }
 
 } //dfd
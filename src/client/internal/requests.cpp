@@ -1,15 +1,20 @@
 #include "client/internal/requests.hpp"
 #include "client/internal/internal/attemptServerRequest.hpp"
 #include "client/internal/internal/attemptPeerRequest.hpp"
+#include "client/internal/internal/bundles.hpp"
+#include "client/internal/internal/bundleThread.hpp"
 #include "client/internal/internal/downloadThread.hpp"
+#include "client/internal/internal/indexThread.hpp"
 #include "networking/fileParsing.hpp"
 #include "networking/messageFormatting.hpp"
 #include "sourceInfo.hpp"
 
 #include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <condition_variable>
 #include <filesystem>
+#include <iomanip>
 #include <iostream>
 #include <mutex>
 #include <optional>
@@ -69,7 +74,7 @@ std::optional<FileId> parseFile(const SourceInfo&  my_listener,
         return std::nullopt;
     }
 
-    uint64_t f_uuid = sha256Hash(f_path);
+    uint64_t f_uuid = fileUuid(f_path);
     if (f_uuid == 0) {
         std::cerr << "[err] file uuid could not be computed." << std::endl;
         return std::nullopt;
@@ -156,6 +161,221 @@ bool doAttempts(std::vector<SourceInfo>& server_list,
     return success;
 }
 
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * registerFile
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Indexes one file of a directory. Goes straight to the server that took
+ *    the last file, then the rest of server_list once each, and only falls
+ *    back to doAttempts() with its list refresh and backoff if none of them
+ *    answer. Keeps a directory of small files from costing a server list
+ *    update per file. A server that answers but turns the file down speaks
+ *    for the rest, they're synced, so it isn't tried anywhere else.
+ *
+ * Takes:
+ * -> f_info:
+ *    The file to index.
+ * -> server_list:
+ *    The list of servers that client.cpp maintains.
+ * -> preferred:
+ *    Index in server_list of the server to try first. Set to the one that
+ *    answered.
+ * -> refused:
+ *    Set if a server turned the file down. Cleared otherwise.
+ *
+ * Returns:
+ * -> On success:
+ *    EXIT_SUCCESS
+ * -> On failure:
+ *    EXIT_FAILURE, if the file was refused or no server answered at all.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+static int registerFile(const FileId&                  f_info,
+                              std::vector<SourceInfo>& server_list,
+                              size_t&                  preferred,
+                              bool&                    refused) {
+    for (size_t i = 0; i < server_list.size(); ++i) {
+        size_t ind = (preferred + i) % server_list.size();
+        if (EXIT_SUCCESS == attemptIndex(f_info,
+                                         refused,
+                                         server_list[ind],
+                                         connection_timeout,
+                                         response_timeout)) {
+            preferred = ind;
+            return EXIT_SUCCESS;
+        }
+        if (refused) {
+            preferred = ind;
+            return EXIT_FAILURE;
+        }
+    }
+
+    preferred = 0;
+    return doAttempts(server_list, attemptIndex, f_info, refused) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * doIndexDirectory
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> doIndex() for a directory. Opens a scanThread() and up to
+ *    INDEX_HASH_THREADS hashThread()s, then registers files with the server in
+ *    batches of INDEX_BATCH_SIZE on this thread as they come out of the
+ *    hashers, printing progress after each batch. Scanning, hashing and
+ *    registering all overlap. Files a server turns down are counted as failed
+ *    and skipped. Stops early if no server answers.
+ *
+ * Takes:
+ * -> See doIndex().
+ *
+ * Returns:
+ * -> On success:
+ *    EXIT_SUCCESS, even if some files couldn't be hashed or were refused.
+ * -> On failure:
+ *    EXIT_FAILURE, if no server answered. Files registered before that stay
+ *    indexed.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+static int doIndexDirectory(const SourceInfo&                      my_listener,
+                            const std::filesystem::path&           dir_path,
+                                  std::map<uint64_t, std::string>& indexed_files,
+                                  std::mutex&                      indexed_files_mtx,
+                                  std::vector<SourceInfo>&         server_list) {
+    IndexJob job;
+    job.my_listener = my_listener;
+
+    size_t num_hashers  = std::min(static_cast<size_t>(std::max(1u, std::thread::hardware_concurrency())),
+                                   static_cast<size_t>(INDEX_HASH_THREADS));
+    job.hashers_running = num_hashers;
+
+    std::cout << "Indexing " << dir_path.string() << "..." << std::endl;
+
+    std::thread scanner(scanThread, std::filesystem::absolute(dir_path), std::ref(job));
+    std::vector<std::thread> hashers;
+    for (size_t i = 0; i < num_hashers; ++i)
+        hashers.emplace_back(hashThread, std::ref(job));
+
+    updateServerList(server_list);
+
+    std::vector<BundleMember> members;
+    std::filesystem::path     abs_dir      = std::filesystem::absolute(dir_path).lexically_normal();
+    auto   start        = std::chrono::steady_clock::now();
+    size_t indexed      = 0;
+    size_t preferred    = 0;
+    bool   servers_down = false;
+    while (!servers_down) {
+        std::vector<std::pair<std::filesystem::path, FileId>> batch;
+        {
+            std::unique_lock<std::mutex> lock(job.hashed_mtx);
+            job.file_ready.wait_for(lock, std::chrono::seconds(1), [&] {
+                return !job.hashed.empty() || job.hashers_running == 0;
+            });
+            while (!job.hashed.empty() && batch.size() < INDEX_BATCH_SIZE) {
+                batch.push_back(std::move(job.hashed.front()));
+                job.hashed.pop();
+            }
+            if (batch.empty() && job.hashers_running == 0)
+                break; //everything's through
+        }
+
+        //the whole batch goes to the last server that answered in one round
+        //trip, whatever it didn't take goes through registerFile()
+        std::vector<FileId> batch_info;
+        for (auto& [f_path, f_info] : batch) batch_info.push_back(f_info);
+
+        size_t answered = 0;
+        bool   refused  = false;
+        if (!server_list.empty())
+            attemptIndexBatch(batch_info,
+                              answered,
+                              refused,
+                              server_list[preferred % server_list.size()],
+                              connection_timeout,
+                              response_timeout);
+
+        for (size_t i = 0; i < batch.size(); ++i) {
+            auto& [f_path, f_info] = batch[i];
+            if (i == answered && refused) {
+                job.failed++; //the server answered it, and won't take it
+                continue;
+            }
+            if (i >= answered && EXIT_SUCCESS != registerFile(f_info, server_list, preferred, refused)) {
+                if (refused) {
+                    job.failed++;
+                    continue;
+                }
+                servers_down = true;
+                break;
+            }
+
+            std::lock_guard<std::mutex> lock(indexed_files_mtx);
+            indexed_files[f_info.uuid] = f_path.string();
+            indexed++;
+            members.push_back({f_info.uuid,
+                               f_info.f_size,
+                               f_path.lexically_relative(abs_dir).generic_string()});
+        }
+
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "\rIndexed " << indexed << "/" << job.scanned << " files found, "
+                  << job.failed << " failed, "
+                  << std::fixed << std::setprecision(1) << (secs > 0 ? indexed / secs : 0.0)
+                  << " files/s" << std::flush;
+    }
+
+    if (servers_down) {
+        //stop the other stages, they wait on to_hash_mtx
+        {
+            std::lock_guard<std::mutex> lock(job.to_hash_mtx);
+            job.cancel = true;
+        }
+        job.path_ready.notify_all();
+    }
+
+    scanner.join();
+    for (auto& h : hashers) h.join();
+    std::cout << std::endl;
+
+    if (servers_down) {
+        std::cerr << "[err] Sorry, tried all known servers twice, and received no response from any." << std::endl;
+        std::cerr << "[err] " << indexed << " files were indexed before that." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cout << indexed << " files from '" << dir_path.string() << "' are now indexed with the DFD network." << std::endl;
+    if (members.empty())
+        return EXIT_SUCCESS;
+
+    //the whole directory can also be fetched in one go, as a bundle named
+    //after it. sorted so the same tree always comes out to the same uuid
+    std::sort(members.begin(), members.end(), [](const BundleMember& a, const BundleMember& b) {
+        return a.name < b.name;
+    });
+
+    auto bundle = std::make_shared<Bundle>();
+    bundle->name     = abs_dir.has_filename() ? abs_dir.filename().string()
+                                              : abs_dir.parent_path().filename().string();
+    bundle->manifest = packBundle(members);
+    for (const auto& m : members) bundle->members.insert(m.uuid);
+
+    uint64_t b_uuid  = dataUuid(bundle->manifest.data(), bundle->manifest.size());
+    bool     refused = false;
+    if (bundle->manifest.empty() ||
+        EXIT_SUCCESS != registerFile(FileId(b_uuid, my_listener, bundle->manifest.size()),
+                                     server_list,
+                                     preferred,
+                                     refused)) {
+        std::cerr << "[err] Couldn't index the directory as a bundle, its files can still be downloaded one by one." << std::endl;
+        return EXIT_SUCCESS;
+    }
+
+    shareBundle(b_uuid, std::move(bundle));
+    std::cout << "Bundle: '" << b_uuid << "' downloads all of them." << std::endl;
+    return EXIT_SUCCESS;
+}
+
 int doIndex(const SourceInfo&                      my_listener,
             const std::string&                     file_path,
                   std::map<uint64_t, std::string>& indexed_files,
@@ -163,6 +383,14 @@ int doIndex(const SourceInfo&                      my_listener,
                   std::vector<SourceInfo>&         server_list) {
     if (!timeout_init) init_timeouts();
 
+    std::error_code ec;
+    if (std::filesystem::is_directory(file_path, ec))
+        return doIndexDirectory(my_listener,
+                                file_path,
+                                indexed_files,
+                                indexed_files_mtx,
+                                server_list);
+
     auto file = parseFile(my_listener, file_path);
     if (!file)
         return EXIT_FAILURE;
@@ -170,11 +398,15 @@ int doIndex(const SourceInfo&                      my_listener,
 
     std::cout << "Indexing..." << std::endl;
 
-    if (doAttempts(server_list, attemptIndex, f_info)) {
+    bool refused = false;
+    if (doAttempts(server_list, attemptIndex, f_info, refused)) {
         std::unique_lock<std::mutex> lock(indexed_files_mtx);
         indexed_files[f_info.uuid] = std::filesystem::absolute(file_path);
         std::cout << "File: '" << f_info.uuid << "' is now indexed with the DFD network." << std::endl;
         return EXIT_SUCCESS;
+    } else if (refused) {
+        std::cerr << "[err] The server turned the file down." << std::endl;
+        return EXIT_FAILURE;
     } else {
         std::cerr << "[err] Sorry, tried all known servers twice, and received no response from any." << std::endl;
         return EXIT_FAILURE;
@@ -202,6 +434,8 @@ int doDrop(const SourceInfo&                       my_listener,
     std::cout << "Dropping..." << std::endl;
 
     if (doAttempts(server_list, attemptDrop, drop_pair)) {
+        dropSeedFile(indexed_files[f_info.uuid]);
+        dropManifest(f_info.uuid);
         indexed_files[f_info.uuid].erase();
         std::cout << "File: '" << f_info.uuid << "' is now dropped from the DFD network." << std::endl;
         return EXIT_SUCCESS;
@@ -242,7 +476,7 @@ int doDownload(const uint64_t                 f_uuid,
     int peer_ind;
     std::string f_name;
     uint64_t    f_size;
-    std::unique_ptr<std::ofstream> file_out = nullptr;
+    std::shared_ptr<DownloadFile> file_out = nullptr;
     while ((peer_ind = selectPeerSource(f_stats)) >= 0) {
         const SourceInfo& server = f_sources[peer_ind];
         if (EXIT_SUCCESS == attemptInitialChunkDownload(f_uuid,
@@ -270,14 +504,18 @@ int doDownload(const uint64_t                 f_uuid,
         return EXIT_FAILURE;
     }
 
-    auto chunks_in_file_opt = fileChunks(f_size);
+    auto chunks_in_file_opt = fileChunks(f_size, downloadChunkSize(file_out));
     if (!chunks_in_file_opt) {
         std::cerr << "[err] Received erroneous file size." << std::endl;
+        closeDownloadFile(file_out, false);
         return EXIT_FAILURE;
     }
 
     size_t f_chunks = chunks_in_file_opt.value();
-    if (f_chunks > 1) {
+
+    //chunk 0 is always done by now, on a resume others may be too
+    std::vector<size_t> missing = missingChunks(file_out);
+    if (!missing.empty()) {
         std::queue<size_t> remaining_chunks;
         std::queue<size_t> done_chunks;
 
@@ -286,9 +524,14 @@ int doDownload(const uint64_t                 f_uuid,
         std::mutex f_stat_mtx;
         std::mutex bad_peers_mtx;
         std::condition_variable chunk_ready;
+        RangeShare              share;
 
         //build chunk list to download
-        for (size_t i = 1; i < f_chunks; ++i) remaining_chunks.push(i);
+        for (size_t c : missing) remaining_chunks.push(c);
+        size_t chunks_needed   = missing.size();
+        size_t chunks_previous = f_chunks - chunks_needed;
+        if (chunks_previous > 1)
+            std::cout << "Resuming, " << chunks_previous << "/" << f_chunks << " chunks already downloaded." << std::endl;
 
         //we want to select a number of concurrent download threads to use
         //we select the minimum of:
@@ -304,6 +547,7 @@ int doDownload(const uint64_t                 f_uuid,
         for (size_t i = 0; i < num_threads; ++i) {
             workers[i] = std::thread(downloadThread,
                                      f_uuid,
+                                     std::cref(file_out),
                                      std::cref(f_sources),
                                      std::ref(f_stats),
                                      std::ref(f_stat_mtx),
@@ -314,18 +558,20 @@ int doDownload(const uint64_t                 f_uuid,
                                      std::ref(done_chunks),
                                      std::ref(done_chunks_mtx),
                                      std::ref(chunk_ready),
+                                     std::ref(share),
                                      std::ref(connection_timeout),
                                      std::ref(response_timeout));
         }
 
-        bool   timed_out      = false;
-        size_t chunks_written = 0;
+        bool   timed_out         = false;
+        size_t chunks_written    = 0;
+        size_t last_checkpoint   = 0;
 
-        //construct chunks
+        //threads write chunks into place themselves, just track progress
         while (true) {
             std::stringstream download_stream;
             download_stream << "[";
-            double chunk_percentage = (double)chunks_written / (double)f_chunks;
+            double chunk_percentage = (double)(chunks_previous+chunks_written) / (double)f_chunks;
             double thresh = 80 * chunk_percentage;
             for (int i = 0; i < 80; i++) {
                 if (i < thresh) download_stream << "#";
@@ -340,16 +586,26 @@ int doDownload(const uint64_t                 f_uuid,
             });
 
             if (!notified) {
+                //chunks may just be held back waiting on their neighbours
+                dc_lock.unlock();
+                if (flushFileWrites(file_out) > 0)
+                    continue;
+
                 //all threads gave up
                 timed_out = true;
                 break;
             }
 
             while (!done_chunks.empty()) {
-                size_t c = done_chunks.front(); done_chunks.pop();
-                assembleChunk(file_out.get(), f_name, c);
+                done_chunks.pop();
                 chunks_written++;
             }
+            dc_lock.unlock();
+
+            if (chunks_written - last_checkpoint >= DOWNLOAD_CHECKPOINT_CHUNKS) {
+                checkpointDownloadFile(file_out);
+                last_checkpoint = chunks_written;
+            }
 
             {
                 std::unique_lock<std::mutex> rc_lock(remaining_chunks_mtx);
@@ -357,8 +613,9 @@ int doDownload(const uint64_t                 f_uuid,
             }
         }
 
-        //join all threads and clean up
+        //join all threads and clean up, writes they queued may still be landing
         for (auto& w : workers) w.join();
+        waitFileWrites(file_out);
 
         for (SourceInfo& faulty_client : bad_peers ) {
             std::cout << faulty_client.ip_addr << " " << faulty_client.port << std::endl; 
@@ -366,36 +623,297 @@ int doDownload(const uint64_t                 f_uuid,
                             attemptControl,
                             f_uuid,
                             faulty_client)) {
+                closeDownloadFile(file_out, false);
                 return EXIT_FAILURE;
             }
         }
 
         if (timed_out) {
             std::cerr << "[err] All peers have dropped out mid-download. Cannot continue, sorry." << std::endl;
+            closeDownloadFile(file_out, false);
             return EXIT_FAILURE;
         }
 
-        //any chunks that haven't been written yet
+        //any chunks written since we last checked
         while (!done_chunks.empty()) {
-            size_t c = done_chunks.front(); done_chunks.pop();
-            assembleChunk(file_out.get(), f_name, c);
+            done_chunks.pop();
             chunks_written++;
         }
 
         std::cout << "[################################################################################] 100%";
         std::cout << std::endl;
 
-        if (chunks_written != f_chunks-1) { //0th is already written
+        if (chunks_written != chunks_needed) {
             std::cerr << "[err] Some chunks were corrupted and no peers remain to re-request from. Sorry." << std::endl;
+            closeDownloadFile(file_out, false);
             return EXIT_FAILURE;
         }
+    }
 
-        //file ptr is still cleaned up when deallocated, even if saveFile not called.
+    //chunks were hashed on their way in, this only reads back what it must
+    auto bad_chunks = verifyDownloadFile(file_out);
+    if (!bad_chunks) {
+        std::cerr << "[err] Could not read the downloaded file back to verify it." << std::endl;
+        closeDownloadFile(file_out, false);
+        return EXIT_FAILURE;
     }
 
-    saveFile(std::move(file_out));
+    if (!bad_chunks->empty()) {
+        std::cerr << "[err] Downloaded file does not match the uuid requested. "
+                  << bad_chunks->size() << " chunks will be fetched again on the next attempt." << std::endl;
+        discardChunks(file_out, bad_chunks.value());
+        closeDownloadFile(file_out, false);
+        return EXIT_FAILURE;
+    }
+
+    closeDownloadFile(file_out, true);
     std::cout << "Downloaded file." << std::endl;
     return EXIT_SUCCESS;
 }
 
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * safeBundlePath
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Checks a name from a bundle's manifest stays inside the download
+ *    directory, so a peer can't write anywhere else with it.
+ *
+ * Takes:
+ * -> name:
+ *    The name, relative to the download directory.
+ *
+ * Returns:
+ * -> On success:
+ *    true
+ * -> On failure:
+ *    false, if it's empty, absolute, or steps up a directory.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+static bool safeBundlePath(const std::filesystem::path& name) {
+    if (name.empty() || name.has_root_path() || !name.has_filename())
+        return false;
+    for (const auto& part : name)
+        if (part == ".." || part == ".")
+            return false;
+    return true;
+}
+
+int doBundleDownload(const uint64_t                 b_uuid,
+                           std::vector<SourceInfo>& server_list) {
+    if (!timeout_init) init_timeouts();
+
+    std::cout << "Sourcing bundle..." << std::endl;
+
+    std::vector<SourceInfo> b_sources;
+    if (!doAttempts(server_list,
+                    attemptSourceRetrieval,
+                    b_uuid,
+                    b_sources)) {
+        std::cerr << "[err] Sorry, tried all known servers twice, and received no response from any." << std::endl;
+        std::cerr << "[err] Could not find any peers." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (b_sources.empty()) {
+        std::cerr << "[err] Server responded, but no sources available. Sorry." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    //the list of files, from whoever answers first
+    BundleJob   job;
+    std::string b_name;
+    job.b_uuid = b_uuid;
+    bool listed = false;
+    for (const SourceInfo& peer : b_sources) {
+        if (EXIT_SUCCESS == attemptBundleManifest(b_uuid,
+                                                  b_name,
+                                                  job.c_size,
+                                                  job.members,
+                                                  peer,
+                                                  connection_timeout,
+                                                  response_timeout)) {
+            listed = true;
+            break;
+        }
+        job.bad_peers.push_back(peer);
+    }
+
+    if (!listed) {
+        std::cerr << "[err] Exhausted peer list before a peer sent the bundle's files. Please try again later." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    //the manifest matched the uuid, but whoever made the bundle could still
+    //have put anything in it
+    std::filesystem::path b_dir(b_name);
+    bool safe = safeBundlePath(b_dir) && std::distance(b_dir.begin(), b_dir.end()) == 1;
+    for (const BundleMember& m : job.members)
+        safe = safe && safeBundlePath(m.name);
+    if (!safe) {
+        std::cerr << "[err] The bundle names files outside of its own directory, refusing to download it." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    size_t total = job.members.size();
+    job.files.resize(total);
+    job.unsent.resize(total);
+    job.unwritten.resize(total);
+
+    //files are opened a window at a time, their missing chunks all going on
+    //the one queue the sessions share
+    size_t next_file = 0;
+    size_t open      = 0;
+    size_t done      = 0;
+    size_t skipped   = 0;
+    size_t failed    = 0;
+    auto openMore = [&]() {
+        while (next_file < total && open < BUNDLE_OPEN_FILES) {
+            size_t              m      = next_file++;
+            const BundleMember& member = job.members[m];
+            std::string         f_name = (b_dir / member.name).string();
+
+            //names of files in a bundle have directories in them, checked
+            //by safeBundlePath() above
+            std::error_code ec;
+            std::filesystem::create_directories((getDownloadDir() / f_name).parent_path(), ec);
+
+            auto file = openDownloadFile(f_name, member.f_size, member.uuid, job.c_size);
+            if (file == nullptr) {
+                //most likely downloaded by an earlier attempt
+                if (std::filesystem::exists(getDownloadDir() / f_name, ec)) skipped++;
+                else                                                      failed++;
+                continue;
+            }
+            fillFromChunkStore(file);
+
+            std::vector<size_t> missing = missingChunks(file);
+            std::lock_guard<std::mutex> lock(job.mtx);
+            job.files[m]     = std::move(file);
+            job.unsent[m]    = missing.size();
+            job.unwritten[m] = missing.size();
+            for (size_t c : missing) job.queue.push_back({m, c});
+            if (missing.empty())
+                job.finished.push(m);
+            open++;
+        }
+        job.queued.notify_all();
+    };
+
+    openMore();
+
+    //a few long lived sessions, spread over the peers. with fewer peers than
+    //sessions some get more than one
+    size_t num_sessions = open > 0 ? BUNDLE_SESSIONS : 0;
+    job.sessions        = num_sessions;
+    std::vector<std::thread> sessions;
+    for (size_t i = 0; i < num_sessions; ++i)
+        sessions.emplace_back(bundleThread,
+                              std::ref(job),
+                              std::cref(b_sources[i % b_sources.size()]),
+                              connection_timeout,
+                              response_timeout);
+
+    bool stalled = false;
+    while (done + skipped + failed < total) {
+        std::cout << "\rDownloaded " << done << "/" << total << " files" << std::flush;
+
+        std::queue<size_t> ready;
+        bool               notified;
+        size_t             live;
+        {
+            std::unique_lock<std::mutex> lock(job.mtx);
+            notified = job.progress.wait_for(lock, std::chrono::seconds(10), [&] {
+                return !job.finished.empty() || job.sessions == 0;
+            });
+            std::swap(ready, job.finished);
+            live = job.sessions;
+        }
+
+        if (ready.empty()) {
+            if (live == 0) {
+                stalled = true; //every session gave up
+                break;
+            }
+
+            //chunks may just be held back waiting on their neighbours
+            size_t flushed = 0;
+            if (!notified) {
+                for (size_t m = 0; m < next_file; ++m) {
+                    std::shared_ptr<DownloadFile> file;
+                    {
+                        std::lock_guard<std::mutex> lock(job.mtx);
+                        file = job.files[m];
+                    }
+                    if (file) flushed += flushFileWrites(file);
+                }
+                if (flushed == 0) {
+                    stalled = true;
+                    break;
+                }
+            }
+            continue;
+        }
+
+        //every chunk of these is written, check them against their uuids
+        for (; !ready.empty(); ready.pop()) {
+            std::shared_ptr<DownloadFile> file;
+            {
+                std::lock_guard<std::mutex> lock(job.mtx);
+                file = std::move(job.files[ready.front()]);
+            }
+            open--;
+
+            auto bad_chunks = verifyDownloadFile(file);
+            if (bad_chunks && bad_chunks->empty()) {
+                closeDownloadFile(file, true);
+                done++;
+                continue;
+            }
+
+            if (bad_chunks)
+                discardChunks(file, bad_chunks.value());
+            closeDownloadFile(file, false);
+            failed++;
+        }
+
+        openMore();
+    }
+    std::cout << "\rDownloaded " << done << "/" << total << " files" << std::endl;
+
+    //let idle sessions go, anything still open keeps what it has for a resume
+    {
+        std::lock_guard<std::mutex> lock(job.mtx);
+        job.closing = true;
+    }
+    job.queued.notify_all();
+    for (auto& s : sessions) s.join();
+
+    for (size_t m = 0; m < total; ++m) {
+        if (job.files[m] == nullptr)
+            continue;
+        waitFileWrites(job.files[m]);
+        closeDownloadFile(job.files[m], false);
+        failed++;
+    }
+
+    for (SourceInfo& faulty_client : job.bad_peers) {
+        std::cout << faulty_client.ip_addr << " " << faulty_client.port << std::endl;
+        doAttempts(server_list, attemptControl, b_uuid, faulty_client);
+    }
+
+    if (stalled)
+        std::cerr << "[err] All peers have dropped out mid-download. Cannot continue, sorry." << std::endl;
+    if (skipped > 0)
+        std::cout << skipped << " files were already in '" << b_name << "', and were skipped." << std::endl;
+    if (failed > 0 || done + skipped < total) {
+        std::cerr << "[err] " << total - done - skipped << " files of the bundle couldn't be downloaded. "
+                  << "Downloading it again only fetches what's missing." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "Downloaded bundle '" << b_name << "'." << std::endl;
+    return EXIT_SUCCESS;
+}
+
 } //dfd
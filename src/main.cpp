@@ -14,6 +14,8 @@ static std::string download_dir = "";
 static uint64_t    my_uuid      = 0;
 static std::string ip_addr = "";
 static std::string listen_addr;
+static std::string hash_scheme  = "sha256";
+static bool        dedup        = false;
 
 //server-specific
 static std::string connect_ip;
@@ -76,7 +78,19 @@ bool isServer(int argc, char **argv) {
                 download_dir = argv[i+1];
         }
 
-        
+        //uuid scheme for indexed files
+        if (std::string(argv[i]) == "--hash") {
+            if (i+1 < argc)
+                hash_scheme = argv[i+1];
+            if (hash_scheme != "sha256" && hash_scheme != "tree") {
+                std::cerr << "USAGE: --hash <sha256|tree>" << std::endl;
+                exit(-1);
+            }
+        }
+
+        //reuse chunks of local files in downloads
+        if (std::string(argv[i]) == "--dedup")
+            dedup = true;
     }
 
     //check what we got
@@ -145,6 +159,6 @@ int main(int argc, char** argv) {
     }
 
     //else client
-    dfd::run_client(ip_addr, port, download_dir, listen_addr);
+    dfd::run_client(ip_addr, port, download_dir, listen_addr, hash_scheme, dedup);
     return 0;
 }
@@ -0,0 +1,163 @@
+#include "networking/bufferPool.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <sys/mman.h>
+
+namespace dfd {
+
+//returned buffers by size class, and what's charged against the ceiling.
+//buffers are charged by capacity, whatever class they were taken as
+static std::mutex                                       pool_mtx;
+static std::condition_variable                          pool_returned;
+static std::map<int, std::vector<std::vector<uint8_t>>> idle_buffs;
+static BufferPoolStats                                  pool_stats;
+
+static size_t classCap(const int k) {
+    return (size_t(1) << k) + BUFFER_POOL_SLACK;
+}
+
+//smallest class len fits in
+static int classFor(const size_t len) {
+    int k = 0;
+    while ((size_t(1) << k) < BUFFER_POOL_MIN_CLASS)
+        ++k;
+    while (classCap(k) < len)
+        ++k;
+    return k;
+}
+
+//largest class a buffer with this capacity can serve, -1 if none
+static int classOf(const size_t capacity) {
+    int k = classFor(0);
+    if (capacity < classCap(k))
+        return -1;
+    while (classCap(k+1) <= capacity)
+        ++k;
+    return k;
+}
+
+static void hugePages(std::vector<uint8_t>& buff) {
+    if (!BUFFER_POOL_HUGE_PAGES)
+        return;
+
+    //only whole huge pages inside the buffer can be backed by one
+    const uintptr_t huge  = 2 << 20;
+    uintptr_t       start = reinterpret_cast<uintptr_t>(buff.data());
+    uintptr_t       end   = start + buff.capacity();
+    uintptr_t       first = (start + huge - 1) & ~(huge - 1);
+    uintptr_t       last  = end & ~(huge - 1);
+    if (last > first)
+        madvise(reinterpret_cast<void*>(first), last - first, MADV_HUGEPAGE);
+}
+
+//deleter of every PooledBuffer
+static void giveBack(std::vector<uint8_t>* buff, const size_t charged) {
+    {
+        std::lock_guard<std::mutex> lock(pool_mtx);
+        pool_stats.used_bytes -= charged;
+
+        //keep it if there's room, it may have been swapped for another buffer
+        //so file it by what it holds now
+        size_t cap = buff->capacity();
+        int    k   = classOf(cap);
+        if (k >= 0 && pool_stats.idle_bytes + cap <= BUFFER_POOL_IDLE_BYTES
+                   && pool_stats.used_bytes + pool_stats.idle_bytes + cap <= BUFFER_POOL_MAX_BYTES) {
+            idle_buffs[k].push_back(std::move(*buff));
+            pool_stats.idle_bytes += cap;
+        }
+    }
+
+    pool_returned.notify_all();
+    delete buff;
+}
+
+//waits for room if wait is set, until deadline if there is one
+static PooledBuffer take(const size_t                                            len,
+                               bool                                              wait,
+                         const std::optional<std::chrono::steady_clock::time_point> deadline) {
+    int    k   = classFor(len);
+    size_t cap = classCap(k);
+
+    std::vector<uint8_t>              buff;
+    std::vector<std::vector<uint8_t>> freed; //deallocated once unlocked
+    bool                              waited = false;
+    std::unique_lock<std::mutex>      lock(pool_mtx);
+    while (true) {
+        //reuse one of the same class
+        auto it = idle_buffs.find(k);
+        if (it != idle_buffs.end() && !it->second.empty()) {
+            buff = std::move(it->second.back());
+            it->second.pop_back();
+            pool_stats.idle_bytes -= buff.capacity();
+            pool_stats.reused++;
+            break;
+        }
+
+        //free idle buffers of other classes to make room, biggest first
+        while (pool_stats.used_bytes + pool_stats.idle_bytes + cap > BUFFER_POOL_MAX_BYTES
+               && pool_stats.idle_bytes > 0) {
+            auto last = std::prev(idle_buffs.end());
+            if (last->second.empty()) {
+                idle_buffs.erase(last);
+                continue;
+            }
+
+            pool_stats.idle_bytes -= last->second.back().capacity();
+            freed.push_back(std::move(last->second.back()));
+            last->second.pop_back();
+        }
+
+        if (pool_stats.used_bytes == 0 || pool_stats.used_bytes + cap <= BUFFER_POOL_MAX_BYTES) {
+            pool_stats.allocated++;
+            break;
+        }
+
+        if (!wait)
+            return nullptr;
+        if (!waited)
+            pool_stats.waits++;
+        waited = true;
+        if (!deadline)
+            pool_returned.wait(lock);
+        else if (pool_returned.wait_until(lock, *deadline) == std::cv_status::timeout)
+            wait = false; //one last look for room, then give up
+    }
+
+    size_t charged = buff.capacity() > 0 ? buff.capacity() : cap;
+    pool_stats.used_bytes += charged;
+    lock.unlock();
+
+    if (buff.capacity() == 0) {
+        buff.reserve(cap);
+        hugePages(buff);
+    }
+
+    buff.resize(len);
+    return PooledBuffer(new std::vector<uint8_t>(std::move(buff)),
+                        [charged](std::vector<uint8_t>* b) { giveBack(b, charged); });
+}
+
+PooledBuffer takeBuffer(const size_t len) {
+    return take(len, true, std::nullopt);
+}
+
+PooledBuffer tryTakeBuffer(const size_t len) {
+    return take(len, false, std::nullopt);
+}
+
+PooledBuffer takeBufferFor(const size_t len, const int timeout_ms) {
+    return take(len, true, std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms));
+}
+
+BufferPoolStats bufferPoolStats() {
+    std::lock_guard<std::mutex> lock(pool_mtx);
+    return pool_stats;
+}
+
+} //dfd
@@ -1,11 +1,29 @@
 #include "networking/fileParsing.hpp"
+#include "networking/internal/fileParsing/chunkStore.hpp"
+#include "networking/internal/fileParsing/contentChunks.hpp"
 #include "networking/internal/fileParsing/fileUtil.hpp"
+#include "networking/internal/fileParsing/fileCache.hpp"
+#include "networking/internal/fileParsing/downloadFile.hpp"
+#include "networking/internal/fileParsing/hashCache.hpp"
+#include "networking/internal/fileParsing/ioEngine.hpp"
+#include "networking/internal/fileParsing/prefetch.hpp"
+#include "networking/internal/fileParsing/seedPolicy.hpp"
+#include "networking/internal/fileParsing/streamVerify.hpp"
+#include "networking/internal/fileParsing/treeHash.hpp"
+#include "networking/internal/fileParsing/writeBehind.hpp"
 #include "networking/internal/messageFormatting/byteOrdering.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
 #include <cstdlib>
 #include <cstring>
 #include <filesystem>
+#include <map>
+#include <mutex>
 #include <openssl/evp.h>
+#include <thread>
+#include <unistd.h>
 
 namespace dfd {
 
@@ -27,6 +45,19 @@ std::filesystem::path initDownloadDir() {
 //DEFAULT: 1Mib, or 1024*1024 bytes.
 static size_t chunk_size = 1 << 20;
 static std::filesystem::path download_path = initDownloadDir(); 
+static uint8_t               hash_scheme   = HASH_SHA256;
+
+//files modified this recently before being hashed aren't cached
+static constexpr int64_t HASH_CACHE_RACY_NS = 2000000000;
+
+//leaf digests of every file hashed with the tree hash, by uuid
+static std::mutex                               manifest_mtx;
+static std::map<uint64_t, std::vector<Digest>> tree_leaves;
+
+//whether local files are kept in the chunk store, and what it's saved
+static bool                  chunk_store  = false;
+static std::atomic<uint64_t> store_chunks = 0;
+static std::atomic<uint64_t> store_bytes  = 0;
 
 int setDownloadDir(const std::filesystem::path& f_path) {
     if (!std::filesystem::exists(f_path)) {
@@ -52,6 +83,18 @@ void setChunkSize(const size_t size) {
         chunk_size = size;
 }
 
+size_t getChunkSize() {
+    return chunk_size;
+}
+
+size_t chunkSizeFor(const uint64_t f_size) {
+    if (f_size < (uint64_t(1) << 26))
+        return 1 << 18; //under 64MiB, 256KiB
+    if (f_size < (uint64_t(1) << 32))
+        return 1 << 20; //under 4GiB, 1MiB
+    return 1 << 22;     //4MiB
+}
+
 std::optional<ssize_t> fileSize(const std::filesystem::path& f_path) {
     ssize_t size = bytesInFile(f_path);
     if (size < 0)
@@ -59,16 +102,17 @@ std::optional<ssize_t> fileSize(const std::filesystem::path& f_path) {
     return size;
 }
 
-std::optional<size_t> fileChunks(const ssize_t f_size) {
-    if (chunk_size < 1 || f_size < 1)
+std::optional<size_t> fileChunks(const ssize_t f_size, const size_t c_size) {
+    if (c_size < 1 || f_size < 1)
         return std::nullopt;
     
-    return std::ceil(double(f_size) / double(chunk_size));
+    return (static_cast<size_t>(f_size) + c_size - 1) / c_size;
 }
 
 std::optional<ssize_t> packageFileChunk(const std::filesystem::path& f_path, 
                                               std::vector<uint8_t>&  buff, 
-                                        const size_t                 chunk) {
+                                        const size_t                 chunk,
+                                        const size_t                 c_size) {
     auto f_size = fileSize(f_path);  
     if (!f_size)
         return std::nullopt; //can't find file
@@ -76,17 +120,17 @@ std::optional<ssize_t> packageFileChunk(const std::filesystem::path& f_path,
     if (f_size.value() == 0 && chunk == 0)
         return 0; //empty file
 
-    auto f_chunks = fileChunks(f_size.value());
+    auto f_chunks = fileChunks(f_size.value(), c_size);
     if (!f_chunks)
         return std::nullopt; //shouldn't happen
 
     if (chunk > f_chunks.value()-1)
         return std::nullopt; //reading past EOF
     
-    size_t offset = chunk*chunk_size;
-    auto read_bytes = readFile(f_path, chunk_size, offset, buff);
+    size_t offset = chunk*c_size;
+    auto read_bytes = readFile(f_path, c_size, offset, buff);
     if (read_bytes) {
-        if (read_bytes.value() <= chunk_size &&
+        if (static_cast<size_t>(read_bytes.value()) <= c_size &&
             read_bytes.value() >= 0)
             return read_bytes.value();
     }
@@ -94,6 +138,104 @@ std::optional<ssize_t> packageFileChunk(const std::filesystem::path& f_path,
     return std::nullopt;
 }
 
+std::shared_ptr<FileHandle> openSeedFile(const std::filesystem::path& f_path) {
+    auto file = cacheAcquire(f_path);
+    if (file)
+        chooseSeedPolicy(*file);
+    return file;
+}
+
+void dropSeedFile(const std::filesystem::path& f_path) {
+    cacheInvalidate(f_path);
+}
+
+std::optional<ssize_t> fileSize(const std::shared_ptr<FileHandle>& file) {
+    if (!file || !file->valid)
+        return std::nullopt;
+    return file->f_size;
+}
+
+std::optional<FileRange> chunkRange(const std::shared_ptr<FileHandle>& file,
+                                    const size_t                       chunk,
+                                    const size_t                       c_size) {
+    if (!file || !file->valid || c_size == 0)
+        return std::nullopt;
+
+    if (file->f_size == 0 && chunk == 0)
+        return FileRange{file->fd, 0, 0}; //empty file
+
+    //handle is shared between sessions with different chunk sizes, so this is
+    //worked out fresh every time
+    size_t f_size = static_cast<size_t>(file->f_size);
+    if (chunk >= (f_size + c_size - 1) / c_size)
+        return std::nullopt; //reading past EOF
+
+    size_t offset = chunk*c_size;
+    size_t len    = std::min(c_size, f_size - offset);
+    seedReadahead(*file, static_cast<off_t>(offset), len);
+    return FileRange{file->fd, static_cast<off_t>(offset), len};
+}
+
+bool canSendRange(const std::shared_ptr<FileHandle>& file) {
+    return file && file->policy != SEED_DIRECT;
+}
+
+void rangeSent(const std::shared_ptr<FileHandle>& file, const FileRange& range) {
+    if (file)
+        seedServed(*file, range.offset, range.len);
+}
+
+void rangeShort(const std::shared_ptr<FileHandle>& file) {
+    if (file)
+        file->valid = false; //stop serving it
+}
+
+std::shared_ptr<SeedPrefetcher> openPrefetcher(const std::shared_ptr<FileHandle>& file,
+                                               const size_t                       c_size) {
+    return createPrefetcher(file, c_size);
+}
+
+PooledBuffer prefetchedChunk(const std::shared_ptr<SeedPrefetcher>& p,
+                             const size_t                           chunk) {
+    return takePrefetched(p, chunk);
+}
+
+void endPrefetcher(std::shared_ptr<SeedPrefetcher>& p) {
+    closePrefetcher(p);
+}
+
+PrefetchStats prefetchStats() {
+    return prefetchTotals();
+}
+
+std::optional<ssize_t> packageFileChunk(const std::shared_ptr<FileHandle>& file,
+                                              std::vector<uint8_t>&        buff,
+                                        const size_t                       chunk,
+                                        const size_t                       c_size) {
+    auto range = chunkRange(file, chunk, c_size);
+    if (!range)
+        return std::nullopt;
+
+    if (range->len == 0) {
+        buff.clear();
+        return 0; //empty file
+    }
+
+    auto read_bytes = file->policy == SEED_DIRECT ? readDirect(*file, range->len, range->offset, buff)
+                                                  : readFileAt(range->fd, range->len, range->offset, buff);
+    if (!read_bytes)
+        return std::nullopt;
+    seedServed(*file, range->offset, range->len); //it's in buff now
+
+    if (static_cast<size_t>(read_bytes.value()) != range->len) {
+        //file was truncated since it was opened, stop serving it
+        file->valid = false;
+        return std::nullopt;
+    }
+
+    return read_bytes.value();
+}
+
 /*
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  * filePath
@@ -119,6 +261,213 @@ std::filesystem::path filePath(const std::string& f_name,
     return std::filesystem::path(download_path / c_name);
 }
 
+std::shared_ptr<DownloadFile> openDownloadFile(const std::string& f_name,
+                                               const uint64_t     f_size,
+                                               const uint64_t     uuid,
+                                               const size_t       c_size) {
+    if (!std::filesystem::exists(download_path) ||
+        !std::filesystem::is_directory(download_path))
+        if (EXIT_SUCCESS != setDownloadDir(download_path))
+            return nullptr;
+
+    std::filesystem::path f_path = filePath(f_name, 0, false);
+
+    //pick up where an earlier attempt left off if it was this same file
+    auto file = resumeDownloadFile(f_path, f_size, uuid, c_size);
+    if (file)
+        return file;
+
+    //a sidecar with nothing to resume into is just left over, clear it
+    if (!std::filesystem::exists(f_path))
+        std::filesystem::remove(partPath(f_path));
+
+    return createDownloadFile(f_path, f_size, uuid, c_size);
+}
+
+std::optional<size_t> partialChunkSize(const std::string& f_name,
+                                       const uint64_t     f_size,
+                                       const uint64_t     uuid) {
+    return sidecarChunkSize(filePath(f_name, 0, false), f_size, uuid);
+}
+
+size_t downloadChunkSize(const std::shared_ptr<DownloadFile>& file) {
+    if (!file)
+        return 0;
+    return file->c_size;
+}
+
+std::vector<size_t> missingChunks(const std::shared_ptr<DownloadFile>& file) {
+    std::vector<size_t> missing;
+    if (!file)
+        return missing;
+
+    for (size_t i = 0; i < file->f_chunks; ++i)
+        if (!hasChunk(*file, i))
+            missing.push_back(i);
+    return missing;
+}
+
+int writeFileChunk(const std::shared_ptr<DownloadFile>& file,
+                   const std::vector<uint8_t>&          buff,
+                   const size_t                         data_len,
+                   const size_t                         chunk) {
+    if (!file || chunk >= file->f_chunks)
+        return EXIT_FAILURE;
+
+    size_t offset   = chunk*file->c_size;
+    size_t expected = std::min(file->c_size, static_cast<size_t>(file->f_size) - offset);
+    if (data_len != expected)
+        return EXIT_FAILURE;
+
+    streamChunk(*file, chunk, buff.data(), data_len, nullptr);
+    if (EXIT_SUCCESS != writeFileAt(file->fd, buff, data_len, offset))
+        return EXIT_FAILURE;
+
+    markChunk(*file, chunk);
+    return EXIT_SUCCESS;
+}
+
+int writeFileChunkAsync(const std::shared_ptr<DownloadFile>& file,
+                              std::vector<uint8_t>&&         buff,
+                        const size_t                         chunk,
+                              std::function<void(int)>       done) {
+    //the stage owns the buffer until it's written
+    auto data = std::make_shared<const std::vector<uint8_t>>(std::move(buff));
+    return writeFileChunkAsync(file, data, chunk, std::move(done));
+}
+
+int writeFileChunkAsync(const std::shared_ptr<DownloadFile>&               file,
+                        const std::shared_ptr<const std::vector<uint8_t>>& data,
+                        const size_t                                       chunk,
+                              std::function<void(int)>                     done) {
+    if (!file || !data || chunk >= file->f_chunks)
+        return EXIT_FAILURE;
+
+    size_t offset   = chunk*file->c_size;
+    size_t expected = std::min(file->c_size, static_cast<size_t>(file->f_size) - offset);
+    if (data->size() != expected)
+        return EXIT_FAILURE;
+
+    //hash it while it waits, the verifier shares the buffer if it has to hold
+    //on to it
+    streamChunk(*file, chunk, data->data(), data->size(), data);
+    return stageWrite(file, chunk, {data, std::move(done)});
+}
+
+size_t flushFileWrites(const std::shared_ptr<DownloadFile>& file) {
+    return flushWrites(file);
+}
+
+void waitFileWrites(const std::shared_ptr<DownloadFile>& file) {
+    if (!file)
+        return;
+
+    drainWrites(file);
+}
+
+int setDownloadManifest(const std::shared_ptr<DownloadFile>& file,
+                        const size_t                         c_size,
+                        const ChunkDigests&                  digests) {
+    if (!file || c_size != file->c_size || digests.size() != file->f_chunks)
+        return EXIT_FAILURE;
+
+    //has to combine back to exactly the uuid we asked for
+    auto root = treeRoot(digests, 0, digests.size());
+    if (!root || treeUuid(file->f_size, root.value()) != file->uuid)
+        return EXIT_FAILURE;
+
+    file->manifest = digests;
+    return EXIT_SUCCESS;
+}
+
+bool verifyFileChunk(const std::shared_ptr<DownloadFile>& file,
+                     const std::vector<uint8_t>&          buff,
+                     const size_t                         data_len,
+                     const size_t                         chunk) {
+    if (!file || data_len > buff.size())
+        return false;
+    if (file->manifest.empty())
+        return true; //nothing to check against
+    if (chunk >= file->manifest.size())
+        return false;
+
+    auto digest = dataDigest(buff.data(), data_len);
+    return digest && digest.value() == file->manifest[chunk];
+}
+
+std::optional<std::vector<size_t>> verifyDownloadFile(const std::shared_ptr<DownloadFile>& file) {
+    if (!file)
+        return std::nullopt;
+
+    waitFileWrites(file);
+    return finishStream(*file);
+}
+
+int discardChunks(const std::shared_ptr<DownloadFile>& file,
+                  const std::vector<size_t>&           chunks) {
+    if (!file)
+        return EXIT_FAILURE;
+    return clearChunks(*file, chunks);
+}
+
+int checkpointDownloadFile(const std::shared_ptr<DownloadFile>& file) {
+    if (!file)
+        return EXIT_FAILURE;
+
+    //staged chunks aren't marked yet, get them on their way for the next one
+    flushWrites(file);
+    return checkpointDownload(*file);
+}
+
+//cuts a file's segments and keeps them in the hash cache, if it sat still
+//while it was cut. segments are only a hint, whatever a downloader puts
+//together from them is checked against the manifest
+static std::vector<Segment> cutSegments(const std::filesystem::path& abs_path,
+                                        const FileStamp&             stamp) {
+    auto segments = contentSegments(cacheAcquire(abs_path));
+    auto after    = fileStamp(abs_path);
+    if (!segments || !after || !(after.value() == stamp))
+        return {};
+
+    storeSegments(abs_path, stamp, segments.value());
+    return segments.value();
+}
+
+int closeDownloadFile(std::shared_ptr<DownloadFile>& file, bool complete) {
+    if (!file)
+        return EXIT_FAILURE;
+
+    //nothing can still be on its way to the file
+    waitFileWrites(file);
+
+    std::filesystem::path f_path = file->f_path;
+    if (!complete) {
+        //keep what we have for the next attempt
+        int res = checkpointDownload(*file);
+        file.reset();
+        return res;
+    }
+
+    //data has to be on disk before the sidecar saying it's incomplete goes
+    int res = fdatasync(file->fd);
+    if (res == 0 && chunk_store && !file->manifest.empty()) {
+        //cut while the file's still in the page cache from being written
+        std::filesystem::path abs_path = std::filesystem::absolute(f_path).lexically_normal();
+        auto stamp = fileStamp(abs_path);
+        if (stamp)
+            storeChunks(abs_path,
+                        stamp.value(),
+                        file->c_size,
+                        file->manifest,
+                        cutSegments(abs_path, stamp.value()));
+    }
+
+    file.reset();
+    if (res < 0)
+        return EXIT_FAILURE;
+    return deleteFile(partPath(f_path));
+}
+
 int unpackFileChunk(const std::string&           f_name, 
                     const std::vector<uint8_t>&  buff, 
                     const size_t                 data_len,
@@ -219,14 +568,15 @@ std::unique_ptr<std::ofstream> openFile(const std::string& f_name) {
 
 int assembleChunk(      std::ofstream* file, 
                   const std::string&                    f_name,
-                  const size_t                          chunk) {
+                  const size_t                          chunk,
+                  const size_t                          c_size) {
     auto c_path = filePath(f_name, chunk, true);
     auto c_pair = readChunkData(c_path); 
     if (!c_pair)
         return EXIT_FAILURE;
 
     auto& [c_len, c_data] = *c_pair;
-    size_t offset = chunk_size*chunk;
+    size_t offset = c_size*chunk;
     if (EXIT_SUCCESS != writeToFile(file, c_len, c_data, offset))
         return EXIT_FAILURE;
     deleteFile(c_path); //chunk is written
@@ -234,7 +584,10 @@ int assembleChunk(      std::ofstream* file,
 }
 
 int saveFile(std::unique_ptr<std::ofstream> file) {
+    //anything still buffered is written here
     file->close();
+    if (file->fail())
+        return EXIT_FAILURE;
     return EXIT_SUCCESS;
 }
 
@@ -253,11 +606,12 @@ union DigestMap {
 };
 
 uint64_t sha256Hash(const std::filesystem::path& f_path) {
-    auto f_size = fileSize(f_path);     
+    auto file   = cacheAcquire(f_path); //not a seed session
+    auto f_size = fileSize(file);
     if (!f_size)
         return 0;
 
-    auto chunks = fileChunks(f_size.value());
+    auto chunks = fileChunks(f_size.value(), chunk_size);
     if (!chunks) 
         return 0;
 
@@ -270,7 +624,7 @@ uint64_t sha256Hash(const std::filesystem::path& f_path) {
 
     std::vector<uint8_t> buff; buff.resize(chunk_size);
     for (size_t i = 0; i < chunks.value(); ++i) {
-        auto res = packageFileChunk(f_path, buff, i);        
+        auto res = packageFileChunk(file, buff, i, chunk_size);
         if (!res)
             return 0;
         if (1 != EVP_DigestUpdate(mdctx, buff.data(), res.value()))
@@ -295,4 +649,281 @@ uint64_t sha256Hash(const std::filesystem::path& f_path) {
     return dm.uuid;
 }
 
+//treeHash(), also cutting the file into segments while its leaves are hashed
+//if given somewhere to put them. both read the file through the page cache
+//at the same time, so it's mostly read from disk once
+static uint64_t hashTree(const std::filesystem::path&               f_path,
+                               std::optional<std::vector<Segment>>* segments) {
+    auto file   = cacheAcquire(f_path); //not a seed session
+    auto f_size = fileSize(file);
+    if (!f_size)
+        return 0;
+
+    std::thread cutter;
+    if (segments)
+        cutter = std::thread([&file, segments]{ *segments = contentSegments(file); });
+
+    auto leaves = leafDigests(file, 0);
+    if (cutter.joinable())
+        cutter.join();
+    if (!leaves)
+        return 0;
+
+    auto root = treeRoot(leaves.value(), 0, leaves->size());
+    if (!root)
+        return 0;
+
+    uint64_t uuid = treeUuid(f_size.value(), root.value());
+    if (uuid != 0) {
+        //kept so chunkManifest() can answer without rehashing
+        std::lock_guard<std::mutex> lock(manifest_mtx);
+        tree_leaves[uuid] = std::move(leaves.value());
+    }
+
+    return uuid;
+}
+
+uint64_t treeHash(const std::filesystem::path& f_path) {
+    return hashTree(f_path, nullptr);
+}
+
+uint64_t dataUuid(const uint8_t* data, const size_t len) {
+    auto root = dataDigest(data, len);
+    if (!root)
+        return 0;
+    return treeUuid(len, root.value());
+}
+
+int setHashScheme(const uint8_t scheme) {
+    if (scheme != HASH_SHA256 && scheme != HASH_TREE)
+        return EXIT_FAILURE;
+    hash_scheme = scheme;
+    return EXIT_SUCCESS;
+}
+
+uint8_t getHashScheme() {
+    return hash_scheme;
+}
+
+int setHashCache(const std::filesystem::path& c_path) {
+    return loadHashCache(std::filesystem::absolute(c_path));
+}
+
+uint64_t fileUuid(const std::filesystem::path& f_path) {
+    std::filesystem::path abs_path = std::filesystem::absolute(f_path).lexically_normal();
+    auto stamp = fileStamp(abs_path);
+    if (!stamp)
+        return 0;
+
+    std::vector<Digest> leaves;
+    auto cached = cachedUuid(abs_path,
+                             stamp.value(),
+                             hash_scheme,
+                             hash_scheme == HASH_TREE ? &leaves : nullptr);
+    if (cached) {
+        if (hash_scheme == HASH_TREE) {
+            //a cache from before segments were kept has them cut this once
+            auto segments = cachedSegments(abs_path, stamp.value());
+            if (!segments)
+                segments = cutSegments(abs_path, stamp.value());
+            if (chunk_store)
+                storeLeaves(abs_path, stamp.value(), leaves, segments.value());
+            std::lock_guard<std::mutex> lock(manifest_mtx);
+            tree_leaves[cached.value()] = std::move(leaves);
+        }
+        return cached.value();
+    }
+
+    int64_t started = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          std::chrono::system_clock::now().time_since_epoch()).count();
+    std::optional<std::vector<Segment>> segments;
+    uint64_t uuid = hash_scheme == HASH_TREE ? hashTree(abs_path, &segments) : sha256Hash(abs_path);
+    if (uuid == 0)
+        return 0;
+    if (!segments)
+        segments.emplace(); //not cut, or couldn't be
+
+    //only remember it if the file sat still the whole time. mtimes are coarse,
+    //on some filesystems 2s, so a write landing just after the hash started
+    //might not change the stamp. a file modified that recently isn't trusted
+    auto after = fileStamp(abs_path);
+    bool still = after && after.value() == stamp.value();
+    if (still && hash_scheme == HASH_TREE) {
+        std::lock_guard<std::mutex> lock(manifest_mtx);
+        auto it = tree_leaves.find(uuid);
+        if (it != tree_leaves.end())
+            leaves = it->second;
+    }
+
+    if (still && stamp->mtime_ns < started - HASH_CACHE_RACY_NS)
+        storeUuid(abs_path, stamp.value(), hash_scheme, uuid, leaves);
+
+    //segments and the store are checked before anything from them is used, a
+    //racy stamp is fine there
+    if (still && !segments->empty())
+        storeSegments(abs_path, stamp.value(), segments.value());
+    if (still && chunk_store)
+        storeLeaves(abs_path, stamp.value(), leaves, segments.value());
+
+    return uuid;
+}
+
+std::optional<ChunkDigests> chunkManifest(const uint64_t uuid, const size_t c_size) {
+    std::lock_guard<std::mutex> lock(manifest_mtx);
+    auto it = tree_leaves.find(uuid);
+    if (it == tree_leaves.end())
+        return std::nullopt;
+
+    auto digests = chunkDigests(it->second, c_size);
+    if (!digests)
+        return std::nullopt;
+    return digests;
+}
+
+void dropManifest(const uint64_t uuid) {
+    std::lock_guard<std::mutex> lock(manifest_mtx);
+    tree_leaves.erase(uuid);
+}
+
+void setChunkStore(const bool on) {
+    chunk_store = on;
+}
+
+size_t fillFromChunkStore(const std::shared_ptr<DownloadFile>& file) {
+    if (!chunk_store || !file || file->manifest.empty())
+        return 0;
+
+    size_t               filled = 0;
+    std::vector<uint8_t> buff;
+    for (size_t chunk : missingChunks(file)) {
+        size_t offset   = chunk*file->c_size;
+        size_t expected = std::min(file->c_size, static_cast<size_t>(file->f_size) - offset);
+
+        //a file that doesn't hold what the store says is dropped, and the
+        //next one with the chunk is tried
+        while (auto found = findStoredChunk(file->c_size, file->manifest[chunk])) {
+            buff.resize(file->c_size);
+            auto res = packageFileChunk(found->f_path, buff, found->chunk, file->c_size);
+            if (res && static_cast<size_t>(res.value()) == expected
+                    && verifyFileChunk(file, buff, expected, chunk)) {
+                if (EXIT_SUCCESS != writeFileChunk(file, buff, expected, chunk))
+                    return filled;
+                filled++;
+                store_chunks++;
+                store_bytes += expected;
+                break;
+            }
+
+            forgetStoreFile(found->f_path);
+        }
+    }
+
+    return filled;
+}
+
+std::optional<SegmentDigests> segmentDigests(const std::shared_ptr<FileHandle>& file) {
+    if (!file || !file->valid)
+        return std::nullopt;
+
+    //only ever cut when the file was hashed, never while a peer waits
+    FileStamp stamp;
+    stamp.dev      = file->dev;
+    stamp.ino      = file->ino;
+    stamp.f_size   = static_cast<uint64_t>(file->f_size);
+    stamp.mtime_ns = file->mtime_ns;
+    auto segments  = cachedSegments(std::filesystem::absolute(file->f_path).lexically_normal(), stamp);
+    if (!segments)
+        return std::nullopt;
+
+    //the record's for the version of the file being sent
+    uint64_t       total = 0;
+    SegmentDigests digests;
+    digests.reserve(segments->size());
+    for (const Segment& segment : segments.value()) {
+        digests.push_back({segment.len, segment.digest});
+        total += segment.len;
+    }
+
+    if (total != static_cast<uint64_t>(file->f_size))
+        return std::nullopt;
+    return digests;
+}
+
+bool wantsSegments(const std::shared_ptr<DownloadFile>& file) {
+    return chunk_store && file && !file->manifest.empty() &&
+           storeSegmentCount() > 0 && !missingChunks(file).empty();
+}
+
+size_t fillFromSegments(const std::shared_ptr<DownloadFile>& file,
+                        const SegmentDigests&                segments) {
+    if (!chunk_store || !file || file->manifest.empty() || segments.empty())
+        return 0;
+
+    //where each segment starts in the download. they have to cover it exactly
+    std::vector<uint64_t> starts(segments.size()+1, 0);
+    for (size_t i = 0; i < segments.size(); ++i) {
+        if (segments[i].first == 0)
+            return 0;
+        starts[i+1] = starts[i] + segments[i].first;
+    }
+    if (starts.back() != file->f_size)
+        return 0;
+
+    size_t                                                       filled = 0;
+    std::vector<uint8_t>                                         buff;
+    std::vector<uint8_t>                                         part;
+    std::map<std::filesystem::path, std::shared_ptr<FileHandle>> local;
+    for (size_t chunk : missingChunks(file)) {
+        uint64_t first    = chunk*file->c_size;
+        size_t   expected = std::min<uint64_t>(file->c_size, file->f_size - first);
+        uint64_t end      = first + expected;
+
+        //the segment holding the chunk's first byte, then each after it until
+        //the chunk's whole or one isn't on the disk
+        size_t   seg = std::upper_bound(starts.begin(), starts.end(), first) - starts.begin() - 1;
+        uint64_t at  = first;
+        buff.resize(expected);
+        while (at < end) {
+            auto found = findStoredSegment(segments[seg].second);
+            if (!found || found->len != segments[seg].first)
+                break;
+
+            std::shared_ptr<FileHandle>& handle = local[found->f_path];
+            if (!handle)
+                handle = cacheAcquire(found->f_path);
+            if (!handle)
+                break;
+
+            size_t take       = std::min(end, starts[seg+1]) - at;
+            auto   read_bytes = readFileAt(handle->fd, take, found->offset + (at - starts[seg]), part);
+            if (!read_bytes || static_cast<size_t>(read_bytes.value()) != take)
+                break;
+
+            std::memcpy(buff.data() + (at - first), part.data(), take);
+            at += take;
+            seg++;
+        }
+
+        //the manifest has the last word, a local file may have changed since
+        //it was cut
+        if (at < end || !verifyFileChunk(file, buff, expected, chunk))
+            continue;
+        if (EXIT_SUCCESS != writeFileChunk(file, buff, expected, chunk))
+            return filled;
+        filled++;
+        store_chunks++;
+        store_bytes += expected;
+    }
+
+    return filled;
+}
+
+ChunkStoreStats chunkStoreStats() {
+    ChunkStoreStats stats;
+    stats.files  = storeFiles();
+    stats.chunks = store_chunks;
+    stats.bytes  = store_bytes;
+    return stats;
+}
+
 } //dfd
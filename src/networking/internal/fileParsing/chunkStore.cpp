@@ -0,0 +1,158 @@
+#include "networking/internal/fileParsing/chunkStore.hpp"
+
+#include <map>
+#include <mutex>
+
+namespace dfd {
+
+//what's known about a file in the store. c_size is 0 if digests are its leaves
+struct StoreFile {
+    FileStamp           stamp;
+    size_t              c_size = 0;
+    std::vector<Digest> digests;
+};
+
+//every file in the store, and per chunk size where each digest can be found.
+//an index is built the first time its chunk size is asked for, and thrown
+//away whenever the files change
+static std::mutex                                      store_mtx;
+static std::map<std::filesystem::path, StoreFile>      store_files;
+static std::map<size_t, std::map<Digest, StoredChunk>> store_index;
+
+//where each segment can be found. a file's segments are added with it and
+//dropped with it, first file to have a segment keeps it
+static std::map<Digest, StoredSegment>                 segment_index;
+
+//caller holds store_mtx
+static void dropSegments(const std::filesystem::path& f_path) {
+    for (auto it = segment_index.begin(); it != segment_index.end(); ) {
+        if (it->second.f_path == f_path)
+            it = segment_index.erase(it);
+        else
+            ++it;
+    }
+}
+
+static void addFile(const std::filesystem::path& f_path,
+                          StoreFile&&            file,
+                    const std::vector<Segment>&  segments) {
+    std::lock_guard<std::mutex> lock(store_mtx);
+    if (store_files.count(f_path) > 0)
+        dropSegments(f_path);
+    store_files[f_path] = std::move(file);
+    store_index.clear();
+
+    for (const Segment& segment : segments)
+        segment_index.emplace(segment.digest, StoredSegment{f_path, segment.offset, segment.len});
+}
+
+void storeLeaves(const std::filesystem::path& f_path,
+                 const FileStamp&             stamp,
+                 const std::vector<Digest>&   leaves,
+                 const std::vector<Segment>&  segments) {
+    if (leaves.empty())
+        return;
+    addFile(f_path, {stamp, 0, leaves}, segments);
+}
+
+void storeChunks(const std::filesystem::path& f_path,
+                 const FileStamp&             stamp,
+                 const size_t                 c_size,
+                 const ChunkDigests&          digests,
+                 const std::vector<Segment>&  segments) {
+    if (c_size == 0 || digests.empty())
+        return;
+    addFile(f_path, {stamp, c_size, digests}, segments);
+}
+
+void forgetStoreFile(const std::filesystem::path& f_path) {
+    std::lock_guard<std::mutex> lock(store_mtx);
+    if (store_files.erase(f_path) > 0) {
+        store_index.clear();
+        dropSegments(f_path);
+    }
+}
+
+//caller holds store_mtx
+static std::map<Digest, StoredChunk>& indexFor(const size_t c_size) {
+    auto it = store_index.find(c_size);
+    if (it != store_index.end())
+        return it->second;
+
+    std::map<Digest, StoredChunk>& index = store_index[c_size];
+    for (const auto& [f_path, file] : store_files) {
+        std::optional<std::vector<Digest>> chunks;
+        if (file.c_size == 0)
+            chunks = chunkDigests(file.digests, c_size);
+        else if (file.c_size == c_size)
+            chunks = file.digests;
+        if (!chunks)
+            continue;
+
+        //first file to have a chunk keeps it
+        for (size_t i = 0; i < chunks->size(); ++i)
+            index.emplace((*chunks)[i], StoredChunk{f_path, i});
+    }
+
+    return index;
+}
+
+std::optional<StoredChunk> findStoredChunk(const size_t c_size, const Digest& digest) {
+    while (true) {
+        StoredChunk found;
+        FileStamp   stamp;
+        {
+            std::lock_guard<std::mutex> lock(store_mtx);
+            auto& index = indexFor(c_size);
+            auto  it    = index.find(digest);
+            if (it == index.end())
+                return std::nullopt;
+
+            found = it->second;
+            stamp = store_files[found.f_path].stamp;
+        }
+
+        //stat outside the lock, it's a syscall per lookup
+        auto now = fileStamp(found.f_path);
+        if (now && now.value() == stamp)
+            return found;
+
+        //changed or gone, look again without it
+        forgetStoreFile(found.f_path);
+    }
+}
+
+std::optional<StoredSegment> findStoredSegment(const Digest& digest) {
+    StoredSegment found;
+    FileStamp     stamp;
+    {
+        std::lock_guard<std::mutex> lock(store_mtx);
+        auto it = segment_index.find(digest);
+        if (it == segment_index.end())
+            return std::nullopt;
+
+        found = it->second;
+        stamp = store_files[found.f_path].stamp;
+    }
+
+    //stat outside the lock, it's a syscall per lookup
+    auto now = fileStamp(found.f_path);
+    if (now && now.value() == stamp)
+        return found;
+
+    //changed or gone, its segments go with it
+    forgetStoreFile(found.f_path);
+    return std::nullopt;
+}
+
+size_t storeFiles() {
+    std::lock_guard<std::mutex> lock(store_mtx);
+    return store_files.size();
+}
+
+size_t storeSegmentCount() {
+    std::lock_guard<std::mutex> lock(store_mtx);
+    return segment_index.size();
+}
+
+} //dfd
@@ -0,0 +1,98 @@
+#include "networking/internal/fileParsing/contentChunks.hpp"
+#include "networking/internal/fileParsing/fileCache.hpp"
+#include "networking/internal/fileParsing/fileUtil.hpp"
+
+#include <algorithm>
+#include <array>
+#include <openssl/evp.h>
+
+//bytes read per pread() while cutting
+#define SEGMENT_READ_SIZE (4 << 20)
+
+namespace dfd {
+
+static constexpr uint8_t SEGMENT_PREFIX = 0x03;
+
+//the gear table, 256 words from splitmix64 seeded with a fixed constant.
+//built at compile time so every build cuts the same
+static constexpr std::array<uint64_t, 256> makeGear() {
+    std::array<uint64_t, 256> gear{};
+    uint64_t state = 0x6466646C67656172ULL; //"dfdlgear"
+    for (size_t i = 0; i < gear.size(); ++i) {
+        state += 0x9E3779B97F4A7C15ULL;
+        uint64_t z = state;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        gear[i] = z ^ (z >> 31);
+    }
+    return gear;
+}
+
+static constexpr std::array<uint64_t, 256> GEAR = makeGear();
+
+std::optional<std::vector<Segment>> contentSegments(const std::shared_ptr<FileHandle>& file) {
+    if (!file || !file->valid || file->f_size < 0)
+        return std::nullopt;
+
+    EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+    if (!ctx)
+        return std::nullopt;
+
+    size_t               f_size = static_cast<size_t>(file->f_size);
+    std::vector<Segment> segments;
+    std::vector<uint8_t> buff;
+    Segment              current;
+    uint64_t             hash = 0;
+    bool                 ok   = true;
+
+    //a segment's digest is fed as its bytes go by, it can span reads
+    auto startSegment = [&](uint64_t offset) {
+        current        = Segment{};
+        current.offset = offset;
+        ok = ok && 1 == EVP_DigestInit_ex(ctx, EVP_sha256(), NULL)
+                && 1 == EVP_DigestUpdate(ctx, &SEGMENT_PREFIX, 1);
+    };
+    auto endSegment = [&]() {
+        unsigned int out_len = 0;
+        ok = ok && 1 == EVP_DigestFinal_ex(ctx, current.digest.data(), &out_len);
+        segments.push_back(current);
+    };
+
+    startSegment(0);
+    for (size_t offset = 0; offset < f_size && ok; ) {
+        size_t want       = std::min<size_t>(SEGMENT_READ_SIZE, f_size - offset);
+        auto   read_bytes = readFileAt(file->fd, want, offset, buff);
+        if (!read_bytes || static_cast<size_t>(read_bytes.value()) != want) {
+            ok = false; //file shrunk, or unreadable
+            break;
+        }
+
+        size_t fed = 0; //bytes of buff already given to the digest
+        for (size_t i = 0; i < want; ++i) {
+            hash = (hash << 1) + GEAR[buff[i]];
+            current.len++;
+            bool cut = current.len >= SEGMENT_MAX_SIZE ||
+                       (current.len >= SEGMENT_MIN_SIZE && (hash >> (64 - SEGMENT_MASK_BITS)) == 0);
+            if (!cut || offset + i + 1 == f_size)
+                continue; //the last segment's ended below
+
+            ok = ok && 1 == EVP_DigestUpdate(ctx, buff.data() + fed, i + 1 - fed);
+            fed = i + 1;
+            endSegment();
+            startSegment(offset + i + 1);
+        }
+
+        ok = ok && 1 == EVP_DigestUpdate(ctx, buff.data() + fed, want - fed);
+        offset += want;
+    }
+
+    if (ok && current.len > 0)
+        endSegment();
+
+    EVP_MD_CTX_free(ctx);
+    if (!ok)
+        return std::nullopt;
+    return segments;
+}
+
+} //dfd
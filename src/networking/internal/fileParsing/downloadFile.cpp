@@ -0,0 +1,266 @@
+#include "networking/internal/fileParsing/downloadFile.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <endian.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace dfd {
+
+static constexpr uint8_t PART_MAGIC[8]   = {'D', 'F', 'D', 'P', 'A', 'R', 'T', 0x01};
+static constexpr size_t  PART_HEADER_LEN = 32;
+
+DownloadFile::DownloadFile(int fd, const std::filesystem::path& f_path, uint64_t f_size)
+    :
+    fd     (fd),
+    f_path (f_path),
+    f_size (f_size) {}
+
+DownloadFile::~DownloadFile() {
+    if (part_map)
+        munmap(part_map, part_len);
+    if (part_fd >= 0)
+        close(part_fd);
+    if (fd >= 0)
+        close(fd);
+}
+
+std::filesystem::path partPath(const std::filesystem::path& f_path) {
+    std::filesystem::path p_path = f_path;
+    p_path += ".dfdpart";
+    return p_path;
+}
+
+static size_t chunksIn(const uint64_t f_size, const size_t c_size) {
+    if (f_size == 0)
+        return 1; //an empty file is still one (empty) chunk
+    return (f_size + c_size - 1) / c_size;
+}
+
+//maps the sidecar and points the handle's bitmap into it
+static int mapSidecar(DownloadFile& file, int part_fd, size_t part_len) {
+    void* map = mmap(nullptr, part_len, PROT_READ | PROT_WRITE, MAP_SHARED, part_fd, 0);
+    if (map == MAP_FAILED)
+        return EXIT_FAILURE;
+
+    file.part_fd  = part_fd;
+    file.part_map = map;
+    file.part_len = part_len;
+    file.bitmap   = static_cast<uint8_t*>(map) + PART_HEADER_LEN;
+    file.pending.assign(part_len - PART_HEADER_LEN, 0);
+    return EXIT_SUCCESS;
+}
+
+std::shared_ptr<DownloadFile> createDownloadFile(const std::filesystem::path& f_path,
+                                                 const uint64_t               f_size,
+                                                 const uint64_t               uuid,
+                                                 const size_t                 c_size) {
+    if (c_size == 0)
+        return nullptr;
+
+    int fd = open(f_path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return nullptr;
+
+    auto file = std::make_shared<DownloadFile>(fd, f_path, f_size);
+    auto fail = [&]() -> std::shared_ptr<DownloadFile> {
+        file.reset();
+        unlink(partPath(f_path).c_str());
+        unlink(f_path.c_str());
+        return nullptr;
+    };
+
+    if (f_size > 0) {
+        //reserve the blocks now so chunks landing out of order don't fragment
+        //the file, fall back to a sparse file where that isn't supported
+        int res = fallocate(fd, 0, 0, f_size);
+        if (res < 0 && (errno == EOPNOTSUPP || errno == ENOSYS))
+            res = ftruncate(fd, f_size);
+
+        if (res < 0)
+            return fail();
+    }
+
+    file->uuid     = uuid;
+    file->c_size   = c_size;
+    file->f_chunks = chunksIn(f_size, c_size);
+
+    //sidecar, header then a zeroed bitmap
+    int part_fd = open(partPath(f_path).c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (part_fd < 0)
+        return fail();
+
+    size_t  part_len = PART_HEADER_LEN + (file->f_chunks + 7) / 8;
+    uint8_t header[PART_HEADER_LEN];
+    uint64_t be_uuid  = htobe64(uuid);
+    uint64_t be_size  = htobe64(f_size);
+    uint64_t be_chunk = htobe64(c_size);
+    std::memcpy(header,    PART_MAGIC, 8);
+    std::memcpy(header+8,  &be_uuid,   8);
+    std::memcpy(header+16, &be_size,   8);
+    std::memcpy(header+24, &be_chunk,  8);
+
+    if (ftruncate(part_fd, part_len) < 0                                  ||
+        pwrite(part_fd, header, PART_HEADER_LEN, 0) != PART_HEADER_LEN ||
+        EXIT_SUCCESS != mapSidecar(*file, part_fd, part_len)) {
+        close(part_fd);
+        return fail();
+    }
+
+    return file;
+}
+
+std::shared_ptr<DownloadFile> resumeDownloadFile(const std::filesystem::path& f_path,
+                                                 const uint64_t               f_size,
+                                                 const uint64_t               uuid,
+                                                 const size_t                 c_size) {
+    if (c_size == 0)
+        return nullptr;
+
+    int part_fd = open(partPath(f_path).c_str(), O_RDWR | O_CLOEXEC);
+    if (part_fd < 0)
+        return nullptr;
+
+    //sidecar has to describe exactly this download
+    size_t   f_chunks = chunksIn(f_size, c_size);
+    size_t   part_len = PART_HEADER_LEN + (f_chunks + 7) / 8;
+    uint8_t  header[PART_HEADER_LEN];
+    uint64_t be_uuid  = htobe64(uuid);
+    uint64_t be_size  = htobe64(f_size);
+    uint64_t be_chunk = htobe64(c_size);
+    struct stat st;
+    if (fstat(part_fd, &st) < 0                                          ||
+        static_cast<size_t>(st.st_size) != part_len                      ||
+        pread(part_fd, header, PART_HEADER_LEN, 0) != PART_HEADER_LEN ||
+        std::memcmp(header,    PART_MAGIC, 8) != 0                       ||
+        std::memcmp(header+8,  &be_uuid,   8) != 0                       ||
+        std::memcmp(header+16, &be_size,   8) != 0                       ||
+        std::memcmp(header+24, &be_chunk,  8) != 0) {
+        close(part_fd);
+        return nullptr;
+    }
+
+    int fd = open(f_path.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd < 0 || fstat(fd, &st) < 0 || static_cast<uint64_t>(st.st_size) != f_size) {
+        if (fd >= 0) close(fd);
+        close(part_fd);
+        return nullptr;
+    }
+
+    auto file      = std::make_shared<DownloadFile>(fd, f_path, f_size);
+    file->uuid     = uuid;
+    file->c_size   = c_size;
+    file->f_chunks = f_chunks;
+    if (EXIT_SUCCESS != mapSidecar(*file, part_fd, part_len)) {
+        close(part_fd);
+        return nullptr;
+    }
+
+    return file;
+}
+
+std::optional<size_t> sidecarChunkSize(const std::filesystem::path& f_path,
+                                       const uint64_t               f_size,
+                                       const uint64_t               uuid) {
+    int part_fd = open(partPath(f_path).c_str(), O_RDONLY | O_CLOEXEC);
+    if (part_fd < 0)
+        return std::nullopt;
+
+    uint8_t  header[PART_HEADER_LEN];
+    uint64_t be_uuid = htobe64(uuid);
+    uint64_t be_size = htobe64(f_size);
+    bool ok = pread(part_fd, header, PART_HEADER_LEN, 0) == PART_HEADER_LEN &&
+              std::memcmp(header,    PART_MAGIC, 8) == 0                       &&
+              std::memcmp(header+8,  &be_uuid,   8) == 0                       &&
+              std::memcmp(header+16, &be_size,   8) == 0;
+    close(part_fd);
+    if (!ok)
+        return std::nullopt;
+
+    uint64_t be_chunk;
+    std::memcpy(&be_chunk, header+24, 8);
+    size_t c_size = be64toh(be_chunk);
+    if (c_size == 0)
+        return std::nullopt;
+    return c_size;
+}
+
+void markChunk(DownloadFile& file, const size_t chunk) {
+    if (chunk >= file.f_chunks)
+        return;
+
+    std::lock_guard<std::mutex> lock(file.part_mtx);
+    uint8_t bit = 1 << (chunk % 8);
+    if (!(file.pending[chunk/8] & bit)) {
+        file.pending[chunk/8] |= bit;
+        file.pending_count++;
+    }
+}
+
+bool hasChunk(DownloadFile& file, const size_t chunk) {
+    if (chunk >= file.f_chunks)
+        return false;
+
+    std::lock_guard<std::mutex> lock(file.part_mtx);
+    uint8_t bit = 1 << (chunk % 8);
+    return (file.bitmap[chunk/8] & bit) || (file.pending[chunk/8] & bit);
+}
+
+int clearChunks(DownloadFile& file, const std::vector<size_t>& chunks) {
+    {
+        std::lock_guard<std::mutex> lock(file.part_mtx);
+        for (size_t chunk : chunks) {
+            if (chunk >= file.f_chunks)
+                continue;
+
+            uint8_t bit = 1 << (chunk % 8);
+            if (file.pending[chunk/8] & bit)
+                file.pending_count--;
+            file.pending[chunk/8] &= ~bit;
+            file.bitmap[chunk/8]  &= ~bit;
+        }
+    }
+
+    if (msync(file.part_map, file.part_len, MS_SYNC) < 0)
+        return EXIT_FAILURE;
+    return EXIT_SUCCESS;
+}
+
+int checkpointDownload(DownloadFile& file) {
+    std::vector<uint8_t> flushing;
+    {
+        std::lock_guard<std::mutex> lock(file.part_mtx);
+        if (file.pending_count == 0)
+            return EXIT_SUCCESS;
+        flushing.swap(file.pending);
+        file.pending.assign(flushing.size(), 0);
+        file.pending_count = 0;
+    }
+
+    //every chunk in flushing finished its pwrite() before it was marked, so
+    //after this they're all on disk and safe to record
+    int res = fdatasync(file.fd);
+
+    std::lock_guard<std::mutex> lock(file.part_mtx);
+    if (res < 0) {
+        //put them back for next time
+        for (size_t i = 0; i < flushing.size(); ++i) {
+            uint8_t fresh = flushing[i] & ~file.pending[i];
+            file.pending[i]    |= flushing[i];
+            file.pending_count += __builtin_popcount(fresh);
+        }
+        return EXIT_FAILURE;
+    }
+
+    for (size_t i = 0; i < flushing.size(); ++i)
+        file.bitmap[i] |= flushing[i];
+
+    if (msync(file.part_map, file.part_len, MS_SYNC) < 0)
+        return EXIT_FAILURE;
+    return EXIT_SUCCESS;
+}
+
+} //dfd
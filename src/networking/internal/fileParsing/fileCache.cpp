@@ -0,0 +1,88 @@
+#include "networking/internal/fileParsing/fileCache.hpp"
+
+#include <fcntl.h>
+#include <map>
+#include <mutex>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace dfd {
+
+//handles are only weakly held here, the sessions using them own them
+static std::mutex                                                  cache_mtx;
+static std::map<std::filesystem::path, std::weak_ptr<FileHandle>> open_files;
+
+FileHandle::FileHandle(int fd, const std::filesystem::path& f_path)
+    :
+    fd     (fd),
+    f_path (f_path) {}
+
+FileHandle::~FileHandle() {
+    if (fd >= 0)
+        close(fd);
+    if (direct_fd >= 0)
+        close(direct_fd);
+}
+
+static int64_t mtimeNs(const struct stat& st) {
+    return static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+//true if the handle still refers to the file currently at its path
+static bool sameFile(const FileHandle& handle, const struct stat& st) {
+    return handle.dev      == st.st_dev  &&
+           handle.ino      == st.st_ino  &&
+           handle.f_size   == st.st_size &&
+           handle.mtime_ns == mtimeNs(st);
+}
+
+std::shared_ptr<FileHandle> cacheAcquire(const std::filesystem::path& f_path) {
+    struct stat st;
+    if (stat(f_path.c_str(), &st) < 0 || !S_ISREG(st.st_mode))
+        return nullptr;
+
+    std::lock_guard<std::mutex> lock(cache_mtx);
+    auto it = open_files.find(f_path);
+    if (it != open_files.end()) {
+        auto cached = it->second.lock();
+        if (cached && cached->valid && sameFile(*cached, st))
+            return cached;
+
+        //file changed underneath us, or nobody holds it anymore
+        if (cached)
+            cached->valid = false;
+        open_files.erase(it);
+    }
+
+    int fd = open(f_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return nullptr;
+
+    //stat the fd we actually opened, the path could have moved since
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return nullptr;
+    }
+
+    auto handle      = std::make_shared<FileHandle>(fd, f_path);
+    handle->f_size   = st.st_size;
+    handle->dev      = st.st_dev;
+    handle->ino      = st.st_ino;
+    handle->mtime_ns = mtimeNs(st);
+
+    open_files[f_path] = handle;
+    return handle;
+}
+
+void cacheInvalidate(const std::filesystem::path& f_path) {
+    std::lock_guard<std::mutex> lock(cache_mtx);
+    auto it = open_files.find(f_path);
+    if (it == open_files.end())
+        return;
+
+    if (auto cached = it->second.lock())
+        cached->valid = false;
+    open_files.erase(it);
+}
+
+} //dfd
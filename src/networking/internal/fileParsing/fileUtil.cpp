@@ -2,6 +2,8 @@
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <cerrno>
+#include <unistd.h>
 
 namespace dfd {
 
@@ -36,6 +38,55 @@ std::optional<ssize_t> readFile(const std::filesystem::path& f_path,
     return file.gcount(); //file deallocated when stack frame is popped
 }
 
+std::optional<ssize_t> readFileAt(const int                   fd,
+                                  const size_t                read_size,
+                                  const size_t                offset,
+                                        std::vector<uint8_t>& buff) {
+    if (buff.size() < read_size)
+        buff.resize(read_size);
+
+    size_t total_read = 0;
+    while (total_read < read_size) {
+        ssize_t res = pread(fd,
+                            buff.data()+total_read,
+                            read_size-total_read,
+                            offset+total_read);
+        if (res < 0 && errno == EINTR)
+            continue;
+        if (res < 0)
+            return std::nullopt;
+        if (res == 0)
+            break; //EOF
+        total_read += res;
+    }
+
+    buff.resize(total_read);
+    return total_read;
+}
+
+int writeFileAt(const int                   fd,
+                const std::vector<uint8_t>& buff,
+                const size_t                len,
+                const size_t                offset) {
+    if (len > buff.size())
+        return EXIT_FAILURE;
+
+    size_t total_written = 0;
+    while (total_written < len) {
+        ssize_t res = pwrite(fd,
+                             buff.data()+total_written,
+                             len-total_written,
+                             offset+total_written);
+        if (res < 0 && errno == EINTR)
+            continue;
+        if (res <= 0)
+            return EXIT_FAILURE;
+        total_written += res;
+    }
+
+    return EXIT_SUCCESS;
+}
+
 std::unique_ptr<std::ofstream> writeToNewFile(const std::filesystem::path& f_path,
                                               const size_t                 len,
                                               const std::vector<uint8_t>&  data) {
@@ -51,8 +102,8 @@ std::unique_ptr<std::ofstream> writeToNewFile(const std::filesystem::path& f_pat
 
     if (!file->good())
         return nullptr;
-    
-    file->flush();
+
+    //buffered, the file is flushed once it's closed
     return file;
 }
 
@@ -63,9 +114,12 @@ int writeToFile(      std::ofstream*         file,
     if (!file->is_open())
         return EXIT_FAILURE;
 
-    file->seekp(offset);
+    //seeking flushes the stream, chunks written in order don't need to
+    if (file->tellp() != static_cast<std::streampos>(offset))
+        file->seekp(offset);
     file->write(reinterpret_cast<const char*>(data.data()), len);
-    file->flush();
+    if (!file->good())
+        return EXIT_FAILURE;
     return EXIT_SUCCESS;
 }
 
@@ -0,0 +1,378 @@
+#include "networking/internal/fileParsing/hashCache.hpp"
+#include "networking/internal/fileParsing/fileUtil.hpp"
+
+#include <cstring>
+#include <endian.h>
+#include <fcntl.h>
+#include <map>
+#include <mutex>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace dfd {
+
+static constexpr uint8_t CACHE_MAGIC[8]   = {'D', 'F', 'D', 'H', 'A', 'S', 'H', 0x02};
+static constexpr uint8_t CACHE_V1         = 0x01;
+static constexpr size_t  CACHE_HEADER_LEN = 8;
+
+//the scheme byte of a record holding segments instead of a uuid
+static constexpr uint8_t SEGMENT_RECORD   = 0xC0;
+static constexpr size_t  SEGMENT_ENTRY    = 4 + sizeof(Digest);
+static constexpr size_t  RECORD_FIXED_LEN = 8*4 + 1 + 8 + 8; //after the path
+static constexpr size_t  MAX_PATH_LEN     = 4096;
+
+//don't bother compacting a cache file smaller than this
+static constexpr size_t  COMPACT_MIN_LEN  = 1 << 20;
+
+//where a record lives in the cache file, the entries stay on disk
+struct CacheRecord {
+    FileStamp stamp;
+    uint64_t  uuid;
+    uint64_t  n_leaves; //entries, leaves or segments
+    size_t    leaves_off;
+    size_t    rec_off;
+    size_t    rec_len;
+};
+
+using CacheKey = std::pair<std::string, uint8_t>; //path, scheme
+
+static std::mutex                      hash_cache_mtx;
+static int                             cache_fd  = -1;
+static size_t                          cache_len = 0;
+static std::map<CacheKey, CacheRecord> records;
+
+std::optional<FileStamp> fileStamp(const std::filesystem::path& f_path) {
+    struct stat st;
+    if (stat(f_path.c_str(), &st) < 0 || !S_ISREG(st.st_mode))
+        return std::nullopt;
+
+    FileStamp stamp;
+    stamp.dev      = st.st_dev;
+    stamp.ino      = st.st_ino;
+    stamp.f_size   = st.st_size;
+    stamp.mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    return stamp;
+}
+
+static void putU64(uint8_t* dest, uint64_t val) {
+    val = htobe64(val);
+    std::memcpy(dest, &val, sizeof(val));
+}
+
+static uint64_t getU64(const uint8_t* src) {
+    uint64_t val;
+    std::memcpy(&val, src, sizeof(val));
+    return be64toh(val);
+}
+
+//bytes per entry of a record of this kind
+static size_t entryLen(const uint8_t scheme) {
+    return scheme == SEGMENT_RECORD ? SEGMENT_ENTRY : sizeof(Digest);
+}
+
+//reads the record header at offset, returns its length or 0 if it's torn
+static size_t readRecord(int          fd,
+                         size_t       offset,
+                         size_t       f_len,
+                         CacheKey&    key,
+                         CacheRecord& rec) {
+    std::vector<uint8_t> buff;
+    auto res = readFileAt(fd, 4, offset, buff);
+    if (!res || res.value() != 4)
+        return 0;
+
+    uint32_t path_len;
+    std::memcpy(&path_len, buff.data(), 4);
+    path_len = be32toh(path_len);
+    if (path_len == 0 || path_len > MAX_PATH_LEN)
+        return 0;
+
+    size_t head_len = 4 + path_len + RECORD_FIXED_LEN;
+    res = readFileAt(fd, head_len - 4, offset + 4, buff);
+    if (!res || static_cast<size_t>(res.value()) != head_len - 4)
+        return 0;
+
+    const uint8_t* p = buff.data() + path_len;
+    key.first.assign(reinterpret_cast<const char*>(buff.data()), path_len);
+    key.second            = p[32];
+    rec.stamp.dev         = getU64(p);
+    rec.stamp.ino         = getU64(p+8);
+    rec.stamp.f_size      = getU64(p+16);
+    rec.stamp.mtime_ns    = static_cast<int64_t>(getU64(p+24));
+    rec.uuid              = getU64(p+33);
+    rec.n_leaves          = getU64(p+41);
+    rec.leaves_off        = offset + head_len;
+    rec.rec_off           = offset;
+
+    //entries can't run past the end of the file
+    if (rec.n_leaves > (f_len - std::min(f_len, rec.leaves_off)) / entryLen(key.second))
+        return 0;
+
+    rec.rec_len = head_len + rec.n_leaves * entryLen(key.second);
+    return rec.rec_len;
+}
+
+//rewrites the cache with only its live records, then swaps it in
+static int compactCache(const std::filesystem::path& c_path) {
+    std::filesystem::path tmp_path = c_path;
+    tmp_path += ".tmp";
+
+    int tmp_fd = open(tmp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (tmp_fd < 0)
+        return EXIT_FAILURE;
+
+    std::vector<uint8_t> buff(CACHE_MAGIC, CACHE_MAGIC + CACHE_HEADER_LEN);
+    size_t new_len = 0;
+    bool   ok      = EXIT_SUCCESS == writeFileAt(tmp_fd, buff, buff.size(), 0);
+    new_len       += buff.size();
+
+    std::map<CacheKey, CacheRecord> moved;
+    for (auto it = records.begin(); ok && it != records.end(); ++it) {
+        CacheRecord rec = it->second;
+        auto res = readFileAt(cache_fd, rec.rec_len, rec.rec_off, buff);
+        if (!res || static_cast<size_t>(res.value()) != rec.rec_len ||
+            EXIT_SUCCESS != writeFileAt(tmp_fd, buff, rec.rec_len, new_len)) {
+            ok = false;
+            break;
+        }
+
+        rec.leaves_off = new_len + (rec.leaves_off - rec.rec_off);
+        rec.rec_off    = new_len;
+        new_len       += rec.rec_len;
+        moved.emplace(it->first, rec);
+    }
+
+    if (!ok || fsync(tmp_fd) < 0 || rename(tmp_path.c_str(), c_path.c_str()) < 0) {
+        close(tmp_fd);
+        unlink(tmp_path.c_str());
+        return EXIT_FAILURE;
+    }
+
+    close(cache_fd);
+    cache_fd  = tmp_fd;
+    cache_len = new_len;
+    records.swap(moved);
+    return EXIT_SUCCESS;
+}
+
+int loadHashCache(const std::filesystem::path& c_path) {
+    std::lock_guard<std::mutex> lock(hash_cache_mtx);
+    if (cache_fd >= 0) {
+        close(cache_fd);
+        cache_fd = -1;
+    }
+    records.clear();
+
+    int fd = open(c_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        if (fd >= 0) close(fd);
+        return EXIT_FAILURE;
+    }
+
+    size_t f_len = st.st_size;
+    std::vector<uint8_t> header;
+    auto res  = readFileAt(fd, CACHE_HEADER_LEN, 0, header);
+    bool read = res && static_cast<size_t>(res.value()) == CACHE_HEADER_LEN;
+    if (read && std::memcmp(header.data(), CACHE_MAGIC, CACHE_HEADER_LEN-1) == 0 &&
+        header[CACHE_HEADER_LEN-1] == CACHE_V1) {
+        //v1 records read the same, only older builds mustn't see segments
+        header.assign(CACHE_MAGIC, CACHE_MAGIC + CACHE_HEADER_LEN);
+        if (EXIT_SUCCESS != writeFileAt(fd, header, CACHE_HEADER_LEN, 0)) {
+            close(fd);
+            return EXIT_FAILURE;
+        }
+    }
+    if (!read || std::memcmp(header.data(), CACHE_MAGIC, CACHE_HEADER_LEN) != 0) {
+        //new, or not ours to read, start over
+        header.assign(CACHE_MAGIC, CACHE_MAGIC + CACHE_HEADER_LEN);
+        if (ftruncate(fd, 0) < 0 ||
+            EXIT_SUCCESS != writeFileAt(fd, header, CACHE_HEADER_LEN, 0)) {
+            close(fd);
+            return EXIT_FAILURE;
+        }
+        f_len = CACHE_HEADER_LEN;
+    }
+
+    size_t offset   = CACHE_HEADER_LEN;
+    size_t live_len = CACHE_HEADER_LEN;
+    while (offset < f_len) {
+        CacheKey    key;
+        CacheRecord rec;
+        size_t rec_len = readRecord(fd, offset, f_len, key, rec);
+        if (rec_len == 0)
+            break;
+
+        auto it = records.find(key);
+        if (it != records.end())
+            live_len -= it->second.rec_len;
+        records[key] = rec;
+        live_len    += rec_len;
+        offset      += rec_len;
+    }
+
+    //drop anything torn off the end by a crash mid-append
+    if (offset < f_len && ftruncate(fd, offset) < 0) {
+        close(fd);
+        records.clear();
+        return EXIT_FAILURE;
+    }
+
+    cache_fd  = fd;
+    cache_len = offset;
+
+    //mostly dead records, rewrite it. if that fails the old one still works
+    if (cache_len > COMPACT_MIN_LEN && cache_len > 2 * live_len)
+        compactCache(c_path);
+
+    return EXIT_SUCCESS;
+}
+
+std::optional<uint64_t> cachedUuid(const std::filesystem::path& f_path,
+                                   const FileStamp&             stamp,
+                                   const uint8_t                scheme,
+                                         std::vector<Digest>*   leaves) {
+    std::lock_guard<std::mutex> lock(hash_cache_mtx);
+    if (cache_fd < 0)
+        return std::nullopt;
+
+    auto it = records.find({f_path.string(), scheme});
+    if (it == records.end() || !(it->second.stamp == stamp))
+        return std::nullopt;
+
+    const CacheRecord& rec = it->second;
+    if (leaves) {
+        std::vector<uint8_t> buff;
+        size_t len = rec.n_leaves * sizeof(Digest);
+        auto   res = readFileAt(cache_fd, len, rec.leaves_off, buff);
+        if (!res || static_cast<size_t>(res.value()) != len)
+            return std::nullopt;
+
+        leaves->resize(rec.n_leaves);
+        if (len > 0)
+            std::memcpy(leaves->data(), buff.data(), len);
+    }
+
+    return rec.uuid;
+}
+
+//appends a record whose n_entries entries are already packed into buff past
+//its header, which is written here
+static int appendRecord(const std::filesystem::path& f_path,
+                        const FileStamp&             stamp,
+                        const uint8_t                scheme,
+                        const uint64_t               uuid,
+                        const uint64_t               n_entries,
+                              std::vector<uint8_t>&  buff) {
+    std::string path     = f_path.string();
+    size_t      head_len = 4 + path.size() + RECORD_FIXED_LEN;
+
+    uint32_t be_len = htobe32(static_cast<uint32_t>(path.size()));
+    std::memcpy(buff.data(), &be_len, 4);
+    std::memcpy(buff.data()+4, path.data(), path.size());
+
+    uint8_t* p = buff.data() + 4 + path.size();
+    putU64(p,    stamp.dev);
+    putU64(p+8,  stamp.ino);
+    putU64(p+16, stamp.f_size);
+    putU64(p+24, static_cast<uint64_t>(stamp.mtime_ns));
+    p[32] = scheme;
+    putU64(p+33, uuid);
+    putU64(p+41, n_entries);
+
+    std::lock_guard<std::mutex> lock(hash_cache_mtx);
+    if (cache_fd < 0)
+        return EXIT_FAILURE;
+
+    if (EXIT_SUCCESS != writeFileAt(cache_fd, buff, buff.size(), cache_len)) {
+        //don't leave half a record for the next one to land after
+        if (ftruncate(cache_fd, cache_len) < 0) {
+            close(cache_fd);
+            cache_fd = -1;
+        }
+        return EXIT_FAILURE;
+    }
+
+    CacheRecord rec;
+    rec.stamp      = stamp;
+    rec.uuid       = uuid;
+    rec.n_leaves   = n_entries;
+    rec.leaves_off = cache_len + head_len;
+    rec.rec_off    = cache_len;
+    rec.rec_len    = buff.size();
+    records[{path, scheme}] = rec;
+    cache_len += buff.size();
+    return EXIT_SUCCESS;
+}
+
+int storeUuid(const std::filesystem::path& f_path,
+              const FileStamp&             stamp,
+              const uint8_t                scheme,
+              const uint64_t               uuid,
+              const std::vector<Digest>&   leaves) {
+    std::string path = f_path.string();
+    if (path.empty() || path.size() > MAX_PATH_LEN || scheme == SEGMENT_RECORD)
+        return EXIT_FAILURE;
+
+    size_t head_len = 4 + path.size() + RECORD_FIXED_LEN;
+    std::vector<uint8_t> buff(head_len + leaves.size() * sizeof(Digest));
+    if (!leaves.empty())
+        std::memcpy(buff.data() + head_len, leaves.data(), leaves.size() * sizeof(Digest));
+    return appendRecord(f_path, stamp, scheme, uuid, leaves.size(), buff);
+}
+
+std::optional<std::vector<Segment>> cachedSegments(const std::filesystem::path& f_path,
+                                                   const FileStamp&             stamp) {
+    std::lock_guard<std::mutex> lock(hash_cache_mtx);
+    if (cache_fd < 0)
+        return std::nullopt;
+
+    auto it = records.find({f_path.string(), SEGMENT_RECORD});
+    if (it == records.end() || !(it->second.stamp == stamp))
+        return std::nullopt;
+
+    const CacheRecord&   rec = it->second;
+    std::vector<uint8_t> buff;
+    size_t len = rec.n_leaves * SEGMENT_ENTRY;
+    auto   res = readFileAt(cache_fd, len, rec.leaves_off, buff);
+    if (!res || static_cast<size_t>(res.value()) != len)
+        return std::nullopt;
+
+    std::vector<Segment> segments(rec.n_leaves);
+    uint64_t             offset = 0;
+    for (size_t i = 0; i < segments.size(); ++i) {
+        const uint8_t* p = buff.data() + i * SEGMENT_ENTRY;
+        uint32_t       seg_len;
+        std::memcpy(&seg_len, p, 4);
+        segments[i].offset = offset;
+        segments[i].len    = be32toh(seg_len);
+        std::memcpy(segments[i].digest.data(), p+4, sizeof(Digest));
+        offset += segments[i].len;
+    }
+
+    //they have to cover the file exactly, or the record's not this file's
+    if (offset != stamp.f_size)
+        return std::nullopt;
+    return segments;
+}
+
+int storeSegments(const std::filesystem::path& f_path,
+                  const FileStamp&             stamp,
+                  const std::vector<Segment>&  segments) {
+    std::string path = f_path.string();
+    if (path.empty() || path.size() > MAX_PATH_LEN)
+        return EXIT_FAILURE;
+
+    size_t head_len = 4 + path.size() + RECORD_FIXED_LEN;
+    std::vector<uint8_t> buff(head_len + segments.size() * SEGMENT_ENTRY);
+    for (size_t i = 0; i < segments.size(); ++i) {
+        uint8_t* p       = buff.data() + head_len + i * SEGMENT_ENTRY;
+        uint32_t seg_len = htobe32(segments[i].len);
+        std::memcpy(p, &seg_len, 4);
+        std::memcpy(p+4, segments[i].digest.data(), sizeof(Digest));
+    }
+    return appendRecord(f_path, stamp, SEGMENT_RECORD, 0, segments.size(), buff);
+}
+
+} //dfd
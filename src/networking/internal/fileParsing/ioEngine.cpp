@@ -0,0 +1,476 @@
+#include "networking/internal/fileParsing/ioEngine.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <thread>
+#include <unistd.h>
+
+#if IO_URING_ENGINE && __has_include(<linux/io_uring.h>) && defined(__NR_io_uring_setup)
+#define HAVE_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#else
+#define HAVE_IO_URING 0
+#endif
+
+namespace dfd {
+
+//what every engine has to provide
+struct IoEngine {
+    virtual ~IoEngine() = default;
+    virtual void        submit(std::vector<IoRequest>& batch) = 0;
+    virtual const char* name() const = 0;
+};
+
+//the part of req's buffers still to go once done bytes have been transferred
+static void remainingIov(const IoRequest& req, size_t done, std::vector<struct iovec>& out) {
+    out.clear();
+    if (req.iov.empty()) {
+        out.push_back({req.buff + done, req.len - done});
+        return;
+    }
+
+    for (const struct iovec& v : req.iov) {
+        if (done >= v.iov_len) {
+            done -= v.iov_len;
+            continue;
+        }
+        out.push_back({static_cast<uint8_t*>(v.iov_base) + done, v.iov_len - done});
+        done = 0;
+    }
+}
+
+//does a whole request with blocking calls, retrying short transfers
+static ssize_t runBlocking(const IoRequest& req) {
+    size_t                    total = 0;
+    std::vector<struct iovec> iov;
+    while (total < req.len) {
+        remainingIov(req, total, iov);
+        ssize_t res = req.op == IO_READ
+                    ? preadv(req.fd,  iov.data(), iov.size(), req.offset+total)
+                    : pwritev(req.fd, iov.data(), iov.size(), req.offset+total);
+        if (res < 0 && errno == EINTR)
+            continue;
+        if (res < 0)
+            return -errno;
+        if (res == 0) {
+            if (req.op == IO_WRITE)
+                return -EIO; //pwrite() making no progress
+            break; //EOF
+        }
+        total += res;
+    }
+    return total;
+}
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * ThreadEngine
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * The fallback, a queue drained by IO_POOL_THREADS threads doing blocking I/O.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+struct ThreadEngine : IoEngine {
+    std::mutex               mtx;
+    std::condition_variable  has_work;
+    std::condition_variable  has_room;
+    std::deque<IoRequest>    queue;
+    size_t                   in_flight = 0;
+    bool                     stopping  = false;
+    std::vector<std::thread> workers;
+
+    ThreadEngine() {
+        for (int i = 0; i < IO_POOL_THREADS; ++i)
+            workers.emplace_back([this] { work(); });
+    }
+
+    ~ThreadEngine() override {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        has_work.notify_all();
+        for (auto& w : workers) w.join(); //queue is drained first
+    }
+
+    void submit(std::vector<IoRequest>& batch) override {
+        std::unique_lock<std::mutex> lock(mtx);
+        for (IoRequest& req : batch) {
+            has_room.wait(lock, [this] { return in_flight < IO_ENGINE_DEPTH; });
+            queue.push_back(std::move(req));
+            in_flight++;
+            has_work.notify_one();
+        }
+    }
+
+    const char* name() const override {
+        return "threads";
+    }
+
+    void work() {
+        std::unique_lock<std::mutex> lock(mtx);
+        while (true) {
+            has_work.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (queue.empty())
+                return; //stopping, and nothing left
+
+            IoRequest req = std::move(queue.front());
+            queue.pop_front();
+            lock.unlock();
+
+            ssize_t res = runBlocking(req);
+            req.done(res);
+
+            lock.lock();
+            in_flight--;
+            has_room.notify_one();
+        }
+    }
+};
+
+#if HAVE_IO_URING
+
+static int uringSetup(unsigned entries, struct io_uring_params* params) {
+    return syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int uringEnter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int uringRegister(int fd, unsigned opcode, void* arg, unsigned nr_args) {
+    return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+//a request on the ring, remembers how far it got for short transfers
+struct RingRequest {
+    IoRequest                 req;
+    size_t                    transferred = 0;
+    std::vector<struct iovec> iov;
+};
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * UringEngine
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * submit() only queues requests and pokes event_fd. A single ring thread owns
+ * the ring: it moves everything queued onto the submission ring, hands the
+ * batch to the kernel with one io_uring_enter(), reaps completions, resubmits
+ * the rest of any short transfer and calls the callbacks. The kernel pokes
+ * the same event_fd whenever a completion is posted, so the ring thread only
+ * ever sleeps in read() on it.
+ *
+ * Only the ring thread enters the ring because the kernel cancels work still
+ * queued by a thread when that thread exits, and download threads exit as
+ * soon as they run out of chunks to fetch.
+ *
+ * The ring is sized so IO_ENGINE_DEPTH requests fit on it, and submit() never
+ * lets more than that be in flight, so neither ring can overflow. Requests
+ * put on the submission ring are tracked until the kernel takes them, so an
+ * enter that only takes some is retried with the rest, and one that fails
+ * outright takes them back off the ring and completes them with its error.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+struct UringEngine : IoEngine {
+    int                       ring_fd  = -1;
+    int                       event_fd = -1;
+    void*                     sq_ptr   = MAP_FAILED;
+    size_t                    sq_len   = 0;
+    void*                     cq_ptr   = MAP_FAILED;
+    size_t                    cq_len   = 0;
+    void*                     sqes_ptr = MAP_FAILED;
+    size_t                    sqes_len = 0;
+
+    unsigned*                 sq_tail;
+    unsigned*                 sq_mask;
+    unsigned*                 sq_array;
+    struct io_uring_sqe*      sqes;
+    unsigned*                 cq_head;
+    unsigned*                 cq_tail;
+    unsigned*                 cq_mask;
+    struct io_uring_cqe*      cqes;
+
+    std::mutex                mtx;
+    std::condition_variable   has_room;
+    std::deque<RingRequest*>  waiting;       //submitted, not on the ring yet
+    size_t                    in_flight = 0; //submitted, callback not run yet
+    std::deque<RingRequest*>  unsubmitted;   //on the ring, not taken yet. ring thread only
+    bool                      stopping  = false;
+    std::thread               ring_thread;
+
+    ~UringEngine() override {
+        if (ring_thread.joinable()) {
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                has_room.wait(lock, [this] { return in_flight == 0; });
+                stopping = true;
+            }
+            poke();
+            ring_thread.join();
+        }
+
+        if (sqes_ptr != MAP_FAILED)
+            munmap(sqes_ptr, sqes_len);
+        if (cq_ptr != MAP_FAILED && cq_ptr != sq_ptr)
+            munmap(cq_ptr, cq_len);
+        if (sq_ptr != MAP_FAILED)
+            munmap(sq_ptr, sq_len);
+        if (ring_fd >= 0)
+            close(ring_fd);
+        if (event_fd >= 0)
+            close(event_fd);
+    }
+
+    static std::unique_ptr<UringEngine> create() {
+        auto engine = std::make_unique<UringEngine>();
+
+        struct io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        engine->ring_fd = uringSetup(IO_ENGINE_DEPTH, &params);
+        if (engine->ring_fd < 0)
+            return nullptr; //ENOSYS, EPERM, ...
+
+        engine->event_fd = eventfd(0, EFD_CLOEXEC);
+        if (engine->event_fd < 0 ||
+            uringRegister(engine->ring_fd, IORING_REGISTER_EVENTFD, &engine->event_fd, 1) < 0)
+            return nullptr;
+
+        engine->sq_len   = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        engine->cq_len   = params.cq_off.cqes  + params.cq_entries * sizeof(struct io_uring_cqe);
+        engine->sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+
+        bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single_mmap)
+            engine->sq_len = engine->cq_len = std::max(engine->sq_len, engine->cq_len);
+
+        engine->sq_ptr = mmap(nullptr, engine->sq_len, PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_POPULATE, engine->ring_fd, IORING_OFF_SQ_RING);
+        if (engine->sq_ptr == MAP_FAILED)
+            return nullptr;
+
+        engine->cq_ptr = single_mmap
+                       ? engine->sq_ptr
+                       : mmap(nullptr, engine->cq_len, PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_POPULATE, engine->ring_fd, IORING_OFF_CQ_RING);
+        if (engine->cq_ptr == MAP_FAILED)
+            return nullptr;
+
+        engine->sqes_ptr = mmap(nullptr, engine->sqes_len, PROT_READ | PROT_WRITE,
+                                MAP_SHARED | MAP_POPULATE, engine->ring_fd, IORING_OFF_SQES);
+        if (engine->sqes_ptr == MAP_FAILED)
+            return nullptr;
+
+        uint8_t* sq = static_cast<uint8_t*>(engine->sq_ptr);
+        uint8_t* cq = static_cast<uint8_t*>(engine->cq_ptr);
+        engine->sq_tail  = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        engine->sq_mask  = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        engine->sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        engine->sqes     = static_cast<struct io_uring_sqe*>(engine->sqes_ptr);
+        engine->cq_head  = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        engine->cq_tail  = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        engine->cq_mask  = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        engine->cqes     = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+
+        UringEngine* raw    = engine.get();
+        engine->ring_thread = std::thread([raw] { raw->run(); });
+        return engine;
+    }
+
+    const char* name() const override {
+        return "io_uring";
+    }
+
+    void submit(std::vector<IoRequest>& batch) override {
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            for (IoRequest& req : batch) {
+                if (in_flight >= IO_ENGINE_DEPTH) {
+                    //let the ring thread start on what we have while we wait
+                    lock.unlock();
+                    poke();
+                    lock.lock();
+                    has_room.wait(lock, [this] { return in_flight < IO_ENGINE_DEPTH; });
+                }
+
+                RingRequest* r = new RingRequest;
+                r->req = std::move(req);
+                waiting.push_back(r);
+                in_flight++;
+            }
+        }
+        poke();
+    }
+
+    //wakes the ring thread
+    void poke() {
+        uint64_t one = 1;
+        while (write(event_fd, &one, sizeof(one)) < 0 && errno == EINTR);
+    }
+
+    //fills the next sqe with what's still left of r. ring thread only
+    void prepSqe(RingRequest* r) {
+        remainingIov(r->req, r->transferred, r->iov);
+
+        unsigned tail = *sq_tail;
+        unsigned idx  = tail & *sq_mask;
+        struct io_uring_sqe* sqe = &sqes[idx];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode    = r->req.op == IO_READ ? IORING_OP_READV : IORING_OP_WRITEV;
+        sqe->fd        = r->req.fd;
+        sqe->addr      = reinterpret_cast<uint64_t>(r->iov.data());
+        sqe->len       = r->iov.size();
+        sqe->off       = r->req.offset + r->transferred;
+        sqe->user_data = reinterpret_cast<uint64_t>(r);
+        sq_array[idx]  = idx;
+
+        //sqe has to be visible to the kernel before the tail moves past it
+        __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+        unsubmitted.push_back(r);
+    }
+
+    //hands every unsubmitted sqe to the kernel. ring thread only
+    void enter() {
+        while (!unsubmitted.empty()) {
+            int res = uringEnter(ring_fd, unsubmitted.size(), 0, 0);
+            if (res < 0 && (errno == EINTR || errno == EAGAIN || errno == EBUSY))
+                continue;
+            if (res <= 0) {
+                fail(res < 0 ? -errno : -EIO);
+                return;
+            }
+
+            //the kernel takes sqes in the order they went on the ring
+            for (int i = 0; i < res; ++i)
+                unsubmitted.pop_front();
+        }
+    }
+
+    //takes every unsubmitted sqe back off the ring and completes its request
+    //with err. the kernel only looks at the ring in enter(), which only this
+    //thread calls, so moving the tail back is safe. ring thread only
+    void fail(int err) {
+        unsigned tail = *sq_tail;
+        __atomic_store_n(sq_tail, tail - static_cast<unsigned>(unsubmitted.size()), __ATOMIC_RELEASE);
+
+        size_t failed = unsubmitted.size();
+        for (RingRequest* r : unsubmitted) {
+            r->req.done(err);
+            delete r;
+        }
+        unsubmitted.clear();
+
+        std::lock_guard<std::mutex> lock(mtx);
+        in_flight -= failed;
+        has_room.notify_all();
+    }
+
+    void run() {
+        std::deque<RingRequest*> batch;
+        while (true) {
+            uint64_t events;
+            if (read(event_fd, &events, sizeof(events)) < 0 && errno == EINTR)
+                continue;
+
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                if (stopping)
+                    return; //only set once nothing is in flight
+                batch.swap(waiting);
+            }
+
+            for (RingRequest* r : batch)
+                prepSqe(r);
+            enter();
+            batch.clear();
+
+            reap();
+        }
+    }
+
+    //handles every completion posted so far. ring thread only
+    void reap() {
+        unsigned resubmit = 0;
+        size_t   finished = 0;
+        unsigned head     = *cq_head;
+        unsigned tail     = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head) {
+            struct io_uring_cqe* cqe = &cqes[head & *cq_mask];
+            RingRequest*         r   = reinterpret_cast<RingRequest*>(cqe->user_data);
+            int                  res = cqe->res;
+
+            if (res == -EINTR || res == -EAGAIN || (res > 0 && r->transferred + res < r->req.len)) {
+                //interrupted or short, send the rest back around
+                if (res > 0) r->transferred += res;
+                prepSqe(r);
+                resubmit++;
+                continue;
+            }
+
+            ssize_t result;
+            if (res < 0)
+                result = res;
+            else if (res == 0 && r->req.op == IO_WRITE && r->transferred < r->req.len)
+                result = -EIO; //no progress
+            else
+                result = r->transferred + res;
+
+            r->req.done(result);
+            delete r;
+            finished++;
+        }
+        __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+
+        if (resubmit > 0)
+            enter();
+
+        if (finished > 0) {
+            std::lock_guard<std::mutex> lock(mtx);
+            in_flight -= finished;
+            has_room.notify_all();
+        }
+    }
+};
+
+#endif
+
+static std::once_flag            engine_once;
+static std::unique_ptr<IoEngine> engine;
+
+static void startEngine() {
+#if HAVE_IO_URING
+    engine = UringEngine::create();
+#endif
+    if (!engine)
+        engine = std::make_unique<ThreadEngine>();
+}
+
+int submitIo(std::vector<IoRequest>& batch) {
+    std::call_once(engine_once, startEngine);
+    if (!engine)
+        return EXIT_FAILURE;
+
+    for (IoRequest& req : batch) {
+        if (req.iov.empty())
+            continue;
+        req.len = 0;
+        for (const struct iovec& v : req.iov)
+            req.len += v.iov_len;
+    }
+
+    engine->submit(batch);
+    return EXIT_SUCCESS;
+}
+
+const char* ioEngineName() {
+    return engine ? engine->name() : "none";
+}
+
+} //dfd
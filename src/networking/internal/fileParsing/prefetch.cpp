@@ -0,0 +1,156 @@
+#include "networking/internal/fileParsing/prefetch.hpp"
+#include "networking/internal/fileParsing/fileCache.hpp"
+#include "networking/internal/fileParsing/ioEngine.hpp"
+#include "networking/internal/fileParsing/seedPolicy.hpp"
+
+#include <algorithm>
+#include <atomic>
+
+namespace dfd {
+
+static std::atomic<uint64_t> total_hits   = 0;
+static std::atomic<uint64_t> total_misses = 0;
+static std::atomic<uint64_t> total_wasted = 0;
+
+static size_t chunkLen(const SeedPrefetcher& p, const size_t chunk) {
+    size_t f_size = static_cast<size_t>(p.file->f_size);
+    return std::min(p.c_size, f_size - chunk*p.c_size);
+}
+
+//sets up a read of a guess, to submit once p->mtx is let go. the engine's
+//callbacks need it. caller holds p->mtx
+static std::optional<IoRequest> prepRead(const std::shared_ptr<SeedPrefetcher>& p,
+                                         const size_t                           chunk) {
+    //guesses are the first thing to go when memory is short
+    auto slot  = std::make_shared<PrefetchSlot>();
+    slot->buff = tryTakeBuffer(chunkLen(*p, chunk));
+    if (!slot->buff)
+        return std::nullopt;
+    p->slots[chunk] = slot;
+
+    IoRequest req;
+    req.op     = IO_READ;
+    req.fd     = p->file->fd;
+    req.buff   = slot->buff->data();
+    req.len    = slot->buff->size();
+    req.offset = chunk*p->c_size;
+    req.done   = [p, slot](ssize_t res) {
+        std::lock_guard<std::mutex> lock(p->mtx);
+        slot->res   = res;
+        slot->ready = true;
+        p->filled.notify_all();
+    };
+    return req;
+}
+
+std::shared_ptr<SeedPrefetcher> createPrefetcher(const std::shared_ptr<FileHandle>& file,
+                                                 const size_t                       c_size) {
+    if (!file || c_size == 0)
+        return nullptr;
+
+    auto p      = std::make_shared<SeedPrefetcher>();
+    p->file     = file;
+    p->c_size   = c_size;
+    p->f_chunks = (static_cast<size_t>(file->f_size) + c_size - 1) / c_size;
+    p->depth    = std::clamp<size_t>(SEED_PREFETCH_BYTES / c_size, 1, SEED_PREFETCH_CHUNKS);
+    return p;
+}
+
+PooledBuffer takePrefetched(const std::shared_ptr<SeedPrefetcher>& p,
+                            const size_t                           chunk) {
+    if (!p)
+        return nullptr;
+
+    std::unique_lock<std::mutex> lock(p->mtx);
+    PooledBuffer ret;
+
+    auto it = p->slots.find(chunk);
+    if (it != p->slots.end()) {
+        auto slot = it->second;
+        p->slots.erase(it);
+        p->filled.wait(lock, [&] { return slot->ready; });
+
+        //a short read means the file shrank, let the normal path find out
+        if (slot->res >= 0 && static_cast<size_t>(slot->res) == slot->buff->size())
+            ret = std::move(slot->buff);
+    }
+
+    if (ret) {
+        total_hits++;
+        //the page cache policy drops it the same as a chunk read now
+        seedServed(*p->file, chunk*p->c_size, ret->size());
+    } else {
+        total_misses++;
+    }
+
+    //guess the step from the last two requests
+    size_t step = 1;
+    if (p->last && chunk > p->last.value()) {
+        size_t delta = chunk - p->last.value();
+        if (delta == p->step)
+            step = delta;
+        p->step = delta;
+    }
+    p->last = chunk;
+
+    //guesses that aren't ahead any more won't be asked for
+    std::vector<size_t> wanted;
+    for (size_t k = 1; k <= p->depth; ++k) {
+        size_t next = chunk + step*k;
+        if (next >= p->f_chunks)
+            break;
+        wanted.push_back(next);
+    }
+
+    for (auto s = p->slots.begin(); s != p->slots.end();) {
+        if (std::find(wanted.begin(), wanted.end(), s->first) == wanted.end()) {
+            total_wasted++;
+            s = p->slots.erase(s); //a read in flight holds on to its slot
+        } else {
+            ++s;
+        }
+    }
+
+    //O_DIRECT files are kept out of the page cache, reading ahead through it
+    //would defeat that
+    std::vector<IoRequest> batch;
+    if (p->file->valid && p->file->policy != SEED_DIRECT) {
+        for (size_t next : wanted) {
+            if (p->slots.count(next))
+                continue;
+            auto req = prepRead(p, next);
+            if (!req)
+                break;
+            batch.push_back(std::move(req.value()));
+        }
+    }
+    lock.unlock();
+
+    if (!batch.empty() && EXIT_SUCCESS != submitIo(batch))
+        for (IoRequest& req : batch)
+            req.done(-1); //no engine, every guess misses
+
+    return ret;
+}
+
+void closePrefetcher(std::shared_ptr<SeedPrefetcher>& p) {
+    if (!p)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(p->mtx);
+        total_wasted += p->slots.size();
+        p->slots.clear();
+    }
+    p.reset();
+}
+
+PrefetchStats prefetchTotals() {
+    PrefetchStats stats;
+    stats.hits   = total_hits;
+    stats.misses = total_misses;
+    stats.wasted = total_wasted;
+    return stats;
+}
+
+} //dfd
@@ -0,0 +1,177 @@
+#include "networking/internal/fileParsing/seedPolicy.hpp"
+#include "networking/internal/fileParsing/fileCache.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+namespace dfd {
+
+//files with less than this left of their count are forgotten
+static constexpr double SEED_FORGET_BELOW = 0.05;
+
+//most files remembered before the cold ones are forgotten
+static constexpr size_t SEED_TRACKED_FILES = 4096;
+
+//served ranges are dropped starting this far back. the page cache holds files in
+//folios bigger than a page, and a folio straddling the end of the last chunk
+//isn't dropped until a range covers all of it
+static constexpr off_t SEED_DROP_BEHIND = 4 << 20;
+
+//recent sessions of every file seeded, decayed to when they were last touched
+struct SeedAccess {
+    double  sessions = 0;
+    int64_t last_ns  = 0;
+};
+
+static std::mutex                                    policy_mtx;
+static std::map<std::pair<dev_t, ino_t>, SeedAccess> seed_access;
+
+static int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static double decayed(const SeedAccess& access, const int64_t now_ns) {
+    double elapsed = static_cast<double>(now_ns - access.last_ns) / 1e9;
+    return access.sessions * std::exp2(-elapsed / SEED_HOT_HALF_LIFE);
+}
+
+//caller holds policy_mtx
+static void forgetCold(const int64_t now_ns) {
+    for (auto it = seed_access.begin(); it != seed_access.end();) {
+        if (decayed(it->second, now_ns) < SEED_FORGET_BELOW)
+            it = seed_access.erase(it);
+        else
+            ++it;
+    }
+}
+
+//caller holds policy_mtx
+static bool openDirect(FileHandle& file) {
+    if (file.direct_fd >= 0)
+        return true;
+
+    int fd = open(file.f_path.c_str(), O_RDONLY | O_DIRECT | O_CLOEXEC);
+    if (fd < 0)
+        return false; //filesystem doesn't support it
+
+    //has to be the file the handle has open, not whatever's at the path now
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_dev != file.dev || st.st_ino != file.ino) {
+        close(fd);
+        return false;
+    }
+
+    file.direct_fd = fd;
+    return true;
+}
+
+uint8_t chooseSeedPolicy(FileHandle& file) {
+    std::lock_guard<std::mutex> lock(policy_mtx);
+    int64_t now_ns = nowNs();
+
+    if (seed_access.size() >= SEED_TRACKED_FILES)
+        forgetCold(now_ns);
+
+    SeedAccess& access = seed_access[{file.dev, file.ino}];
+    access.sessions    = decayed(access, now_ns) + 1;
+    access.last_ns     = now_ns;
+
+    uint8_t policy = SEED_CACHED;
+    if (file.f_size >= SEED_COLD_MIN_SIZE && access.sessions < SEED_HOT_SESSIONS) {
+        policy = SEED_STREAM;
+        if (SEED_DIRECT_IO && file.f_size >= SEED_DIRECT_MIN_SIZE && openDirect(file))
+            policy = SEED_DIRECT;
+    }
+
+    //the hint is on the shared fd, so it only changes with the policy
+    if (policy != file.policy) {
+        int advice = policy == SEED_CACHED ? POSIX_FADV_NORMAL : POSIX_FADV_SEQUENTIAL;
+        posix_fadvise(file.fd, 0, 0, advice);
+    }
+    file.policy = policy;
+    return policy;
+}
+
+void seedReadahead(const FileHandle& file, const off_t offset, const size_t len) {
+    if (file.policy != SEED_STREAM)
+        return;
+
+    off_t ahead = offset + static_cast<off_t>(len);
+    if (ahead < file.f_size)
+        posix_fadvise(file.fd, ahead, SEED_READAHEAD_BYTES, POSIX_FADV_WILLNEED);
+}
+
+void seedServed(const FileHandle& file, const off_t offset, const size_t len) {
+    if (file.policy != SEED_STREAM || len == 0)
+        return;
+
+    off_t start = std::max<off_t>(0, offset - SEED_DROP_BEHIND);
+    posix_fadvise(file.fd, start, offset + static_cast<off_t>(len) - start, POSIX_FADV_DONTNEED);
+}
+
+//aligned scratch space for O_DIRECT, one per thread
+struct AlignedBuffer {
+    std::unique_ptr<uint8_t, decltype(&std::free)> data{nullptr, &std::free};
+    size_t                                         cap = 0;
+};
+
+std::optional<ssize_t> readDirect(const FileHandle&           file,
+                                  const size_t                read_size,
+                                  const size_t                offset,
+                                        std::vector<uint8_t>& buff) {
+    int fd = file.direct_fd;
+    if (fd < 0)
+        return std::nullopt;
+
+    size_t start = offset & ~static_cast<size_t>(SEED_DIRECT_ALIGN - 1);
+    size_t end   = (offset + read_size + SEED_DIRECT_ALIGN - 1) & ~static_cast<size_t>(SEED_DIRECT_ALIGN - 1);
+    size_t span  = end - start;
+
+    thread_local AlignedBuffer scratch;
+    if (scratch.cap < span) {
+        void* mem = nullptr;
+        if (0 != posix_memalign(&mem, SEED_DIRECT_ALIGN, span))
+            return std::nullopt;
+        scratch.data.reset(static_cast<uint8_t*>(mem));
+        scratch.cap = span;
+    }
+
+    size_t total_read = 0;
+    while (total_read < span) {
+        ssize_t res = pread(fd,
+                            scratch.data.get()+total_read,
+                            span-total_read,
+                            start+total_read);
+        if (res < 0 && errno == EINTR)
+            continue;
+        if (res < 0)
+            return std::nullopt;
+        if (res == 0)
+            break; //EOF
+        total_read += res;
+
+        //only the last read of the file comes up short of alignment
+        if (total_read % SEED_DIRECT_ALIGN != 0)
+            break;
+    }
+
+    size_t skip = offset - start;
+    size_t got  = total_read > skip ? std::min(read_size, total_read - skip) : 0;
+    buff.resize(got);
+    std::memcpy(buff.data(), scratch.data.get() + skip, got);
+    return got;
+}
+
+} //dfd
@@ -0,0 +1,210 @@
+#include "networking/internal/fileParsing/streamVerify.hpp"
+#include "networking/internal/fileParsing/downloadFile.hpp"
+#include "networking/internal/fileParsing/fileUtil.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <endian.h>
+
+namespace dfd {
+
+//same as treeHash.cpp, so the leaves come out identical
+static constexpr uint8_t LEAF_PREFIX = 0x00;
+
+StreamVerifier::StreamVerifier()
+    :
+    whole (EVP_MD_CTX_new()),
+    leaf  (EVP_MD_CTX_new()) {
+    if (!whole || !leaf || 1 != EVP_DigestInit_ex(whole, EVP_sha256(), NULL))
+        failed = true;
+}
+
+StreamVerifier::~StreamVerifier() {
+    if (whole)
+        EVP_MD_CTX_free(whole);
+    if (leaf)
+        EVP_MD_CTX_free(leaf);
+}
+
+static size_t chunkLen(const DownloadFile& file, const size_t chunk) {
+    size_t f_size = static_cast<size_t>(file.f_size);
+    size_t offset = std::min(chunk*file.c_size, f_size);
+    return std::min(file.c_size, f_size - offset);
+}
+
+static bool openLeaf(StreamVerifier& v) {
+    if (1 != EVP_DigestInit_ex(v.leaf, EVP_sha256(), NULL) ||
+        1 != EVP_DigestUpdate(v.leaf, &LEAF_PREFIX, 1))
+        return false;
+    v.leaf_open = true;
+    v.leaf_fill = 0;
+    return true;
+}
+
+static bool closeLeaf(StreamVerifier& v) {
+    Digest       digest;
+    unsigned int out_len = 0;
+    if (1 != EVP_DigestFinal_ex(v.leaf, digest.data(), &out_len))
+        return false;
+    v.leaves.push_back(digest);
+    v.leaf_open = false;
+    return true;
+}
+
+//feeds the next bytes of the file to both digests. only the draining thread
+//calls this
+static bool hashBytes(StreamVerifier& v, const uint8_t* data, size_t len) {
+    if (1 != EVP_DigestUpdate(v.whole, data, len))
+        return false;
+
+    while (len > 0) {
+        if (!v.leaf_open && !openLeaf(v))
+            return false;
+
+        size_t take = std::min(len, TREE_LEAF_SIZE - v.leaf_fill);
+        if (1 != EVP_DigestUpdate(v.leaf, data, take))
+            return false;
+        data        += take;
+        len         -= take;
+        v.leaf_fill += take;
+
+        if (v.leaf_fill == TREE_LEAF_SIZE && !closeLeaf(v))
+            return false;
+    }
+
+    return true;
+}
+
+static bool hashFromDisk(      DownloadFile&         file,
+                               StreamVerifier&       v,
+                         const size_t                chunk,
+                               std::vector<uint8_t>& buff) {
+    size_t len = chunkLen(file, chunk);
+    auto   res = readFileAt(file.fd, len, chunk*file.c_size, buff);
+    return res && static_cast<size_t>(res.value()) == len && hashBytes(v, buff.data(), len);
+}
+
+//called with draining set. hashes forward from next until it reaches a chunk
+//that hasn't arrived, then hands draining back
+static void drain(DownloadFile& file, StreamVerifier& v) {
+    std::vector<uint8_t>         buff;
+    std::unique_lock<std::mutex> lock(v.mtx);
+    while (!v.failed && v.next < file.f_chunks) {
+        size_t chunk = v.next;
+        bool   ok;
+
+        auto it = v.held.find(chunk);
+        if (it != v.held.end()) {
+            auto data = std::move(it->second);
+            v.held.erase(it);
+            lock.unlock();
+            ok = hashBytes(v, data->data(), data->size());
+        } else if (hasChunk(file, chunk)) {
+            //was too far ahead to hold, or from an earlier attempt
+            lock.unlock();
+            ok = hashFromDisk(file, v, chunk, buff);
+        } else {
+            break; //not here yet
+        }
+
+        lock.lock();
+        if (ok)
+            v.next++;
+        else
+            v.failed = true;
+    }
+
+    v.draining = false;
+}
+
+void streamChunk(      DownloadFile&                                file,
+                 const size_t                                       chunk,
+                 const uint8_t*                                     data,
+                 const size_t                                       len,
+                 const std::shared_ptr<const std::vector<uint8_t>>& owner) {
+    if (!file.manifest.empty() || chunk >= file.f_chunks || len != chunkLen(file, chunk))
+        return;
+
+    StreamVerifier& v = file.verifier;
+    {
+        std::lock_guard<std::mutex> lock(v.mtx);
+        if (v.failed || chunk < v.next)
+            return; //already hashed
+
+        //whoever's draining will get to it, if it's close enough to hold
+        if (chunk != v.next || v.draining) {
+            size_t window = std::max<size_t>(1, VERIFY_REORDER_BYTES / file.c_size);
+            if (chunk != v.next && chunk - v.next < window && !v.held.count(chunk))
+                v.held[chunk] = owner ? owner : std::make_shared<const std::vector<uint8_t>>(data, data+len);
+            return;
+        }
+        v.draining = true;
+    }
+
+    bool ok = hashBytes(v, data, len);
+    {
+        std::lock_guard<std::mutex> lock(v.mtx);
+        if (!ok) {
+            v.failed   = true;
+            v.draining = false;
+            return;
+        }
+        v.next++;
+    }
+
+    drain(file, v);
+}
+
+std::optional<std::vector<size_t>> finishStream(DownloadFile& file) {
+    if (!file.manifest.empty())
+        return std::vector<size_t>();
+
+    StreamVerifier&             v = file.verifier;
+    std::lock_guard<std::mutex> lock(v.mtx);
+    if (v.draining)
+        return std::nullopt; //still being fed
+
+    //everything past the prefix, every chunk is on disk by now
+    std::vector<uint8_t> buff;
+    for (; !v.failed && v.next < file.f_chunks; ++v.next) {
+        auto it = v.held.find(v.next);
+        bool ok = it != v.held.end() ? hashBytes(v, it->second->data(), it->second->size())
+                                     : hashFromDisk(file, v, v.next, buff);
+        if (!ok)
+            v.failed = true;
+    }
+    v.held.clear();
+    if (v.failed)
+        return std::nullopt;
+
+    //an empty file is still one empty leaf
+    if (v.leaves.empty() && !v.leaf_open && !openLeaf(v))
+        return std::nullopt;
+    if (v.leaf_open && !closeLeaf(v))
+        return std::nullopt;
+
+    uint8_t      digest[EVP_MAX_MD_SIZE];
+    unsigned int hash_len = 0;
+    bool         ok       = 1 == EVP_DigestFinal_ex(v.whole, digest, &hash_len);
+    v.failed = true; //digests are spent
+    if (!ok)
+        return std::nullopt;
+
+    //read the same way sha256Hash() and treeUuid() do
+    uint64_t sha_uuid;
+    std::memcpy(&sha_uuid, digest, sizeof(sha_uuid));
+    sha_uuid = be64toh(sha_uuid);
+
+    auto     root      = treeRoot(v.leaves, 0, v.leaves.size());
+    uint64_t tree_uuid = root ? treeUuid(file.f_size, root.value()) : 0;
+
+    std::vector<size_t> bad;
+    if (sha_uuid == file.uuid || tree_uuid == file.uuid)
+        return bad;
+
+    for (size_t i = 0; i < file.f_chunks; ++i)
+        bad.push_back(i);
+    return bad;
+}
+
+} //dfd
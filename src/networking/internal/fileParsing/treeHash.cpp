@@ -0,0 +1,211 @@
+#include "networking/internal/fileParsing/treeHash.hpp"
+#include "networking/internal/fileParsing/fileCache.hpp"
+#include "networking/internal/fileParsing/fileUtil.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <endian.h>
+#include <openssl/evp.h>
+#include <thread>
+
+namespace dfd {
+
+static constexpr uint8_t LEAF_PREFIX = 0x00;
+static constexpr uint8_t NODE_PREFIX = 0x01;
+static constexpr uint8_t UUID_PREFIX = 0x02;
+
+//leaves read per pread() by each hashing thread
+static constexpr size_t LEAVES_PER_READ = 16;
+
+//SHA256(prefix || a || b), b may be empty
+static bool prefixedDigest(EVP_MD_CTX*    ctx,
+                           uint8_t        prefix,
+                           const uint8_t* a,
+                           size_t         a_len,
+                           const uint8_t* b,
+                           size_t         b_len,
+                           Digest&        out) {
+    unsigned int out_len = 0;
+    return 1 == EVP_DigestInit_ex(ctx, EVP_sha256(), NULL) &&
+           1 == EVP_DigestUpdate(ctx, &prefix, 1)          &&
+           1 == EVP_DigestUpdate(ctx, a, a_len)            &&
+           (b_len == 0 || 1 == EVP_DigestUpdate(ctx, b, b_len)) &&
+           1 == EVP_DigestFinal_ex(ctx, out.data(), &out_len);
+}
+
+std::optional<std::vector<Digest>> leafDigests(const std::shared_ptr<FileHandle>& file,
+                                               size_t                             threads) {
+    if (!file || !file->valid || file->f_size < 0)
+        return std::nullopt;
+
+    size_t f_size = static_cast<size_t>(file->f_size);
+    size_t leaves = std::max<size_t>(1, (f_size + TREE_LEAF_SIZE - 1) / TREE_LEAF_SIZE);
+
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min(threads, leaves);
+
+    std::vector<Digest> digests(leaves);
+    std::atomic<bool>   failed = false;
+
+    //each thread gets a contiguous run of leaves, so reads stay sequential
+    auto hashRun = [&](size_t first, size_t last) {
+        EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+        if (!ctx) {
+            failed = true;
+            return;
+        }
+
+        std::vector<uint8_t> buff;
+        for (size_t leaf = first; leaf < last && !failed; leaf += LEAVES_PER_READ) {
+            size_t batch  = std::min(LEAVES_PER_READ, last - leaf);
+            size_t offset = leaf * TREE_LEAF_SIZE;
+            size_t want   = std::min(batch * TREE_LEAF_SIZE, f_size - std::min(offset, f_size));
+
+            auto read_bytes = readFileAt(file->fd, want, offset, buff);
+            if (!read_bytes || static_cast<size_t>(read_bytes.value()) != want) {
+                failed = true; //file shrunk, or unreadable
+                break;
+            }
+
+            for (size_t i = 0; i < batch; ++i) {
+                size_t start = i * TREE_LEAF_SIZE;
+                size_t len   = std::min(TREE_LEAF_SIZE, want - std::min(start, want));
+                if (!prefixedDigest(ctx, LEAF_PREFIX, buff.data()+start, len, nullptr, 0, digests[leaf+i])) {
+                    failed = true;
+                    break;
+                }
+            }
+        }
+
+        EVP_MD_CTX_free(ctx);
+    };
+
+    std::vector<std::thread> workers;
+    size_t per_thread = leaves / threads;
+    size_t extra      = leaves % threads;
+    size_t next       = 0;
+    for (size_t t = 0; t < threads; ++t) {
+        size_t run = per_thread + (t < extra ? 1 : 0);
+        if (t == threads-1)
+            hashRun(next, next+run); //this thread does the last run itself
+        else
+            workers.emplace_back(hashRun, next, next+run);
+        next += run;
+    }
+
+    for (auto& w : workers) w.join();
+
+    if (failed)
+        return std::nullopt;
+    return digests;
+}
+
+std::optional<Digest> treeRoot(const std::vector<Digest>& nodes,
+                               size_t                     first,
+                               size_t                     count) {
+    if (count == 0 || first + count > nodes.size())
+        return std::nullopt;
+
+    std::vector<Digest> level(nodes.begin() + first, nodes.begin() + first + count);
+    if (level.size() == 1)
+        return level.front();
+
+    EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+    if (!ctx)
+        return std::nullopt;
+
+    while (level.size() > 1) {
+        std::vector<Digest> next((level.size() + 1) / 2);
+        for (size_t i = 0; i+1 < level.size(); i += 2) {
+            if (!prefixedDigest(ctx,
+                                NODE_PREFIX,
+                                level[i].data(),   level[i].size(),
+                                level[i+1].data(), level[i+1].size(),
+                                next[i/2])) {
+                EVP_MD_CTX_free(ctx);
+                return std::nullopt;
+            }
+        }
+
+        if (level.size() % 2 == 1)
+            next.back() = level.back(); //odd one out moves up as is
+        level.swap(next);
+    }
+
+    EVP_MD_CTX_free(ctx);
+    return level.front();
+}
+
+uint64_t treeUuid(const uint64_t f_size, const Digest& root) {
+    EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+    if (!ctx)
+        return 0;
+
+    uint64_t be_size = htobe64(f_size);
+    Digest   digest;
+    bool ok = prefixedDigest(ctx,
+                             UUID_PREFIX,
+                             reinterpret_cast<const uint8_t*>(&be_size), sizeof(be_size),
+                             root.data(), root.size(),
+                             digest);
+    EVP_MD_CTX_free(ctx);
+    if (!ok)
+        return 0;
+
+    //same as sha256Hash, first 8 bytes read big-endian on every host
+    uint64_t uuid;
+    std::memcpy(&uuid, digest.data(), sizeof(uuid));
+    return be64toh(uuid);
+}
+
+std::optional<size_t> leavesPerChunk(const size_t c_size) {
+    if (c_size == 0 || c_size % TREE_LEAF_SIZE != 0)
+        return std::nullopt;
+
+    size_t leaves = c_size / TREE_LEAF_SIZE;
+    if ((leaves & (leaves-1)) != 0)
+        return std::nullopt; //not a power of two
+    return leaves;
+}
+
+std::optional<std::vector<Digest>> chunkDigests(const std::vector<Digest>& leaves,
+                                                const size_t               c_size) {
+    auto per_chunk = leavesPerChunk(c_size);
+    if (!per_chunk || leaves.empty())
+        return std::nullopt;
+
+    size_t k = per_chunk.value();
+    std::vector<Digest> chunks;
+    chunks.reserve((leaves.size() + k - 1) / k);
+    for (size_t first = 0; first < leaves.size(); first += k) {
+        auto root = treeRoot(leaves, first, std::min(k, leaves.size() - first));
+        if (!root)
+            return std::nullopt;
+        chunks.push_back(root.value());
+    }
+
+    return chunks;
+}
+
+std::optional<Digest> dataDigest(const uint8_t* data, const size_t len) {
+    EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+    if (!ctx)
+        return std::nullopt;
+
+    std::vector<Digest> leaves(std::max<size_t>(1, (len + TREE_LEAF_SIZE - 1) / TREE_LEAF_SIZE));
+    for (size_t i = 0; i < leaves.size(); ++i) {
+        size_t start = i * TREE_LEAF_SIZE;
+        size_t l_len = std::min(TREE_LEAF_SIZE, len - std::min(start, len));
+        if (!prefixedDigest(ctx, LEAF_PREFIX, data+start, l_len, nullptr, 0, leaves[i])) {
+            EVP_MD_CTX_free(ctx);
+            return std::nullopt;
+        }
+    }
+
+    EVP_MD_CTX_free(ctx);
+    return treeRoot(leaves, 0, leaves.size());
+}
+
+} //dfd
@@ -0,0 +1,191 @@
+#include "networking/internal/fileParsing/writeBehind.hpp"
+#include "networking/internal/fileParsing/downloadFile.hpp"
+#include "networking/internal/fileParsing/ioEngine.hpp"
+
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <iterator>
+
+namespace dfd {
+
+//staged chunks that follow on from each other, written with one pwritev()
+struct StagedRun {
+    size_t                   first = 0;
+    size_t                   bytes = 0;
+    std::vector<StagedChunk> chunks;
+};
+
+//whether a chunk next to a run means it can't grow, it's written, being
+//written, or past the end of the file. caller holds writer.mtx
+static bool settled(DownloadFile& file, const size_t chunk) {
+    if (chunk >= file.f_chunks)
+        return true;
+    return file.writer.submitted[chunk] || hasChunk(file, chunk);
+}
+
+//moves every staged chunk from first to last into runs, marking them
+//submitted. caller holds writer.mtx
+static void takeStaged(      WriteBehind&            wb,
+                       const size_t                  first,
+                       const size_t                  last,
+                             std::vector<StagedRun>& runs) {
+    auto   it       = wb.staged.lower_bound(first);
+    size_t expected = SIZE_MAX;
+    while (it != wb.staged.end() && it->first <= last) {
+        if (it->first != expected || runs.back().chunks.size() >= IOV_MAX) {
+            runs.emplace_back();
+            runs.back().first = it->first;
+        }
+
+        StagedRun& run = runs.back();
+        size_t     len = it->second.data->size();
+        run.bytes        += len;
+        wb.staged_bytes  -= len;
+        wb.submitted[it->first] = true;
+        run.chunks.push_back(std::move(it->second));
+
+        expected = it->first + 1;
+        it       = wb.staged.erase(it);
+    }
+}
+
+//hands runs to the I/O engine. called without writer.mtx, the engine can block
+static void submitRuns(const std::shared_ptr<DownloadFile>& file,
+                             std::vector<StagedRun>&        runs) {
+    if (runs.empty())
+        return;
+
+    std::vector<IoRequest> batch;
+    batch.reserve(runs.size());
+    for (StagedRun& r : runs) {
+        auto run = std::make_shared<StagedRun>(std::move(r));
+
+        IoRequest req;
+        req.op     = IO_WRITE;
+        req.fd     = file->fd;
+        req.buff   = nullptr;
+        req.len    = run->bytes;
+        req.offset = run->first * file->c_size;
+        for (const StagedChunk& c : run->chunks) {
+            //only read from, iovec just isn't const
+            req.iov.push_back({const_cast<uint8_t*>(c.data->data()), c.data->size()});
+        }
+
+        req.done = [file, run](ssize_t res) {
+            bool ok = res >= 0 && static_cast<size_t>(res) == run->bytes;
+            if (ok) {
+                for (size_t i = 0; i < run->chunks.size(); ++i)
+                    markChunk(*file, run->first + i);
+            } else {
+                //someone has to fetch them again, let them join a run then
+                std::lock_guard<std::mutex> lock(file->writer.mtx);
+                for (size_t i = 0; i < run->chunks.size(); ++i)
+                    file->writer.submitted[run->first + i] = false;
+            }
+
+            for (StagedChunk& c : run->chunks)
+                c.done(ok ? EXIT_SUCCESS : EXIT_FAILURE);
+
+            std::lock_guard<std::mutex> lock(file->writer.mtx);
+            file->writer.dirty_bytes -= run->bytes;
+            file->writer.drained.notify_all();
+        };
+        batch.push_back(std::move(req));
+    }
+    runs.clear();
+
+    if (EXIT_SUCCESS != submitIo(batch)) {
+        //no engine, fail them the same way a write would
+        for (IoRequest& req : batch)
+            req.done(-EIO);
+    }
+}
+
+int stageWrite(const std::shared_ptr<DownloadFile>& file,
+               const size_t                         chunk,
+                     StagedChunk&&                  staged) {
+    if (!file || chunk >= file->f_chunks || !staged.data || !staged.done)
+        return EXIT_FAILURE;
+
+    WriteBehind&           wb  = file->writer;
+    size_t                 len = staged.data->size();
+    std::vector<StagedRun> runs;
+    {
+        std::unique_lock<std::mutex> lock(wb.mtx);
+        if (wb.submitted.size() != file->f_chunks)
+            wb.submitted.assign(file->f_chunks, false);
+        if (wb.staged.count(chunk))
+            return EXIT_FAILURE; //already have it
+
+        //over budget, get what's staged moving and wait for the disk
+        while (wb.dirty_bytes > 0 && wb.dirty_bytes + len > DOWNLOAD_DIRTY_BYTES) {
+            if (wb.staged.empty()) {
+                wb.drained.wait(lock);
+                continue;
+            }
+
+            takeStaged(wb, 0, SIZE_MAX, runs);
+            lock.unlock();
+            submitRuns(file, runs);
+            lock.lock();
+        }
+
+        wb.staged_bytes += len;
+        wb.dirty_bytes  += len;
+        auto it = wb.staged.emplace(chunk, std::move(staged)).first;
+
+        //find the run it joined
+        auto   lo        = it;
+        auto   hi        = it;
+        size_t run_bytes = len;
+        while (lo != wb.staged.begin() && std::prev(lo)->first + 1 == lo->first) {
+            --lo;
+            run_bytes += lo->second.data->size();
+        }
+        while (std::next(hi) != wb.staged.end() && std::next(hi)->first == hi->first + 1) {
+            ++hi;
+            run_bytes += hi->second.data->size();
+        }
+
+        size_t first  = lo->first;
+        size_t last   = hi->first;
+        bool   closed = (first == 0 || settled(*file, first - 1)) && settled(*file, last + 1);
+        if (closed || run_bytes >= WRITE_BEHIND_RUN_BYTES)
+            takeStaged(wb, first, last, runs);
+
+        //too much waiting on chunks that haven't turned up, write it all
+        if (wb.staged_bytes >= DOWNLOAD_DIRTY_BYTES / 2)
+            takeStaged(wb, 0, SIZE_MAX, runs);
+    }
+
+    submitRuns(file, runs);
+    return EXIT_SUCCESS;
+}
+
+size_t flushWrites(const std::shared_ptr<DownloadFile>& file) {
+    if (!file)
+        return 0;
+
+    std::vector<StagedRun> runs;
+    size_t                 chunks = 0;
+    {
+        std::lock_guard<std::mutex> lock(file->writer.mtx);
+        chunks = file->writer.staged.size();
+        takeStaged(file->writer, 0, SIZE_MAX, runs);
+    }
+
+    submitRuns(file, runs);
+    return chunks;
+}
+
+void drainWrites(const std::shared_ptr<DownloadFile>& file) {
+    if (!file)
+        return;
+
+    flushWrites(file);
+    std::unique_lock<std::mutex> lock(file->writer.mtx);
+    file->writer.drained.wait(lock, [&] { return file->writer.dirty_bytes == 0; });
+}
+
+} //dfd
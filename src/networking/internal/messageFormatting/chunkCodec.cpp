@@ -0,0 +1,103 @@
+#include "networking/internal/messageFormatting/chunkCodec.hpp"
+#include "networking/messageFormatting.hpp"
+
+#include <cstdlib>
+#include <memory>
+
+#if DFD_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#if DFD_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace dfd {
+
+uint8_t localCodecs() {
+    uint8_t codecs = 0;
+#if DFD_HAVE_ZLIB
+    codecs |= CODEC_ZLIB;
+#endif
+#if DFD_HAVE_ZSTD
+    codecs |= CODEC_ZSTD;
+#endif
+    return codecs;
+}
+
+uint8_t bestCodec(const uint8_t peer_codecs) {
+    uint8_t shared = localCodecs() & peer_codecs;
+    if (shared & CODEC_ZSTD)
+        return CODEC_ZSTD;
+    if (shared & CODEC_ZLIB)
+        return CODEC_ZLIB;
+    return CODEC_NONE;
+}
+
+std::optional<size_t> packBytes(const uint8_t               codec,
+                                const uint8_t*              in,
+                                const size_t                in_len,
+                                      std::vector<uint8_t>& out) {
+#if DFD_HAVE_ZSTD
+    if (codec == CODEC_ZSTD) {
+        //a context per thread, setting one up costs more than a small chunk
+        thread_local std::unique_ptr<ZSTD_CCtx, size_t(*)(ZSTD_CCtx*)> ctx(ZSTD_createCCtx(),
+                                                                           ZSTD_freeCCtx);
+        if (!ctx)
+            return std::nullopt;
+
+        size_t res = ZSTD_compressCCtx(ctx.get(), out.data(), out.size(), in, in_len, ZSTD_PACK_LEVEL);
+        if (ZSTD_isError(res))
+            return std::nullopt;
+        out.resize(res);
+        return res;
+    }
+#endif
+
+#if DFD_HAVE_ZLIB
+    if (codec == CODEC_ZLIB) {
+        uLongf out_len = out.size();
+        if (Z_OK != compress2(out.data(), &out_len, in, in_len, ZLIB_PACK_LEVEL))
+            return std::nullopt;
+        out.resize(out_len);
+        return out_len;
+    }
+#endif
+
+    (void)codec; (void)in; (void)in_len; (void)out;
+    return std::nullopt;
+}
+
+int unpackBytes(const uint8_t  codec,
+                const uint8_t* in,
+                const size_t   in_len,
+                      uint8_t* out,
+                const size_t   out_len) {
+#if DFD_HAVE_ZSTD
+    if (codec == CODEC_ZSTD) {
+        thread_local std::unique_ptr<ZSTD_DCtx, size_t(*)(ZSTD_DCtx*)> ctx(ZSTD_createDCtx(),
+                                                                           ZSTD_freeDCtx);
+        if (!ctx)
+            return EXIT_FAILURE;
+
+        size_t res = ZSTD_decompressDCtx(ctx.get(), out, out_len, in, in_len);
+        if (ZSTD_isError(res) || res != out_len)
+            return EXIT_FAILURE;
+        return EXIT_SUCCESS;
+    }
+#endif
+
+#if DFD_HAVE_ZLIB
+    if (codec == CODEC_ZLIB) {
+        uLongf res = out_len;
+        if (Z_OK != uncompress(out, &res, in, in_len) || res != out_len)
+            return EXIT_FAILURE;
+        return EXIT_SUCCESS;
+    }
+#endif
+
+    (void)codec; (void)in; (void)in_len; (void)out; (void)out_len;
+    return EXIT_FAILURE;
+}
+
+} //dfd
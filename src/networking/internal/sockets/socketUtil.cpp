@@ -2,6 +2,10 @@
 #include "networking/internal/messageFormatting/byteOrdering.hpp"
 
 #include <bits/types/struct_timeval.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
 #include <cstring>
 #include <cstdint>
 #include <sys/socket.h>
@@ -9,6 +13,7 @@
 #include <vector>
 #include <unistd.h>
 #include <netinet/in.h>
+#include <poll.h>
 #include <arpa/inet.h>
 
 namespace dfd{
@@ -19,43 +24,65 @@ void msgLenToBytes(const uint64_t len, uint8_t* buffer) {
     std::memcpy(buffer, &ordered, sizeof(uint64_t)); 
 }
 
-uint64_t bytesToMsgLen(const std::vector<uint8_t>& buffer) {
+uint64_t bytesToMsgLen(const uint8_t* bytes) {
     int err_code;
     uint64_t ordered;
-    std::memcpy(&ordered, buffer.data(), sizeof(ordered));
+    std::memcpy(&ordered, bytes, sizeof(ordered));
     return fromNetworkOrder(ordered, err_code);
 }
 
-ssize_t recvBytes(int                  socket_fd, 
-                 std::vector<uint8_t>& buffer, 
-                 size_t                try_to_recv, 
-                 timeval               timeout
-                ) {
-    if (try_to_recv == 0) {
-        return -1;
-    }
+uint64_t bytesToMsgLen(const std::vector<uint8_t>& buffer) {
+    return bytesToMsgLen(buffer.data());
+}
 
-    fd_set read_fds;
-    FD_ZERO(&read_fds);
-    FD_SET(socket_fd, &read_fds);
-    // int ret = select(socket_fd + 1, &read_fds, NULL, NULL, &timeout);
-    int ret = setsockopt(socket_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
-    if (ret < 0) {
+ssize_t recvInto(int      socket_fd,
+                 uint8_t* dest,
+                 size_t   len,
+                 timeval  timeout) {
+    if (len == 0) {
         return -1;
     }
 
-    size_t original_len = buffer.size();
-    buffer.resize(original_len + try_to_recv);
+    //a zero timeout waits forever, same as SO_RCVTIMEO did
+    auto idle     = std::chrono::seconds(timeout.tv_sec) + std::chrono::microseconds(timeout.tv_usec);
+    bool forever  = idle.count() == 0;
+    auto deadline = std::chrono::steady_clock::now() + idle;
+
+    size_t total_recv = 0;
+    while (total_recv < len) {
+        //try first, most reads find data already waiting and skip the poll
+        ssize_t bytes_read = recv(socket_fd, dest + total_recv, len - total_recv, MSG_DONTWAIT);
+        if (bytes_read > 0) {
+            total_recv += bytes_read;
+            deadline    = std::chrono::steady_clock::now() + idle;
+            continue;
+        }
+        if (bytes_read == 0)
+            return -1; //peer closed
+        if (errno == EINTR)
+            continue;
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+            return -1;
 
-    ssize_t bytes_read = recv(socket_fd, buffer.data()+original_len, try_to_recv, 0);
+        int wait_ms = -1;
+        if (!forever) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                            deadline - std::chrono::steady_clock::now());
+            if (left.count() <= 0)
+                return -1; //nothing for a whole timeout
+            wait_ms = std::min<int64_t>(left.count() + 1, INT_MAX);
+        }
 
-    if (bytes_read > 0) {
-        buffer.resize(original_len + bytes_read);
-        return bytes_read;
+        struct pollfd pfd = {socket_fd, POLLIN, 0};
+        int res = poll(&pfd, 1, wait_ms);
+        if (res < 0 && errno != EINTR)
+            return -1;
+        if (res > 0 && (pfd.revents & POLLNVAL))
+            return -1;
+        //hangups and errors are left for the recv to report
     }
 
-    buffer.resize(original_len);
-    return -1;
+    return total_recv;
 }
 
 }
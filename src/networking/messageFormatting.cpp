@@ -1,5 +1,10 @@
 #include "networking/messageFormatting.hpp"
 #include "networking/internal/messageFormatting/byteOrdering.hpp"
+#include "networking/internal/messageFormatting/chunkCodec.hpp"
+#include "networking/fileParsing.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstdlib>
 #include <cstring>
 #include <endian.h>
@@ -11,6 +16,15 @@
 
 namespace dfd {
 
+//packing counts, see packStats()
+static std::atomic<uint64_t> total_tried        = 0;
+static std::atomic<uint64_t> total_kept         = 0;
+static std::atomic<uint64_t> total_kept_bytes   = 0;
+static std::atomic<uint64_t> total_packed_bytes = 0;
+static std::atomic<uint64_t> total_pack_ns      = 0;
+static std::atomic<uint64_t> total_unpacked     = 0;
+static std::atomic<uint64_t> total_unpack_ns    = 0;
+
 std::vector<uint8_t> createFailMessage(const std::string& error_message) {
     if (error_message.length() <= 0)
         return {};
@@ -327,7 +341,9 @@ std::pair<uint64_t, SourceInfo> parseControlRequest(const std::vector<uint8_t>&
 
 //CLIENT MESSAGE CODES AND FUNCTIONS
 
-std::vector<uint8_t> createDownloadInit(const uint64_t uuid, std::optional<size_t> chunk_size) {
+std::vector<uint8_t> createDownloadInit(const uint64_t        uuid,
+                                        std::optional<size_t> chunk_size,
+                                        const uint8_t         codecs) {
     std::vector<uint8_t> init_buffer = {DOWNLOAD_INIT};
     init_buffer.resize(1+16);
     uint64_t c_size = 0;
@@ -338,9 +354,10 @@ std::vector<uint8_t> createDownloadInit(const uint64_t uuid, std::optional<size_
     int err_code  = 0;
 
     //ORDER:
-    //file uuid, chunk size
+    //file uuid, chunk size, codecs
     createNetworkData(init_buffer.data(), uuid,   offset, err_code);
     createNetworkData(init_buffer.data(), c_size, offset, err_code);
+    init_buffer.push_back(codecs);
 
     if (err_code != 0)
         return {};
@@ -348,40 +365,46 @@ std::vector<uint8_t> createDownloadInit(const uint64_t uuid, std::optional<size_
     return init_buffer;
 }
 
-std::pair<uint64_t, std::optional<size_t>> parseDownloadInit(const std::vector<uint8_t> init_message) {
-    if (init_message.size() != 17)
-        return {};
-    else if (*init_message.begin() != DOWNLOAD_INIT)
-        return {};
+std::tuple<uint64_t, std::optional<size_t>, uint8_t> parseDownloadInit(const std::vector<uint8_t> init_message) {
+    //codecs were added on the end, older peers don't send them
+    if (init_message.size() != 17 && init_message.size() != 18)
+        return {0, std::nullopt, CODEC_NONE};
+    else if (*init_message.begin() != DOWNLOAD_INIT && *init_message.begin() != BUNDLE_INIT)
+        return {0, std::nullopt, CODEC_NONE};
 
-    std::pair<uint64_t, std::optional<size_t>> pair(0, std::nullopt);
-    size_t offset = 1;
+    uint64_t uuid   = 0;
+    size_t offset   = 1;
     int err_code    = 0;
     uint64_t c_size = 0;
 
     //pull stuff out in the same order as it was inserted by createDownloadInit
-    parseNetworkData(&pair.first, init_message.data(), offset, err_code);
-    parseNetworkData(&c_size,     init_message.data(), offset, err_code);
+    parseNetworkData(&uuid,   init_message.data(), offset, err_code);
+    parseNetworkData(&c_size, init_message.data(), offset, err_code);
+    uint8_t codecs = init_message.size() > offset ? init_message[offset] : CODEC_NONE;
 
     if (err_code != 0)
-        return {0, std::nullopt};
+        return {0, std::nullopt, CODEC_NONE};
 
+    std::optional<size_t> size;
     if (c_size != 0)
-        pair.second = c_size;
+        size = c_size;
 
-    return pair;
+    return {uuid, size, codecs};
 }
 
-std::vector<uint8_t> createDownloadConfirm(const uint64_t f_size, const std::string& f_name) {
+std::vector<uint8_t> createDownloadConfirm(const uint64_t     f_size,
+                                           const uint64_t     c_size,
+                                           const std::string& f_name) {
     std::vector<uint8_t> confirm_buffer = {DOWNLOAD_CONFIRM};
-    confirm_buffer.resize(1+8+f_name.size());
+    confirm_buffer.resize(1+16+f_name.size());
     
     size_t offset = 1;
     int err_code  = 0;
 
     //ORDER:
-    //file size
+    //file size, chunk size, file name
     createNetworkData(confirm_buffer.data(), f_size, offset, err_code);
+    createNetworkData(confirm_buffer.data(), c_size, offset, err_code);
     std::memcpy(confirm_buffer.data()+offset, f_name.c_str(), f_name.size());
 
     if (err_code != 0)
@@ -390,22 +413,23 @@ std::vector<uint8_t> createDownloadConfirm(const uint64_t f_size, const std::str
     return confirm_buffer;
 }
 
-std::pair<uint64_t, std::string> parseDownloadConfirm(const std::vector<uint8_t> confirm_message) {
-    if (*confirm_message.begin() != DOWNLOAD_CONFIRM)
-        return {};
+std::tuple<uint64_t, uint64_t, std::string> parseDownloadConfirm(const std::vector<uint8_t> confirm_message) {
+    if (confirm_message.size() < 17 || *confirm_message.begin() != DOWNLOAD_CONFIRM)
+        return {0, 0, ""};
 
     size_t offset = 1;
     int err_code  = 0;
-    std::pair<uint64_t, std::string> file_info;
+    uint64_t f_size = 0;
+    uint64_t c_size = 0;
 
-    parseNetworkData(&file_info.first, confirm_message.data(), offset, err_code);
+    parseNetworkData(&f_size, confirm_message.data(), offset, err_code);
+    parseNetworkData(&c_size, confirm_message.data(), offset, err_code);
     std::string f_name(confirm_message.begin()+offset, confirm_message.end());
-    file_info.second = f_name;
 
-    if (err_code != 0)
-        return {0, ""};
+    if (err_code != 0 || c_size == 0)
+        return {0, 0, ""};
 
-    return file_info;
+    return {f_size, c_size, f_name};
 }
 
 std::vector<uint8_t> createChunkRequest(const size_t chunk) {
@@ -445,6 +469,97 @@ size_t parseChunkRequest(const std::vector<uint8_t>& request_message) {
     return (size_t)chunk;
 }
 
+//messages that are a code and two chunk indexes
+static std::vector<uint8_t> createChunkPair(const uint8_t code, const size_t a, const size_t b) {
+    std::vector<uint8_t> pair_buff = {code};
+    pair_buff.resize(1+8+8);
+    uint64_t first  = a;
+    uint64_t second = b;
+
+    size_t offset = 1;
+    int err_code  = 0;
+
+    //ORDER:
+    //first index, second index
+    createNetworkData(pair_buff.data(), first,  offset, err_code);
+    createNetworkData(pair_buff.data(), second, offset, err_code);
+
+    if (err_code != 0)
+        return {};
+
+    return pair_buff;
+}
+
+static std::pair<size_t, size_t> parseChunkPair(const uint8_t code, const std::vector<uint8_t>& message) {
+    if (message.size() != 1+8+8 || message[0] != code)
+        return {SIZE_MAX, SIZE_MAX};
+
+    uint64_t first, second;
+    size_t offset = 1;
+    int err_code  = 0;
+
+    parseNetworkData(&first,  message.data(), offset, err_code);
+    parseNetworkData(&second, message.data(), offset, err_code);
+
+    if (err_code != 0)
+        return {SIZE_MAX, SIZE_MAX};
+
+    return {(size_t)first, (size_t)second};
+}
+
+std::vector<uint8_t> createRangeRequest(const size_t first, const size_t end) {
+    if (first >= end)
+        return {};
+    return createChunkPair(REQUEST_RANGE, first, end);
+}
+
+std::pair<size_t, size_t> parseRangeRequest(const std::vector<uint8_t>& request_message) {
+    auto range = parseChunkPair(REQUEST_RANGE, request_message);
+    if (range.first >= range.second)
+        return {SIZE_MAX, SIZE_MAX};
+    return range;
+}
+
+std::vector<uint8_t> createRangeShrink(const size_t first, const size_t end) {
+    return createChunkPair(SHRINK_RANGE, first, end);
+}
+
+std::pair<size_t, size_t> parseRangeShrink(const std::vector<uint8_t>& shrink_message) {
+    return parseChunkPair(SHRINK_RANGE, shrink_message);
+}
+
+std::vector<uint8_t> createRangeEnd(const size_t end) {
+    std::vector<uint8_t> end_buff = {RANGE_END};
+    end_buff.resize(1+8);
+    uint64_t e = end;
+
+    size_t offset = 1;
+    int err_code  = 0;
+
+    createNetworkData(end_buff.data(), e, offset, err_code);
+
+    if (err_code != 0)
+        return {};
+
+    return end_buff;
+}
+
+size_t parseRangeEnd(const std::vector<uint8_t>& end_message) {
+    if (end_message.size() != 1+8 || end_message[0] != RANGE_END)
+        return SIZE_MAX;
+
+    uint64_t end;
+    size_t offset = 1;
+    int err_code  = 0;
+
+    parseNetworkData(&end, end_message.data(), offset, err_code);
+
+    if (err_code != 0)
+        return SIZE_MAX;
+
+    return (size_t)end;
+}
+
 std::vector<uint8_t> createDataChunk(const DataChunk& chunk) {
     std::vector<uint8_t> data_buff = {DATA_CHUNK};
     data_buff.resize(1+8+chunk.second.size());
@@ -464,6 +579,24 @@ std::vector<uint8_t> createDataChunk(const DataChunk& chunk) {
     return data_buff;
 }
 
+std::vector<uint8_t> createDataChunkHeader(const size_t chunk) {
+    std::vector<uint8_t> header_buff = {DATA_CHUNK};
+    header_buff.resize(1+8);
+    uint64_t c = chunk;
+
+    size_t offset = 1;
+    int err_code  = 0;
+
+    //ORDER:
+    //chunk index, same as createDataChunk
+    createNetworkData(header_buff.data(), c, offset, err_code);
+
+    if (err_code != 0)
+        return {};
+
+    return header_buff;
+}
+
 DataChunk parseDataChunk(const std::vector<uint8_t>& data_chunk_message) {
     //can't check len here
     if (*data_chunk_message.begin() != DATA_CHUNK)
@@ -486,6 +619,391 @@ DataChunk parseDataChunk(const std::vector<uint8_t>& data_chunk_message) {
     return {(size_t)c, data};
 }
 
+//unpacks a PACKED_CHUNK's data over the message, see stripDataChunk
+static size_t stripPackedChunk(std::vector<uint8_t>& packed_message) {
+    if (packed_message.size() < 1+8+1+8)
+        return SIZE_MAX;
+
+    uint64_t c, c_len;
+    size_t offset = 1;
+    int err_code  = 0;
+
+    //same order as createPackedChunkHeader
+    parseNetworkData(&c, packed_message.data(), offset, err_code);
+    uint8_t codec = packed_message[offset++];
+    parseNetworkData(&c_len, packed_message.data(), offset, err_code);
+    if (err_code != 0 || c_len > MAX_CHUNK_SIZE)
+        return SIZE_MAX;
+
+    //the receive buffer is already held, so don't wait on the pool for this one
+    PooledBuffer         pooled = tryTakeBuffer(c_len);
+    std::vector<uint8_t> fallback;
+    std::vector<uint8_t>& chunk = pooled ? *pooled : fallback;
+    chunk.resize(c_len);
+
+    auto start = std::chrono::steady_clock::now();
+    if (EXIT_SUCCESS != unpackBytes(codec,
+                                    packed_message.data()+offset,
+                                    packed_message.size()-offset,
+                                    chunk.data(),
+                                    chunk.size()))
+        return SIZE_MAX;
+    auto took = std::chrono::steady_clock::now() - start;
+    total_unpacked++;
+    total_unpack_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(took).count();
+
+    //the message's buffer goes back to the pool in its place
+    packed_message.swap(chunk);
+    return (size_t)c;
+}
+
+size_t stripDataChunk(std::vector<uint8_t>& data_chunk_message) {
+    if (!data_chunk_message.empty() && data_chunk_message[0] == PACKED_CHUNK)
+        return stripPackedChunk(data_chunk_message);
+    if (data_chunk_message.size() < 9 || data_chunk_message[0] != DATA_CHUNK)
+        return SIZE_MAX;
+
+    uint64_t c;
+    size_t offset = 1;
+    int err_code  = 0;
+
+    //same order as parseDataChunk
+    parseNetworkData(&c, data_chunk_message.data(), offset, err_code);
+    if (err_code != 0)
+        return SIZE_MAX;
+
+    data_chunk_message.erase(data_chunk_message.begin(), data_chunk_message.begin()+offset);
+    return (size_t)c;
+}
+
+uint8_t supportedCodecs() {
+    return localCodecs();
+}
+
+ChunkPacker openPacker(const uint8_t peer_codecs) {
+    ChunkPacker packer;
+    packer.codec = bestCodec(peer_codecs);
+    return packer;
+}
+
+bool packNext(ChunkPacker& packer) {
+    if (packer.codec == CODEC_NONE)
+        return false;
+    if (packer.skip > 0) {
+        packer.skip--;
+        return false;
+    }
+    return true;
+}
+
+PooledBuffer packChunk(ChunkPacker& packer, const std::vector<uint8_t>& chunk) {
+    if (packer.codec == CODEC_NONE || chunk.empty())
+        return nullptr;
+
+    //the chunk is already held, so don't wait on the pool for this one. only
+    //room for as much as it's allowed to pack to, a chunk that won't shrink
+    //fails as soon as it runs out
+    PooledBuffer packed = tryTakeBuffer(chunk.size() * PACK_KEEP_RATIO);
+    if (!packed)
+        return nullptr;
+
+    auto start = std::chrono::steady_clock::now();
+    auto res   = packBytes(packer.codec, chunk.data(), chunk.size(), *packed);
+    auto took  = std::chrono::steady_clock::now() - start;
+    total_tried++;
+    total_pack_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(took).count();
+
+    if (!res) {
+        //not worth it, leave the next few alone
+        packer.skip    = packer.backoff;
+        packer.backoff = std::min<uint32_t>(packer.backoff * 2, PACK_MAX_BACKOFF);
+        return nullptr;
+    }
+
+    packer.backoff = 1;
+    total_kept++;
+    total_kept_bytes   += chunk.size();
+    total_packed_bytes += res.value();
+    return packed;
+}
+
+std::vector<uint8_t> createPackedChunkHeader(const size_t  chunk,
+                                             const uint8_t codec,
+                                             const size_t  chunk_len) {
+    std::vector<uint8_t> header_buff = {PACKED_CHUNK};
+    header_buff.resize(1+8+1+8);
+    uint64_t c     = chunk;
+    uint64_t c_len = chunk_len;
+
+    size_t offset = 1;
+    int err_code  = 0;
+
+    //ORDER:
+    //chunk index, codec, unpacked length
+    createNetworkData(header_buff.data(), c, offset, err_code);
+    header_buff[offset++] = codec;
+    createNetworkData(header_buff.data(), c_len, offset, err_code);
+
+    if (err_code != 0)
+        return {};
+
+    return header_buff;
+}
+
+PackStats packStats() {
+    PackStats stats;
+    stats.tried        = total_tried;
+    stats.kept         = total_kept;
+    stats.kept_bytes   = total_kept_bytes;
+    stats.packed_bytes = total_packed_bytes;
+    stats.pack_ns      = total_pack_ns;
+    stats.unpacked     = total_unpacked;
+    stats.unpack_ns    = total_unpack_ns;
+    return stats;
+}
+
+size_t messageLimit(const uint8_t code) {
+    switch (code) {
+        case DATA_CHUNK:
+        case PACKED_CHUNK:
+            return MAX_CHUNK_SIZE + CHUNK_MESSAGE_SLACK;
+        case MANIFEST:
+            return 1 + 8 + size_t(MANIFEST_MAX_DIGESTS) * 32;
+        case BUNDLE_MANIFEST:
+            return 1 + BUNDLE_MANIFEST_MAX;
+        case SEGMENT_MANIFEST:
+            return 1 + 8 + size_t(SEGMENT_MANIFEST_MAX) * (4 + 32);
+        default:
+            return CONTROL_MESSAGE_MAX;
+    }
+}
+
+std::vector<uint8_t> createManifest(const ChunkManifest& manifest) {
+    auto& [c_size, digests] = manifest;
+    if (digests.size() > MANIFEST_MAX_DIGESTS)
+        return {}; //past what a downloader will take
+
+    std::vector<uint8_t> manifest_buff = {MANIFEST};
+    manifest_buff.resize(1+8+digests.size()*32);
+    uint64_t c = c_size;
+
+    size_t offset = 1;
+    int err_code  = 0;
+
+    //ORDER:
+    //chunk size, then digests back to back
+    createNetworkData(manifest_buff.data(), c, offset, err_code);
+    for (auto& digest : digests) {
+        std::memcpy(manifest_buff.data()+offset, digest.data(), digest.size());
+        offset += digest.size();
+    }
+
+    if (err_code != 0)
+        return {};
+
+    return manifest_buff;
+}
+
+ChunkManifest parseManifest(const std::vector<uint8_t>& manifest_message) {
+    if (manifest_message.size() < 1+8 || (manifest_message.size()-9) % 32 != 0)
+        return {0, {}};
+    if (*manifest_message.begin() != MANIFEST)
+        return {0, {}};
+
+    uint64_t c;
+    size_t offset = 1;
+    int err_code  = 0;
+
+    //pull stuff out in the same order as it was inserted by createManifest
+    parseNetworkData(&c, manifest_message.data(), offset, err_code);
+    if (err_code != 0)
+        return {0, {}};
+
+    ChunkManifest manifest;
+    manifest.first = c;
+    manifest.second.resize((manifest_message.size()-offset) / 32);
+    for (auto& digest : manifest.second) {
+        std::memcpy(digest.data(), manifest_message.data()+offset, digest.size());
+        offset += digest.size();
+    }
+
+    return manifest;
+}
+
+std::vector<uint8_t> createSegmentManifest(const SegmentManifest& segments) {
+    if (segments.size() > SEGMENT_MANIFEST_MAX)
+        return {}; //past what a downloader will take
+
+    std::vector<uint8_t> segment_buff = {SEGMENT_MANIFEST};
+    segment_buff.resize(1+8+segments.size()*(4+32));
+    uint64_t count = segments.size();
+
+    size_t offset = 1;
+    int err_code  = 0;
+
+    //ORDER:
+    //segment count, then each length and digest back to back
+    createNetworkData(segment_buff.data(), count, offset, err_code);
+    for (auto& [len, digest] : segments) {
+        createNetworkData(segment_buff.data(), len, offset, err_code);
+        std::memcpy(segment_buff.data()+offset, digest.data(), digest.size());
+        offset += digest.size();
+    }
+
+    if (err_code != 0)
+        return {};
+
+    return segment_buff;
+}
+
+SegmentManifest parseSegmentManifest(const std::vector<uint8_t>& segment_message) {
+    if (segment_message.size() < 1+8 || *segment_message.begin() != SEGMENT_MANIFEST)
+        return {};
+
+    uint64_t count;
+    size_t offset = 1;
+    int err_code  = 0;
+
+    //pull stuff out in the same order as it was inserted by createSegmentManifest
+    parseNetworkData(&count, segment_message.data(), offset, err_code);
+    if (err_code != 0 || count > SEGMENT_MANIFEST_MAX ||
+        segment_message.size() != 1+8+count*(4+32))
+        return {};
+
+    SegmentManifest segments(count);
+    for (auto& [len, digest] : segments) {
+        parseNetworkData(&len, segment_message.data(), offset, err_code);
+        std::memcpy(digest.data(), segment_message.data()+offset, digest.size());
+        offset += digest.size();
+    }
+
+    if (err_code != 0)
+        return {};
+    return segments;
+}
+
+std::vector<uint8_t> packBundle(const std::vector<BundleMember>& members) {
+    size_t len = 8;
+    for (auto& member : members) {
+        if (member.name.size() > UINT16_MAX)
+            return {};
+        len += 8+8+2+member.name.size();
+    }
+    if (len > BUNDLE_MANIFEST_MAX)
+        return {}; //past what a downloader will take
+
+    std::vector<uint8_t> packed(len);
+    uint64_t count    = members.size();
+    size_t   offset   = 0;
+    int      err_code = 0;
+
+    //ORDER:
+    //file count, then uuid, size, name length, name for each file
+    createNetworkData(packed.data(), count, offset, err_code);
+    for (auto& member : members) {
+        uint16_t name_len = member.name.size();
+        createNetworkData(packed.data(), member.uuid,   offset, err_code);
+        createNetworkData(packed.data(), member.f_size, offset, err_code);
+        createNetworkData(packed.data(), name_len,      offset, err_code);
+        std::memcpy(packed.data()+offset, member.name.data(), name_len);
+        offset += name_len;
+    }
+
+    if (err_code != 0)
+        return {};
+
+    return packed;
+}
+
+std::optional<std::vector<BundleMember>> unpackBundle(const uint8_t* data, const size_t len) {
+    if (len < 8)
+        return std::nullopt;
+
+    uint64_t count;
+    size_t   offset   = 0;
+    int      err_code = 0;
+
+    //pull stuff out in the same order as it was inserted by packBundle
+    parseNetworkData(&count, data, offset, err_code);
+    if (err_code != 0 || count > (len-8) / (8+8+2))
+        return std::nullopt;
+
+    std::vector<BundleMember> members(count);
+    for (auto& member : members) {
+        uint16_t name_len;
+        if (len - offset < 8+8+2)
+            return std::nullopt;
+        parseNetworkData(&member.uuid,   data, offset, err_code);
+        parseNetworkData(&member.f_size, data, offset, err_code);
+        parseNetworkData(&name_len,      data, offset, err_code);
+        if (len - offset < name_len)
+            return std::nullopt;
+        member.name.assign(reinterpret_cast<const char*>(data+offset), name_len);
+        offset += name_len;
+    }
+
+    if (err_code != 0 || offset != len)
+        return std::nullopt;
+
+    return members;
+}
+
+std::vector<uint8_t> createBundleInit(const uint64_t        uuid,
+                                      std::optional<size_t> chunk_size,
+                                      const uint8_t         codecs) {
+    //same layout, only the code differs
+    std::vector<uint8_t> init_buffer = createDownloadInit(uuid, chunk_size, codecs);
+    if (!init_buffer.empty())
+        init_buffer[0] = BUNDLE_INIT;
+    return init_buffer;
+}
+
+std::vector<uint8_t> createBundleManifest(const std::vector<uint8_t>& packed) {
+    std::vector<uint8_t> manifest_buff = {BUNDLE_MANIFEST};
+    manifest_buff.insert(manifest_buff.end(), packed.begin(), packed.end());
+    return manifest_buff;
+}
+
+std::vector<uint8_t> createFileChunkRequest(const uint64_t f_uuid, const size_t chunk) {
+    std::vector<uint8_t> chunk_buff = {REQUEST_FILE_CHUNK};
+    chunk_buff.resize(1+16);
+    uint64_t c = chunk;
+
+    size_t offset = 1;
+    int err_code  = 0;
+
+    //ORDER:
+    //file uuid, chunk index
+    createNetworkData(chunk_buff.data(), f_uuid, offset, err_code);
+    createNetworkData(chunk_buff.data(), c,      offset, err_code);
+
+    if (err_code != 0)
+        return {};
+
+    return chunk_buff;
+}
+
+std::pair<uint64_t, size_t> parseFileChunkRequest(const std::vector<uint8_t>& request_message) {
+    if (request_message.size() != 17)
+        return {0, SIZE_MAX};
+    else if (*request_message.begin() != REQUEST_FILE_CHUNK)
+        return {0, SIZE_MAX};
+
+    uint64_t f_uuid;
+    uint64_t chunk;
+    size_t offset = 1;
+    int err_code  = 0;
+
+    //pull stuff out in the same order as it was inserted by createFileChunkRequest
+    parseNetworkData(&f_uuid, request_message.data(), offset, err_code);
+    parseNetworkData(&chunk,  request_message.data(), offset, err_code);
+
+    if (err_code != 0)
+        return {0, SIZE_MAX};
+
+    return {f_uuid, (size_t)chunk};
+}
+
 std::vector<uint8_t> createNewServerReg(const SourceInfo& new_server) {
     std::vector<uint8_t> reg_buff = {SERVER_REG};
     reg_buff.resize(1+6);
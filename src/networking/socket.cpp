@@ -8,13 +8,19 @@
 #include <cstdint>
 #include <iostream>
 #include <ostream>
+#include <climits>
+#include <poll.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/types.h>
 #include <vector>
 #include <unistd.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <fcntl.h>
+#include <algorithm>
+#include <cerrno>
 
 namespace dfd {
 
@@ -82,6 +88,17 @@ void closeSocket(int socket_fd) {
     close(socket_fd);
 }
 
+int setBlocking(int socket_fd, bool blocking) {
+    int flags = fcntl(socket_fd, F_GETFL);
+    if (flags < 0)
+        return EXIT_FAILURE;
+
+    flags = blocking ? (flags & ~O_NONBLOCK) : (flags | O_NONBLOCK);
+    if (fcntl(socket_fd, F_SETFL, flags) < 0)
+        return EXIT_FAILURE;
+    return EXIT_SUCCESS;
+}
+
 namespace tcp {
 
 //TCP UTIL
@@ -203,23 +220,144 @@ int accept(int                                 server_fd,
     return client_fd;
 }
 
+//waits for a socket that's full to take more, false if it doesn't in time
+static bool waitWritable(int socket_fd) {
+    struct pollfd pfd = {socket_fd, POLLOUT, 0};
+    int res;
+    do {
+        res = poll(&pfd, 1, SEND_STALL_MS);
+    } while (res < 0 && errno == EINTR);
+    return res > 0 && !(pfd.revents & (POLLERR | POLLHUP | POLLNVAL));
+}
+
+//sends everything iov points at, moving it along past what went out, and adds
+//what went out to sent if given. false if the connection broke
+static bool sendIov(int socket_fd, struct iovec* iov, size_t iov_cnt, int flags,
+                    size_t* sent = nullptr) {
+    while (iov_cnt > 0) {
+        struct msghdr msg{};
+        msg.msg_iov    = iov;
+        msg.msg_iovlen = std::min<size_t>(iov_cnt, IOV_MAX);
+
+        ssize_t bytes_sent = sendmsg(socket_fd, &msg, flags | MSG_NOSIGNAL);
+        if (bytes_sent < 0 && errno == EINTR)
+            continue;
+        if (bytes_sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (!waitWritable(socket_fd))
+                return false;
+            continue;
+        }
+        if (bytes_sent <= 0)
+            return false;
+        if (sent)
+            *sent += bytes_sent;
+
+        //skip past what was sent, the first part left may be partly sent
+        size_t done = bytes_sent;
+        while (iov_cnt > 0 && done >= iov->iov_len) {
+            done -= iov->iov_len;
+            ++iov;
+            --iov_cnt;
+        }
+        if (iov_cnt > 0) {
+            iov->iov_base = static_cast<uint8_t*>(iov->iov_base) + done;
+            iov->iov_len -= done;
+        }
+    }
+
+    return true;
+}
+
+//sends all of buff, false if the connection broke
+static bool sendAll(int socket_fd, const uint8_t* buff, size_t len, int flags) {
+    struct iovec iov = {const_cast<uint8_t*>(buff), len};
+    return sendIov(socket_fd, &iov, len > 0 ? 1 : 0, flags);
+}
+
 int sendMessage(int socket_fd, const std::vector<uint8_t>& data) {
-    uint64_t data_len = data.size();
+    return sendFramed(socket_fd, {data});
+}
+
+int sendMessage(int                         socket_fd,
+                const std::vector<uint8_t>& header,
+                const std::vector<uint8_t>& data) {
+    return sendFramed(socket_fd, {header, data});
+}
+
+int sendFramed(int socket_fd, std::initializer_list<ByteSpan> parts, size_t* sent) {
+    if (sent)
+        *sent = 0;
+    uint64_t data_len = 0;
+    for (const ByteSpan& part : parts)
+        data_len += part.len;
     if (data_len == 0) {
         return EXIT_SUCCESS;
     }
 
-    std::vector<uint8_t> data_msg;
-    data_msg.resize(8+data.size());
-    msgLenToBytes(data_len, data_msg.data());
+    //the length prefix and every part go out in the same sendmsg(), so they
+    //share segments without being copied together
+    uint8_t prefix[8];
+    msgLenToBytes(data_len, prefix);
+
+    std::vector<struct iovec> iov;
+    iov.reserve(1 + parts.size());
+    iov.push_back({prefix, sizeof(prefix)});
+    for (const ByteSpan& part : parts)
+        if (part.len > 0)
+            iov.push_back({const_cast<uint8_t*>(part.data), part.len});
+
+    return sendIov(socket_fd, iov.data(), iov.size(), 0, sent) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int sendFileMessage(int                         socket_fd,
+                    const std::vector<uint8_t>& header,
+                    int                         file_fd,
+                    off_t                       offset,
+                    size_t                      len) {
+    uint64_t data_len = header.size() + len;
+    if (data_len == 0)
+        return EXIT_SUCCESS;
+
+    //length prefix + header in one go, MSG_MORE holds them back so they share
+    //a segment with the start of the file data
+    std::vector<uint8_t> head_msg(8+header.size());
+    msgLenToBytes(data_len, head_msg.data());
+    std::memcpy(head_msg.data()+8, header.data(), header.size());
+    if (!sendAll(socket_fd, head_msg.data(), head_msg.size(), len > 0 ? MSG_MORE : 0))
+        return EXIT_FAILURE;
 
-    std::memcpy(data_msg.data()+8, data.data(), data.size());
     size_t sent = 0;
-    while (sent < data_msg.size()) {
-        ssize_t bytes_sent = send(socket_fd, data_msg.data()+sent, data_msg.size()-sent, MSG_NOSIGNAL);
+    while (sent < len) {
+        ssize_t bytes_sent = sendfile(socket_fd, file_fd, &offset, len-sent);
+        if (bytes_sent < 0 && errno == EINTR)
+            continue;
+        if (bytes_sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (!waitWritable(socket_fd))
+                return EXIT_FAILURE;
+            continue;
+        }
+        if (bytes_sent < 0 && (errno == EINVAL || errno == ENOSYS))
+            break; //this fd can't be sendfile'd, finish the message by hand
+        if (bytes_sent <= 0)
+            return EXIT_FAILURE; //error, or the file shrunk under us
         sent += bytes_sent;
     }
 
+    //fallback, the prefix is already out so the rest has to follow it
+    std::vector<uint8_t> buff;
+    while (sent < len) {
+        buff.resize(std::min<size_t>(len-sent, 1<<16));
+        ssize_t bytes_read = pread(file_fd, buff.data(), buff.size(), offset);
+        if (bytes_read < 0 && errno == EINTR)
+            continue;
+        if (bytes_read <= 0)
+            return EXIT_FAILURE;
+        if (!sendAll(socket_fd, buff.data(), bytes_read, 0))
+            return EXIT_FAILURE;
+        offset += bytes_read;
+        sent   += bytes_read;
+    }
+
     return EXIT_SUCCESS;
 }
 
@@ -228,35 +366,228 @@ ssize_t recvMessage(int                   socket_fd,
                     timeval               timeout) {
     int KEEP_ALIVE_LIMIT = 10;
     for (int i = 0; i < KEEP_ALIVE_LIMIT; ++i) {
-        std::vector<uint8_t> header;
-        ssize_t header_read = recvBytes(socket_fd, header, 8, timeout);
-        if (header_read != 8) {
+        uint8_t header[8];
+        if (recvInto(socket_fd, header, sizeof(header), timeout) != sizeof(header)) {
             return -1;
         }
         
-        //got header okay
+        //got header okay, the code says how big the message can be before
+        //the buffer's sized for it
         uint64_t data_len = bytesToMsgLen(header);
+        buffer.clear();
+        if (data_len > 0) {
+            uint8_t code;
+            if (recvInto(socket_fd, &code, 1, timeout) != 1)
+                return -1;
+            if (data_len > messageLimit(code))
+                return -1;
 
-        size_t total_recv = 0;
-        while (total_recv < data_len) {
-            ssize_t bytes_read = recvBytes(socket_fd, buffer, data_len - total_recv, timeout);
-            if (bytes_read < 0) {
+            //size the buffer once. a pooled buffer already has the room, so
+            //this doesn't allocate
+            buffer.resize(data_len);
+            buffer[0] = code;
+            if (data_len > 1 && recvInto(socket_fd, buffer.data() + 1, data_len - 1, timeout) < 0) {
+                buffer.clear();
                 return -1;
             }
-            total_recv += bytes_read;
         }
 
-        buffer.resize(total_recv);
         if (buffer.size() == 1 && *buffer.begin() == KEEP_ALIVE) {
             buffer.clear();
             continue;
         }
-        return total_recv;
+        return data_len;
     }
 
     return -1;
 }
 
+//reads what's waiting into dest, up to len. how much arrived, 0 if nothing
+//has, -1 if the connection's done
+static ssize_t recvWaiting(int socket_fd, uint8_t* dest, size_t len) {
+    ssize_t bytes_read;
+    do {
+        bytes_read = recv(socket_fd, dest, len, MSG_DONTWAIT);
+    } while (bytes_read < 0 && errno == EINTR);
+
+    if (bytes_read < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return 0;
+    if (bytes_read <= 0)
+        return -1;
+    return bytes_read;
+}
+
+int recvFrame(int socket_fd, FrameReader& reader, size_t max_len) {
+    while (true) {
+        if (reader.prefix_got < sizeof(reader.prefix)) {
+            ssize_t got = recvWaiting(socket_fd,
+                                      reader.prefix + reader.prefix_got,
+                                      sizeof(reader.prefix) - reader.prefix_got);
+            if (got <= 0)
+                return got;
+            reader.prefix_got += got;
+            if (reader.prefix_got < sizeof(reader.prefix))
+                return 0;
+
+            uint64_t data_len = bytesToMsgLen(reader.prefix);
+            if (data_len > max_len)
+                return -1;
+            reader.msg_len = data_len;
+            reader.msg.clear();
+            reader.msg_got = 0;
+        }
+
+        while (reader.msg_got < reader.msg_len) {
+            if (reader.msg_got == reader.msg.size()) {
+                //room for what's come so far again, not what the prefix claims
+                size_t room = std::max<size_t>(reader.msg_got * 2, FRAME_GROW_BYTES);
+                reader.msg.resize(std::min(reader.msg_len, room));
+            }
+
+            ssize_t got = recvWaiting(socket_fd,
+                                      reader.msg.data() + reader.msg_got,
+                                      reader.msg.size() - reader.msg_got);
+            if (got <= 0)
+                return got;
+            reader.msg_got += got;
+        }
+
+        //whole message, the next call starts on the one after it
+        reader.prefix_got = 0;
+        if (reader.msg.size() == 1 && reader.msg[0] == KEEP_ALIVE)
+            continue;
+        return 1;
+    }
+}
+
+//a frame with just its length prefix and header, for the rest to be added to
+static QueuedFrame frameHead(const std::vector<uint8_t>& header, size_t rest_len) {
+    QueuedFrame frame;
+    frame.head.resize(8 + header.size());
+    msgLenToBytes(header.size() + rest_len, frame.head.data());
+    std::copy(header.begin(), header.end(), frame.head.begin() + 8);
+    return frame;
+}
+
+static void pushFrame(FrameWriter& writer, QueuedFrame&& frame) {
+    writer.queued += frame.head.size() + (frame.body ? frame.body->size() : 0) + frame.file_len;
+    writer.frames.push_back(std::move(frame));
+}
+
+void queueFrame(FrameWriter& writer, const std::vector<uint8_t>& data) {
+    pushFrame(writer, frameHead(data, 0));
+}
+
+void queueFrame(FrameWriter&                                writer,
+                const std::vector<uint8_t>&                 header,
+                std::shared_ptr<const std::vector<uint8_t>> body) {
+    size_t      body_len = body ? body->size() : 0;
+    QueuedFrame frame    = frameHead(header, body_len);
+    if (body_len > 0)
+        frame.body = std::move(body);
+    pushFrame(writer, std::move(frame));
+}
+
+void queueFileFrame(FrameWriter&                writer,
+                    const std::vector<uint8_t>& header,
+                    int                         file_fd,
+                    off_t                       offset,
+                    size_t                      len,
+                    std::function<void()>       on_sent,
+                    std::function<void()>       on_short) {
+    QueuedFrame frame = frameHead(header, len);
+    frame.file_fd  = file_fd;
+    frame.offset   = offset;
+    frame.file_len = len;
+    frame.on_sent  = std::move(on_sent);
+    frame.on_short = std::move(on_short);
+    pushFrame(writer, std::move(frame));
+}
+
+//sends what it can of the file part of a frame, from done bytes in. how much
+//went, 0 if the socket's full, -1 if the connection broke, -2 if the file
+//ended early
+static ssize_t sendFilePart(int socket_fd, const QueuedFrame& frame, size_t done) {
+    off_t  offset = frame.offset + done;
+    size_t left   = frame.file_len - done;
+    ssize_t bytes_sent;
+    do {
+        bytes_sent = sendfile(socket_fd, frame.file_fd, &offset, left);
+    } while (bytes_sent < 0 && errno == EINTR);
+
+    if (bytes_sent < 0 && (errno == EINVAL || errno == ENOSYS)) {
+        //no sendfile() for this file, copy a piece through memory instead
+        uint8_t buff[1 << 16];
+        ssize_t bytes_read = pread(frame.file_fd, buff, std::min(left, sizeof(buff)), frame.offset + done);
+        if (bytes_read == 0)
+            return -2;
+        if (bytes_read < 0)
+            return -1;
+        bytes_sent = send(socket_fd, buff, bytes_read, MSG_DONTWAIT | MSG_NOSIGNAL);
+    }
+
+    if (bytes_sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return 0;
+    if (bytes_sent == 0)
+        return -2; //truncated since it was queued, can't be finished either
+    if (bytes_sent < 0)
+        return -1;
+    return bytes_sent;
+}
+
+int sendQueued(int socket_fd, FrameWriter& writer) {
+    while (!writer.frames.empty()) {
+        QueuedFrame& frame    = writer.frames.front();
+        size_t       body_len = frame.body ? frame.body->size() : 0;
+        size_t       mem_len  = frame.head.size() + body_len;
+
+        ssize_t bytes_sent;
+        if (writer.sent < mem_len) {
+            //head and body in one go, from wherever the last send stopped
+            struct iovec iov[2];
+            size_t       iov_cnt = 0;
+            if (writer.sent < frame.head.size())
+                iov[iov_cnt++] = {frame.head.data() + writer.sent, frame.head.size() - writer.sent};
+            size_t body_done = writer.sent > frame.head.size() ? writer.sent - frame.head.size() : 0;
+            if (body_done < body_len)
+                iov[iov_cnt++] = {const_cast<uint8_t*>(frame.body->data()) + body_done, body_len - body_done};
+
+            struct msghdr msg{};
+            msg.msg_iov    = iov;
+            msg.msg_iovlen = iov_cnt;
+            bytes_sent = sendmsg(socket_fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+            if (bytes_sent < 0 && errno == EINTR)
+                continue;
+            if (bytes_sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                return 0;
+            if (bytes_sent <= 0)
+                return -1;
+        } else {
+            bytes_sent = sendFilePart(socket_fd, frame, writer.sent - mem_len);
+            if (bytes_sent == -2 && frame.on_short)
+                frame.on_short();
+            if (bytes_sent < 0)
+                return -1;
+            if (bytes_sent == 0)
+                return 0;
+        }
+
+        writer.sent   += bytes_sent;
+        writer.queued -= bytes_sent;
+        if (writer.sent < mem_len + frame.file_len)
+            continue;
+
+        //whole frame's out
+        std::function<void()> on_sent = std::move(frame.on_sent);
+        writer.frames.pop_front();
+        writer.sent = 0;
+        if (on_sent)
+            on_sent();
+    }
+
+    return 1;
+}
+
 } //tcp
 
 //UDP UTIL
@@ -4,7 +4,6 @@
 #include "networking/messageFormatting.hpp"
 #include "networking/socket.hpp"
 #include <atomic>
-#include <condition_variable>
 #include <thread>
 #include <array>
 #include <iostream>
@@ -14,35 +13,6 @@
 
 namespace dfd {
 
-//sends a message to the client every 1s to stop timeouts
-//open as thread, notify with cv
-void keepClientAlive(int client_fd,
-                     std::atomic<bool>& run,
-                     std::mutex& m,
-                     std::condition_variable& cv) {
-    while (run) {
-        tcp::sendMessage(client_fd, {KEEP_ALIVE});
-        std::unique_lock<std::mutex> lock(m);
-        if (cv.wait_for(lock, std::chrono::milliseconds(1000), [&run] {return !run;}))
-            break;
-    }
-    return;
-}
-
-
-//receives tcp message with timeout. closes socket if nothing received.
-int recvClientRequest(int client_sock, std::vector<uint8_t>& buff) {
-    struct timeval timeout;
-    timeout.tv_sec  = 5;
-    timeout.tv_usec = 0;
-    ssize_t bytes_read = tcp::recvMessage(client_sock, buff, timeout);
-    if (bytes_read <= 0) {
-        closeSocket(client_sock);
-        return EXIT_FAILURE;
-    }
-    return EXIT_SUCCESS;
-}
-
 //receives udp message with timeout. DOES NOT close socket if nothing received
 int recvWorkerMessage(int worker_sock, SourceInfo& src_info, std::vector<uint8_t>& buff) {
     struct timeval timeout;
@@ -176,103 +146,67 @@ void workerNoReply(int                                              udp_sock,
     }
 }
 
-struct KeepAliveThread {
-    std::atomic<bool>       still_running = true;
-    std::mutex              keep_alive_mtx;
-    std::condition_variable keep_alive_cv;
-    std::thread             keep_alive_thread;
-
-    KeepAliveThread(int client_sock) {
-        keep_alive_thread = std::thread(keepClientAlive,
-                                        client_sock,
-                                        std::ref(still_running),
-                                        std::ref(keep_alive_mtx),
-                                        std::ref(keep_alive_cv));
-    }
-
-    ~KeepAliveThread() {
-        {
-            std::lock_guard<std::mutex> lock(keep_alive_mtx);
-            still_running = false;
-        }
-        keep_alive_cv.notify_one();
-        keep_alive_thread.join();
-    }
-};
-
-void clientConnection(int                                              client_sock,
-                      std::atomic<int>&                                next_reader,
-                      std::array<std::thread,       WORKER_THREADS  >& workers,
-                      std::array<std::atomic<bool>, WORKER_THREADS  >& worker_stats,
-                      std::array<std::atomic<int>,  WORKER_THREADS  >& worker_strikes,
-                      std::array<uint16_t,          WORKER_THREADS-1>& read_workers,
-                      uint16_t&                                        write_worker,
-                      std::mutex&                                      election_mtx,
-                      std::vector<SourceInfo>&                         known_servers,
-                      std::mutex&                                      known_server_mtx,
-                      std::atomic<bool>&                               record_msgs,
-                      std::queue<std::vector<uint8_t>>&                record_queue,
-                      std::mutex&                                      record_queue_mtx) {
-    //receive client message
-    std::vector<uint8_t> client_request;
-    SourceInfo client;
-    if (EXIT_FAILURE == recvClientRequest(client_sock, client_request))
-        return;
+bool takesClientSocket(const std::vector<uint8_t>& client_request) {
+    return !client_request.empty() && (client_request[0] == MIGRATE_OK ||
+                                       client_request[0] == DOWNLOAD_INIT);
+}
 
-    if (*client_request.begin() == SERVER_REG) {
-        SourceInfo si = parseNewServerReg(client_request);
-        client.ip_addr = si.ip_addr;
-        client.port    = si.port;
+bool serveClientRequest(int                   client_sock,
+                        std::vector<uint8_t>& client_request,
+                        std::vector<uint8_t>& reply,
+                        ClientContext&        ctx) {
+    reply.clear();
+    if (client_request.empty()) {
+        reply = createFailMessage("Invalid message.");
+        return false;
     }
 
     if (*client_request.begin() == MIGRATE_OK) {
         std::string path = "temp.db";
         deleteFile(path);
         closeSocket(client_sock);
-        return;
+        return false;
     }
 
     if (*client_request.begin() == DOWNLOAD_INIT) {
+        SourceInfo client;
         databaseSendNS(client_sock);
         {
-            std::lock_guard<std::mutex> lock(record_queue_mtx);
-            massWriteSend(client, record_queue);
+            std::lock_guard<std::mutex> lock(ctx.record_queue_mtx);
+            massWriteSend(client, ctx.record_queue);
         }
-        record_msgs = false;
+        ctx.record_msgs = false;
         closeSocket(client_sock);
-        return;
+        return false;
     }
     
     //save to mass write send
-    if (record_msgs == true){
+    if (ctx.record_msgs == true){
         {
-            std::lock_guard<std::mutex> lock(record_queue_mtx);
-            record_queue.push(client_request);
+            std::lock_guard<std::mutex> lock(ctx.record_queue_mtx);
+            ctx.record_queue.push(client_request);
         }
     }
 
     //open udp sock to talk to worker
     auto udp_sock_init = openSocket(false, 0, true);
     if (!udp_sock_init) {
-        closeSocket(client_sock);
-        return;
+        reply = createFailMessage("Server is out of resources. Sorry, please try another server.");
+        return false;
     }
 
-    //start up keep alive thread
-    KeepAliveThread* keep_alive = new KeepAliveThread(client_sock); 
-
     int worker_sock = udp_sock_init.value().first;
     for (int i = 0; i < 10; ++i) {
         //get address of worker to contact
         SourceInfo worker_addr; worker_addr.ip_addr = "127.0.0.1"; //workers are internal
-        auto res = selectWorker(client_request, next_reader, worker_stats, read_workers, write_worker);
+        auto res = selectWorker(client_request, ctx.next_reader, ctx.worker_stats, ctx.read_workers, ctx.write_worker);
         if (res.first == -1) continue; //read thread is down, we skip it
         int worker_id    = res.first;
         worker_addr.port = res.second;
 
         //send request 
         if (EXIT_FAILURE == udp::sendMessage(worker_sock, worker_addr, client_request)) {
-            worker_strikes[worker_id]++;
+            ctx.worker_strikes[worker_id]++;
             continue;
         }
 
@@ -284,49 +218,46 @@ void clientConnection(int                                              client_so
                 std::cout << parseFailMessage(worker_response) << std::endl;
             
             //WE GOT A REPLY
-            worker_strikes[worker_id] = 0;
-            
-            //shutdown keep alive thread
-            delete keep_alive;
-
-            //reply to client
-            tcp::sendMessage(client_sock, worker_response);
-            closeSocket(client_sock);
-
-            //sync with other servers
-            broadcastToServers(client_request, known_servers, known_server_mtx);
-
-            //if server reg, add the server to my list
-            if (*client_request.begin() == SERVER_REG) {
-                std::lock_guard<std::mutex> lock(known_server_mtx);
-                known_servers.push_back(client);
-            }
-
-            std::cout << "SERVER LIST:" << std::endl;
-            for (auto& serv : known_servers) {
-                std::cout << serv.ip_addr << " " << serv.port << std::endl;
-            }
-
-            return;
+            ctx.worker_strikes[worker_id] = 0;
+            closeSocket(worker_sock);
+            reply = std::move(worker_response);
+            return true;
         }
         
         //WE DIDN'T GET A REPLY FAST ENOUGH
         workerNoReply(worker_sock,
                       worker_id,
-                      next_reader,
-                      workers,
-                      worker_stats,
-                      worker_strikes,
-                      read_workers,
-                      write_worker,
-                      election_mtx);
+                      ctx.next_reader,
+                      ctx.workers,
+                      ctx.worker_stats,
+                      ctx.worker_strikes,
+                      ctx.read_workers,
+                      ctx.write_worker,
+                      ctx.election_mtx);
     }
 
-    delete keep_alive;
-    auto fail_msg = createFailMessage("Database appears to be down. Sorry, please try another server.");
-    tcp::sendMessage(client_sock, fail_msg);
-    closeSocket(client_sock);
+    closeSocket(worker_sock);
+    reply = createFailMessage("Database appears to be down. Sorry, please try another server.");
+    return false;
+}
+
+void syncClientRequest(std::vector<uint8_t>& client_request,
+                       ClientContext&        ctx) {
+    //sync with other servers
+    broadcastToServers(client_request, ctx.known_servers, ctx.known_server_mtx);
 
+    //if server reg, add the server to my list
+    if (*client_request.begin() == SERVER_REG) {
+        SourceInfo client = parseNewServerReg(client_request);
+        std::lock_guard<std::mutex> lock(ctx.known_server_mtx);
+        ctx.known_servers.push_back(client);
+    }
+
+    std::cout << "SERVER LIST:" << std::endl;
+    std::lock_guard<std::mutex> lock(ctx.known_server_mtx);
+    for (auto& serv : ctx.known_servers) {
+        std::cout << serv.ip_addr << " " << serv.port << std::endl;
+    }
 }
 
 }
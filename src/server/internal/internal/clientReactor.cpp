@@ -0,0 +1,616 @@
+#include "server/internal/internal/clientReactor.hpp"
+#include "networking/messageFormatting.hpp"
+#include "networking/socket.hpp"
+#include "sourceInfo.hpp"
+
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace dfd {
+
+using Clock = std::chrono::steady_clock;
+
+//how often a loop checks its clients for timeouts and keep alives, in ms. also
+//how long shutting down can take to be noticed
+#define REACTOR_TICK_MS 250
+
+//how long a loop stops accepting after running out of file descriptors, in ms
+#define REACTOR_ACCEPT_BACKOFF_MS 100
+
+enum class ConnState {
+    READING, //waiting on the request
+    WAITING, //request is with a handler, sending keep alives
+    WRITING  //reply is queued, reads the next request once it's out
+};
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * ClientConn
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> One client connection, owned by the loop that accepted it.
+ *
+ * Member Variables:
+ * -> id:
+ *    Unique to the loop, so a reply for a connection that's since closed
+ *    isn't sent to whoever got its file descriptor next.
+ * -> state:
+ *    Where the connection is in its request.
+ * -> in:
+ *    The request, as it arrives.
+ * -> out:
+ *    Keep alives and the reply, as they go.
+ * -> due:
+ *    When the connection times out while READING, when the next keep alive
+ *    is sent while WAITING, and when it's closed while WRITING if none of the
+ *    reply has gone by then.
+ * -> watching_out:
+ *    If the loop is waiting for room to send on the socket.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+struct ClientConn {
+    uint64_t          id           = 0;
+    ConnState         state        = ConnState::READING;
+    FrameReader       in;
+    FrameWriter       out;
+    Clock::time_point due;
+    bool              watching_out = false;
+};
+
+//a reply from a handler for a loop to send
+struct HandlerDone {
+    int                  fd;
+    uint64_t             id;
+    std::vector<uint8_t> reply;
+};
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * ReactorLoop
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> One event loop. Everything but done and done_mtx is only touched by the
+ *    loop's own thread.
+ *
+ * Member Variables:
+ * -> epoll_fd:
+ *    The loop's epoll instance, watching the listener, wake_fd and conns.
+ * -> wake_fd:
+ *    An eventfd handlers write to once they've pushed onto done.
+ * -> conns:
+ *    The loop's clients, by socket.
+ * -> next_id:
+ *    The id the next client accepted gets.
+ * -> done:
+ *    Replies from handlers not yet picked up.
+ * -> done_mtx:
+ *    Guards done.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+struct ReactorLoop {
+    int                                 epoll_fd = -1;
+    int                                 wake_fd  = -1;
+    std::unordered_map<int, ClientConn> conns;
+    uint64_t                            next_id  = 1;
+    std::vector<HandlerDone>            done;
+    std::mutex                          done_mtx;
+};
+
+//a request for a handler. loop is nullptr if the handler has the socket to
+//itself
+struct HandlerJob {
+    ReactorLoop*         loop = nullptr;
+    int                  fd   = -1;
+    uint64_t             id   = 0;
+    std::vector<uint8_t> request;
+};
+
+//requests waiting on a handler, shared by every loop
+struct HandlerPool {
+    std::deque<HandlerJob>  jobs;
+    bool                    stopping = false;
+    std::mutex              mtx;
+    std::condition_variable ready;
+};
+
+//served requests waiting to be passed on to the other servers
+struct SyncQueue {
+    std::deque<std::vector<uint8_t>> requests;
+    bool                             stopping = false;
+    std::mutex                       mtx;
+    std::condition_variable          ready;
+};
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * syncThread
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Designed to be opened as a thread. Passes served requests on to the other
+ *    servers in the order they were served, so a slow server only holds up
+ *    this thread. Returns once the queue is stopping and empty.
+ *
+ * Takes:
+ * -> syncs:
+ *    The served requests.
+ * -> ctx:
+ *    The server.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+static void syncThread(SyncQueue& syncs, ClientContext& ctx) {
+    while (true) {
+        std::vector<uint8_t> request;
+        {
+            std::unique_lock<std::mutex> lock(syncs.mtx);
+            syncs.ready.wait(lock, [&syncs]{ return !syncs.requests.empty() || syncs.stopping; });
+            if (syncs.requests.empty())
+                return;
+            request = std::move(syncs.requests.front());
+            syncs.requests.pop_front();
+        }
+
+        syncClientRequest(request, ctx);
+    }
+}
+
+//hands a served request to the sync thread, dropping it if that's too far
+//behind
+static void queueSync(SyncQueue& syncs, std::vector<uint8_t>& request) {
+    {
+        std::lock_guard<std::mutex> lock(syncs.mtx);
+        if (syncs.requests.size() < SERVER_SYNC_QUEUE_MAX) {
+            syncs.requests.push_back(std::move(request));
+            syncs.ready.notify_one();
+            return;
+        }
+    }
+    std::cerr << "Sync queue full, not passing a request on to the other servers." << std::endl;
+}
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * handlerThread
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Designed to be opened as a thread. Serves requests off the pool and
+ *    passes each reply back to the loop it came from, then queues the request
+ *    to be synced with the other servers. Returns once the pool is stopping
+ *    and empty.
+ *
+ * Takes:
+ * -> pool:
+ *    The requests.
+ * -> syncs:
+ *    Where served requests go to be passed on.
+ * -> ctx:
+ *    The server.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+static void handlerThread(HandlerPool& pool, SyncQueue& syncs, ClientContext& ctx) {
+    while (true) {
+        HandlerJob job;
+        {
+            std::unique_lock<std::mutex> lock(pool.mtx);
+            pool.ready.wait(lock, [&pool]{ return !pool.jobs.empty() || pool.stopping; });
+            if (pool.jobs.empty())
+                return;
+            job = std::move(pool.jobs.front());
+            pool.jobs.pop_front();
+        }
+
+        std::vector<uint8_t> reply;
+        bool sync = serveClientRequest(job.fd, job.request, reply, ctx);
+
+        //a nullptr loop was served over the socket, already closed
+        if (job.loop != nullptr) {
+            {
+                std::lock_guard<std::mutex> lock(job.loop->done_mtx);
+                job.loop->done.push_back({job.fd, job.id, std::move(reply)});
+            }
+            uint64_t one = 1;
+            ssize_t  res = write(job.loop->wake_fd, &one, sizeof(one));
+            (void)res; //only fails if the counter's full, and then it's awake anyway
+        }
+
+        //client has its reply, now the other servers can be told
+        if (sync)
+            queueSync(syncs, job.request);
+    }
+}
+
+//changes what the loop waits on for a socket
+static void watch(ReactorLoop& loop, int fd, uint32_t events) {
+    struct epoll_event ev{};
+    ev.events  = events;
+    ev.data.fd = fd;
+    epoll_ctl(loop.epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+}
+
+static void closeConn(ReactorLoop& loop, int fd) {
+    closeSocket(fd); //leaves the epoll set with it
+    loop.conns.erase(fd);
+}
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * flushConn
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Sends what's queued for a client, and waits for room on the socket if it
+ *    didn't all go. While a reply's going out, anything sent puts off closing
+ *    the client for SEND_STALL_MS. Once it's out, goes back to reading the
+ *    client's next request.
+ *
+ * Takes:
+ * -> loop:
+ *    The loop that owns the client.
+ * -> fd:
+ *    The client's socket.
+ * -> conn:
+ *    The client.
+ *
+ * Returns:
+ * -> true if the connection carries on, false if it broke and should be
+ *    closed.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+static bool flushConn(ReactorLoop& loop, int fd, ClientConn& conn) {
+    size_t queued = conn.out.queued;
+    int    res    = tcp::sendQueued(fd, conn.out);
+    if (res < 0)
+        return false;
+    if (conn.state == ConnState::WRITING && conn.out.queued < queued)
+        conn.due = Clock::now() + std::chrono::milliseconds(SEND_STALL_MS); //still taking it
+    if (res == 1 && conn.state == ConnState::WRITING) {
+        //kept open for the client's next request, which may already be here
+        conn.state        = ConnState::READING;
+        conn.due          = Clock::now() + std::chrono::milliseconds(CLIENT_IDLE_MS);
+        conn.watching_out = false;
+        watch(loop, fd, EPOLLIN);
+        return true;
+    }
+
+    bool want_out = res == 0;
+    if (want_out != conn.watching_out) {
+        uint32_t events = conn.state == ConnState::READING ? (uint32_t)EPOLLIN : 0u;
+        watch(loop, fd, events | (want_out ? (uint32_t)EPOLLOUT : 0u));
+        conn.watching_out = want_out;
+    }
+    return true;
+}
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * acceptClients
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Accepts every client waiting on the listener onto the loop.
+ *
+ * Takes:
+ * -> loop:
+ *    The loop to own them.
+ * -> listener:
+ *    The non-blocking listening socket.
+ *
+ * Returns:
+ * -> true if the listener's drained, false if the process is out of file
+ *    descriptors and accepting should back off.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+static bool acceptClients(ReactorLoop& loop, int listener) {
+    while (true) {
+        SourceInfo client;
+        int client_sock = tcp::accept(listener, client);
+        if (client_sock < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            return errno != EMFILE && errno != ENFILE;
+        }
+
+        struct epoll_event ev{};
+        ev.events  = EPOLLIN;
+        ev.data.fd = client_sock;
+        if (EXIT_SUCCESS != setBlocking(client_sock, false) ||
+            epoll_ctl(loop.epoll_fd, EPOLL_CTL_ADD, client_sock, &ev) < 0) {
+            closeSocket(client_sock);
+            continue;
+        }
+
+        ClientConn& conn = loop.conns[client_sock];
+        conn       = ClientConn{};
+        conn.id    = loop.next_id++;
+        conn.due   = Clock::now() + std::chrono::milliseconds(CLIENT_REQUEST_TIMEOUT_MS);
+    }
+}
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * readRequest
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Reads what's arrived of a client's request, and hands it to a handler
+ *    once it's whole.
+ *
+ * Takes:
+ * -> loop:
+ *    The loop that owns the client.
+ * -> fd:
+ *    The client's socket.
+ * -> conn:
+ *    The client.
+ * -> pool:
+ *    Where to hand the request.
+ *
+ * Returns:
+ * -> false if the client should be closed, true otherwise.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+static bool readRequest(ReactorLoop& loop, int fd, ClientConn& conn, HandlerPool& pool) {
+    int res = tcp::recvFrame(fd, conn.in, SERVER_REQUEST_MAX);
+    if (res < 0)
+        return false;
+    if (res == 0)
+        return true; //more to come
+
+    HandlerJob job;
+    job.loop    = &loop;
+    job.fd      = fd;
+    job.id      = conn.id;
+    job.request = std::move(conn.in.msg);
+    conn.in     = FrameReader{};
+
+    if (takesClientSocket(job.request)) {
+        //the handler gets the socket to itself, the loop forgets it
+        epoll_ctl(loop.epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+        loop.conns.erase(fd);
+        setBlocking(fd, true);
+        job.loop = nullptr;
+    } else {
+        //one request at a time, the next waits in the socket until this one's
+        //answered so replies go out in order. hangups still come in
+        conn.state = ConnState::WAITING;
+        conn.due   = Clock::now() + std::chrono::milliseconds(CLIENT_KEEP_ALIVE_MS);
+        watch(loop, fd, conn.watching_out ? (uint32_t)EPOLLOUT : 0u);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(pool.mtx);
+        pool.jobs.push_back(std::move(job));
+    }
+    pool.ready.notify_one();
+    return true;
+}
+
+//sends the replies handlers have finished for the loop's clients
+static void sendReplies(ReactorLoop& loop) {
+    uint64_t count;
+    ssize_t  res = read(loop.wake_fd, &count, sizeof(count));
+    (void)res;
+
+    std::vector<HandlerDone> done;
+    {
+        std::lock_guard<std::mutex> lock(loop.done_mtx);
+        done.swap(loop.done);
+    }
+
+    for (HandlerDone& reply : done) {
+        auto it = loop.conns.find(reply.fd);
+        if (it == loop.conns.end() || it->second.id != reply.id)
+            continue; //client went away while it was being served
+
+        ClientConn& conn = it->second;
+        tcp::queueFrame(conn.out, reply.reply);
+        if (conn.out.queued > CLIENT_OUT_MAX) {
+            closeConn(loop, reply.fd); //more than the client should be owed
+            continue;
+        }
+
+        conn.state = ConnState::WRITING;
+        conn.due   = Clock::now() + std::chrono::milliseconds(SEND_STALL_MS);
+        if (!flushConn(loop, reply.fd, conn))
+            closeConn(loop, reply.fd);
+    }
+}
+
+//times out clients that haven't sent a request in time or stopped taking
+//their reply, and keeps alive the ones waiting on a reply
+static void sweepClients(ReactorLoop& loop) {
+    static const std::vector<uint8_t> keep_alive = {KEEP_ALIVE};
+
+    Clock::time_point now = Clock::now();
+    std::vector<int>  dead;
+    for (auto& [fd, conn] : loop.conns) {
+        if (now < conn.due)
+            continue;
+
+        if (conn.state != ConnState::WAITING) {
+            dead.push_back(fd);
+        } else {
+            conn.due = now + std::chrono::milliseconds(CLIENT_KEEP_ALIVE_MS);
+            if (conn.out.queued > 0)
+                continue; //the last one hasn't gone, no use piling more up
+            tcp::queueFrame(conn.out, keep_alive);
+            if (!flushConn(loop, fd, conn))
+                dead.push_back(fd);
+        }
+    }
+
+    for (int fd : dead)
+        closeConn(loop, fd);
+}
+
+/*
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * runLoop
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Description:
+ * -> Designed to be opened as a thread. Runs one event loop until
+ *    server_running is cleared, then closes its clients and its epoll
+ *    instance. wake_fd is left for clientReactor() to close once no handler
+ *    can write to it.
+ *
+ * Takes:
+ * -> server_running:
+ *    Cleared to shut down.
+ * -> listener:
+ *    The non-blocking listening socket.
+ * -> loop:
+ *    The loop, already watching listener and wake_fd.
+ * -> pool:
+ *    Where to hand requests.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ */
+static void runLoop(std::atomic<bool>& server_running,
+                    int                listener,
+                    ReactorLoop&       loop,
+                    HandlerPool&       pool) {
+    std::array<struct epoll_event, 256> events;
+    std::optional<Clock::time_point>    accept_paused;
+    Clock::time_point                   next_sweep = Clock::now();
+
+    while (server_running) {
+        int ready = epoll_wait(loop.epoll_fd, events.data(), events.size(), REACTOR_TICK_MS);
+        if (ready < 0 && errno != EINTR)
+            break;
+
+        for (int i = 0; i < ready; ++i) {
+            int      fd = events[i].data.fd;
+            uint32_t ev = events[i].events;
+            if (fd == listener) {
+                if (!acceptClients(loop, listener)) {
+                    //out of descriptors, the listener would just keep waking us
+                    epoll_ctl(loop.epoll_fd, EPOLL_CTL_DEL, listener, nullptr);
+                    accept_paused = Clock::now() + std::chrono::milliseconds(REACTOR_ACCEPT_BACKOFF_MS);
+                }
+                continue;
+            }
+
+            if (fd == loop.wake_fd) {
+                sendReplies(loop);
+                continue;
+            }
+
+            auto it = loop.conns.find(fd);
+            if (it == loop.conns.end())
+                continue; //closed earlier in this batch
+
+            ClientConn& conn = it->second;
+            bool        keep = !(ev & (EPOLLERR | EPOLLHUP));
+            if (keep && (ev & EPOLLIN) && conn.state == ConnState::READING)
+                keep = readRequest(loop, fd, conn, pool);
+            if (keep && (ev & EPOLLOUT) && loop.conns.count(fd))
+                keep = flushConn(loop, fd, conn);
+            if (!keep && loop.conns.count(fd))
+                closeConn(loop, fd);
+        }
+
+        Clock::time_point now = Clock::now();
+        if (accept_paused && now >= *accept_paused) {
+            struct epoll_event ev{};
+            ev.events  = EPOLLIN | EPOLLEXCLUSIVE;
+            ev.data.fd = listener;
+            epoll_ctl(loop.epoll_fd, EPOLL_CTL_ADD, listener, &ev);
+            accept_paused.reset();
+        }
+
+        if (now >= next_sweep) {
+            sweepClients(loop);
+            next_sweep = now + std::chrono::milliseconds(REACTOR_TICK_MS);
+        }
+    }
+
+    for (auto& [fd, conn] : loop.conns)
+        closeSocket(fd);
+    loop.conns.clear();
+    closeSocket(loop.epoll_fd);
+}
+
+//creates a loop's epoll instance and eventfd, watching the listener
+static int openLoop(ReactorLoop& loop, int listener) {
+    loop.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    loop.wake_fd  = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (loop.epoll_fd < 0 || loop.wake_fd < 0)
+        return EXIT_FAILURE;
+
+    //exclusive so a new client wakes one loop, not all of them
+    struct epoll_event ev{};
+    ev.events  = EPOLLIN | EPOLLEXCLUSIVE;
+    ev.data.fd = listener;
+    if (epoll_ctl(loop.epoll_fd, EPOLL_CTL_ADD, listener, &ev) < 0)
+        return EXIT_FAILURE;
+
+    ev.events  = EPOLLIN;
+    ev.data.fd = loop.wake_fd;
+    if (epoll_ctl(loop.epoll_fd, EPOLL_CTL_ADD, loop.wake_fd, &ev) < 0)
+        return EXIT_FAILURE;
+    return EXIT_SUCCESS;
+}
+
+void clientReactor(std::atomic<bool>& server_running,
+                   int                listener,
+                   ClientContext&     ctx) {
+    std::array<ReactorLoop, SERVER_REACTOR_LOOPS> loops;
+    bool opened = EXIT_SUCCESS == setBlocking(listener, false);
+    for (ReactorLoop& loop : loops)
+        opened = opened && EXIT_SUCCESS == openLoop(loop, listener);
+
+    if (!opened) {
+        std::cerr << "Could not start the client event loops." << std::endl;
+        for (ReactorLoop& loop : loops) {
+            if (loop.epoll_fd >= 0) closeSocket(loop.epoll_fd);
+            if (loop.wake_fd  >= 0) closeSocket(loop.wake_fd);
+        }
+        return;
+    }
+
+    HandlerPool              pool;
+    SyncQueue                syncs;
+    std::thread              syncer(syncThread, std::ref(syncs), std::ref(ctx));
+    std::vector<std::thread> handlers;
+    for (int i = 0; i < SERVER_HANDLER_THREADS; ++i)
+        handlers.emplace_back(handlerThread, std::ref(pool), std::ref(syncs), std::ref(ctx));
+
+    //this thread runs the first loop
+    std::vector<std::thread> loop_threads;
+    for (size_t i = 1; i < loops.size(); ++i)
+        loop_threads.emplace_back(runLoop,
+                                  std::ref(server_running),
+                                  listener,
+                                  std::ref(loops[i]),
+                                  std::ref(pool));
+    runLoop(server_running, listener, loops[0], pool);
+
+    for (std::thread& t : loop_threads)
+        t.join();
+
+    {
+        std::lock_guard<std::mutex> lock(pool.mtx);
+        pool.stopping = true;
+    }
+    pool.ready.notify_all();
+    for (std::thread& t : handlers)
+        t.join();
+
+    {
+        std::lock_guard<std::mutex> lock(syncs.mtx);
+        syncs.stopping = true;
+    }
+    syncs.ready.notify_all();
+    syncer.join();
+
+    for (ReactorLoop& loop : loops)
+        closeSocket(loop.wake_fd);
+}
+
+} //dfd
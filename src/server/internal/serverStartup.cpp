@@ -51,8 +51,8 @@ int migrationHandshake(const SourceInfo&           server,
         return EXIT_FAILURE;
     }
 
-    auto [size, name] = parseDownloadConfirm(response_buff);
-    if (size == 0 || name != "temp.db") {
+    auto [size, c_size, name] = parseDownloadConfirm(response_buff);
+    if (size == 0 || c_size != getChunkSize() || name != "temp.db") {
         std::cerr << "[ERR] Failed to parseDownloadConfirm for db migration." << std::endl;
         closeSocket(sock);
         return EXIT_FAILURE;
@@ -112,7 +112,7 @@ int databaseSendNS(int socket_fd) {
         return EXIT_FAILURE;
     }
     ssize_t f_size = f_size_op.value();
-    std::vector<uint8_t> confirm_buff = createDownloadConfirm(f_size, "temp.db");
+    std::vector<uint8_t> confirm_buff = createDownloadConfirm(f_size, getChunkSize(), "temp.db");
     tcp::sendMessage(socket_fd, confirm_buff);
 
     std::vector<uint8_t> ack_buff;
@@ -121,7 +121,7 @@ int databaseSendNS(int socket_fd) {
 
         //read chunk
         std::vector<uint8_t> chunk;
-        auto res = packageFileChunk(temp_path, chunk, chunk_id);
+        auto res = packageFileChunk(temp_path, chunk, chunk_id, getChunkSize());
         if (!res) {
             //could not read file for some reason
             std::vector<uint8_t> fail_msg = createFailMessage("Sorry, file appears to be unavailable.");
@@ -129,12 +129,10 @@ int databaseSendNS(int socket_fd) {
             return EXIT_FAILURE;
         }
 
-        //send chunk
+        //send chunk, framed around the data instead of copied in behind a header
         chunk.resize(res.value());
-        DataChunk dc = {chunk_id, chunk};
-        std::vector<uint8_t> chunk_msg = createDataChunk(dc);
-        double X=((double)rand()/(double)RAND_MAX);
-        if (!sendOkay(socket_fd, chunk_msg)) {
+        std::vector<uint8_t> header = createDataChunkHeader(chunk_id);
+        if (header.empty() || EXIT_SUCCESS != tcp::sendFramed(socket_fd, {header, chunk})) {
             return EXIT_FAILURE;
         }
 
@@ -179,7 +177,7 @@ int databaseReciveNS(const SourceInfo& server) {
     }
 
 
-    auto chunks_in_file_opt = fileChunks(f_size);
+    auto chunks_in_file_opt = fileChunks(f_size, getChunkSize());
     if (!chunks_in_file_opt) {
         std::cerr << "[ERR] Received erroneous file size at db migration." << std::endl;
         return EXIT_FAILURE;
@@ -200,7 +198,7 @@ int databaseReciveNS(const SourceInfo& server) {
                 closeSocket(sock);
                 return EXIT_FAILURE;
             }
-            assembleChunk(file_out.get(), f_name, i);
+            assembleChunk(file_out.get(), f_name, i, getChunkSize());
         }
         sendOkay(sock1, {FINISH_DOWNLOAD});
         closeSocket(sock1);
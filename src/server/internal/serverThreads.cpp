@@ -2,7 +2,7 @@
 #include "networking/messageFormatting.hpp"
 #include "server/internal/internal/electionThread.hpp"
 #include "server/internal/internal/workerActions.hpp"
-#include "server/internal/internal/clientConnection.hpp"
+#include "server/internal/internal/clientReactor.hpp"
 #include "server/internal/syncing.hpp"
 #include "networking/socket.hpp"
 
@@ -127,38 +127,28 @@ void listenThread(std::atomic<bool>&                               server_runnin
 
     auto& [my_sock, _] = socket.value();
 
-    if (EXIT_FAILURE == listen(my_sock, 10)) {
+    if (EXIT_FAILURE == listen(my_sock, SERVER_LISTEN_BACKLOG)) {
         std::cerr << "Could not start listening." << std::endl;
         closeSocket(my_sock);
         return;
     }
 
     std::atomic<int> next_reader = 0;
+    ClientContext ctx{next_reader,
+                      workers,
+                      worker_stats,
+                      worker_strikes,
+                      read_workers,
+                      write_worker,
+                      election_mtx,
+                      known_servers,
+                      known_servers_mtx,
+                      record_msgs,
+                      record_queue,
+                      record_queue_mtx};
     ///////////////////////////////////////////////////////////////////////
     //MAIN LOOP
-    while (server_running) {
-        SourceInfo client;
-        int client_sock = tcp::accept(my_sock, client);
-        if (client_sock < 0) {
-            continue;
-        } else {
-            std::thread client_conn(clientConnection,
-                                    client_sock,
-                                    std::ref(next_reader),
-                                    std::ref(workers),
-                                    std::ref(worker_stats),
-                                    std::ref(worker_strikes),
-                                    std::ref(read_workers),
-                                    std::ref(write_worker),
-                                    std::ref(election_mtx),
-                                    std::ref(known_servers),
-                                    std::ref(known_servers_mtx),
-                                    std::ref(record_msgs),
-                                    std::ref(record_queue),
-                                    std::ref(record_queue_mtx));
-            client_conn.detach();
-        }
-    }
+    clientReactor(server_running, my_sock, ctx);
 
     ///////////////////////////////////////////////////////////////////////
     //SHUTDOWN PROCESS